@@ -30,6 +30,7 @@
 #include <vmm_error.h>
 #include <libs/kallsyms.h>
 #include <libs/stacktrace.h>
+#include <arch_regs.h>
 
 struct stackframe {
 	unsigned long fp;
@@ -129,3 +130,19 @@ void arch_save_stacktrace(struct stack_trace *trace)
 	walk_stackframe(&frame, save_trace, &data);
 }
 
+void arch_save_stacktrace_regs(struct arch_regs *regs,
+			       struct stack_trace *trace)
+{
+	struct stack_trace_data data;
+	struct stackframe frame;
+
+	data.trace = trace;
+	data.skip = trace->skip;
+
+	frame.fp = regs->gpr[11];
+	frame.sp = regs->sp;
+	frame.lr = regs->lr;
+	frame.pc = regs->pc;
+
+	walk_stackframe(&frame, save_trace, &data);
+}
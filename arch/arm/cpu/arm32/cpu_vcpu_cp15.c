@@ -787,7 +787,8 @@ int cpu_vcpu_cp15_trans_fault(struct vmm_vcpu *vcpu,
 	bool is_user, is_virtual;
 	int rc, access_type;
 	struct cpu_page pg;
-	physical_size_t availsz;
+	physical_addr_t gpa;
+	physical_size_t gsz, availsz;
 	struct arm_priv_cp15 *cp15 = &arm_priv(vcpu)->cp15;
 
 	/* If VCPU tried to access hypervisor space then
@@ -830,14 +831,17 @@ int cpu_vcpu_cp15_trans_fault(struct vmm_vcpu *vcpu,
 		pg.va = info->far & ~(pg.sz - 1);
 	}
 
+	gpa = pg.pa;
+	gsz = pg.sz;
 	if ((rc = vmm_guest_physical_map(vcpu->guest,
-					 pg.pa, pg.sz,
+					 gpa, gsz,
 					 &pg.pa, &availsz,
 					 &reg_flags))) {
 		vmm_manager_vcpu_halt(vcpu);
 		return rc;
 	}
 	if (availsz < TTBL_L2TBL_SMALL_PAGE_SIZE) {
+		vmm_guest_physical_unmap(vcpu->guest, gpa, gsz);
 		return rc;
 	}
 	orig_domain = pg.dom;
@@ -969,7 +973,11 @@ int cpu_vcpu_cp15_trans_fault(struct vmm_vcpu *vcpu,
 		pg.b = pg.b && (reg_flags & VMM_REGION_BUFFERABLE);
 	}
 
-	return cpu_vcpu_cp15_vtlb_update(cp15, &pg, orig_domain, is_virtual);
+	/* Keep demand allocated chunk pinned till VTLB is updated */
+	rc = cpu_vcpu_cp15_vtlb_update(cp15, &pg, orig_domain, is_virtual);
+	vmm_guest_physical_unmap(vcpu->guest, gpa, gsz);
+
+	return rc;
 }
 
 int cpu_vcpu_cp15_access_fault(struct vmm_vcpu *vcpu,
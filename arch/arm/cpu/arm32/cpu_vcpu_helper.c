@@ -771,6 +771,13 @@ int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 	return VMM_OK;
 }
 
+int arch_guest_unmap_memory(struct vmm_guest *guest,
+			    physical_addr_t gphys_addr,
+			    physical_size_t gphys_size)
+{
+	return VMM_ENOTSUPP;
+}
+
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
 {
 	int rc;
@@ -1102,6 +1109,11 @@ void cpu_vcpu_dump_user_reg(struct vmm_vcpu *vcpu, arch_regs_t *regs)
 	__cpu_vcpu_dump_user_reg(NULL, vcpu, regs);
 }
 
+virtual_addr_t arch_regs_pc(arch_regs_t *regs)
+{
+	return (virtual_addr_t)regs->pc;
+}
+
 void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	u32 i;
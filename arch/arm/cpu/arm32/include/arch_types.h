@@ -38,9 +38,16 @@ typedef struct {
 	volatile long long counter;
 } atomic64_t;
 
+#if defined(CONFIG_ARM_TICKET_LOCKS)
+/* Next ticket in bits[31:16] and owner ticket in bits[15:0] */
+typedef struct {
+	volatile unsigned int lock;
+} arch_spinlock_t;
+#else
 typedef struct {
 	volatile long lock;
 } arch_spinlock_t;
+#endif
 
 #define ARCH_ATOMIC_INIT(_lptr, val)		\
 	(_lptr)->counter = (val)
@@ -54,7 +61,12 @@ typedef struct {
 #define ARCH_ATOMIC64_INITIALIZER(val)		\
 	{ .counter = (val), }
 
+#if defined(CONFIG_ARM_TICKET_LOCKS)
+#define __ARCH_SPIN_TICKET_SHIFT	16
+#define __ARCH_SPIN_UNLOCKED		0
+#else
 #define __ARCH_SPIN_UNLOCKED		0xffffffff
+#endif
 
 /* FIXME: Need memory barrier for this. */
 #define ARCH_SPIN_LOCK_INIT(_lptr)		\
@@ -63,6 +75,28 @@ typedef struct {
 #define ARCH_SPIN_LOCK_INITIALIZER		\
 	{ .lock = __ARCH_SPIN_UNLOCKED, }
 
+#if defined(CONFIG_ARM_QUEUED_RWLOCKS)
+/* Writer state in bits[8:0] and reader count from bit 9 onwards.
+ * Waiters queue up in FIFO order on the wait ticket lock.
+ */
+typedef struct {
+	atomic_t cnts;
+	arch_spinlock_t wait;
+} arch_rwlock_t;
+
+#define __ARCH_RW_WLOCKED		0xff
+#define __ARCH_RW_WWAITING		0x100
+#define __ARCH_RW_WMASK			0x1ff
+#define __ARCH_RW_RBIAS			0x200
+
+#define ARCH_RW_LOCK_INIT(_lptr)		\
+	(ARCH_ATOMIC_INIT(&(_lptr)->cnts, 0),	\
+	 ARCH_SPIN_LOCK_INIT(&(_lptr)->wait))
+
+#define ARCH_RW_LOCK_INITIALIZER		\
+	{ .cnts = ARCH_ATOMIC_INITIALIZER(0),	\
+	  .wait = ARCH_SPIN_LOCK_INITIALIZER, }
+#else
 typedef struct {
 	volatile long lock;
 } arch_rwlock_t;
@@ -76,6 +110,7 @@ typedef struct {
 
 #define ARCH_RW_LOCK_INITIALIZER		\
 	{ .lock = __ARCH_RW_UNLOCKED, }
+#endif
 
 #define ARCH_BITS_PER_LONG		32
 
@@ -25,6 +25,7 @@
 #define _ARCH_CONFIG_H__
 
 #define ARCH_HAS_MEMORY_READWRITE
+#define ARCH_MEMORY_READWRITE_PAGES	16
 
 #define ARCH_HAS_MEMCPY
 #define ARCH_HAS_MEMSET
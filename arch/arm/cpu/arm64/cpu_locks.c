@@ -27,6 +27,89 @@
 #include <vmm_compiler.h>
 #include <arch_barrier.h>
 
+#if defined(CONFIG_ARM_TICKET_LOCKS)
+
+#define TICKET_OWNER(v)		((v) & 0xffff)
+#define TICKET_NEXT(v)		((v) >> __ARCH_SPIN_TICKET_SHIFT)
+
+/* Owner ticket is the low halfword of lock value (little endian) */
+#define TICKET_OWNER_REF(l)	(*(volatile u16 *)&(l)->lock)
+
+bool __lock arch_spin_lock_check(arch_spinlock_t *lock)
+{
+	u32 val = lock->lock;
+
+	return (TICKET_OWNER(val) == TICKET_NEXT(val)) ? FALSE : TRUE;
+}
+
+void __lock arch_spin_lock(arch_spinlock_t *lock)
+{
+	unsigned int val, newval, tmp;
+
+	__asm__ __volatile__(
+"	prfm	pstl1strm, %3\n"
+"1:	ldaxr	%w0, %3\n"
+"	add	%w1, %w0, %w5\n"
+"	stxr	%w2, %w1, %3\n"
+"	cbnz	%w2, 1b\n"
+	/* Did we get the lock? */
+"	eor	%w1, %w0, %w0, ror #16\n"
+"	cbz	%w1, 3f\n"
+	/* No, wait for owner ticket to reach our ticket. Owner
+	 * update clears our exclusive monitor and wakes us up.
+	 */
+"	sevl\n"
+"2:	wfe\n"
+"	ldaxrh	%w2, %4\n"
+"	eor	%w1, %w2, %w0, lsr #16\n"
+"	cbnz	%w1, 2b\n"
+"3:\n"
+	: "=&r" (val), "=&r" (newval), "=&r" (tmp), "+Q" (lock->lock)
+	: "Q" (TICKET_OWNER_REF(lock)), "r" (1 << __ARCH_SPIN_TICKET_SHIFT)
+	: "cc", "memory");
+
+	arch_smp_mb();
+}
+
+int __lock arch_spin_trylock(arch_spinlock_t *lock)
+{
+	unsigned int val, tmp;
+
+	__asm__ __volatile__(
+"	prfm	pstl1strm, %2\n"
+"1:	ldaxr	%w0, %2\n"
+"	eor	%w1, %w0, %w0, ror #16\n"
+"	cbnz	%w1, 2f\n"
+"	add	%w0, %w0, %w3\n"
+"	stxr	%w1, %w0, %2\n"
+"	cbnz	%w1, 1b\n"
+"2:\n"
+	: "=&r" (val), "=&r" (tmp), "+Q" (lock->lock)
+	: "r" (1 << __ARCH_SPIN_TICKET_SHIFT)
+	: "cc", "memory");
+
+	if (tmp == 0) {
+		arch_smp_mb();	/* do mb if we succeeded */
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+void __lock arch_spin_unlock(arch_spinlock_t *lock)
+{
+	arch_smp_mb();
+
+	/* Serve next ticket. Only owner writes owner ticket. */
+	__asm__ __volatile__(
+"	stlrh	%w1, %0\n"
+	: "=Q" (TICKET_OWNER_REF(lock))
+	: "r" (TICKET_OWNER(lock->lock) + 1)
+	: "memory");
+}
+
+#else
+
 bool __lock arch_spin_lock_check(arch_spinlock_t *lock)
 {
 	return (lock->lock == __ARCH_SPIN_UNLOCKED) ? FALSE : TRUE;
@@ -87,6 +170,10 @@ void __lock arch_spin_unlock(arch_spinlock_t *lock)
 	: "memory");
 }
 
+#endif
+
+#if !defined(CONFIG_ARM_QUEUED_RWLOCKS)
+
 bool __lock arch_write_lock_check(arch_rwlock_t *lock)
 {
 	return (lock->lock & __ARCH_RW_LOCKED) ? TRUE : FALSE;
@@ -200,3 +287,5 @@ void __lock arch_read_unlock(arch_rwlock_t *lock)
 	: "r" (&lock->lock)
 	: "memory");
 }
+
+#endif
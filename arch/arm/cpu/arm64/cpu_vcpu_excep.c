@@ -40,11 +40,17 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 			       physical_addr_t fipa)
 {
 	int rc, rc1;
+	bool demand;
 	u32 reg_flags = 0x0, pg_reg_flags = 0x0;
 	struct cpu_page pg;
 	physical_addr_t inaddr, outaddr;
 	physical_size_t size, availsz;
 
+	/* Each successful vmm_guest_physical_map() pins the demand
+	 * allocated chunk behind it. Only the mapping we are about to
+	 * install stays pinned and it is unpinned once Stage2 is updated
+	 * so that a concurrent discard also removes the new Stage2 entry.
+	 */
 	memset(&pg, 0, sizeof(pg));
 
 	inaddr = fipa & TTBL_L3_MAP_MASK;
@@ -60,6 +66,7 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 	}
 
 	if (availsz < TTBL_L3_BLOCK_SIZE) {
+		vmm_guest_physical_unmap(vcpu->guest, inaddr, size);
 		vmm_printf("%s: availsz=0x%lx insufficent for IPA=0x%lx\n",
 			   __func__, availsz, inaddr);
 		return VMM_EFAIL;
@@ -70,26 +77,46 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 	pg.oa = outaddr;
 	pg_reg_flags = reg_flags;
 
+	/* Bigger blocks of demand allocated RAM are only probed when
+	 * already populated so that we don't allocate unused chunks.
+	 */
+	demand = (reg_flags & VMM_REGION_ISDEMAND) ? TRUE : FALSE;
 	if (reg_flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) {
 		inaddr = fipa & TTBL_L2_MAP_MASK;
 		size = TTBL_L2_BLOCK_SIZE;
-		rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
-				    &outaddr, &availsz, &reg_flags);
-		if (!rc && (availsz >= TTBL_L2_BLOCK_SIZE)) {
-			pg.ia = inaddr;
-			pg.sz = size;
-			pg.oa = outaddr;
-			pg_reg_flags = reg_flags;
+		if (!demand ||
+		    vmm_guest_physical_populated(vcpu->guest, inaddr)) {
+			rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
+					    &outaddr, &availsz, &reg_flags);
+			if (!rc && (availsz >= TTBL_L2_BLOCK_SIZE)) {
+				vmm_guest_physical_unmap(vcpu->guest,
+							 pg.ia, pg.sz);
+				pg.ia = inaddr;
+				pg.sz = size;
+				pg.oa = outaddr;
+				pg_reg_flags = reg_flags;
+			} else if (!rc) {
+				vmm_guest_physical_unmap(vcpu->guest,
+							 inaddr, size);
+			}
 		}
 		inaddr = fipa & TTBL_L1_MAP_MASK;
 		size = TTBL_L1_BLOCK_SIZE;
-		rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
-				    &outaddr, &availsz, &reg_flags);
-		if (!rc && (availsz >= TTBL_L1_BLOCK_SIZE)) {
-			pg.ia = inaddr;
-			pg.sz = size;
-			pg.oa = outaddr;
-			pg_reg_flags = reg_flags;
+		if (!demand ||
+		    vmm_guest_physical_populated(vcpu->guest, inaddr)) {
+			rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
+					    &outaddr, &availsz, &reg_flags);
+			if (!rc && (availsz >= TTBL_L1_BLOCK_SIZE)) {
+				vmm_guest_physical_unmap(vcpu->guest,
+							 pg.ia, pg.sz);
+				pg.ia = inaddr;
+				pg.sz = size;
+				pg.oa = outaddr;
+				pg_reg_flags = reg_flags;
+			} else if (!rc) {
+				vmm_guest_physical_unmap(vcpu->guest,
+							 inaddr, size);
+			}
 		}
 	}
 
@@ -123,6 +150,7 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 
 	/* Try to map the page in Stage2 */
 	rc = mmu_lpae_map_page(arm_guest_priv(vcpu->guest)->ttbl, &pg);
+	vmm_guest_physical_unmap(vcpu->guest, pg.ia, pg.sz);
 	if (rc) {
 		/* On SMP Guest, two different VCPUs may try to map same
 		 * Guest region in Stage2 at the same time. This may cause
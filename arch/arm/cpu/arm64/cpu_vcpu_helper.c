@@ -349,6 +349,31 @@ int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 	return VMM_OK;
 }
 
+int arch_guest_unmap_memory(struct vmm_guest *guest,
+			    physical_addr_t gphys_addr,
+			    physical_size_t gphys_size)
+{
+	struct cpu_page pg;
+	struct cpu_ttbl *ttbl;
+	physical_addr_t ia = gphys_addr;
+
+	if (!guest->arch_priv) {
+		return VMM_OK;
+	}
+	ttbl = arm_guest_priv(guest)->ttbl;
+
+	while (ia < (gphys_addr + gphys_size)) {
+		if (mmu_lpae_get_page(ttbl, ia, &pg)) {
+			ia += TTBL_L3_BLOCK_SIZE;
+			continue;
+		}
+		mmu_lpae_unmap_page(ttbl, &pg);
+		ia = pg.ia + pg.sz;
+	}
+
+	return VMM_OK;
+}
+
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
 {
 	int rc = VMM_OK;
@@ -810,6 +835,11 @@ void cpu_vcpu_dump_user_reg(arch_regs_t *regs)
 	__cpu_vcpu_dump_user_reg(NULL, regs);
 }
 
+virtual_addr_t arch_regs_pc(arch_regs_t *regs)
+{
+	return (virtual_addr_t)regs->pc;
+}
+
 void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	struct arm_priv *p;
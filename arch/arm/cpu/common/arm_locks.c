@@ -32,6 +32,82 @@
 #include <arch_barrier.h>
 #include <vmm_smp.h>
 
+#if defined(CONFIG_ARM_TICKET_LOCKS)
+
+#define TICKET_OWNER(v)		((v) & 0xffff)
+#define TICKET_NEXT(v)		((v) >> __ARCH_SPIN_TICKET_SHIFT)
+
+/* Owner ticket is the low halfword of lock value (little endian) */
+#define TICKET_OWNER_PTR(l)	((volatile u16 *)&(l)->lock)
+
+bool __lock arch_spin_lock_check(arch_spinlock_t *lock)
+{
+	u32 val = lock->lock;
+
+	return (TICKET_OWNER(val) == TICKET_NEXT(val)) ? FALSE : TRUE;
+}
+
+void __lock arch_spin_lock(arch_spinlock_t *lock)
+{
+	u32 val, newval, ticket;
+	unsigned long tmp;
+
+	__asm__ __volatile__(
+"1:	ldrex	%0, [%3]\n"	/* load the lock value */
+"	add	%1, %0, %4\n"	/* take the next ticket */
+"	strex	%2, %1, [%3]\n"
+"	teq	%2, #0\n"	/* did we succeed */
+"	bne	1b"		/* if not try again */
+	: "=&r" (val), "=&r" (newval), "=&r" (tmp)
+	: "r" (&lock->lock), "I" (1 << __ARCH_SPIN_TICKET_SHIFT)
+	: "cc");
+
+	/* Sleep until some other core serves our ticket */
+	ticket = TICKET_NEXT(val);
+	while (ticket != TICKET_OWNER(val)) {
+		wfe();
+		val = lock->lock;
+	}
+
+	arch_smp_mb();		/* do a mb to sync everything */
+}
+
+int __lock arch_spin_trylock(arch_spinlock_t *lock)
+{
+	unsigned long val, contended, res;
+
+	do {
+		__asm__ __volatile__(
+"	ldrex	%0, [%3]\n"	/* load the lock value */
+"	mov	%2, #0\n"
+"	subs	%1, %0, %0, ror #16\n" /* is the lock free */
+"	addeq	%0, %0, %4\n"	/* if yes, take the next ticket */
+"	strexeq	%2, %0, [%3]"
+		: "=&r" (val), "=&r" (contended), "=&r" (res)
+		: "r" (&lock->lock), "I" (1 << __ARCH_SPIN_TICKET_SHIFT)
+		: "cc");
+	} while (res);
+
+	if (!contended) {
+		arch_smp_mb();	/* do mb if we succeeded */
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+void __lock arch_spin_unlock(arch_spinlock_t *lock)
+{
+	arch_smp_mb();		/* sync everything */
+
+	/* Serve next ticket. Only owner writes owner ticket. */
+	*TICKET_OWNER_PTR(lock) = TICKET_OWNER(lock->lock) + 1;
+	dsb();			/* sync again */
+	sev();			/* notify all cores */
+}
+
+#else
+
 bool __lock arch_spin_lock_check(arch_spinlock_t *lock)
 {
 	return (lock->lock == __ARCH_SPIN_UNLOCKED) ? FALSE : TRUE;
@@ -87,6 +163,10 @@ void __lock arch_spin_unlock(arch_spinlock_t *lock)
 	sev();			/* notify all cores */
 }
 
+#endif
+
+#if !defined(CONFIG_ARM_QUEUED_RWLOCKS)
+
 bool __lock arch_write_lock_check(arch_rwlock_t *lock)
 {
 	return (lock->lock & __ARCH_RW_LOCKED) ? TRUE : FALSE;
@@ -205,3 +285,5 @@ void __lock arch_read_unlock(arch_rwlock_t *lock)
 		sev();
 	}
 }
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file arm_qrwlocks.c
+ * @author Xvisor Developers
+ * @brief ARM fair queued read-write locks.
+ *
+ * Uncontended readers and writers take the lock with a single atomic
+ * operation on lock counts. When a writer holds or waits for the lock,
+ * everybody else queues up on the wait ticket spinlock so the lock is
+ * handed over in FIFO order.
+ */
+
+#include <vmm_error.h>
+#include <vmm_types.h>
+#include <vmm_compiler.h>
+#include <arch_atomic.h>
+#include <arch_barrier.h>
+#include <arch_locks.h>
+
+bool __lock arch_write_lock_check(arch_rwlock_t *lock)
+{
+	return (arch_atomic_read(&lock->cnts) & __ARCH_RW_WLOCKED) ?
+								TRUE : FALSE;
+}
+
+void __lock arch_write_lock(arch_rwlock_t *lock)
+{
+	long cnts;
+
+	if (!arch_atomic_cmpxchg(&lock->cnts, 0, __ARCH_RW_WLOCKED)) {
+		arch_smp_mb();
+		return;
+	}
+
+	arch_spin_lock(&lock->wait);
+
+	/* Try once more now that we are at head of the queue */
+	if (!arch_atomic_read(&lock->cnts) &&
+	    !arch_atomic_cmpxchg(&lock->cnts, 0, __ARCH_RW_WLOCKED)) {
+		goto done;
+	}
+
+	/* Stop new readers once current writer is gone */
+	while (1) {
+		cnts = arch_atomic_read(&lock->cnts);
+		if (!(cnts & __ARCH_RW_WMASK) &&
+		    (arch_atomic_cmpxchg(&lock->cnts, cnts,
+				cnts | __ARCH_RW_WWAITING) == cnts)) {
+			break;
+		}
+		arch_cpu_relax();
+	}
+
+	/* Wait for active readers to drain */
+	while (1) {
+		if ((arch_atomic_read(&lock->cnts) == __ARCH_RW_WWAITING) &&
+		    (arch_atomic_cmpxchg(&lock->cnts, __ARCH_RW_WWAITING,
+				__ARCH_RW_WLOCKED) == __ARCH_RW_WWAITING)) {
+			break;
+		}
+		arch_cpu_relax();
+	}
+
+done:
+	arch_spin_unlock(&lock->wait);
+
+	arch_smp_mb();
+}
+
+int __lock arch_write_trylock(arch_rwlock_t *lock)
+{
+	if (arch_atomic_read(&lock->cnts) ||
+	    arch_atomic_cmpxchg(&lock->cnts, 0, __ARCH_RW_WLOCKED)) {
+		return 0;
+	}
+
+	arch_smp_mb();
+
+	return 1;
+}
+
+void __lock arch_write_unlock(arch_rwlock_t *lock)
+{
+	arch_smp_mb();
+
+	/* Readers in queue might have already added their bias */
+	arch_atomic_sub(&lock->cnts, __ARCH_RW_WLOCKED);
+}
+
+bool __lock arch_read_lock_check(arch_rwlock_t *lock)
+{
+	return (arch_atomic_read(&lock->cnts) & ~__ARCH_RW_WWAITING) ?
+								TRUE : FALSE;
+}
+
+void __lock arch_read_lock(arch_rwlock_t *lock)
+{
+	long cnts;
+
+	cnts = arch_atomic_add_return(&lock->cnts, __ARCH_RW_RBIAS);
+	if (likely(!(cnts & __ARCH_RW_WMASK))) {
+		arch_smp_mb();
+		return;
+	}
+
+	/* Writer holds or waits for the lock so queue up behind it */
+	arch_atomic_sub(&lock->cnts, __ARCH_RW_RBIAS);
+
+	arch_spin_lock(&lock->wait);
+
+	/* No writer can start waiting while we hold the wait lock
+	 * so only wait for current writer to release the lock.
+	 */
+	arch_atomic_add(&lock->cnts, __ARCH_RW_RBIAS);
+	while (arch_atomic_read(&lock->cnts) & __ARCH_RW_WLOCKED) {
+		arch_cpu_relax();
+	}
+
+	arch_spin_unlock(&lock->wait);
+
+	arch_smp_mb();
+}
+
+int __lock arch_read_trylock(arch_rwlock_t *lock)
+{
+	long cnts;
+
+	cnts = arch_atomic_read(&lock->cnts);
+	if (cnts & __ARCH_RW_WMASK) {
+		return 0;
+	}
+
+	cnts = arch_atomic_add_return(&lock->cnts, __ARCH_RW_RBIAS);
+	if (likely(!(cnts & __ARCH_RW_WMASK))) {
+		arch_smp_mb();
+		return 1;
+	}
+
+	arch_atomic_sub(&lock->cnts, __ARCH_RW_RBIAS);
+
+	return 0;
+}
+
+void __lock arch_read_unlock(arch_rwlock_t *lock)
+{
+	arch_smp_mb();
+
+	arch_atomic_sub(&lock->cnts, __ARCH_RW_RBIAS);
+}
@@ -678,27 +678,66 @@ int mmu_lpae_stage2_chttbl(u8 vmid, struct cpu_ttbl *ttbl)
 	 ((AINDEX_NORMAL_WB << TTBL_STAGE1_LOWER_AINDEX_SHIFT) &	\
 	    TTBL_STAGE1_LOWER_AINDEX_MASK))
 
-int arch_cpu_aspace_memory_read(virtual_addr_t tmp_va,
-				physical_addr_t src,
-				void *dst, u32 len, bool cacheable)
+#if defined(ARCH_MEMORY_READWRITE_PAGES)
+#define PHYS_RW_PAGES		ARCH_MEMORY_READWRITE_PAGES
+#else
+#define PHYS_RW_PAGES		1
+#endif
+
+/* Map all pages covering given physical range in memory read/write
+ * window of current host CPU. The TTEs of window pages are contiguous
+ * so we update all of them and sync only once.
+ */
+static u32 mmu_lpae_memory_rw_map(virtual_addr_t tmp_va,
+				  physical_addr_t pa, u32 len,
+				  bool cacheable, u64 *old_tte)
 {
-	u64 old_tte_val;
+	u32 i, pages;
 	u64 *tte = mmuctrl.mem_rw_tte[vmm_smp_processor_id()];
 	struct cpu_ttbl *ttbl = mmuctrl.mem_rw_ttbl[vmm_smp_processor_id()];
-	virtual_addr_t offset = (src & VMM_PAGE_MASK);
 
-	old_tte_val = *tte;
+	pages = VMM_SIZE_TO_PAGE((pa & VMM_PAGE_MASK) + len);
+	for (i = 0; i < pages; i++) {
+		old_tte[i] = tte[i];
+		tte[i] = (cacheable) ? PHYS_RW_TTE_CACHE : PHYS_RW_TTE_NOCACHE;
+		tte[i] |= (pa + i * VMM_PAGE_SIZE) &
+			  (mmu_lpae_level_map_mask(ttbl->level) &
+			   TTBL_OUTADDR_MASK);
+	}
 
-	if (cacheable) {
-		*tte = PHYS_RW_TTE_CACHE;
-	} else {
-		*tte = PHYS_RW_TTE_NOCACHE;
+	cpu_mmu_sync_tte(tte);
+	for (i = 0; i < pages; i++) {
+		cpu_invalid_va_hypervisor_tlb(tmp_va + i * VMM_PAGE_SIZE);
+	}
+
+	return pages;
+}
+
+static void mmu_lpae_memory_rw_unmap(u32 pages, u64 *old_tte)
+{
+	u32 i;
+	u64 *tte = mmuctrl.mem_rw_tte[vmm_smp_processor_id()];
+
+	for (i = 0; i < pages; i++) {
+		tte[i] = old_tte[i];
 	}
-	*tte |= src &
-		(mmu_lpae_level_map_mask(ttbl->level) & TTBL_OUTADDR_MASK);
 
 	cpu_mmu_sync_tte(tte);
-	cpu_invalid_va_hypervisor_tlb(tmp_va);
+}
+
+int arch_cpu_aspace_memory_read(virtual_addr_t tmp_va,
+				physical_addr_t src,
+				void *dst, u32 len, bool cacheable)
+{
+	u32 pages;
+	u64 old_tte[PHYS_RW_PAGES];
+	virtual_addr_t offset = (src & VMM_PAGE_MASK);
+
+	if ((PHYS_RW_PAGES * VMM_PAGE_SIZE) < (offset + len)) {
+		return VMM_EINVALID;
+	}
+
+	pages = mmu_lpae_memory_rw_map(tmp_va, src, len, cacheable, old_tte);
 
 	switch (len) {
 	case 1:
@@ -718,8 +757,7 @@ int arch_cpu_aspace_memory_read(virtual_addr_t tmp_va,
 		break;
 	};
 
-	*tte = old_tte_val;
-	cpu_mmu_sync_tte(tte);
+	mmu_lpae_memory_rw_unmap(pages, old_tte);
 
 	return VMM_OK;
 }
@@ -728,23 +766,15 @@ int arch_cpu_aspace_memory_write(virtual_addr_t tmp_va,
 				 physical_addr_t dst,
 				 void *src, u32 len, bool cacheable)
 {
-	u64 old_tte_val;
-	u64 *tte = mmuctrl.mem_rw_tte[vmm_smp_processor_id()];
-	struct cpu_ttbl *ttbl = mmuctrl.mem_rw_ttbl[vmm_smp_processor_id()];
+	u32 pages;
+	u64 old_tte[PHYS_RW_PAGES];
 	virtual_addr_t offset = (dst & VMM_PAGE_MASK);
 
-	old_tte_val = *tte;
-
-	if (cacheable) {
-		*tte = PHYS_RW_TTE_CACHE;
-	} else {
-		*tte = PHYS_RW_TTE_NOCACHE;
+	if ((PHYS_RW_PAGES * VMM_PAGE_SIZE) < (offset + len)) {
+		return VMM_EINVALID;
 	}
-	*tte |= dst &
-		(mmu_lpae_level_map_mask(ttbl->level) & TTBL_OUTADDR_MASK);
 
-	cpu_mmu_sync_tte(tte);
-	cpu_invalid_va_hypervisor_tlb(tmp_va);
+	pages = mmu_lpae_memory_rw_map(tmp_va, dst, len, cacheable, old_tte);
 
 	switch (len) {
 	case 1:
@@ -764,8 +794,7 @@ int arch_cpu_aspace_memory_write(virtual_addr_t tmp_va,
 		break;
 	};
 
-	*tte = old_tte_val;
-	cpu_mmu_sync_tte(tte);
+	mmu_lpae_memory_rw_unmap(pages, old_tte);
 
 	return VMM_OK;
 }
@@ -819,23 +848,27 @@ static int __cpuinit mmu_lpae_find_tte(struct cpu_ttbl *ttbl,
 int __cpuinit arch_cpu_aspace_memory_rwinit(virtual_addr_t tmp_va)
 {
 	int rc;
-	u32 cpu = vmm_smp_processor_id();
+	u32 i, cpu = vmm_smp_processor_id();
+	u64 *tte;
+	struct cpu_ttbl *ttbl;
 	struct cpu_page p;
 
-	memset(&p, 0, sizeof(p));
-	p.ia = tmp_va;
-	p.oa = 0x0;
-	p.sz = VMM_PAGE_SIZE;
-	p.af = 1;
-	p.ap = TTBL_AP_SR_U;
-	p.xn = 1;
-	p.ns = 1;
-	p.sh = TTBL_SH_INNER_SHAREABLE;
-	p.aindex = AINDEX_SO;
+	for (i = 0; i < PHYS_RW_PAGES; i++) {
+		memset(&p, 0, sizeof(p));
+		p.ia = tmp_va + i * VMM_PAGE_SIZE;
+		p.oa = 0x0;
+		p.sz = VMM_PAGE_SIZE;
+		p.af = 1;
+		p.ap = TTBL_AP_SR_U;
+		p.xn = 1;
+		p.ns = 1;
+		p.sh = TTBL_SH_INNER_SHAREABLE;
+		p.aindex = AINDEX_SO;
 
-	rc = mmu_lpae_map_hypervisor_page(&p);
-	if (rc) {
-		return rc;
+		rc = mmu_lpae_map_hypervisor_page(&p);
+		if (rc) {
+			return rc;
+		}
 	}
 
 	mmuctrl.mem_rw_tte[cpu] = NULL;
@@ -847,6 +880,20 @@ int __cpuinit arch_cpu_aspace_memory_rwinit(virtual_addr_t tmp_va)
 		return rc;
 	}
 
+	/* Window pages must use contiguous TTEs of same table */
+	for (i = 1; i < PHYS_RW_PAGES; i++) {
+		rc = mmu_lpae_find_tte(mmuctrl.hyp_ttbl,
+				       tmp_va + i * VMM_PAGE_SIZE,
+				       &tte, &ttbl);
+		if (rc) {
+			return rc;
+		}
+		if ((ttbl != mmuctrl.mem_rw_ttbl[cpu]) ||
+		    (tte != &mmuctrl.mem_rw_tte[cpu][i])) {
+			return VMM_EFAIL;
+		}
+	}
+
 	return VMM_OK;
 }
 
@@ -25,6 +25,7 @@ cpu-common-objs-y+=emulate_arm.o
 cpu-common-objs-y+=emulate_thumb.o
 cpu-common-objs-y+=emulate_psci.o
 cpu-common-objs-$(CONFIG_ARM_LOCKS)+=arm_locks.o
+cpu-common-objs-$(CONFIG_ARM_QUEUED_RWLOCKS)+=arm_qrwlocks.o
 cpu-common-objs-$(CONFIG_ARM_VGIC)+=vgic.o
 cpu-common-objs-$(CONFIG_ARM_VGIC)+=vgic_v2.o
 cpu-common-objs-$(CONFIG_ARM_GENERIC_TIMER)+=generic_timer.o
@@ -52,8 +52,9 @@ int arch_cpu_aspace_va2pa(virtual_addr_t va,
  *  NOTE: This arch function is optional.
  *  NOTE: The tmp_va is per host CPU temporary virtual address which
  *  can be optionally used to access the physical memory.
- *  NOTE: The len field will be less than or equal to VMM_PAGE_SIZE.
- *  is to ensure that no VCPU over-haul the CPU.
+ *  NOTE: The range accessed will be within ARCH_MEMORY_READWRITE_PAGES
+ *  pages starting at page of physical address. This is to ensure that
+ *  no VCPU over-haul the CPU.
  *  NOTE: If arch implments this function then arch_config.h
  *  will define ARCH_HAS_MEMORY_READWRITE feature.
  */
@@ -65,8 +66,9 @@ int arch_cpu_aspace_memory_read(virtual_addr_t tmp_va,
  *  NOTE: This arch function is optional.
  *  NOTE: The tmp_va is per host CPU temporary virtual address which
  *  can be optionally used to access the physical memory.
- *  NOTE: The len field will be less than or equal to VMM_PAGE_SIZE.
- *  This is to ensure that no VCPU over-haul the CPU.
+ *  NOTE: The range accessed will be within ARCH_MEMORY_READWRITE_PAGES
+ *  pages starting at page of physical address. This is to ensure that
+ *  no VCPU over-haul the CPU.
  *  NOTE: If arch implments this function then arch_config.h
  *  will define ARCH_HAS_MEMORY_READWRITE feature.
  */
@@ -74,10 +76,12 @@ int arch_cpu_aspace_memory_write(virtual_addr_t tmp_va,
 				 physical_addr_t dst, 
 				 void *src, u32 len, bool cacheable);
 
-/** Write data to memory with given physical adress
+/** Initialize memory read/write for current host CPU
  *  NOTE: This arch function is optional.
  *  NOTE: The tmp_va is per host CPU temporary virtual address which
- *  can be optionally used to access the physical memory.
+ *  can be optionally used to access the physical memory. It covers
+ *  ARCH_MEMORY_READWRITE_PAGES pages which arch_config.h can define
+ *  if arch maps more than one page at a time (default is 1 page).
  *  NOTE: If arch implments this function then arch_config.h
  *  will define ARCH_HAS_MEMORY_READWRITE feature.
  */
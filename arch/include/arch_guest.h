@@ -57,4 +57,21 @@ int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region);
  */
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region);
 
+/** Architecture specific callback to unmap guest memory
+ *
+ * Remove mappings of given guest physical address range from
+ * guest page tables (e.g. stage2 page tables) so that next guest
+ * access to the range faults. This is used to release host RAM
+ * backing demand allocated guest RAM.
+ *
+ * @param guest Guest for which memory is being unmapped.
+ * @param gphys_addr Guest physical address of range.
+ * @param gphys_size Size of range.
+ * @return This function should return VMM_OK on success,
+ * VMM_ENOTSUPP if not supported or appropriate error code otherwise.
+ */
+int arch_guest_unmap_memory(struct vmm_guest *guest,
+			    physical_addr_t gphys_addr,
+			    physical_size_t gphys_size);
+
 #endif
@@ -62,6 +62,9 @@ void arch_vcpu_post_switch(struct vmm_vcpu *vcpu,
  */
 void arch_vcpu_preempt_orphan(void);
 
+/** Get program counter from register state saved by interrupt handlers */
+virtual_addr_t arch_regs_pc(arch_regs_t *regs);
+
 /** Print architecture specific registers of a VCPU */
 void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu);
 
@@ -118,6 +118,14 @@ int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 	return VMM_OK;
 }
 
+int arch_guest_unmap_memory(struct vmm_guest *guest,
+			    physical_addr_t gphys_addr,
+			    physical_size_t gphys_size)
+{
+	/* Shadow page tables are indexed by guest virtual address */
+	return VMM_ENOTSUPP;
+}
+
 static void guest_cmos_init(struct vmm_guest *guest)
 {
 	int val;
@@ -398,6 +398,11 @@ static void dump_guest_vcpu_state(struct vcpu_hw_context *context)
 	vmm_printf("]\n");
 }
 
+virtual_addr_t arch_regs_pc(arch_regs_t *regs)
+{
+	return (virtual_addr_t)regs->rip;
+}
+
 void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	struct vcpu_hw_context *context = x86_vcpu_hw_context(vcpu);
@@ -234,7 +234,9 @@ void handle_guest_resident_page_fault(struct vcpu_hw_context *context)
 static inline
 void handle_guest_realmode_page_fault(struct vcpu_hw_context *context)
 {
+	int rc;
 	physical_addr_t fault_gphys = context->vmcb->exitinfo2;
+	physical_addr_t fault_hphys;
 	u64 fault_offset;
 	struct vmm_region *g_reg;
 	struct vmm_guest *guest = context->assoc_vcpu->guest;
@@ -248,16 +250,30 @@ void handle_guest_realmode_page_fault(struct vcpu_hw_context *context)
 	}
 
 	fault_offset = fault_gphys - g_reg->gphys_addr;
+	fault_hphys = g_reg->hphys_addr + fault_offset;
 
-	if (create_guest_shadow_map(context, fault_gphys,
-				    (g_reg->hphys_addr + fault_offset),
-				    PAGE_SIZE, 0x3, 0x3) != VMM_OK) {
+	/* Demand allocated RAM gets host RAM on first fault */
+	if ((g_reg->flags & VMM_REGION_ISDEMAND) &&
+	    vmm_guest_physical_map(guest, fault_gphys, PAGE_SIZE,
+				   &fault_hphys, NULL, NULL)) {
+		VM_LOG(LVL_ERR, "ERROR: Failed to populate "
+		       "guest physical: 0x%lx\n", fault_gphys);
+		goto guest_bad_fault;
+	}
+
+	/* Demand allocated chunk stays pinned till shadow map is created */
+	rc = create_guest_shadow_map(context, fault_gphys, fault_hphys,
+				     PAGE_SIZE, 0x3, 0x3);
+	if (g_reg->flags & VMM_REGION_ISDEMAND) {
+		vmm_guest_physical_unmap(guest, fault_gphys, PAGE_SIZE);
+	}
+	if (rc != VMM_OK) {
 		VM_LOG(LVL_ERR, "ERROR: Failed to create map in"
 		       "guest's shadow page table.\n"
 		       "Gphys: 0x%lx Fault offs: 0x%lx Fault "
 		       "Gphys: 0x%lx Host Phys: %lx\n",
 		       g_reg->gphys_addr, fault_offset,
-		       fault_gphys, g_reg->hphys_addr);
+		       fault_gphys, fault_hphys);
 		goto guest_bad_fault;
 	}
 
@@ -395,10 +411,11 @@ void handle_guest_mmio_fault(struct vcpu_hw_context *context,
 static inline
 void handle_guest_protected_mem_rw(struct vcpu_hw_context *context)
 {
+	int rc;
 	struct vmm_guest *guest = context->assoc_vcpu->guest;
 	physical_addr_t fault_gphys = context->vmcb->exitinfo2;
 	u64 fault_offset;
-	physical_addr_t lookedup_gphys;
+	physical_addr_t lookedup_gphys, fault_hphys;
 	struct vmm_region *g_reg;
 	union page32 pte, pde;
 	u32 prot, pdprot;
@@ -477,16 +494,31 @@ void handle_guest_protected_mem_rw(struct vcpu_hw_context *context)
 	 * Otherwise do emulate.
 	 */
 	if (g_reg->flags & (VMM_REGION_REAL | VMM_REGION_ALIAS)) {
-		if (create_guest_shadow_map(context, fault_gphys,
-					    (g_reg->hphys_addr + fault_offset),
-					    PAGE_SIZE, pdprot,
-					    prot) != VMM_OK) {
+		fault_hphys = g_reg->hphys_addr + fault_offset;
+
+		/* Demand allocated RAM gets host RAM on first fault */
+		if ((g_reg->flags & VMM_REGION_ISDEMAND) &&
+		    vmm_guest_physical_map(guest, lookedup_gphys, PAGE_SIZE,
+					   &fault_hphys, NULL, NULL)) {
+			VM_LOG(LVL_ERR, "ERROR: Failed to populate "
+			       "guest physical: 0x%lx\n", lookedup_gphys);
+			goto guest_bad_fault;
+		}
+
+		rc = create_guest_shadow_map(context, fault_gphys,
+					     fault_hphys, PAGE_SIZE,
+					     pdprot, prot);
+		if (g_reg->flags & VMM_REGION_ISDEMAND) {
+			vmm_guest_physical_unmap(guest, lookedup_gphys,
+						 PAGE_SIZE);
+		}
+		if (rc != VMM_OK) {
 			VM_LOG(LVL_ERR, "ERROR: Failed to create map in"
 			       "guest's shadow page table.\n"
 			       "Gphys: 0x%lx Fault offs: 0x%lx Fault "
 			       "Gphys: 0x%lx Host Phys: %lx\n",
 			       g_reg->gphys_addr, fault_offset,
-			       fault_gphys, g_reg->hphys_addr);
+			       fault_gphys, fault_hphys);
 			goto guest_bad_fault;
 		}
 	} else {
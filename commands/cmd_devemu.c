@@ -0,0 +1,433 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_devemu.c
+ * @author Xvisor Developers
+ * @brief Implementation of devemu command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <vmm_heap.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_devemu.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#include <libs/libsort.h>
+
+#define MODULE_DESC			"Command devemu"
+#define MODULE_AUTHOR			"Xvisor Developers"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_devemu_init
+#define	MODULE_EXIT			cmd_devemu_exit
+
+#define CMD_DEVEMU_TRACE_DEFAULT_COUNT	32
+
+struct cmd_devemu_iter {
+	struct vmm_chardev *cdev;
+	struct vmm_guest *guest;
+	const char *name;
+	bool found;
+	struct vmm_devemu_stats *stats;
+};
+
+static void cmd_devemu_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage: \n");
+	vmm_cprintf(cdev, "   devemu help\n");
+	vmm_cprintf(cdev, "   devemu stats [<guest_name>]\n");
+	vmm_cprintf(cdev, "   devemu stats <guest_name> <device_name>\n");
+	vmm_cprintf(cdev, "   devemu stats clear [<guest_name>]\n");
+	vmm_cprintf(cdev, "   devemu trace start\n");
+	vmm_cprintf(cdev, "   devemu trace stop\n");
+	vmm_cprintf(cdev, "   devemu trace status\n");
+	vmm_cprintf(cdev, "   devemu trace dump [<count_per_cpu>]\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   latencies are in nsecs and trace dump "
+		    "shows last %d entries per CPU by default\n",
+		    CMD_DEVEMU_TRACE_DEFAULT_COUNT);
+}
+
+static int cmd_devemu_help(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	cmd_devemu_usage(cdev);
+
+	return VMM_OK;
+}
+
+static u64 cmd_devemu_avg(u64 total, u64 count)
+{
+	return (count) ? udiv64(total, count) : 0;
+}
+
+static bool cmd_devemu_match(struct vmm_emudev *edev,
+			     struct cmd_devemu_iter *it)
+{
+	if (it->guest && (edev->reg->aspace->guest != it->guest)) {
+		return FALSE;
+	}
+	if (it->name && strcmp(edev->node->name, it->name)) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int cmd_devemu_stats_list_iter(struct vmm_emudev *edev, void *priv)
+{
+	struct cmd_devemu_iter *it = priv;
+	struct vmm_devemu_stats *s = it->stats;
+
+	if (!cmd_devemu_match(edev, it)) {
+		return VMM_OK;
+	}
+
+	vmm_devemu_stats_get(edev, s);
+	vmm_cprintf(it->cdev, "%-16s %-20s %-16s %10llu %10llu %8llu "
+		    "%8llu %8llu\n", edev->reg->aspace->guest->name,
+		    edev->node->name, edev->emu->name,
+		    s->read.count, s->write.count,
+		    cmd_devemu_avg(s->read.total_nsecs, s->read.count),
+		    cmd_devemu_avg(s->write.total_nsecs, s->write.count),
+		    (s->read.max_nsecs < s->write.max_nsecs) ?
+		    s->write.max_nsecs : s->read.max_nsecs);
+	it->found = TRUE;
+
+	return VMM_OK;
+}
+
+static int cmd_devemu_offset_less(void *m, size_t a, size_t b)
+{
+	struct vmm_devemu_offset_stats *o = m;
+
+	return (o[a].offset < o[b].offset) ? 1 : 0;
+}
+
+static void cmd_devemu_offset_swap(void *m, size_t a, size_t b)
+{
+	struct vmm_devemu_offset_stats tmp;
+	struct vmm_devemu_offset_stats *o = m;
+
+	tmp = o[a];
+	o[a] = o[b];
+	o[b] = tmp;
+}
+
+static void cmd_devemu_stats_show(struct vmm_chardev *cdev,
+				  struct vmm_emudev *edev,
+				  struct vmm_devemu_stats *s)
+{
+	u32 i, n;
+	u64 lo, hi;
+
+	vmm_cprintf(cdev, "Device        : %s/%s\n",
+		    edev->reg->aspace->guest->name, edev->node->name);
+	vmm_cprintf(cdev, "Emulator      : %s\n", edev->emu->name);
+	vmm_cprintf(cdev, "Address       : 0x%llx (%s)\n",
+		    (u64)edev->reg->gphys_addr,
+		    (edev->reg->flags & VMM_REGION_IO) ? "io" : "memory");
+
+	vmm_cprintf(cdev, "\n%-8s %12s %10s %10s %10s\n",
+		    "Access", "Count", "Errors", "Avg(ns)", "Max(ns)");
+	vmm_cprintf(cdev, "%-8s %12llu %10llu %10llu %10llu\n", "read",
+		    s->read.count, s->read.errors,
+		    cmd_devemu_avg(s->read.total_nsecs, s->read.count),
+		    s->read.max_nsecs);
+	vmm_cprintf(cdev, "%-8s %12llu %10llu %10llu %10llu\n", "write",
+		    s->write.count, s->write.errors,
+		    cmd_devemu_avg(s->write.total_nsecs, s->write.count),
+		    s->write.max_nsecs);
+
+	vmm_cprintf(cdev, "\n%-24s %12s %12s\n",
+		    "Latency(ns)", "Reads", "Writes");
+	for (i = 0; i < VMM_DEVEMU_STATS_HIST_BUCKETS; i++) {
+		if (!s->read.hist[i] && !s->write.hist[i]) {
+			continue;
+		}
+		lo = (i) ? 1ULL << (VMM_DEVEMU_STATS_HIST_SHIFT + i - 1) : 0;
+		hi = 1ULL << (VMM_DEVEMU_STATS_HIST_SHIFT + i);
+		if (i < (VMM_DEVEMU_STATS_HIST_BUCKETS - 1)) {
+			vmm_cprintf(cdev, "%10llu - %-11llu %12llu %12llu\n",
+				    lo, hi, s->read.hist[i], s->write.hist[i]);
+		} else {
+			vmm_cprintf(cdev, "%10llu+ %-12s %12llu %12llu\n",
+				    lo, "", s->read.hist[i], s->write.hist[i]);
+		}
+	}
+
+	/* Compact used offsets to the front before sorting them */
+	n = 0;
+	for (i = 0; i < VMM_DEVEMU_STATS_OFFSETS; i++) {
+		if (!s->offsets[i].reads && !s->offsets[i].writes) {
+			continue;
+		}
+		s->offsets[n++] = s->offsets[i];
+	}
+	if (n) {
+		libsort_smoothsort(s->offsets, 0, n, cmd_devemu_offset_less,
+				   cmd_devemu_offset_swap);
+	}
+
+	vmm_cprintf(cdev, "\n%-12s %12s %12s %10s\n",
+		    "Offset", "Reads", "Writes", "Avg(ns)");
+	for (i = 0; i < n; i++) {
+		vmm_cprintf(cdev, "0x%-10llx %12llu %12llu %10llu\n",
+			    (u64)s->offsets[i].offset,
+			    s->offsets[i].reads, s->offsets[i].writes,
+			    cmd_devemu_avg(s->offsets[i].total_nsecs,
+					   s->offsets[i].reads +
+					   s->offsets[i].writes));
+	}
+	if (s->offset_overflow) {
+		vmm_cprintf(cdev, "%-12s %25llu\n", "(untracked)",
+			    s->offset_overflow);
+	}
+}
+
+static int cmd_devemu_stats_show_iter(struct vmm_emudev *edev, void *priv)
+{
+	struct cmd_devemu_iter *it = priv;
+
+	if (!cmd_devemu_match(edev, it)) {
+		return VMM_OK;
+	}
+
+	vmm_devemu_stats_get(edev, it->stats);
+	cmd_devemu_stats_show(it->cdev, edev, it->stats);
+	it->found = TRUE;
+
+	return VMM_OK;
+}
+
+static int cmd_devemu_stats_clear_iter(struct vmm_emudev *edev, void *priv)
+{
+	struct cmd_devemu_iter *it = priv;
+
+	if (!cmd_devemu_match(edev, it)) {
+		return VMM_OK;
+	}
+
+	return vmm_devemu_stats_clear(edev);
+}
+
+static int cmd_devemu_stats(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc, gidx = 2;
+	bool clear = FALSE;
+	struct cmd_devemu_iter it;
+
+	memset(&it, 0, sizeof(it));
+	it.cdev = cdev;
+
+	if ((argc > 2) && !strcmp(argv[2], "clear")) {
+		clear = TRUE;
+		gidx = 3;
+	}
+	if (argc > 4) {
+		cmd_devemu_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	if (gidx < argc) {
+		it.guest = vmm_manager_guest_find(argv[gidx]);
+		if (!it.guest) {
+			vmm_cprintf(cdev, "Failed to find guest %s\n",
+				    argv[gidx]);
+			return VMM_ENOTAVAIL;
+		}
+	}
+
+	if (clear) {
+		return vmm_devemu_iterate_emudev(cmd_devemu_stats_clear_iter,
+						 &it);
+	}
+
+	it.stats = vmm_zalloc(sizeof(*it.stats));
+	if (!it.stats) {
+		return VMM_ENOMEM;
+	}
+
+	if (argc == 4) {
+		it.name = argv[3];
+		rc = vmm_devemu_iterate_emudev(cmd_devemu_stats_show_iter,
+					       &it);
+		if (!rc && !it.found) {
+			vmm_cprintf(cdev, "Failed to find device %s\n",
+				    argv[3]);
+			rc = VMM_ENOTAVAIL;
+		}
+	} else {
+		vmm_cprintf(cdev, "%-16s %-20s %-16s %10s %10s %8s "
+			    "%8s %8s\n", "Guest", "Device", "Emulator",
+			    "Reads", "Writes", "RdAvg", "WrAvg", "Max");
+		rc = vmm_devemu_iterate_emudev(cmd_devemu_stats_list_iter,
+					       &it);
+	}
+
+	vmm_free(it.stats);
+
+	return rc;
+}
+
+static int cmd_devemu_trace_status(struct vmm_chardev *cdev)
+{
+	u32 cpu;
+
+	vmm_cprintf(cdev, "Trace         : %s\n",
+		    (vmm_devemu_trace_isactive()) ? "running" : "stopped");
+	vmm_cprintf(cdev, "Max Entries   : %d per CPU\n",
+		    vmm_devemu_trace_max_entries());
+
+	vmm_cprintf(cdev, "%-6s %-10s %-10s\n", "CPU", "Entries", "Lost");
+	for_each_online_cpu(cpu) {
+		vmm_cprintf(cdev, "%-6d %-10d %-10llu\n", cpu,
+			    vmm_devemu_trace_count(cpu),
+			    vmm_devemu_trace_lost(cpu));
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_devemu_trace_dump(struct vmm_chardev *cdev, u32 max)
+{
+	u32 cpu, i, count;
+	struct vmm_vcpu *vcpu;
+	struct vmm_devemu_trace_entry e;
+
+	if (vmm_devemu_trace_isactive()) {
+		vmm_cprintf(cdev, "Stop trace before dumping it\n");
+		return VMM_EBUSY;
+	}
+
+	vmm_cprintf(cdev, "%-4s %-20s %-16s %-6s %-18s %-4s %-18s %-10s\n",
+		    "CPU", "Timestamp", "VCPU", "Access", "Address",
+		    "Len", "Value", "Nsecs");
+	for_each_online_cpu(cpu) {
+		count = vmm_devemu_trace_count(cpu);
+		i = (max < count) ? count - max : 0;
+		for (; i < count; i++) {
+			if (vmm_devemu_trace_entry(cpu, i, &e)) {
+				break;
+			}
+			vcpu = vmm_manager_vcpu(e.vcpu_id);
+			vmm_cprintf(cdev, "%-4d %-20llu %-16s %c%c%-4s "
+				    "0x%016llx %-4d 0x%016llx %-10d\n",
+				    cpu, e.timestamp,
+				    (vcpu) ? vcpu->name : "(destroyed)",
+				    (e.flags & VMM_DEVEMU_TRACE_WRITE) ?
+				    'W' : 'R',
+				    (e.flags & VMM_DEVEMU_TRACE_IO) ?
+				    'I' : 'M',
+				    (e.flags & VMM_DEVEMU_TRACE_ERROR) ?
+				    "!" : "",
+				    e.gphys_addr, e.len, e.value, e.nsecs);
+		}
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_devemu_trace(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc;
+	u32 max = CMD_DEVEMU_TRACE_DEFAULT_COUNT;
+
+	if ((argc < 3) || (argc > 4)) {
+		cmd_devemu_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	if (!strcmp(argv[2], "start")) {
+		rc = vmm_devemu_trace_start();
+		if (rc) {
+			vmm_cprintf(cdev, "Failed to start trace "
+				    "(error %d)\n", rc);
+		}
+		return rc;
+	} else if (!strcmp(argv[2], "stop")) {
+		return vmm_devemu_trace_stop();
+	} else if (!strcmp(argv[2], "status")) {
+		return cmd_devemu_trace_status(cdev);
+	} else if (!strcmp(argv[2], "dump")) {
+		if (argc > 3) {
+			max = strtoul(argv[3], NULL, 10);
+		}
+		return cmd_devemu_trace_dump(cdev, max);
+	}
+
+	cmd_devemu_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static const struct {
+	char *name;
+	int (*function) (struct vmm_chardev *, int, char **);
+} command[] = {
+	{"help", cmd_devemu_help},
+	{"stats", cmd_devemu_stats},
+	{"trace", cmd_devemu_trace},
+	{NULL, NULL},
+};
+
+static int cmd_devemu_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int index = 0;
+
+	if (argc < 2) {
+		goto fail;
+	}
+
+	while (command[index].name) {
+		if (strcmp(argv[1], command[index].name) == 0) {
+			return command[index].function(cdev, argc, argv);
+		}
+		index++;
+	}
+
+fail:
+	cmd_devemu_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_devemu = {
+	.name = "devemu",
+	.desc = "emulated device statistics and trace",
+	.usage = cmd_devemu_usage,
+	.exec = cmd_devemu_exec,
+};
+
+static int __init cmd_devemu_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_devemu);
+}
+
+static void __exit cmd_devemu_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_devemu);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
@@ -51,12 +51,17 @@ static void cmd_guest_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   guest pause   <guest_name>\n");
 	vmm_cprintf(cdev, "   guest resume  <guest_name>\n");
 	vmm_cprintf(cdev, "   guest halt    <guest_name>\n");
+	vmm_cprintf(cdev, "   guest info    <guest_name>\n");
+	vmm_cprintf(cdev, "   guest balloon <guest_name> "
+			  "[<target_mem_MB>]\n");
 	vmm_cprintf(cdev, "   guest dumpmem <guest_name> <gphys_addr> "
 			  "[mem_sz]\n");
 	vmm_cprintf(cdev, "   guest region  <guest_name> <gphys_addr>\n");
 	vmm_cprintf(cdev, "Note:\n");
 	vmm_cprintf(cdev, "   <guest_name> = node name under /guests "
 			  "device tree node\n");
+	vmm_cprintf(cdev, "   <target_mem_MB> = guest RAM left to guest "
+			  "after inflating balloon\n");
 }
 
 static int guest_list_iter(struct vmm_guest *guest, void *priv)
@@ -157,6 +162,112 @@ static int cmd_guest_reset(struct vmm_chardev *cdev, const char *name)
 	return ret;
 }
 
+static int cmd_guest_info(struct vmm_chardev *cdev, const char *name)
+{
+	int ret;
+	physical_size_t committed, resident;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	ret = vmm_guest_ram_usage(guest, &committed, &resident);
+	if (ret) {
+		vmm_cprintf(cdev, "%s: Failed to get RAM usage\n", name);
+		return ret;
+	}
+
+	vmm_cprintf(cdev, "ID            : %d\n", guest->id);
+	vmm_cprintf(cdev, "Name          : %s\n", guest->name);
+	vmm_cprintf(cdev, "Endianness    : %s\n",
+		    (guest->is_big_endian) ? "big" : "little");
+	vmm_cprintf(cdev, "VCPU Count    : %d\n",
+		    vmm_manager_guest_vcpu_count(guest));
+	vmm_cprintf(cdev, "RAM Committed : %llu KB\n",
+		    (u64)committed >> 10);
+	vmm_cprintf(cdev, "RAM Resident  : %llu KB\n",
+		    (u64)resident >> 10);
+
+	return VMM_OK;
+}
+
+static const char *const balloon_stat_names[] = {
+	[VMM_GUEST_BALLOON_STAT_SWAP_IN] = "Swap In",
+	[VMM_GUEST_BALLOON_STAT_SWAP_OUT] = "Swap Out",
+	[VMM_GUEST_BALLOON_STAT_MAJFLT] = "Major Faults",
+	[VMM_GUEST_BALLOON_STAT_MINFLT] = "Minor Faults",
+	[VMM_GUEST_BALLOON_STAT_MEMFREE] = "Free Memory",
+	[VMM_GUEST_BALLOON_STAT_MEMTOT] = "Total Memory",
+	[VMM_GUEST_BALLOON_STAT_AVAIL] = "Available Memory",
+	[VMM_GUEST_BALLOON_STAT_CACHES] = "Disk Caches",
+	[VMM_GUEST_BALLOON_STAT_HTLB_PGALLOC] = "Hugetlb Allocs",
+	[VMM_GUEST_BALLOON_STAT_HTLB_PGFAIL] = "Hugetlb Failures",
+};
+
+static int cmd_guest_balloon(struct vmm_chardev *cdev, const char *name,
+			     int argc, char **argv)
+{
+	int ret, i;
+	u64 target_mb;
+	physical_size_t committed, resident, target;
+	struct vmm_guest_balloon info;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	ret = vmm_guest_ram_usage(guest, &committed, &resident);
+	if (ret) {
+		vmm_cprintf(cdev, "%s: Failed to get RAM usage\n", name);
+		return ret;
+	}
+
+	if (argc > 3) {
+		target_mb = strtoull(argv[3], NULL, 0);
+		target = (physical_size_t)target_mb << 20;
+		target = (target < committed) ? (committed - target) : 0;
+		ret = vmm_guest_balloon_set_target(guest, target);
+		if (ret) {
+			vmm_cprintf(cdev, "%s: Failed to set balloon target "
+				    "(error %d)\n", name, ret);
+		} else {
+			vmm_cprintf(cdev, "%s: Balloon target %llu KB\n",
+				    name, (u64)target >> 10);
+		}
+		return ret;
+	}
+
+	ret = vmm_guest_balloon_info(guest, &info);
+	if (ret) {
+		vmm_cprintf(cdev, "%s: No balloon device\n", name);
+		return ret;
+	}
+
+	vmm_cprintf(cdev, "RAM Committed    : %llu KB\n",
+		    (u64)committed >> 10);
+	vmm_cprintf(cdev, "RAM Resident     : %llu KB\n",
+		    (u64)resident >> 10);
+	vmm_cprintf(cdev, "Balloon Target   : %llu KB\n",
+		    (u64)info.target >> 10);
+	vmm_cprintf(cdev, "Balloon Actual   : %llu KB\n",
+		    (u64)info.actual >> 10);
+	vmm_cprintf(cdev, "Host RAM Released: %llu KB\n",
+		    (u64)info.released >> 10);
+	if (info.stats_valid) {
+		vmm_cprintf(cdev, "Guest Statistics:\n");
+		for (i = 0; i < VMM_GUEST_BALLOON_STAT_MAX; i++) {
+			vmm_cprintf(cdev, "  %-17s: %llu\n",
+				    balloon_stat_names[i], info.stats[i]);
+		}
+	}
+
+	return VMM_OK;
+}
+
 static int cmd_guest_kick(struct vmm_chardev *cdev, const char *name)
 {
 	int ret;
@@ -376,6 +487,10 @@ static int cmd_guest_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		return cmd_guest_resume(cdev, argv[2]);
 	} else if (strcmp(argv[1], "halt") == 0) {
 		return cmd_guest_halt(cdev, argv[2]);
+	} else if (strcmp(argv[1], "info") == 0) {
+		return cmd_guest_info(cdev, argv[2]);
+	} else if (strcmp(argv[1], "balloon") == 0) {
+		return cmd_guest_balloon(cdev, argv[2], argc, argv);
 	} else if (strcmp(argv[1], "dumpmem") == 0) {
 		ret = cmd_guest_param(cdev, argc, argv, &src_addr, &size);
 		if (VMM_OK != ret) {
@@ -24,12 +24,16 @@
 #include <vmm_error.h>
 #include <vmm_stdio.h>
 #include <vmm_version.h>
+#include <vmm_cache.h>
 #include <vmm_heap.h>
+#include <vmm_slab.h>
 #include <vmm_host_aspace.h>
+#include <vmm_timer.h>
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <libs/buddy.h>
 
 #define MODULE_DESC			"Command heap"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -46,6 +50,8 @@ static void cmd_heap_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   heap state\n");
 	vmm_cprintf(cdev, "   heap dma_info\n");
 	vmm_cprintf(cdev, "   heap dma_state\n");
+	vmm_cprintf(cdev, "   heap slab\n");
+	vmm_cprintf(cdev, "   heap bench [<rounds>]\n");
 }
 
 static int heap_info(struct vmm_chardev *cdev,
@@ -134,8 +140,147 @@ static int cmd_heap_dma_state(struct vmm_chardev *cdev)
 	return vmm_dma_heap_print_state(cdev);
 }
 
+#define HEAP_BENCH_MEM_START		VMM_PAGE_SIZE
+#define HEAP_BENCH_MEM_SIZE		(1024 * 1024)
+#define HEAP_BENCH_MIN_BIN		VMM_CACHE_LINE_SHIFT
+#define HEAP_BENCH_MAX_BIN		VMM_PAGE_SHIFT
+#define HEAP_BENCH_OBJ_COUNT		512
+#define HEAP_BENCH_DEFAULT_ROUNDS	16
+
+static int heap_bench_run(struct vmm_chardev *cdev, const char *name,
+			  bool use_map, u32 rounds, unsigned long *addrs)
+{
+	int rc = VMM_OK;
+	u32 r, i, seed;
+	u64 t, alloc_ns, find_ns, free_ns, ops;
+	unsigned long hk_size, map_size, asize;
+	void *hk_area = NULL, *map_area = NULL;
+	struct buddy_allocator *ba;
+
+	ba = vmm_zalloc(sizeof(*ba));
+	if (!ba) {
+		return VMM_ENOMEM;
+	}
+
+	hk_size = HEAP_BENCH_MEM_SIZE / 8;
+	hk_area = vmm_malloc(hk_size);
+	if (!hk_area) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	map_size = 0;
+	if (use_map) {
+		map_size = buddy_alloc_map_size(HEAP_BENCH_MEM_SIZE,
+						HEAP_BENCH_MIN_BIN);
+		map_area = vmm_malloc(map_size);
+		if (!map_area) {
+			rc = VMM_ENOMEM;
+			goto done;
+		}
+	}
+
+	/* Buddy allocator never touches managed memory
+	 * so we can safely use a dummy address range.
+	 */
+	rc = buddy_allocator_init(ba, hk_area, hk_size, map_area, map_size,
+				  HEAP_BENCH_MEM_START, HEAP_BENCH_MEM_SIZE,
+				  HEAP_BENCH_MIN_BIN, HEAP_BENCH_MAX_BIN);
+	if (rc) {
+		goto done;
+	}
+
+	seed = 1;
+	alloc_ns = find_ns = free_ns = 0;
+	for (r = 0; r < rounds; r++) {
+		t = vmm_timer_timestamp();
+		for (i = 0; i < HEAP_BENCH_OBJ_COUNT; i++) {
+			seed = seed * 1103515245 + 12345;
+			if (buddy_mem_alloc(ba, 32 + ((seed >> 16) & 0x1ff),
+					    &addrs[i])) {
+				addrs[i] = 0;
+			}
+		}
+		alloc_ns += vmm_timer_timestamp() - t;
+
+		t = vmm_timer_timestamp();
+		for (i = 0; i < HEAP_BENCH_OBJ_COUNT; i++) {
+			if (addrs[i]) {
+				buddy_mem_find(ba, addrs[i], NULL, NULL, &asize);
+			}
+		}
+		find_ns += vmm_timer_timestamp() - t;
+
+		/* Free even objects first and then odd objects */
+		t = vmm_timer_timestamp();
+		for (i = 0; i < HEAP_BENCH_OBJ_COUNT; i += 2) {
+			if (addrs[i]) {
+				buddy_mem_free(ba, addrs[i]);
+			}
+		}
+		for (i = 1; i < HEAP_BENCH_OBJ_COUNT; i += 2) {
+			if (addrs[i]) {
+				buddy_mem_free(ba, addrs[i]);
+			}
+		}
+		free_ns += vmm_timer_timestamp() - t;
+	}
+
+	ops = (u64)rounds * HEAP_BENCH_OBJ_COUNT;
+	vmm_cprintf(cdev, "%-8s alloc %6lld ns/op, find %6lld ns/op, "
+		    "free %6lld ns/op\n", name, udiv64(alloc_ns, ops),
+		    udiv64(find_ns, ops), udiv64(free_ns, ops));
+
+done:
+	if (map_area) {
+		vmm_free(map_area);
+	}
+	if (hk_area) {
+		vmm_free(hk_area);
+	}
+	vmm_free(ba);
+
+	return rc;
+}
+
+static int cmd_heap_bench(struct vmm_chardev *cdev, u32 rounds)
+{
+	int rc;
+	unsigned long *addrs;
+
+	if (!rounds) {
+		vmm_cprintf(cdev, "Error: Invalid number of rounds\n");
+		return VMM_EINVALID;
+	}
+
+	addrs = vmm_zalloc(HEAP_BENCH_OBJ_COUNT * sizeof(*addrs));
+	if (!addrs) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_cprintf(cdev, "Buddy allocator: %d rounds of %d objects\n",
+		    rounds, HEAP_BENCH_OBJ_COUNT);
+
+	rc = heap_bench_run(cdev, "rbtree", FALSE, rounds, addrs);
+	if (!rc) {
+		rc = heap_bench_run(cdev, "map", TRUE, rounds, addrs);
+	}
+	if (rc) {
+		vmm_cprintf(cdev, "Error: Benchmark failed (error %d)\n", rc);
+	}
+
+	vmm_free(addrs);
+
+	return rc;
+}
+
 static int cmd_heap_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
+	if (argc == 2 && strcmp(argv[1], "bench") == 0) {
+		return cmd_heap_bench(cdev, HEAP_BENCH_DEFAULT_ROUNDS);
+	} else if (argc == 3 && strcmp(argv[1], "bench") == 0) {
+		return cmd_heap_bench(cdev, atoi(argv[2]));
+	}
 	if (argc == 2) {
 		if (strcmp(argv[1], "help") == 0) {
 			cmd_heap_usage(cdev);
@@ -148,6 +293,8 @@ static int cmd_heap_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			return cmd_heap_dma_info(cdev);
 		} else if (strcmp(argv[1], "dma_state") == 0) {
 			return cmd_heap_dma_state(cdev);
+		} else if (strcmp(argv[1], "slab") == 0) {
+			return vmm_slab_print_state(cdev);
 		}
 	}
 	cmd_heap_usage(cdev);
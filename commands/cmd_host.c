@@ -36,9 +36,12 @@
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <vmm_delay.h>
+#include <vmm_heap.h>
+#include <vmm_timer.h>
 #include <vmm_scheduler.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <arch_atomic.h>
 #include <arch_board.h>
 #include <arch_cpu.h>
 
@@ -49,6 +52,16 @@
 #define	MODULE_INIT			cmd_host_init
 #define	MODULE_EXIT			cmd_host_exit
 
+#define HOST_TIMER_BENCH_DEFAULT_COUNT	4096
+#define HOST_TIMER_BENCH_MAX_COUNT	65536
+#define HOST_TIMER_BENCH_FAR_NSECS	1000000000
+#define HOST_TIMER_BENCH_NEAR_NSECS	1000000
+#define HOST_TIMER_BENCH_WAIT_MSECS	1000
+#define HOST_RAM_BENCH_DEFAULT_COUNT	4096
+#define HOST_RAM_BENCH_MAX_COUNT	65536
+#define HOST_RAM_BENCH_HUGE_COUNT	16
+#define HOST_RAM_BENCH_HUGE_ORDER	21
+
 static void cmd_host_usage(struct vmm_chardev *cdev)
 {
 	vmm_cprintf(cdev, "Usage:\n");
@@ -59,8 +72,11 @@ static void cmd_host_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   host irq stats\n");
 	vmm_cprintf(cdev, "   host irq set_affinity <hirq> <hcpu>\n");
 	vmm_cprintf(cdev, "   host extirq stats\n");
+	vmm_cprintf(cdev, "   host timer info\n");
+	vmm_cprintf(cdev, "   host timer bench [<event count>]\n");
 	vmm_cprintf(cdev, "   host ram info\n");
 	vmm_cprintf(cdev, "   host ram bitmap [<column count>]\n");
+	vmm_cprintf(cdev, "   host ram bench [<alloc count>]\n");
 	vmm_cprintf(cdev, "   host vapool info\n");
 	vmm_cprintf(cdev, "   host vapool state\n");
 	vmm_cprintf(cdev, "   host vapool bitmap [<column count>]\n");
@@ -240,6 +256,114 @@ static void cmd_host_extirq_stats(struct vmm_chardev *cdev)
 	vmm_host_irqext_debug_dump(cdev);
 }
 
+static void cmd_host_timer_info(struct vmm_chardev *cdev)
+{
+	u32 c;
+	u64 tstamp, next;
+
+	tstamp = vmm_timer_timestamp();
+
+	vmm_cprintf(cdev, "----------------------------------------\n");
+	vmm_cprintf(cdev, " %4s %14s %18s\n",
+			  "CPU#", "Active Events", "Next Event (ns)");
+	vmm_cprintf(cdev, "----------------------------------------\n");
+	for_each_online_cpu(c) {
+		next = vmm_timer_next_event(c);
+		if (next) {
+			vmm_cprintf(cdev, " %4d %14d %18lld\n", c,
+				    vmm_timer_event_count(c),
+				    (tstamp < next) ? next - tstamp : 0);
+		} else {
+			vmm_cprintf(cdev, " %4d %14d %18s\n", c,
+				    vmm_timer_event_count(c), "---");
+		}
+	}
+	vmm_cprintf(cdev, "----------------------------------------\n");
+}
+
+static void cmd_host_timer_bench_event(struct vmm_timer_event *ev)
+{
+	arch_atomic_add((atomic_t *)ev->priv, 1);
+}
+
+static u64 cmd_host_timer_bench_arm(struct vmm_timer_event *evs, u32 count,
+				    u32 *seed, u64 base_nsecs)
+{
+	u32 i;
+	u64 t = vmm_timer_timestamp();
+
+	for (i = 0; i < count; i++) {
+		*seed = *seed * 1103515245 + 12345;
+		vmm_timer_event_start(&evs[i],
+				      base_nsecs + umod32(*seed, base_nsecs));
+	}
+
+	return vmm_timer_timestamp() - t;
+}
+
+static int cmd_host_timer_bench(struct vmm_chardev *cdev, u32 count)
+{
+	u32 i, seed = 1, waited;
+	u64 t, arm_ns, rearm_ns, cancel_ns;
+	atomic_t fired;
+	struct vmm_timer_event *evs;
+
+	if (!count || (HOST_TIMER_BENCH_MAX_COUNT < count)) {
+		vmm_cprintf(cdev, "Error: Event count should be "
+			    "between 1 and %d\n", HOST_TIMER_BENCH_MAX_COUNT);
+		return VMM_EINVALID;
+	}
+
+	evs = vmm_zalloc(count * sizeof(*evs));
+	if (!evs) {
+		return VMM_ENOMEM;
+	}
+
+	arch_atomic_write(&fired, 0);
+	for (i = 0; i < count; i++) {
+		INIT_TIMER_EVENT(&evs[i], cmd_host_timer_bench_event, &fired);
+	}
+
+	vmm_cprintf(cdev, "Timer events: %d events\n", count);
+
+	/* Arm, re-arm and cancel events which will not expire */
+	arm_ns = cmd_host_timer_bench_arm(evs, count, &seed,
+					  HOST_TIMER_BENCH_FAR_NSECS);
+	rearm_ns = cmd_host_timer_bench_arm(evs, count, &seed,
+					    HOST_TIMER_BENCH_FAR_NSECS);
+	t = vmm_timer_timestamp();
+	for (i = 0; i < count; i++) {
+		vmm_timer_event_stop(&evs[i]);
+	}
+	cancel_ns = vmm_timer_timestamp() - t;
+
+	vmm_cprintf(cdev, "arm %lld ns/op, re-arm %lld ns/op, "
+		    "cancel %lld ns/op\n", udiv64(arm_ns, count),
+		    udiv64(rearm_ns, count), udiv64(cancel_ns, count));
+
+	/* Arm events which expire within a short window */
+	cmd_host_timer_bench_arm(evs, count, &seed,
+				 HOST_TIMER_BENCH_NEAR_NSECS);
+	t = vmm_timer_timestamp();
+	for (waited = 0; waited < HOST_TIMER_BENCH_WAIT_MSECS; waited++) {
+		if (arch_atomic_read(&fired) == count) {
+			break;
+		}
+		vmm_msleep(1);
+	}
+	t = vmm_timer_timestamp() - t;
+
+	vmm_cprintf(cdev, "expired %ld/%d events in %lld us\n",
+		    arch_atomic_read(&fired), count, udiv64(t, 1000));
+
+	for (i = 0; i < count; i++) {
+		vmm_timer_event_stop(&evs[i]);
+	}
+	vmm_free(evs);
+
+	return VMM_OK;
+}
+
 static void cmd_host_ram_info(struct vmm_chardev *cdev)
 {
 	u32 bn, bank_count = vmm_host_ram_bank_count();
@@ -283,6 +407,96 @@ static void cmd_host_ram_info(struct vmm_chardev *cdev)
 	}
 }
 
+static u32 cmd_host_ram_bench_alloc(physical_addr_t *pa, u32 count,
+				    u32 step, physical_size_t sz,
+				    u32 align_order, u64 *ns)
+{
+	u32 i, done = 0;
+	u64 t = vmm_timer_timestamp();
+
+	for (i = 0; i < count; i += step) {
+		if (!vmm_host_ram_alloc(&pa[i], sz, align_order)) {
+			break;
+		}
+		done++;
+	}
+
+	*ns = vmm_timer_timestamp() - t;
+
+	return done;
+}
+
+static void cmd_host_ram_bench_free(physical_addr_t *pa, u32 count,
+				    u32 step, physical_size_t sz, u64 *ns)
+{
+	u32 i;
+	u64 t = vmm_timer_timestamp();
+
+	for (i = 0; i < (count * step); i += step) {
+		vmm_host_ram_free(pa[i], sz);
+	}
+
+	*ns = vmm_timer_timestamp() - t;
+}
+
+static int cmd_host_ram_bench(struct vmm_chardev *cdev, u32 count)
+{
+	u32 done, frag;
+	u64 alloc_ns, free_ns;
+	physical_addr_t *pa;
+
+	if (!count || (HOST_RAM_BENCH_MAX_COUNT < count)) {
+		vmm_cprintf(cdev, "Error: Alloc count should be "
+			    "between 1 and %d\n", HOST_RAM_BENCH_MAX_COUNT);
+		return VMM_EINVALID;
+	}
+
+	pa = vmm_zalloc(count * sizeof(*pa));
+	if (!pa) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_cprintf(cdev, "Free frames: %d\n",
+		    vmm_host_ram_total_free_frames());
+
+	/* Single frame allocations */
+	done = cmd_host_ram_bench_alloc(pa, count, 1, VMM_PAGE_SIZE,
+					VMM_PAGE_SHIFT, &alloc_ns);
+	cmd_host_ram_bench_free(pa, done, 1, VMM_PAGE_SIZE, &free_ns);
+	vmm_cprintf(cdev, "1 frame    : %d allocs, alloc %lld ns/op, "
+		    "free %lld ns/op\n", done, udiv64(alloc_ns, done ? done : 1),
+		    udiv64(free_ns, done ? done : 1));
+
+	/* Two frame allocations after freeing every other single frame */
+	done = cmd_host_ram_bench_alloc(pa, count, 1, VMM_PAGE_SIZE,
+					VMM_PAGE_SHIFT, &alloc_ns);
+	cmd_host_ram_bench_free(&pa[1], done / 2, 2, VMM_PAGE_SIZE, &free_ns);
+	frag = cmd_host_ram_bench_alloc(&pa[1], done - 1, 2,
+					2 * VMM_PAGE_SIZE, VMM_PAGE_SHIFT,
+					&alloc_ns);
+	cmd_host_ram_bench_free(&pa[1], frag, 2, 2 * VMM_PAGE_SIZE, &free_ns);
+	vmm_cprintf(cdev, "2 frames   : %d allocs in fragmented RAM, "
+		    "alloc %lld ns/op\n", frag,
+		    udiv64(alloc_ns, frag ? frag : 1));
+	cmd_host_ram_bench_free(pa, (done + 1) / 2, 2, VMM_PAGE_SIZE,
+				&free_ns);
+
+	/* Huge aligned allocations */
+	done = cmd_host_ram_bench_alloc(pa, HOST_RAM_BENCH_HUGE_COUNT, 1,
+					1UL << HOST_RAM_BENCH_HUGE_ORDER,
+					HOST_RAM_BENCH_HUGE_ORDER, &alloc_ns);
+	cmd_host_ram_bench_free(pa, done, 1, 1UL << HOST_RAM_BENCH_HUGE_ORDER,
+				&free_ns);
+	vmm_cprintf(cdev, "%d KB    : %d allocs, alloc %lld ns/op, "
+		    "free %lld ns/op\n", (1 << HOST_RAM_BENCH_HUGE_ORDER) / 1024,
+		    done, udiv64(alloc_ns, done ? done : 1),
+		    udiv64(free_ns, done ? done : 1));
+
+	vmm_free(pa);
+
+	return VMM_OK;
+}
+
 static void cmd_host_ram_bitmap(struct vmm_chardev *cdev, int colcnt)
 {
 	u32 ite, count, bn, bank_count = vmm_host_ram_bank_count();
@@ -555,6 +769,17 @@ static int cmd_host_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			cmd_host_extirq_stats(cdev);
 			return VMM_OK;
 		}
+	} else if ((strcmp(argv[1], "timer") == 0) && (2 < argc)) {
+		if (strcmp(argv[2], "info") == 0) {
+			cmd_host_timer_info(cdev);
+			return VMM_OK;
+		} else if (strcmp(argv[2], "bench") == 0) {
+			if (3 < argc) {
+				return cmd_host_timer_bench(cdev, atoi(argv[3]));
+			}
+			return cmd_host_timer_bench(cdev,
+					HOST_TIMER_BENCH_DEFAULT_COUNT);
+		}
 	} else if ((strcmp(argv[1], "ram") == 0) && (2 < argc)) {
 		if (strcmp(argv[2], "info") == 0) {
 			cmd_host_ram_info(cdev);
@@ -567,6 +792,12 @@ static int cmd_host_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			}
 			cmd_host_ram_bitmap(cdev, colcnt);
 			return VMM_OK;
+		} else if (strcmp(argv[2], "bench") == 0) {
+			if (3 < argc) {
+				return cmd_host_ram_bench(cdev, atoi(argv[3]));
+			}
+			return cmd_host_ram_bench(cdev,
+					HOST_RAM_BENCH_DEFAULT_COUNT);
 		}
 	} else if ((strcmp(argv[1], "vapool") == 0) && (2 < argc)) {
 		if (strcmp(argv[2], "info") == 0) {
@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_lockstat.c
+ * @author Xvisor Developers
+ * @brief Implementation of lockstat command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <vmm_heap.h>
+#include <vmm_lockstat.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#include <libs/libsort.h>
+#include <libs/kallsyms.h>
+
+#define MODULE_DESC			"Command lockstat"
+#define MODULE_AUTHOR			"Xvisor Developers"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_lockstat_init
+#define	MODULE_EXIT			cmd_lockstat_exit
+
+#define CMD_LOCKSTAT_DEFAULT_COUNT	32
+
+static const char *cmd_lockstat_type_name[] = {
+	[VMM_LOCKSTAT_SPIN] = "spin",
+	[VMM_LOCKSTAT_READ] = "read",
+	[VMM_LOCKSTAT_WRITE] = "write",
+};
+
+static void cmd_lockstat_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage: \n");
+	vmm_cprintf(cdev, "   lockstat help\n");
+	vmm_cprintf(cdev, "   lockstat show [<count>]\n");
+	vmm_cprintf(cdev, "   lockstat clear\n");
+	vmm_cprintf(cdev, "   lockstat start\n");
+	vmm_cprintf(cdev, "   lockstat stop\n");
+	vmm_cprintf(cdev, "   lockstat status\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   wait times are in nsecs and show lists "
+		    "top %d lock classes by total wait time by default\n",
+		    CMD_LOCKSTAT_DEFAULT_COUNT);
+}
+
+static int cmd_lockstat_help(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	cmd_lockstat_usage(cdev);
+
+	return VMM_OK;
+}
+
+static int cmd_lockstat_less(void *m, size_t a, size_t b)
+{
+	struct vmm_lockstat_info *l = m;
+
+	return (l[a].wait_nsecs > l[b].wait_nsecs) ? 1 : 0;
+}
+
+static void cmd_lockstat_swap(void *m, size_t a, size_t b)
+{
+	struct vmm_lockstat_info tmp;
+	struct vmm_lockstat_info *l = m;
+
+	tmp = l[a];
+	l[a] = l[b];
+	l[b] = tmp;
+}
+
+static int cmd_lockstat_show(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	u32 i, n, max, count = CMD_LOCKSTAT_DEFAULT_COUNT;
+	char symname[KSYM_NAME_LEN];
+	struct vmm_lockstat_info *l;
+
+	if (argc > 3) {
+		cmd_lockstat_usage(cdev);
+		return VMM_EFAIL;
+	}
+	if (argc == 3) {
+		count = strtoul(argv[2], NULL, 10);
+	}
+
+	max = vmm_lockstat_max_count();
+	l = vmm_zalloc(sizeof(*l) * max);
+	if (!l) {
+		return VMM_ENOMEM;
+	}
+
+	n = 0;
+	for (i = 0; i < max; i++) {
+		if (vmm_lockstat_get(i, &l[n])) {
+			continue;
+		}
+		if (l[n].contended) {
+			n++;
+		}
+	}
+	if (n) {
+		libsort_smoothsort(l, 0, n, cmd_lockstat_less,
+				   cmd_lockstat_swap);
+	}
+
+	vmm_cprintf(cdev, "%-40s %-5s %10s %14s %10s %10s\n",
+		    "Site", "Type", "Contended", "Total(ns)",
+		    "Avg(ns)", "Max(ns)");
+	for (i = 0; (i < n) && (i < count); i++) {
+		kallsyms_sprint_symbol(symname, l[i].site);
+		vmm_cprintf(cdev, "%-40s %-5s %10llu %14llu %10llu %10llu\n",
+			    symname, cmd_lockstat_type_name[l[i].type],
+			    l[i].contended, l[i].wait_nsecs,
+			    udiv64(l[i].wait_nsecs, l[i].contended),
+			    l[i].wait_max_nsecs);
+	}
+
+	vmm_free(l);
+
+	return VMM_OK;
+}
+
+static int cmd_lockstat_clear(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	vmm_lockstat_clear();
+
+	return VMM_OK;
+}
+
+static int cmd_lockstat_start(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	vmm_lockstat_set_active(TRUE);
+
+	return VMM_OK;
+}
+
+static int cmd_lockstat_stop(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	vmm_lockstat_set_active(FALSE);
+
+	return VMM_OK;
+}
+
+static int cmd_lockstat_status(struct vmm_chardev *cdev,
+			       int argc, char **argv)
+{
+	u32 i, used = 0;
+	struct vmm_lockstat_info info;
+
+	for (i = 0; i < vmm_lockstat_max_count(); i++) {
+		if (!vmm_lockstat_get(i, &info)) {
+			used++;
+		}
+	}
+
+	vmm_cprintf(cdev, "Lockstat      : %s\n",
+		    (vmm_lockstat_isactive()) ? "running" : "stopped");
+	vmm_cprintf(cdev, "Lock Classes  : %d of %d\n",
+		    used, vmm_lockstat_max_count());
+	vmm_cprintf(cdev, "Dropped       : %llu\n", vmm_lockstat_dropped());
+
+	return VMM_OK;
+}
+
+static const struct {
+	char *name;
+	int (*function) (struct vmm_chardev *, int, char **);
+} command[] = {
+	{"help", cmd_lockstat_help},
+	{"show", cmd_lockstat_show},
+	{"clear", cmd_lockstat_clear},
+	{"start", cmd_lockstat_start},
+	{"stop", cmd_lockstat_stop},
+	{"status", cmd_lockstat_status},
+	{NULL, NULL},
+};
+
+static int cmd_lockstat_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int index = 0;
+
+	if (argc < 2) {
+		goto fail;
+	}
+
+	while (command[index].name) {
+		if (strcmp(argv[1], command[index].name) == 0) {
+			return command[index].function(cdev, argc, argv);
+		}
+		index++;
+	}
+
+fail:
+	cmd_lockstat_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_lockstat = {
+	.name = "lockstat",
+	.desc = "spinlock contention statistics",
+	.usage = cmd_lockstat_usage,
+	.exec = cmd_lockstat_exec,
+};
+
+static int __init cmd_lockstat_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_lockstat);
+}
+
+static void __exit cmd_lockstat_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_lockstat);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
@@ -26,10 +26,8 @@
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <vmm_heap.h>
-#include <vmm_timer.h>
+#include <vmm_manager.h>
 #include <vmm_profiler.h>
-#include <arch_atomic.h>
-#include <arch_atomic64.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
 #include <libs/kallsyms.h>
@@ -42,326 +40,390 @@
 #define	MODULE_INIT			cmd_profile_init
 #define	MODULE_EXIT			cmd_profile_exit
 
-static bool cmd_profile_updated = FALSE;
+struct cmd_profile_symbol {
+	u32 pos;
+	u32 self;
+	u32 total;
+};
 
 static void cmd_profile_usage(struct vmm_chardev *cdev)
 {
 	vmm_cprintf(cdev, "Usage: \n");
 	vmm_cprintf(cdev, "   profile help\n");
-	vmm_cprintf(cdev, "   profile start\n");
+	vmm_cprintf(cdev, "   profile start [<period_usecs>] [<stack_depth>]\n");
 	vmm_cprintf(cdev, "   profile stop\n");
 	vmm_cprintf(cdev, "   profile status\n");
-	vmm_cprintf(cdev,
-		    "   profile dump [name|count|total_time|single_time]\n");
+	vmm_cprintf(cdev, "   profile dump [self|total|name]\n");
+	vmm_cprintf(cdev, "   profile context\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   default period is %d usecs and stack "
+		    "unwinding is disabled by default\n",
+		    (u32)udiv64(VMM_PROFILER_DEFAULT_PERIOD_NSECS, 1000));
+	vmm_cprintf(cdev, "   maximum stack_depth is %d\n",
+		    VMM_PROFILER_MAX_DEPTH);
 }
 
-static int cmd_profile_help(struct vmm_chardev *cdev, char *dummy)
+static int cmd_profile_help(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	cmd_profile_usage(cdev);
 
 	return VMM_OK;
 }
 
-static int cmd_profile_status(struct vmm_chardev *cdev, char *dummy)
+static void cmd_profile_percent(u32 count, u32 total,
+				u32 *whole, u32 *frac)
 {
-	if (vmm_profiler_isactive()) {
-		vmm_cprintf(cdev, "profile function is running\n");
-	} else {
-		vmm_cprintf(cdev, "profile function is not running\n");
-	}
+	u64 tmp = (total) ? udiv64((u64)count * 10000, total) : 0;
 
-	return VMM_OK;
+	*whole = (u32)udiv64(tmp, 100);
+	*frac = (u32)umod64(tmp, 100);
 }
 
-static int cmd_profile_name_cmp(void *m, size_t a, size_t b)
+static int cmd_profile_status(struct vmm_chardev *cdev, int argc, char **argv)
 {
-	int retval = 0;
-	struct vmm_profiler_stat *ptr = m;
-	char name_a[KSYM_NAME_LEN], name_b[KSYM_NAME_LEN];
-
-	name_a[0] = name_b[0] = name_a[KSYM_NAME_LEN - 1] =
-	    name_b[KSYM_NAME_LEN - 1] = 0;
-
-	kallsyms_expand_symbol(kallsyms_get_symbol_offset
-			       (ptr[a].counter[0].index), name_a);
-	kallsyms_expand_symbol(kallsyms_get_symbol_offset
-			       (ptr[b].counter[0].index), name_b);
-
-	retval = strncmp(name_a, name_b, KSYM_NAME_LEN) < 0 ? 1 : 0;
+	u32 cpu, count, dropped;
+
+	vmm_cprintf(cdev, "Profiler      : %s\n",
+		    (vmm_profiler_isactive()) ? "running" : "stopped");
+	vmm_cprintf(cdev, "Period        : %d usecs\n",
+		    (u32)udiv64(vmm_profiler_period(), 1000));
+	vmm_cprintf(cdev, "Stack Depth   : %d\n",
+		    vmm_profiler_stack_depth());
+	vmm_cprintf(cdev, "Max Samples   : %d per CPU\n",
+		    vmm_profiler_max_samples());
+
+	vmm_cprintf(cdev, "%-6s %-10s %-10s\n", "CPU", "Samples", "Dropped");
+	for_each_online_cpu(cpu) {
+		count = vmm_profiler_sample_count(cpu);
+		dropped = vmm_profiler_dropped_count(cpu);
+		vmm_cprintf(cdev, "%-6d %-10d %-10d\n", cpu, count, dropped);
+	}
 
-	return retval;
+	return VMM_OK;
 }
 
-static u32 cmd_profile_compute_count(struct vmm_profiler_stat *ptr)
+static int cmd_profile_self_less(void *m, size_t a, size_t b)
 {
-	int i;
-	u32 count = 0;
+	struct cmd_profile_symbol *syms = m;
 
-	for (i = 0; i < VMM_PROFILE_ARRAY_SIZE; i++) {
-		count += arch_atomic_read(&ptr->counter[i].count);
+	if (syms[a].self != syms[b].self) {
+		return (syms[a].self > syms[b].self) ? 1 : 0;
 	}
-
-	return count;
-}
-
-static int cmd_profile_count_cmp(void *m, size_t a, size_t b)
-{
-	struct vmm_profiler_stat *ptr = m;
-	u32 count_a = cmd_profile_compute_count(&ptr[a]);
-	u32 count_b = cmd_profile_compute_count(&ptr[b]);
-
-	if (count_a < count_b) {
-		return 1;
-	} else if ((count_a == count_b)
-		   && arch_atomic_read(&ptr[a].counter[0].count)
-		   && arch_atomic_read(&ptr[b].counter[0].count)) {
-		return cmd_profile_name_cmp(m, a, b);
-	} else {
-		return 0;
+	if (syms[a].total != syms[b].total) {
+		return (syms[a].total > syms[b].total) ? 1 : 0;
 	}
+
+	return (syms[a].pos < syms[b].pos) ? 1 : 0;
 }
 
-static u64 cmd_profile_compute_total_time(struct vmm_profiler_stat *ptr)
+static int cmd_profile_total_less(void *m, size_t a, size_t b)
 {
-	int i;
-	u64 time = 0;
+	struct cmd_profile_symbol *syms = m;
 
-	for (i = 0; i < VMM_PROFILE_ARRAY_SIZE; i++) {
-		if (arch_atomic_read(&ptr->counter[i].count))
-			time += arch_atomic64_read(&ptr->counter[i].total_time);
+	if (syms[a].total != syms[b].total) {
+		return (syms[a].total > syms[b].total) ? 1 : 0;
 	}
-
-	return time;
-}
-
-static int cmd_profile_total_time_cmp(void *m, size_t a, size_t b)
-{
-	struct vmm_profiler_stat *ptr = m;
-	u64 time_a = cmd_profile_compute_total_time(&ptr[a]);
-	u64 time_b = cmd_profile_compute_total_time(&ptr[b]);
-
-	if (time_a < time_b) {
-		return 1;
-	} else if ((time_a == time_b)
-		   && arch_atomic_read(&ptr[a].counter[0].count)
-		   && arch_atomic_read(&ptr[b].counter[0].count)) {
-		return cmd_profile_name_cmp(m, a, b);
-	} else {
-		return 0;
+	if (syms[a].self != syms[b].self) {
+		return (syms[a].self > syms[b].self) ? 1 : 0;
 	}
+
+	return (syms[a].pos < syms[b].pos) ? 1 : 0;
 }
 
-static u64 cmd_profile_compute_time_per_call(struct vmm_profiler_stat *ptr)
+static int cmd_profile_name_less(void *m, size_t a, size_t b)
 {
-	u64 time = 0;
-	u64 count = cmd_profile_compute_count(ptr);
+	struct cmd_profile_symbol *syms = m;
+	char name_a[KSYM_NAME_LEN], name_b[KSYM_NAME_LEN];
 
-	if (count) {
-		time = cmd_profile_compute_total_time(ptr);
-		time = udiv64(time, count);
-	}
+	name_a[0] = name_b[0] = name_a[KSYM_NAME_LEN - 1] =
+	    name_b[KSYM_NAME_LEN - 1] = 0;
 
-	return time;
-}
+	kallsyms_expand_symbol(kallsyms_get_symbol_offset(syms[a].pos),
+			       name_a);
+	kallsyms_expand_symbol(kallsyms_get_symbol_offset(syms[b].pos),
+			       name_b);
 
-static int cmd_profile_time_per_call_cmp(void *m, size_t a, size_t b)
-{
-	struct vmm_profiler_stat *ptr = m;
-	int time_a = cmd_profile_compute_time_per_call(&ptr[a]);
-	int time_b = cmd_profile_compute_time_per_call(&ptr[b]);
-
-	if (time_a < time_b) {
-		return 1;
-	} else if ((time_a == time_b)
-		   && arch_atomic_read(&ptr[a].counter[0].count)
-		   && arch_atomic_read(&ptr[b].counter[0].count)) {
-		return cmd_profile_name_cmp(m, a, b);
-	} else {
-		return 0;
-	}
+	return (strncmp(name_a, name_b, KSYM_NAME_LEN) < 0) ? 1 : 0;
 }
 
 static void cmd_profile_swap(void *m, size_t a, size_t b)
 {
-	struct vmm_profiler_stat tmp;
-	struct vmm_profiler_stat *ptr = m;
+	struct cmd_profile_symbol tmp;
+	struct cmd_profile_symbol *syms = m;
 
-	tmp = ptr[a];
-	ptr[a] = ptr[b];
-	ptr[b] = tmp;
-}
-
-static int cmd_profile_stat_update(void *data, const char *name,
-				   unsigned long addr)
-{
-	int i, count;
-	struct vmm_profiler_stat *ptr = data;
-	u32 index = kallsyms_get_symbol_pos(addr, NULL, NULL);
-
-	ptr += index;
-
-	for (i = 0; i < VMM_PROFILE_ARRAY_SIZE; i++) {
-		ptr->counter[i].index = index;
-		count = arch_atomic_read(&ptr->counter[i].count);
-		/* we need to compute "time_per_call" */
-		if (count) {
-			arch_atomic64_write(&ptr->counter[i].time_per_call,
-			    udiv64(arch_atomic64_read(&ptr->counter[i].total_time), count));
-		} else {
-			arch_atomic64_write(&ptr->counter[i].time_per_call, 0);
-		}
-	}
-
-	/* mark unknown parent as such */
-	ptr->counter[VMM_PROFILE_ARRAY_SIZE - 1].parent_index =
-	    VMM_PROFILE_OTHER_PARENT;
-
-	return VMM_OK;
+	tmp = syms[a];
+	syms[a] = syms[b];
+	syms[b] = tmp;
 }
 
 static const struct {
 	char *name;
 	int (*function) (void *, size_t, size_t);
 } const filters[] = {
-	{"count", cmd_profile_count_cmp},
-	{"total_time", cmd_profile_total_time_cmp},
-	{"single_time", cmd_profile_time_per_call_cmp},
-	{"name", cmd_profile_name_cmp},
+	{"self", cmd_profile_self_less},
+	{"total", cmd_profile_total_less},
+	{"name", cmd_profile_name_less},
 	{NULL, NULL},
 };
 
-static u32 ns_to_micros(u64 count)
+static bool cmd_profile_symbol_pos(virtual_addr_t addr, u32 *pos)
 {
-	if (count > ((u64) 0xffffffff * 1000)) {
-		return 0xffffffff;
-	} else {
-		return (u32) udiv64(count, 1000);
+	if (!kallsyms_num_syms || (addr < kallsyms_addresses[0])) {
+		return FALSE;
 	}
+
+	*pos = kallsyms_get_symbol_pos(addr, NULL, NULL);
+
+	return TRUE;
 }
 
-static int cmd_profile_dump(struct vmm_chardev *cdev, char *filter_mode)
+/* Account one host sample. The pc symbol gets self and total count
+ * whereas each distinct caller symbol only gets total count.
+ */
+static bool cmd_profile_account(struct cmd_profile_symbol *syms,
+				struct vmm_profiler_sample *s)
 {
-	int index = 0;
-	int (*cmp_function) (void *, size_t, size_t) = cmd_profile_count_cmp;
-	struct vmm_profiler_stat *stat_array = vmm_profiler_get_stat_array();
+	u32 i, j, n = 0, pos;
+	u32 seen[VMM_PROFILER_MAX_DEPTH + 1];
 
-	if (stat_array == NULL) {
-		vmm_cprintf(cdev, "Profiler stat pointer is NULL\n");
-		return VMM_EFAIL;
+	if (!cmd_profile_symbol_pos(s->pc, &pos)) {
+		return FALSE;
+	}
+
+	syms[pos].self++;
+	syms[pos].total++;
+	seen[n++] = pos;
+
+	for (i = 0; i < s->depth; i++) {
+		if (!cmd_profile_symbol_pos(s->stack[i], &pos)) {
+			continue;
+		}
+		for (j = 0; j < n; j++) {
+			if (seen[j] == pos) {
+				break;
+			}
+		}
+		if (j < n) {
+			continue;
+		}
+		syms[pos].total++;
+		seen[n++] = pos;
 	}
 
-	if (vmm_profiler_isactive()) {
-		vmm_cprintf(cdev, "Can't dump while profiler is active\n");
+	return TRUE;
+}
+
+static int cmd_profile_dump(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int index = 0;
+	u32 cpu, i, count, nsyms, host = 0, unknown = 0;
+	u32 self_w, self_f, total_w, total_f;
+	char name[KSYM_NAME_LEN];
+	struct vmm_profiler_sample *s;
+	struct cmd_profile_symbol *syms;
+	int (*less_function) (void *, size_t, size_t) = cmd_profile_self_less;
+
+	if (argc > 3) {
+		cmd_profile_usage(cdev);
 		return VMM_EFAIL;
 	}
 
-	if (filter_mode != NULL) {
-		cmp_function = NULL;
+	if (argc == 3) {
+		less_function = NULL;
 		while (filters[index].name) {
-			if (strcmp(filter_mode, filters[index].name) == 0) {
-				cmp_function = filters[index].function;
+			if (strcmp(argv[2], filters[index].name) == 0) {
+				less_function = filters[index].function;
 				break;
 			}
 			index++;
 		}
 	}
 
-	if (cmp_function == NULL) {
+	if (less_function == NULL) {
 		cmd_profile_usage(cdev);
 		return VMM_EFAIL;
 	}
 
-	if (!cmd_profile_updated) {
-		kallsyms_on_each_symbol(cmd_profile_stat_update, stat_array);
-		cmd_profile_updated = TRUE;
+	if (!kallsyms_num_syms) {
+		vmm_cprintf(cdev, "No kernel symbols available\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	syms = vmm_zalloc(sizeof(*syms) * kallsyms_num_syms);
+	if (!syms) {
+		return VMM_ENOMEM;
+	}
+
+	/* Symbolization is done here so that sampling stays cheap */
+	for_each_online_cpu(cpu) {
+		count = vmm_profiler_sample_count(cpu);
+		for (i = 0; i < count; i++) {
+			s = vmm_profiler_sample(cpu, i);
+			if (s->type != VMM_PROFILER_SAMPLE_HOST) {
+				continue;
+			}
+			host++;
+			if (!cmd_profile_account(syms, s)) {
+				unknown++;
+			}
+		}
+	}
+
+	nsyms = 0;
+	for (i = 0; i < kallsyms_num_syms; i++) {
+		if (!syms[i].total) {
+			continue;
+		}
+		syms[nsyms] = syms[i];
+		syms[nsyms].pos = i;
+		nsyms++;
+	}
+
+	if (nsyms) {
+		libsort_smoothsort(syms, 0, nsyms, less_function,
+				   cmd_profile_swap);
+	}
+
+	vmm_cprintf(cdev, "%-40s %10s %8s %10s %8s\n",
+		    "Function", "Self", "Self%", "Total", "Total%");
+	for (i = 0; i < nsyms; i++) {
+		name[0] = name[KSYM_NAME_LEN - 1] = 0;
+		kallsyms_expand_symbol(kallsyms_get_symbol_offset(syms[i].pos),
+				       name);
+		cmd_profile_percent(syms[i].self, host, &self_w, &self_f);
+		cmd_profile_percent(syms[i].total, host, &total_w, &total_f);
+		vmm_cprintf(cdev, "%-40s %10d %5d.%02d %10d %5d.%02d\n",
+			    name, syms[i].self, self_w, self_f,
+			    syms[i].total, total_w, total_f);
+	}
+	if (unknown) {
+		cmd_profile_percent(unknown, host, &self_w, &self_f);
+		vmm_cprintf(cdev, "%-40s %10d %5d.%02d\n",
+			    "[unknown]", unknown, self_w, self_f);
+	}
+	vmm_cprintf(cdev, "Total hypervisor samples: %d\n", host);
+
+	vmm_free(syms);
+
+	return VMM_OK;
+}
+
+static int cmd_profile_context(struct vmm_chardev *cdev,
+			       int argc, char **argv)
+{
+	u32 cpu, i, count, vcpu_count, total = 0;
+	u32 host = 0, guest = 0, whole, frac;
+	u32 *counts;
+	struct vmm_vcpu *vcpu;
+	struct vmm_profiler_sample *s;
+
+	/* Last entry accounts samples without any current VCPU */
+	vcpu_count = vmm_manager_max_vcpu_count();
+	counts = vmm_zalloc(sizeof(*counts) * (vcpu_count + 1));
+	if (!counts) {
+		return VMM_ENOMEM;
 	}
 
-	libsort_smoothsort(stat_array, 0, kallsyms_num_syms, cmp_function,
-			   cmd_profile_swap);
-
-	for (index = 0; index < kallsyms_num_syms; index++) {
-		int i;
-		struct vmm_profiler_stat *ptr = &stat_array[index];
-		u32 total_count = cmd_profile_compute_count(ptr);
-		u64 time_per_call = cmd_profile_compute_time_per_call(ptr);
-		u64 total_time = cmd_profile_compute_total_time(ptr);
-
-		for (i = 0; i < VMM_PROFILE_ARRAY_SIZE; i++) {
-			struct vmm_profiler_counter *cnt = &ptr->counter[i];
-			u32 count = arch_atomic_read(&cnt->count);
-
-			if (count) {
-				char name[KSYM_NAME_LEN], parent[KSYM_NAME_LEN];
-
-				name[0] = name[KSYM_NAME_LEN - 1] = 0;
-				parent[0] = parent[KSYM_NAME_LEN - 1] = 0;
-
-				kallsyms_expand_symbol
-				    (kallsyms_get_symbol_offset(cnt->index),
-				     name);
-
-				if (stat_array[index].counter[i].parent_index !=
-				    VMM_PROFILE_OTHER_PARENT) {
-					kallsyms_expand_symbol
-					    (kallsyms_get_symbol_offset
-					     (cnt->parent_index), parent);
-				} else {
-					strcpy(parent, "[other]");
-				}
-
-				vmm_cprintf(cdev,
-					    "%30s -> %-30s %8u/%-8u %10u/%-10u %10u/%-10u\n",
-					    parent, name, count, total_count,
-					    ns_to_micros(arch_atomic64_read(&cnt->total_time)),
-					    ns_to_micros(total_time),
-					    ns_to_micros(arch_atomic64_read(&cnt->time_per_call)),
-					    ns_to_micros(time_per_call));
+	for_each_online_cpu(cpu) {
+		count = vmm_profiler_sample_count(cpu);
+		for (i = 0; i < count; i++) {
+			s = vmm_profiler_sample(cpu, i);
+			if (s->vcpu_id < vcpu_count) {
+				counts[s->vcpu_id]++;
+			} else {
+				counts[vcpu_count]++;
 			}
+			if (s->type == VMM_PROFILER_SAMPLE_GUEST) {
+				guest++;
+			} else {
+				host++;
+			}
+			total++;
 		}
 	}
 
+	vmm_cprintf(cdev, "%-10s %-32s %10s %8s\n",
+		    "Context", "VCPU", "Samples", "Percent");
+	for (i = 0; i <= vcpu_count; i++) {
+		if (!counts[i]) {
+			continue;
+		}
+		vcpu = (i < vcpu_count) ? vmm_manager_vcpu(i) : NULL;
+		cmd_profile_percent(counts[i], total, &whole, &frac);
+		vmm_cprintf(cdev, "%-10s %-32s %10d %5d.%02d\n",
+			    (vcpu && vcpu->is_normal) ? "guest" : "hypervisor",
+			    (vcpu) ? vcpu->name :
+			    (i < vcpu_count) ? "(destroyed)" : "(none)",
+			    counts[i], whole, frac);
+	}
+
+	cmd_profile_percent(host, total, &whole, &frac);
+	vmm_cprintf(cdev, "Hypervisor samples: %d (%d.%02d%%)\n",
+		    host, whole, frac);
+	cmd_profile_percent(guest, total, &whole, &frac);
+	vmm_cprintf(cdev, "Guest samples     : %d (%d.%02d%%)\n",
+		    guest, whole, frac);
+
+	vmm_free(counts);
+
 	return VMM_OK;
 }
 
-static int cmd_profile_start(struct vmm_chardev *cdev, char *dummy)
+static int cmd_profile_start(struct vmm_chardev *cdev, int argc, char **argv)
 {
-	cmd_profile_updated = FALSE;
-	return vmm_profiler_start();
+	int rc;
+	u64 period_nsecs = 0;
+	u32 stack_depth = 0;
+
+	if (argc > 4) {
+		cmd_profile_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	if (argc > 2) {
+		period_nsecs = (u64)strtoul(argv[2], NULL, 10) * 1000;
+	}
+	if (argc > 3) {
+		stack_depth = strtoul(argv[3], NULL, 10);
+	}
+
+	rc = vmm_profiler_start(period_nsecs, stack_depth);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to start profiler (error %d)\n", rc);
+	}
+
+	return rc;
 }
 
-static int cmd_profile_stop(struct vmm_chardev *cdev, char *dummy)
+static int cmd_profile_stop(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	return vmm_profiler_stop();
 }
 
 static const struct {
 	char *name;
-	int (*function) (struct vmm_chardev *, char *);
+	int (*function) (struct vmm_chardev *, int, char **);
 } const command[] = {
 	{"help", cmd_profile_help},
 	{"start", cmd_profile_start},
 	{"stop", cmd_profile_stop},
 	{"status", cmd_profile_status},
 	{"dump", cmd_profile_dump},
+	{"context", cmd_profile_context},
 	{NULL, NULL},
 };
 
 static int cmd_profile_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
-	char *param = NULL;
 	int index = 0;
 
-	if (argc > 3) {
+	if (argc < 2) {
 		goto fail;
 	}
 
-	if (argc == 3) {
-		param = argv[2];
-	}
-
 	while (command[index].name) {
 		if (strcmp(argv[1], command[index].name) == 0) {
-			return command[index].function(cdev, param);
+			return command[index].function(cdev, argc, argv);
 		}
 		index++;
 	}
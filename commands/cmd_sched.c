@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_sched.c
+ * @author Xvisor Developers
+ * @brief Implementation of sched command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <vmm_cpumask.h>
+#include <vmm_manager.h>
+#include <vmm_scheduler.h>
+#include <libs/stringlib.h>
+
+#define MODULE_DESC			"Command sched"
+#define MODULE_AUTHOR			"Xvisor Developers"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_sched_init
+#define	MODULE_EXIT			cmd_sched_exit
+
+static void cmd_sched_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage: \n");
+	vmm_cprintf(cdev, "   sched help\n");
+	vmm_cprintf(cdev, "   sched stats [<hcpu>]\n");
+	vmm_cprintf(cdev, "   sched clear [<hcpu>]\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   wait is latency from VCPU ready to VCPU "
+		    "running and slice is running time per dispatch\n");
+	vmm_cprintf(cdev, "   per VCPU statistics are shown by "
+		    "vcpu dumpstat command\n");
+}
+
+static int cmd_sched_help(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	cmd_sched_usage(cdev);
+
+	return VMM_OK;
+}
+
+static int cmd_sched_parse_hcpu(struct vmm_chardev *cdev,
+				int argc, char **argv, int *hcpu)
+{
+	*hcpu = -1;
+
+	if (argc > 3) {
+		cmd_sched_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	if (argc == 3) {
+		*hcpu = atoi(argv[2]);
+		if ((*hcpu < 0) || (CONFIG_CPU_COUNT <= *hcpu) ||
+		    !vmm_cpu_online(*hcpu)) {
+			vmm_cprintf(cdev, "Invalid host CPU %s\n", argv[2]);
+			return VMM_EINVALID;
+		}
+	}
+
+	return VMM_OK;
+}
+
+static void cmd_sched_stats_show(struct vmm_chardev *cdev, u32 hcpu)
+{
+	u32 i;
+	u64 lo, hi;
+	struct vmm_scheduler_stats s;
+
+	if (vmm_scheduler_stats(hcpu, &s)) {
+		return;
+	}
+
+	vmm_cprintf(cdev, "Host CPU %d\n", hcpu);
+	vmm_cprintf(cdev, "Switch Count     : %llu\n", s.switch_count);
+	vmm_cprintf(cdev, "Preempt Count    : %llu\n", s.preempt_count);
+	vmm_cprintf(cdev, "Migrate Count    : %llu\n", s.migrate_count);
+
+	vmm_cprintf(cdev, "%-24s %12s %12s\n",
+		    "Latency(ns)", "Wait", "Slice");
+	for (i = 0; i < VMM_SCHEDULER_HIST_BUCKETS; i++) {
+		if (!s.wait_hist[i] && !s.slice_hist[i]) {
+			continue;
+		}
+		lo = (i) ? 1ULL << (VMM_SCHEDULER_HIST_SHIFT + i - 1) : 0;
+		hi = 1ULL << (VMM_SCHEDULER_HIST_SHIFT + i);
+		if (i < (VMM_SCHEDULER_HIST_BUCKETS - 1)) {
+			vmm_cprintf(cdev, "%10llu - %-11llu %12llu %12llu\n",
+				    lo, hi, s.wait_hist[i], s.slice_hist[i]);
+		} else {
+			vmm_cprintf(cdev, "%10llu+ %-12s %12llu %12llu\n",
+				    lo, "", s.wait_hist[i], s.slice_hist[i]);
+		}
+	}
+	vmm_cprintf(cdev, "\n");
+}
+
+static int cmd_sched_stats(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc, hcpu;
+	u32 c;
+
+	rc = cmd_sched_parse_hcpu(cdev, argc, argv, &hcpu);
+	if (rc) {
+		return rc;
+	}
+
+	if (hcpu >= 0) {
+		cmd_sched_stats_show(cdev, hcpu);
+		return VMM_OK;
+	}
+
+	for_each_online_cpu(c) {
+		cmd_sched_stats_show(cdev, c);
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_sched_clear(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc, hcpu;
+	u32 c;
+
+	rc = cmd_sched_parse_hcpu(cdev, argc, argv, &hcpu);
+	if (rc) {
+		return rc;
+	}
+
+	if (hcpu >= 0) {
+		return vmm_scheduler_stats_clear(hcpu);
+	}
+
+	for_each_online_cpu(c) {
+		rc = vmm_scheduler_stats_clear(c);
+		if (rc) {
+			vmm_cprintf(cdev, "Failed to clear host CPU %d "
+				    "(error %d)\n", c, rc);
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+static const struct {
+	char *name;
+	int (*function) (struct vmm_chardev *, int, char **);
+} command[] = {
+	{"help", cmd_sched_help},
+	{"stats", cmd_sched_stats},
+	{"clear", cmd_sched_clear},
+	{NULL, NULL},
+};
+
+static int cmd_sched_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int index = 0;
+
+	if (argc < 2) {
+		goto fail;
+	}
+
+	while (command[index].name) {
+		if (strcmp(argv[1], command[index].name) == 0) {
+			return command[index].function(cdev, argc, argv);
+		}
+		index++;
+	}
+
+fail:
+	cmd_sched_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_sched = {
+	.name = "sched",
+	.desc = "scheduler statistics",
+	.usage = cmd_sched_usage,
+	.exec = cmd_sched_exec,
+};
+
+static int __init cmd_sched_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_sched);
+}
+
+static void __exit cmd_sched_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_sched);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
@@ -28,7 +28,14 @@
 #include <vmm_threads.h>
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
+#include <vmm_heap.h>
+#include <vmm_timer.h>
+#include <vmm_mutex.h>
+#include <vmm_completion.h>
+#include <vmm_scheduler.h>
+#include <arch_barrier.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 
 #define MODULE_DESC			"Command thread"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -42,6 +49,7 @@ static void cmd_thread_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "Usage:\n");
 	vmm_cprintf(cdev, "   thread help\n");
 	vmm_cprintf(cdev, "   thread list\n");
+	vmm_cprintf(cdev, "   thread mutexbench [<threads>] [<iterations>]\n");
 }
 
 static void cmd_thread_list(struct vmm_chardev *cdev)
@@ -87,8 +95,188 @@ static void cmd_thread_list(struct vmm_chardev *cdev)
 			  "----------------------------------------\n");
 }
 
+#define MUTEX_BENCH_DEFAULT_ITERS	10000
+#define MUTEX_BENCH_HOLD_NSECS		2000
+#define MUTEX_BENCH_WORK_NSECS		2000
+
+struct mutex_bench {
+	struct vmm_mutex mut;
+	struct vmm_completion done;
+	u32 iters;
+	u64 counter;
+};
+
+static void mutex_bench_delay(u64 nsecs)
+{
+	u64 tstamp = vmm_timer_timestamp();
+
+	while ((vmm_timer_timestamp() - tstamp) < nsecs) {
+		arch_cpu_relax();
+	}
+}
+
+static int mutex_bench_worker(void *udata)
+{
+	u32 i;
+	struct mutex_bench *mb = udata;
+
+	for (i = 0; i < mb->iters; i++) {
+		vmm_mutex_lock(&mb->mut);
+		mb->counter++;
+		mutex_bench_delay(MUTEX_BENCH_HOLD_NSECS);
+		vmm_mutex_unlock(&mb->mut);
+		mutex_bench_delay(MUTEX_BENCH_WORK_NSECS);
+	}
+
+	vmm_completion_complete(&mb->done);
+
+	return VMM_OK;
+}
+
+static u64 mutex_bench_switches(void)
+{
+	u32 cpu;
+	u64 ret = 0;
+	struct vmm_scheduler_stats stats;
+
+	for_each_online_cpu(cpu) {
+		if (!vmm_scheduler_stats(cpu, &stats)) {
+			ret += stats.switch_count;
+		}
+	}
+
+	return ret;
+}
+
+static int mutex_bench_run(struct vmm_chardev *cdev, const char *name,
+			   u64 spin_nsecs, u32 nthreads, u32 iters,
+			   struct vmm_thread **threads)
+{
+	int rc = VMM_OK;
+	char tname[VMM_FIELD_NAME_SIZE];
+	u32 i, cpu, created = 0;
+	u64 t, switches, old_spin_nsecs, ops;
+	struct mutex_bench *mb;
+
+	mb = vmm_zalloc(sizeof(*mb));
+	if (!mb) {
+		return VMM_ENOMEM;
+	}
+	INIT_MUTEX(&mb->mut);
+	INIT_COMPLETION(&mb->done);
+	mb->iters = iters;
+
+	/* One worker per online host CPU so that mutex owner is
+	 * always running while others are contending for it.
+	 */
+	i = 0;
+	for_each_online_cpu(cpu) {
+		if (nthreads <= i) {
+			break;
+		}
+		vmm_snprintf(tname, sizeof(tname), "mutexbench%d", i);
+		threads[i] = vmm_threads_create(tname, mutex_bench_worker, mb,
+						VMM_THREAD_DEF_PRIORITY,
+						VMM_THREAD_DEF_TIME_SLICE);
+		if (!threads[i]) {
+			rc = VMM_EFAIL;
+			goto done;
+		}
+		created++;
+		rc = vmm_threads_set_affinity(threads[i],
+					      vmm_cpumask_of(cpu));
+		if (rc) {
+			goto done;
+		}
+		i++;
+	}
+
+	old_spin_nsecs = vmm_mutex_get_spin_nsecs();
+	vmm_mutex_set_spin_nsecs(spin_nsecs);
+
+	switches = mutex_bench_switches();
+	t = vmm_timer_timestamp();
+	for (i = 0; i < created; i++) {
+		vmm_threads_start(threads[i]);
+	}
+	for (i = 0; i < created; i++) {
+		vmm_completion_wait(&mb->done);
+	}
+	t = vmm_timer_timestamp() - t;
+	switches = mutex_bench_switches() - switches;
+
+	vmm_mutex_set_spin_nsecs(old_spin_nsecs);
+
+	ops = (u64)created * iters;
+	if (mb->counter != ops) {
+		vmm_cprintf(cdev, "Error: Mutex counter %lld expected %lld\n",
+			    mb->counter, ops);
+		rc = VMM_EFAIL;
+		goto done;
+	}
+
+	vmm_cprintf(cdev, "%-8s %8lld ns/op, %8lld context switches\n",
+		    name, udiv64(t, ops), switches);
+
+done:
+	for (i = 0; i < created; i++) {
+		vmm_threads_stop(threads[i]);
+		vmm_threads_destroy(threads[i]);
+	}
+	vmm_free(mb);
+
+	return rc;
+}
+
+static int cmd_thread_mutexbench(struct vmm_chardev *cdev,
+				 u32 nthreads, u32 iters)
+{
+	int rc;
+	struct vmm_thread **threads;
+
+	if (nthreads < 2 || vmm_num_online_cpus() < nthreads) {
+		vmm_cprintf(cdev, "Error: Need 2 to %d threads\n",
+			    vmm_num_online_cpus());
+		return VMM_EINVALID;
+	}
+	if (!iters) {
+		vmm_cprintf(cdev, "Error: Invalid number of iterations\n");
+		return VMM_EINVALID;
+	}
+
+	threads = vmm_zalloc(nthreads * sizeof(*threads));
+	if (!threads) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_cprintf(cdev, "Mutex: %d threads, %d iterations, "
+		    "%d ns held, %d ns outside\n", nthreads, iters,
+		    MUTEX_BENCH_HOLD_NSECS, MUTEX_BENCH_WORK_NSECS);
+
+	rc = mutex_bench_run(cdev, "sleep", 0, nthreads, iters, threads);
+	if (!rc) {
+		rc = mutex_bench_run(cdev, "spin",
+				     vmm_mutex_get_spin_nsecs(),
+				     nthreads, iters, threads);
+	}
+	if (rc) {
+		vmm_cprintf(cdev, "Error: Benchmark failed (error %d)\n", rc);
+	}
+
+	vmm_free(threads);
+
+	return rc;
+}
+
 static int cmd_thread_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
+	if (2 <= argc && argc <= 4 && strcmp(argv[1], "mutexbench") == 0) {
+		return cmd_thread_mutexbench(cdev,
+				(argc > 2) ? atoi(argv[2]) :
+					     vmm_num_online_cpus(),
+				(argc > 3) ? atoi(argv[3]) :
+					     MUTEX_BENCH_DEFAULT_ITERS);
+	}
 	if (argc == 2) {
 		if (strcmp(argv[1], "help") == 0) {
 			cmd_thread_usage(cdev);
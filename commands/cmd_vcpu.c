@@ -464,6 +464,8 @@ static int cmd_vcpu_dumpstat(struct vmm_chardev *cdev,
 	u32 state, hcpu, reset_count;
 	u64 last_reset_nsecs, total_nsecs;
 	u64 ready_nsecs, running_nsecs, paused_nsecs, halted_nsecs;
+	u64 usage;
+	struct vmm_vcpu_sched_stats sstats;
 	struct vmm_vcpu *vcpu;
 
 	if (!argc) {
@@ -546,6 +548,31 @@ static int cmd_vcpu_dumpstat(struct vmm_chardev *cdev,
 			  h, m, s, ms);
 	vmm_cprintf(cdev, "\n");
 
+	/* Scheduling statistics */
+	ret = vmm_scheduler_vcpu_stats(vcpu, &sstats);
+	if (ret) {
+		vmm_cprintf(cdev, "%s: Failed to get scheduling stats\n",
+				  vcpu->name);
+		return ret;
+	}
+	vmm_cprintf(cdev, "Dispatch Count   : %llu\n",
+			  sstats.dispatch_count);
+	vmm_cprintf(cdev, "Preempted Count  : %llu\n",
+			  sstats.preempted_count);
+	vmm_cprintf(cdev, "Migrate Count    : %llu\n",
+			  sstats.migrate_count);
+	vmm_cprintf(cdev, "Average Wait     : %llu nsecs\n",
+			  (sstats.dispatch_count) ?
+			  udiv64(sstats.wait_nsecs, sstats.dispatch_count) : 0);
+	vmm_cprintf(cdev, "Maximum Wait     : %llu nsecs\n",
+			  sstats.wait_max_nsecs);
+	/* Usage in hundredths of percent without overflowing u64 */
+	usage = udiv64(sstats.slice_nsecs, 10000);
+	usage = (usage) ? udiv64(sstats.slice_used_nsecs, usage) : 0;
+	vmm_cprintf(cdev, "Time Slice Usage : %d.%02d%%\n",
+			  (u32)udiv64(usage, 100), (u32)umod64(usage, 100));
+	vmm_cprintf(cdev, "\n");
+
 	/* Architecture specific dumpstat */
 	arch_vcpu_stat_dump(cdev, vcpu);
 
@@ -43,6 +43,9 @@ static void cmd_vdisk_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   vdisk list\n");
 	vmm_cprintf(cdev, "   vdisk detach <vdisk_name>\n");
 	vmm_cprintf(cdev, "   vdisk attach <vdisk_name> <block_device_name>\n");
+	vmm_cprintf(cdev, "   vdisk limit <vdisk_name> <max_inflight>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   <max_inflight> = 0 means no in-flight limit\n");
 }
 
 static int cmd_vdisk_list_iter(struct vmm_vdisk *vdisk, void *data)
@@ -103,6 +106,20 @@ static int cmd_vdisk_attach(struct vmm_chardev *cdev,
 	return VMM_OK;
 }
 
+static int cmd_vdisk_limit(struct vmm_chardev *cdev,
+			   const char *vdisk_name,
+			   u32 max_inflight)
+{
+	struct vmm_vdisk *vdisk = vmm_vdisk_find(vdisk_name);
+
+	if (!vdisk) {
+		vmm_cprintf(cdev, "Failed to find virtual disk\n");
+		return VMM_ENODEV;
+	}
+
+	return vmm_vdisk_set_max_inflight(vdisk, max_inflight);
+}
+
 static int cmd_vdisk_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	if (argc == 2) {
@@ -120,6 +137,8 @@ static int cmd_vdisk_exec(struct vmm_chardev *cdev, int argc, char **argv)
 	} else if (argc == 4) {
 		if (strcmp(argv[1], "attach") == 0) {
 			return cmd_vdisk_attach(cdev, argv[2], argv[3]);
+		} else if (strcmp(argv[1], "limit") == 0) {
+			return cmd_vdisk_limit(cdev, argv[2], atoi(argv[3]));
 		}
 	}
 	cmd_vdisk_usage(cdev);
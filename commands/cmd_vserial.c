@@ -225,6 +225,41 @@ static void cmd_vserial_recv(struct vmm_vserial *vser, void *priv, u8 ch)
 	}
 }
 
+static void cmd_vserial_recv_buf(struct vmm_vserial *vser, void *priv,
+				 u8 *data, u32 len)
+{
+	u32 i = 0, run;
+	struct cmd_vserial_recvcntx *v;
+	v = (struct cmd_vserial_recvcntx *)priv;
+
+	if (!v) {
+		return;
+	}
+
+	while ((i < len) && v->chcount) {
+		/* Print run of plain characters in one go */
+		run = 0;
+		while (!v->esc_cmd_active && ((i + run) < len) &&
+		       ((v->chcount < 0) || (run < v->chcount)) &&
+		       (data[i + run] != '\r') && (data[i + run] != '\n') &&
+		       (data[i + run] != '\e')) {
+			run++;
+		}
+
+		if (run) {
+			vmm_printchars(v->cdev, (char *)&data[i], run, TRUE);
+			if (0 < v->chcount) {
+				v->chcount -= run;
+			}
+			i += run;
+			continue;
+		}
+
+		cmd_vserial_recv(vser, priv, data[i]);
+		i++;
+	}
+}
+
 static int cmd_vserial_bind(struct vmm_chardev *cdev, const char *name)
 {
 	int rc = VMM_OK;
@@ -249,7 +284,8 @@ static int cmd_vserial_bind(struct vmm_chardev *cdev, const char *name)
 	recvcntx.esc_attrib[0] = 0;
 	recvcntx.cdev = cdev;
 
-	rc = vmm_vserial_register_receiver(vser, &cmd_vserial_recv, &recvcntx);
+	rc = vmm_vserial_register_receiver_buf(vser, &cmd_vserial_recv_buf,
+					       &recvcntx);
 	if (rc) {
 		return rc;
 	}
@@ -347,7 +383,8 @@ send_break:
 
 	vmm_cprintf(cdev, "\n");
 
-	rc = vmm_vserial_unregister_receiver(vser, &cmd_vserial_recv, &recvcntx);
+	rc = vmm_vserial_unregister_receiver_buf(vser, &cmd_vserial_recv_buf,
+						 &recvcntx);
 	if (rc) {
 		return rc;
 	}
@@ -377,14 +414,16 @@ static int cmd_vserial_dump(struct vmm_chardev *cdev,
 	recvcntx.esc_attrib[0] = 0;
 	recvcntx.cdev = cdev;
 
-	rc = vmm_vserial_register_receiver(vser, &cmd_vserial_recv, &recvcntx);
+	rc = vmm_vserial_register_receiver_buf(vser, &cmd_vserial_recv_buf,
+					       &recvcntx);
 	if (rc) {
 		return rc;
 	}
 
 	vmm_cprintf(cdev, "\n");
 
-	rc = vmm_vserial_unregister_receiver(vser, &cmd_vserial_recv, &recvcntx);
+	rc = vmm_vserial_unregister_receiver_buf(vser, &cmd_vserial_recv_buf,
+						 &recvcntx);
 	if (rc) {
 		return rc;
 	}
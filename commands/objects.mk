@@ -29,6 +29,7 @@ commands-objs-$(CONFIG_CMD_SHUTDOWN)+= cmd_shutdown.o
 commands-objs-$(CONFIG_CMD_HOST)+= cmd_host.o
 commands-objs-$(CONFIG_CMD_DEVTREE)+= cmd_devtree.o
 commands-objs-$(CONFIG_CMD_VCPU)+= cmd_vcpu.o
+commands-objs-$(CONFIG_CMD_SCHED)+= cmd_sched.o
 commands-objs-$(CONFIG_CMD_GUEST)+= cmd_guest.o
 commands-objs-$(CONFIG_CMD_MEMORY)+= cmd_memory.o
 commands-objs-$(CONFIG_CMD_THREAD)+= cmd_thread.o
@@ -38,6 +39,8 @@ commands-objs-$(CONFIG_CMD_HEAP)+= cmd_heap.o
 commands-objs-$(CONFIG_CMD_WALLCLOCK)+= cmd_wallclock.o
 commands-objs-$(CONFIG_CMD_MODULE)+= cmd_module.o
 commands-objs-$(CONFIG_CMD_PROFILE)+= cmd_profile.o
+commands-objs-$(CONFIG_CMD_DEVEMU)+= cmd_devemu.o
+commands-objs-$(CONFIG_CMD_LOCKSTAT)+= cmd_lockstat.o
 
 commands-objs-$(CONFIG_CMD_VSERIAL)+= cmd_vserial.o
 commands-objs-$(CONFIG_CMD_VDISK)+= cmd_vdisk.o
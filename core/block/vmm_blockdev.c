@@ -120,8 +120,7 @@ int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 		rc = bdev->rq->make_request(bdev->rq, r);
 		vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
 		if (rc) {
-			r->bdev = NULL;
-			return rc;
+			goto failed;
 		}
 	} else {
 		rc = VMM_EFAIL;
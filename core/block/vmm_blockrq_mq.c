@@ -0,0 +1,562 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_blockrq_mq.c
+ * @author Xvisor Developers
+ * @brief source file for multi-queue strategy based request queue
+ */
+
+#include <vmm_error.h>
+#include <vmm_macros.h>
+#include <vmm_heap.h>
+#include <vmm_smp.h>
+#include <vmm_delay.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cpumask.h>
+#include <vmm_host_aspace.h>
+#include <block/vmm_blockrq_mq.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+
+struct blockrq_mq_work {
+	struct dlist head;
+	struct vmm_request *r;
+};
+
+static struct blockrq_mq_work *blockrq_mq_alloc_work(
+					struct vmm_blockrq_mq *rqmq,
+					struct vmm_request *r)
+{
+	irq_flags_t flags;
+	struct blockrq_mq_work *mqwork = NULL;
+
+	vmm_spin_lock_irqsave_lite(&rqmq->free_lock, flags);
+
+	if (list_empty(&rqmq->free_list)) {
+		goto done;
+	}
+
+	mqwork = list_first_entry(&rqmq->free_list,
+				  struct blockrq_mq_work, head);
+	list_del(&mqwork->head);
+	mqwork->r = r;
+	if (!r) {
+		rqmq->flush_pending = TRUE;
+	}
+
+done:
+	vmm_spin_unlock_irqrestore_lite(&rqmq->free_lock, flags);
+
+	return mqwork;
+}
+
+static void blockrq_mq_free_works(struct vmm_blockrq_mq *rqmq,
+				  struct dlist *works)
+{
+	irq_flags_t flags;
+	struct blockrq_mq_work *mqwork;
+
+	vmm_spin_lock_irqsave_lite(&rqmq->free_lock, flags);
+
+	while (!list_empty(works)) {
+		mqwork = list_first_entry(works, struct blockrq_mq_work, head);
+		list_del(&mqwork->head);
+		mqwork->r = NULL;
+		list_add_tail(&mqwork->head, &rqmq->free_list);
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&rqmq->free_lock, flags);
+}
+
+static void blockrq_mq_kick(struct vmm_blockrq_mq *rqmq, u32 cpu)
+{
+	u32 i;
+	struct vmm_blockrq_mq_worker *worker;
+
+	worker = &rqmq->workers[umod32(cpu, rqmq->worker_count)];
+
+	/* Busy home worker will scan again before sleeping so we
+	 * additionally wake one idle worker to pick up the request.
+	 */
+	if (worker->busy) {
+		for (i = 0; i < rqmq->worker_count; i++) {
+			if (!rqmq->workers[i].busy) {
+				vmm_completion_complete_once(
+					&rqmq->workers[i].work_avail);
+				break;
+			}
+		}
+	}
+
+	vmm_completion_complete_once(&worker->work_avail);
+}
+
+static int blockrq_mq_queue_work(struct vmm_blockrq_mq *rqmq,
+				 struct vmm_request *r)
+{
+	u32 cpu;
+	irq_flags_t flags;
+	struct vmm_blockrq_mq_queue *sq;
+	struct blockrq_mq_work *mqwork;
+
+	/* Flush queued and not yet started covers this one as well */
+	if (!r && rqmq->flush_pending) {
+		return VMM_OK;
+	}
+
+	mqwork = blockrq_mq_alloc_work(rqmq, r);
+	if (!mqwork) {
+		return VMM_ENOMEM;
+	}
+
+	cpu = vmm_smp_processor_id();
+	sq = &rqmq->sq[cpu];
+
+	vmm_spin_lock_irqsave_lite(&sq->lock, flags);
+	list_add_tail(&mqwork->head, &sq->pending_list);
+	sq->pending_count++;
+	vmm_spin_unlock_irqrestore_lite(&sq->lock, flags);
+
+	blockrq_mq_kick(rqmq, cpu);
+
+	return VMM_OK;
+}
+
+static bool blockrq_mq_can_merge(struct vmm_blockrq_mq *rqmq,
+				 struct vmm_request *prev,
+				 struct vmm_request *next,
+				 u32 bytes)
+{
+	if (!next ||
+	    (next->type != prev->type) ||
+	    (next->bdev->block_size != prev->bdev->block_size) ||
+	    (next->lba != (prev->lba + prev->bcnt))) {
+		return FALSE;
+	}
+
+	return ((bytes + next->bcnt * next->bdev->block_size) <=
+							rqmq->max_merge);
+}
+
+/* Move next batch of works to given list and return number of works */
+static u32 blockrq_mq_dequeue_works(struct vmm_blockrq_mq_worker *worker,
+				    struct dlist *works)
+{
+	u32 i, count, bytes;
+	irq_flags_t flags;
+	struct vmm_request *prev;
+	struct blockrq_mq_work *mqwork;
+	struct vmm_blockrq_mq_queue *sq;
+	struct vmm_blockrq_mq *rqmq = worker->rqmq;
+
+	for (i = 0; i < CONFIG_CPU_COUNT; i++) {
+		sq = &rqmq->sq[umod32(worker->home + i, CONFIG_CPU_COUNT)];
+		if (!sq->pending_count) {
+			continue;
+		}
+
+		vmm_spin_lock_irqsave_lite(&sq->lock, flags);
+
+		if (list_empty(&sq->pending_list)) {
+			vmm_spin_unlock_irqrestore_lite(&sq->lock, flags);
+			continue;
+		}
+
+		mqwork = list_first_entry(&sq->pending_list,
+					  struct blockrq_mq_work, head);
+		list_del(&mqwork->head);
+		list_add_tail(&mqwork->head, works);
+		sq->pending_count--;
+		count = 1;
+		if (!mqwork->r) {
+			rqmq->flush_pending = FALSE;
+		}
+
+		prev = mqwork->r;
+		bytes = (prev) ? prev->bcnt * prev->bdev->block_size : 0;
+		while (prev && worker->merge_va &&
+		       !list_empty(&sq->pending_list)) {
+			mqwork = list_first_entry(&sq->pending_list,
+						  struct blockrq_mq_work, head);
+			if (!blockrq_mq_can_merge(rqmq, prev,
+						  mqwork->r, bytes)) {
+				break;
+			}
+			list_del(&mqwork->head);
+			list_add_tail(&mqwork->head, works);
+			sq->pending_count--;
+			count++;
+			prev = mqwork->r;
+			bytes += prev->bcnt * prev->bdev->block_size;
+		}
+
+		vmm_spin_unlock_irqrestore_lite(&sq->lock, flags);
+
+		return count;
+	}
+
+	return 0;
+}
+
+static int blockrq_mq_rw(struct vmm_blockrq_mq *rqmq,
+			 struct vmm_request *r)
+{
+	switch (r->type) {
+	case VMM_REQUEST_READ:
+		if (rqmq->read) {
+			return rqmq->read(rqmq, r, rqmq->priv);
+		}
+		return VMM_EIO;
+	case VMM_REQUEST_WRITE:
+		if (rqmq->write) {
+			return rqmq->write(rqmq, r, rqmq->priv);
+		}
+		return VMM_EIO;
+	default:
+		break;
+	};
+
+	return VMM_EINVALID;
+}
+
+static void blockrq_mq_dispatch_works(struct vmm_blockrq_mq_worker *worker,
+				      struct dlist *works, u32 count)
+{
+	int rc;
+	u32 len;
+	u8 *buf;
+	struct vmm_request mr;
+	struct blockrq_mq_work *mqwork;
+	struct vmm_blockrq_mq *rqmq = worker->rqmq;
+
+	mqwork = list_first_entry(works, struct blockrq_mq_work, head);
+
+	if (!mqwork->r) {
+		if (rqmq->flush) {
+			rqmq->flush(rqmq, rqmq->priv);
+		}
+		return;
+	}
+
+	if (count == 1) {
+		rc = blockrq_mq_rw(rqmq, mqwork->r);
+		if (rc) {
+			vmm_blockdev_fail_request(mqwork->r);
+		} else {
+			vmm_blockdev_complete_request(mqwork->r);
+		}
+		return;
+	}
+
+	/* Issue merged request using bounce buffer of worker */
+	memcpy(&mr, mqwork->r, sizeof(mr));
+	mr.bcnt = 0;
+	mr.data = (void *)worker->merge_va;
+	buf = (u8 *)worker->merge_va;
+	list_for_each_entry(mqwork, works, head) {
+		len = mqwork->r->bcnt * mqwork->r->bdev->block_size;
+		if (mr.type == VMM_REQUEST_WRITE) {
+			memcpy(buf, mqwork->r->data, len);
+		}
+		buf += len;
+		mr.bcnt += mqwork->r->bcnt;
+	}
+
+	rc = blockrq_mq_rw(rqmq, &mr);
+
+	buf = (u8 *)worker->merge_va;
+	list_for_each_entry(mqwork, works, head) {
+		len = mqwork->r->bcnt * mqwork->r->bdev->block_size;
+		if (!rc && (mr.type == VMM_REQUEST_READ)) {
+			memcpy(mqwork->r->data, buf, len);
+		}
+		buf += len;
+		if (rc) {
+			vmm_blockdev_fail_request(mqwork->r);
+		} else {
+			vmm_blockdev_complete_request(mqwork->r);
+		}
+	}
+}
+
+static int blockrq_mq_worker_main(void *data)
+{
+	u32 count;
+	struct dlist works;
+	struct vmm_blockrq_mq_worker *worker = data;
+	struct vmm_blockrq_mq *rqmq = worker->rqmq;
+
+	INIT_LIST_HEAD(&works);
+
+	while (1) {
+		vmm_completion_wait(&worker->work_avail);
+
+		worker->busy = TRUE;
+		while ((count = blockrq_mq_dequeue_works(worker, &works))) {
+			blockrq_mq_dispatch_works(worker, &works, count);
+			blockrq_mq_free_works(rqmq, &works);
+		}
+		worker->busy = FALSE;
+	}
+
+	return VMM_OK;
+}
+
+static int blockrq_mq_abort_work(struct vmm_blockrq_mq *rqmq,
+				 struct vmm_request *r)
+{
+	u32 cpu;
+	bool found = FALSE;
+	irq_flags_t flags;
+	struct dlist works;
+	struct vmm_blockrq_mq_queue *sq;
+	struct blockrq_mq_work *mqwork;
+
+	INIT_LIST_HEAD(&works);
+
+	for (cpu = 0; (cpu < CONFIG_CPU_COUNT) && !found; cpu++) {
+		sq = &rqmq->sq[cpu];
+
+		vmm_spin_lock_irqsave_lite(&sq->lock, flags);
+
+		list_for_each_entry(mqwork, &sq->pending_list, head) {
+			if (mqwork->r == r) {
+				list_del(&mqwork->head);
+				list_add_tail(&mqwork->head, &works);
+				sq->pending_count--;
+				found = TRUE;
+				break;
+			}
+		}
+
+		vmm_spin_unlock_irqrestore_lite(&sq->lock, flags);
+	}
+
+	if (!found) {
+		return VMM_ENOTAVAIL;
+	}
+
+	blockrq_mq_free_works(rqmq, &works);
+
+	return VMM_OK;
+}
+
+static int blockrq_mq_make_request(struct vmm_request_queue *rq,
+				   struct vmm_request *r)
+{
+	return blockrq_mq_queue_work(vmm_blockrq_mq_from_rq(rq), r);
+}
+
+static int blockrq_mq_abort_request(struct vmm_request_queue *rq,
+				    struct vmm_request *r)
+{
+	return blockrq_mq_abort_work(vmm_blockrq_mq_from_rq(rq), r);
+}
+
+static int blockrq_mq_flush_cache(struct vmm_request_queue *rq)
+{
+	return blockrq_mq_queue_work(vmm_blockrq_mq_from_rq(rq), NULL);
+}
+
+static void blockrq_mq_free(struct vmm_blockrq_mq *rqmq)
+{
+	u32 i;
+	struct vmm_blockrq_mq_worker *worker;
+
+	for (i = 0; i < rqmq->worker_count; i++) {
+		worker = &rqmq->workers[i];
+		if (worker->thread) {
+			vmm_threads_stop(worker->thread);
+			vmm_threads_destroy(worker->thread);
+		}
+		if (worker->merge_va) {
+			vmm_host_free_pages(worker->merge_va,
+					    worker->merge_page_count);
+		}
+	}
+
+	vmm_free(rqmq->workers);
+	if (rqmq->work_page_va) {
+		vmm_host_free_pages(rqmq->work_page_va, rqmq->work_page_count);
+	}
+	vmm_free(rqmq);
+}
+
+int vmm_blockrq_mq_destroy(struct vmm_blockrq_mq *rqmq)
+{
+	u32 i;
+	irq_flags_t flags;
+	struct dlist works;
+	struct blockrq_mq_work *mqwork;
+	struct vmm_blockrq_mq_queue *sq;
+
+	if (!rqmq) {
+		return VMM_EINVALID;
+	}
+
+	INIT_LIST_HEAD(&works);
+
+	/* Fail requests which are not yet picked by any worker */
+	for (i = 0; i < CONFIG_CPU_COUNT; i++) {
+		sq = &rqmq->sq[i];
+		vmm_spin_lock_irqsave_lite(&sq->lock, flags);
+		list_splice_tail_init(&sq->pending_list, &works);
+		sq->pending_count = 0;
+		vmm_spin_unlock_irqrestore_lite(&sq->lock, flags);
+	}
+	rqmq->flush_pending = FALSE;
+	list_for_each_entry(mqwork, &works, head) {
+		if (mqwork->r) {
+			vmm_blockdev_fail_request(mqwork->r);
+		}
+	}
+	blockrq_mq_free_works(rqmq, &works);
+
+	/* Wait for in-progress requests */
+	for (i = 0; i < rqmq->worker_count; i++) {
+		while (rqmq->workers[i].busy) {
+			vmm_msleep(1);
+		}
+	}
+
+	blockrq_mq_free(rqmq);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_mq_destroy);
+
+struct vmm_blockrq_mq *vmm_blockrq_mq_create(
+	const char *name, u32 max_pending, u32 worker_count, u32 max_merge,
+	int (*read)(struct vmm_blockrq_mq *,struct vmm_request *, void *),
+	int (*write)(struct vmm_blockrq_mq *,struct vmm_request *, void *),
+	void (*flush)(struct vmm_blockrq_mq *,void *),
+	void *priv)
+{
+	u32 i;
+	char tname[VMM_FIELD_NAME_SIZE];
+	struct vmm_blockrq_mq *rqmq;
+	struct blockrq_mq_work *mqwork;
+	struct vmm_blockrq_mq_worker *worker;
+
+	if (!name || (max_pending==0)) {
+		goto fail;
+	}
+
+	rqmq = vmm_zalloc(sizeof(*rqmq));
+	if (!rqmq) {
+		goto fail;
+	}
+
+	if (strlcpy(rqmq->name, name, sizeof(rqmq->name)) >=
+	    sizeof(rqmq->name)) {
+		goto fail_free_rqmq;
+	}
+	rqmq->max_pending = max_pending;
+	rqmq->max_merge = max_merge;
+	rqmq->read = read;
+	rqmq->write = write;
+	rqmq->flush = flush;
+	rqmq->priv = priv;
+
+	rqmq->work_page_count =
+			VMM_SIZE_TO_PAGE(max_pending * sizeof(*mqwork));
+	rqmq->work_page_va = vmm_host_alloc_pages(rqmq->work_page_count,
+						  VMM_MEMORY_FLAGS_NORMAL);
+	if (!rqmq->work_page_va) {
+		goto fail_free_rqmq;
+	}
+	INIT_SPIN_LOCK(&rqmq->free_lock);
+	INIT_LIST_HEAD(&rqmq->free_list);
+	rqmq->flush_pending = FALSE;
+
+	for (i = 0; i < rqmq->max_pending; i++) {
+		mqwork = (struct blockrq_mq_work *)(rqmq->work_page_va +
+						    i*sizeof(*mqwork));
+		INIT_LIST_HEAD(&mqwork->head);
+		mqwork->r = NULL;
+		list_add_tail(&mqwork->head, &rqmq->free_list);
+	}
+
+	for (i = 0; i < CONFIG_CPU_COUNT; i++) {
+		INIT_SPIN_LOCK(&rqmq->sq[i].lock);
+		INIT_LIST_HEAD(&rqmq->sq[i].pending_list);
+		rqmq->sq[i].pending_count = 0;
+	}
+
+	rqmq->worker_count = (worker_count) ?
+				worker_count : vmm_num_online_cpus();
+	rqmq->workers = vmm_zalloc(rqmq->worker_count * sizeof(*worker));
+	if (!rqmq->workers) {
+		goto fail_free_pages;
+	}
+
+	for (i = 0; i < rqmq->worker_count; i++) {
+		worker = &rqmq->workers[i];
+		worker->rqmq = rqmq;
+		worker->index = i;
+		worker->home = umod32(i, CONFIG_CPU_COUNT);
+		worker->busy = FALSE;
+		INIT_COMPLETION(&worker->work_avail);
+		if (rqmq->max_merge) {
+			worker->merge_page_count =
+				VMM_SIZE_TO_PAGE(rqmq->max_merge);
+			worker->merge_va = vmm_host_alloc_pages(
+						worker->merge_page_count,
+						VMM_MEMORY_FLAGS_NORMAL);
+			if (!worker->merge_va) {
+				goto fail_free_workers;
+			}
+		}
+		vmm_snprintf(tname, sizeof(tname), "%s/%d", name, i);
+		worker->thread = vmm_threads_create(tname,
+						blockrq_mq_worker_main, worker,
+						VMM_THREAD_DEF_PRIORITY,
+						VMM_THREAD_DEF_TIME_SLICE);
+		if (!worker->thread) {
+			goto fail_free_workers;
+		}
+		if (vmm_cpu_online(worker->home)) {
+			vmm_threads_set_affinity(worker->thread,
+					vmm_cpumask_of(worker->home));
+		}
+	}
+
+	INIT_REQUEST_QUEUE(&rqmq->rq);
+	rqmq->rq.make_request = blockrq_mq_make_request;
+	rqmq->rq.abort_request = blockrq_mq_abort_request;
+	rqmq->rq.flush_cache = blockrq_mq_flush_cache;
+	rqmq->rq.priv = rqmq;
+
+	for (i = 0; i < rqmq->worker_count; i++) {
+		vmm_threads_start(rqmq->workers[i].thread);
+	}
+
+	return rqmq;
+
+fail_free_workers:
+	blockrq_mq_free(rqmq);
+	goto fail;
+fail_free_pages:
+	vmm_host_free_pages(rqmq->work_page_va, rqmq->work_page_count);
+fail_free_rqmq:
+	vmm_free(rqmq);
+fail:
+	return NULL;
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_mq_create);
@@ -159,7 +159,9 @@ int vmm_blockdev_complete_request(struct vmm_request *r);
 /** Generic block IO fail request */
 int vmm_blockdev_fail_request(struct vmm_request *r);
 
-/** Generic block IO submit request */
+/** Generic block IO submit request
+ *  Note: Request is failed using fail callback when error is returned
+ */
 int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 				struct vmm_request *r);
 
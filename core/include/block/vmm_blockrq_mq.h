@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_blockrq_mq.h
+ * @author Xvisor Developers
+ * @brief header file for multi-queue strategy based request queue
+ */
+
+#ifndef __VMM_BLOCKRQ_MQ_H_
+#define __VMM_BLOCKRQ_MQ_H_
+
+#include <vmm_types.h>
+#include <vmm_limits.h>
+#include <vmm_threads.h>
+#include <vmm_completion.h>
+#include <vmm_spinlocks.h>
+#include <block/vmm_blockdev.h>
+#include <libs/list.h>
+
+struct vmm_blockrq_mq;
+
+/** Per-CPU submission queue of multi-queue request queue */
+struct vmm_blockrq_mq_queue {
+	vmm_spinlock_t lock;
+	struct dlist pending_list;
+	u32 pending_count;
+};
+
+/** Worker thread of multi-queue request queue */
+struct vmm_blockrq_mq_worker {
+	struct vmm_blockrq_mq *rqmq;
+	u32 index;
+	u32 home;
+	bool busy;
+	struct vmm_thread *thread;
+	struct vmm_completion work_avail;
+	u32 merge_page_count;
+	virtual_addr_t merge_va;
+};
+
+/** Representation of multi-queue strategy based request queue
+ *
+ * Requests are queued on the submission queue of the host CPU calling
+ * make_request() and dispatched by a pool of worker threads. Each worker
+ * has a home submission queue which it drains first before helping the
+ * other submission queues. Adjacent requests found at the head of a
+ * submission queue are merged into one backend call of up to max_merge
+ * bytes using a per-worker bounce buffer.
+ */
+struct vmm_blockrq_mq {
+	char name[VMM_FIELD_NAME_SIZE];
+	u32 max_pending;
+	u32 max_merge;
+
+	int (*read)(struct vmm_blockrq_mq *rqmq,
+		    struct vmm_request *r, void *priv);
+	int (*write)(struct vmm_blockrq_mq *rqmq,
+		     struct vmm_request *r, void *priv);
+	void (*flush)(struct vmm_blockrq_mq *rqmq, void *priv);
+	void *priv;
+
+	u32 work_page_count;
+	virtual_addr_t work_page_va;
+	vmm_spinlock_t free_lock;
+	struct dlist free_list;
+	bool flush_pending;
+
+	struct vmm_blockrq_mq_queue sq[CONFIG_CPU_COUNT];
+
+	u32 worker_count;
+	struct vmm_blockrq_mq_worker *workers;
+
+	struct vmm_request_queue rq;
+};
+
+/** Get multi-queue strategy based request queue from request queue pointer */
+static inline struct vmm_blockrq_mq *vmm_blockrq_mq_from_rq(
+					struct vmm_request_queue *rq)
+{
+	return (struct vmm_blockrq_mq *)rq->priv;
+}
+
+/** Get request queue pointer from multi-queue strategy based request queue */
+static inline struct vmm_request_queue *vmm_blockrq_mq_to_rq(
+					struct vmm_blockrq_mq *rqmq)
+{
+	return &rqmq->rq;
+}
+
+/** Destroy multi-queue strategy based request queue
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+int vmm_blockrq_mq_destroy(struct vmm_blockrq_mq *rqmq);
+
+/** Create multi-queue strategy based request queue
+ *  @name name of request queue (also used for worker threads)
+ *  @max_pending maximum number of queued requests
+ *  @worker_count number of worker threads (zero for one per online CPU)
+ *  @max_merge maximum bytes of one merged request (zero to disable merging)
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+struct vmm_blockrq_mq *vmm_blockrq_mq_create(
+	const char *name, u32 max_pending, u32 worker_count, u32 max_merge,
+	int (*read)(struct vmm_blockrq_mq *,struct vmm_request *, void *),
+	int (*write)(struct vmm_blockrq_mq *,struct vmm_request *, void *),
+	void (*flush)(struct vmm_blockrq_mq *,void *),
+	void *priv);
+
+#endif
@@ -111,6 +111,12 @@ struct m_hdr {
  */
 struct m_pkthdr {
 	int	len;			/* total packet length */
+	u16	csum_flags;		/* checksum offload flags; see below */
+	u16	csum_start;		/* offset to start checksumming from */
+	u16	csum_offset;		/* offset after csum_start to store csum */
+	u16	gso_type;		/* segmentation offload type; see below */
+	u16	gso_size;		/* payload bytes per segment */
+	u16	hdr_len;		/* header bytes in front of each segment */
 };
 
 struct m_ext {
@@ -135,6 +141,12 @@ struct vmm_mbuf {
 #define	m_len		m_hdr.mh_len
 #define	m_flags		m_hdr.mh_flags
 #define m_pktlen	m_pkthdr.len
+#define m_csum_flags	m_pkthdr.csum_flags
+#define m_csum_start	m_pkthdr.csum_start
+#define m_csum_offset	m_pkthdr.csum_offset
+#define m_gso_type	m_pkthdr.gso_type
+#define m_gso_size	m_pkthdr.gso_size
+#define m_hdr_len	m_pkthdr.hdr_len
 #define m_extbuf	m_ext.ext_buf
 #define m_extlen	m_ext.ext_size
 #define m_extref	m_ext.ext_refcnt
@@ -152,6 +164,17 @@ struct vmm_mbuf {
 /* mbuf flags */
 #define	M_PKTHDR	0x00001	/* start of record */
 
+/* checksum offload flags (m_csum_flags) */
+#define	M_CSUM_PARTIAL	0x0001	/* L4 csum to be completed from csum_start */
+#define	M_CSUM_VALID	0x0002	/* L4 csum already verified */
+
+/* segmentation offload types (m_gso_type) */
+#define	M_GSO_NONE	0x0000	/* not a large segment */
+#define	M_GSO_TCPV4	0x0001	/* TCP over IPv4 segmentation */
+#define	M_GSO_UDP	0x0002	/* UDP fragmentation */
+#define	M_GSO_TCPV6	0x0004	/* TCP over IPv6 segmentation */
+#define	M_GSO_ECN	0x8000	/* TCP has ECN set */
+
 /* additional flags for M_EXT mbufs */
 #define	M_EXT_FLAGS	0xff000000
 #define	M_EXT_RW	0x01000000	/* ext storage is writable */
@@ -160,6 +183,8 @@ struct vmm_mbuf {
 #define	M_EXT_POOL	0x08000000	/* ext storage is pool alloced */
 #define	M_EXT_HEAP	0x10000000	/* ext storage is normal heap alloced */
 #define	M_EXT_DMA	0x20000000	/* ext storage is dma heap alloced */
+#define	M_EXT_SLAB	0x40000000	/* ext storage is slab cache alloced */
+#define	M_EXT_GUEST	0x80000000	/* ext storage references guest memory */
 
 /* flags copied when copying m_pkthdr */
 #define	M_COPYFLAGS	(M_PKTHDR)
@@ -178,6 +203,12 @@ struct vmm_mbuf {
 #define	MGET(m, how, flags)	m = m_get((how), (flags))
 #define	MGETHDR(m, how, flags)	m = m_get((how), (flags | M_PKTHDR))
 
+/*
+ * M_COPY_PKTHDR(struct vmm_mbuf *to, struct vmm_mbuf *from)
+ * copies packet header including offload info from one mbuf to another
+ */
+#define	M_COPY_PKTHDR(to, from)	(to)->m_pkthdr = (from)->m_pkthdr
+
 #define	MCLINITREFERENCE(m)	m->m_ext.ext_refcnt = 1
 
 /*
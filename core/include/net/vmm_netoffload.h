@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netoffload.h
+ * @author Xvisor Developers
+ * @brief Software fallback for checksum and segmentation offloads.
+ */
+
+#ifndef __VMM_NETOFFLOAD_H_
+#define __VMM_NETOFFLOAD_H_
+
+#include <vmm_types.h>
+#include <net/vmm_mbuf.h>
+#include <net/vmm_netport.h>
+
+/** Check whether offload info of mbuf must be resolved in software
+ *  before handing it over to given port
+ */
+static inline bool vmm_netoffload_needed(struct vmm_netport *port,
+					 struct vmm_mbuf *m)
+{
+	u32 need = 0;
+
+	if (!(m->m_flags & M_PKTHDR) ||
+	    (!(m->m_csum_flags & M_CSUM_PARTIAL) &&
+	     (m->m_gso_type == M_GSO_NONE))) {
+		return FALSE;
+	}
+
+	if (m->m_csum_flags & M_CSUM_PARTIAL) {
+		need |= VMM_NETPORT_F_CSUM;
+	}
+
+	switch (m->m_gso_type & ~M_GSO_ECN) {
+	case M_GSO_NONE:
+		break;
+	case M_GSO_TCPV4:
+		need |= VMM_NETPORT_F_TSO4;
+		break;
+	case M_GSO_TCPV6:
+		need |= VMM_NETPORT_F_TSO6;
+		break;
+	case M_GSO_UDP:
+		need |= VMM_NETPORT_F_UFO;
+		break;
+	default:
+		return TRUE;
+	}
+
+	return ((port->features & need) != need) ? TRUE : FALSE;
+}
+
+/** Complete checksum and segmentation offloads of mbuf in software
+ *  The mbuf itself is not modified. Every resulting frame is passed
+ *  to xfer() which takes ownership of it.
+ */
+int vmm_netoffload_resolve(struct vmm_mbuf *m,
+			   int (*xfer)(struct vmm_mbuf *, void *),
+			   void *arg);
+
+#endif /* __VMM_NETOFFLOAD_H_ */
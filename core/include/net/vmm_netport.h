@@ -35,12 +35,24 @@
 /* Port Flags (should be defined as bits) */
 #define VMM_NETPORT_LINK_UP		1	/* If this bit is set link is up */
 
+/* Port offload features (should be defined as bits) */
+#define VMM_NETPORT_F_CSUM		0x1	/* Accepts partial checksum */
+#define VMM_NETPORT_F_TSO4		0x2	/* Accepts TCP over IPv4 GSO */
+#define VMM_NETPORT_F_TSO6		0x4	/* Accepts TCP over IPv6 GSO */
+#define VMM_NETPORT_F_UFO		0x8	/* Accepts UDP GSO */
+
 /* Default per-port queue size */
 #define VMM_NETPORT_MAX_QUEUE_SIZE	256
 
 /* Default per-port queue size */
 #define VMM_NETPORT_DEF_QUEUE_SIZE	(VMM_NETPORT_MAX_QUEUE_SIZE / 4)
 
+/* Max number of mbufs moved by one burst xfer */
+#define VMM_NETPORT_MAX_BURST		16
+
+/* Per-port number of burst xfer mbuf arrays */
+#define VMM_NETPORT_BURST_POOL_SIZE	16
+
 struct vmm_netswitch;
 struct vmm_netport;
 struct vmm_mbuf;
@@ -48,7 +60,13 @@ struct vmm_mbuf;
 enum vmm_netport_xfer_type {
 	VMM_NETPORT_XFER_UNKNOWN,
 	VMM_NETPORT_XFER_MBUF,
-	VMM_NETPORT_XFER_LAZY
+	VMM_NETPORT_XFER_LAZY,
+	VMM_NETPORT_XFER_BURST
+};
+
+struct vmm_netport_burst {
+	struct dlist head;
+	struct vmm_mbuf *mbufs[VMM_NETPORT_MAX_BURST];
 };
 
 struct vmm_netport_xfer {
@@ -59,6 +77,8 @@ struct vmm_netport_xfer {
 	int lazy_budget;
 	void *lazy_arg;
 	void (*lazy_xfer)(struct vmm_netport *, void *, int);
+	u32 mbuf_count;
+	struct vmm_netport_burst *burst;
 };
 
 struct vmm_netport {
@@ -66,6 +86,7 @@ struct vmm_netport {
 	char name[VMM_FIELD_NAME_SIZE];
 	u32 queue_size;
 	int flags;
+	u32 features;
 	int mtu;
 	u8 macaddr[6];
 	struct vmm_netswitch *nsw;
@@ -80,6 +101,14 @@ struct vmm_netport {
 	vmm_spinlock_t free_list_lock;
 	struct vmm_netport_xfer xfer_pool[VMM_NETPORT_MAX_QUEUE_SIZE];
 
+	/* Per-port pool of mbuf arrays for burst xfer instances
+	 * Only few burst xfers are in-flight at a time so these
+	 * are kept separate instead of widening every xfer instance.
+	 * Protected by free_list_lock.
+	 */
+	struct dlist burst_free_list;
+	struct vmm_netport_burst burst_pool[VMM_NETPORT_BURST_POOL_SIZE];
+
 	/* Link status changed */
 	void (*link_changed) (struct vmm_netport *);
 	/* Callback to determine if the port can RX */
@@ -87,6 +116,9 @@ struct vmm_netport {
 	/* Handle RX from switch to port */
 	vmm_spinlock_t switch2port_xfer_lock;
 	int (*switch2port_xfer) (struct vmm_netport *, struct vmm_mbuf *);
+	/* Optional: Handle burst RX from switch to port */
+	int (*switch2port_xfer_burst) (struct vmm_netport *,
+				       struct vmm_mbuf **, u32);
 	/* Port private data */
 	void *priv;
 };
@@ -96,7 +128,11 @@ struct vmm_netport {
 /** Allocate new netport xfer instance */
 struct vmm_netport_xfer *vmm_netport_alloc_xfer(struct vmm_netport *port);
 
-/** Free netport xfer instance */
+/** Allocate new netport xfer instance with mbuf array for burst xfer */
+struct vmm_netport_xfer *vmm_netport_alloc_xfer_burst(
+					struct vmm_netport *port);
+
+/** Free netport xfer instance (and its burst mbuf array, if any) */
 void vmm_netport_free_xfer(struct vmm_netport *port,
 			   struct vmm_netport_xfer *xfer);
 
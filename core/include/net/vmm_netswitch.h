@@ -49,6 +49,10 @@ struct vmm_netswitch {
 	int (*port2switch_xfer) (struct vmm_netswitch *,
 				 struct vmm_netport *,
 				 struct vmm_mbuf *);
+	/* Optional: Handle burst of RX packets from port to switch */
+	int (*port2switch_xfer_burst) (struct vmm_netswitch *,
+				       struct vmm_netport *,
+				       struct vmm_mbuf **, u32);
 	/* Handle enabling of a port */
 	int (*port_add) (struct vmm_netswitch *,
 			 struct vmm_netport *);
@@ -63,16 +67,37 @@ struct vmm_netswitch {
 int vmm_port2switch_xfer_mbuf(struct vmm_netport *src,
 			      struct vmm_mbuf *mbuf);
 
+/** Transfer burst of packets from port to switch
+ *  NOTE: References of all mbufs are consumed
+ */
+int vmm_port2switch_xfer_burst(struct vmm_netport *src,
+			       struct vmm_mbuf **mbufs, u32 count);
+
 /** Lazy transfer from port to switch */
 int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
 			 void *lazy_arg, int lazy_budget);
 
+/** Lazy transfer from port to switch done by bottom-half of given
+ *  host CPU (current host CPU if given host CPU is not online)
+ */
+int vmm_port2switch_xfer_lazy_oncpu(struct vmm_netport *src, u32 cpu,
+			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
+			 void *lazy_arg, int lazy_budget);
+
 /** Transfer packets from switch to port */
 int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 			      struct vmm_netport *dst,
 			      struct vmm_mbuf *mbuf);
 
+/** Transfer burst of packets from switch to port
+ *  NOTE: Destination port lock is taken once per VMM_NETPORT_MAX_BURST
+ *  packets and references of mbufs are retained by caller
+ */
+int vmm_switch2port_xfer_burst(struct vmm_netswitch *nsw,
+			       struct vmm_netport *dst,
+			       struct vmm_mbuf **mbufs, u32 count);
+
 /** Allocate new network switch
  *  @name name of the network switch
  */
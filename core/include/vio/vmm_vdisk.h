@@ -62,6 +62,7 @@ enum vmm_vdisk_request_type {
 
 /** Representation of a virtual disk request  */
 struct vmm_vdisk_request {
+	struct dlist head;
 	struct vmm_vdisk *vdisk;
 	struct vmm_request r;
 };
@@ -81,6 +82,12 @@ struct vmm_vdisk {
 	struct vmm_blockdev *blk;
 	u32 blk_factor;
 
+	vmm_spinlock_t inflight_lock; /* Protect in-flight accounting */
+	u32 max_inflight;
+	u32 inflight;
+	bool submitting;
+	struct dlist deferred_list;
+
 	void *priv;
 };
 
@@ -171,7 +178,10 @@ static inline void *vmm_vdisk_priv(struct vmm_vdisk *vdisk)
 	return (vdisk) ? vdisk->priv: NULL;
 }
 
-/** Submit IO request to virtual disk */
+/** Submit IO request to virtual disk
+ *  NOTE: Requests beyond in-flight limit of virtual disk are deferred
+ *  and submitted to block device as earlier requests finish.
+ */
 int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 			     struct vmm_vdisk_request *vreq,
 			     enum vmm_vdisk_request_type type,
@@ -196,6 +206,12 @@ static inline u32 vmm_vdisk_block_size(struct vmm_vdisk *vdisk)
 	return (vdisk) ? vdisk->block_size : 0;
 }
 
+/** Maximum in-flight requests of virtual disk (zero means unlimited) */
+u32 vmm_vdisk_get_max_inflight(struct vmm_vdisk *vdisk);
+
+/** Update maximum in-flight requests of virtual disk */
+int vmm_vdisk_set_max_inflight(struct vmm_vdisk *vdisk, u32 max_inflight);
+
 /** Block count of virtual disk based on attached block device */
 u64 vmm_vdisk_capacity(struct vmm_vdisk *vdisk);
 
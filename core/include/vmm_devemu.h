@@ -75,12 +75,78 @@ struct vmm_emulator {
 		        u64 src);
 };
 
+/** Flags of emulated access */
+#define VMM_DEVEMU_TRACE_WRITE		0x1
+#define VMM_DEVEMU_TRACE_IO		0x2
+#define VMM_DEVEMU_TRACE_ERROR		0x4
+
+#ifdef CONFIG_DEVEMU_STATS
+
+#define VMM_DEVEMU_STATS_HIST_BUCKETS	16
+#define VMM_DEVEMU_STATS_HIST_SHIFT	7
+#define VMM_DEVEMU_STATS_OFFSETS_SHIFT	6
+#define VMM_DEVEMU_STATS_OFFSETS	(1 << VMM_DEVEMU_STATS_OFFSETS_SHIFT)
+
+/** Access statistics of emulated device for one direction
+ *  Bucket 0 of latency histogram counts accesses below
+ *  2^VMM_DEVEMU_STATS_HIST_SHIFT nsecs and every next bucket
+ *  doubles the upper bound. Last bucket has no upper bound.
+ */
+struct vmm_devemu_access_stats {
+	u64 count;
+	u64 errors;
+	u64 total_nsecs;
+	u64 max_nsecs;
+	u64 hist[VMM_DEVEMU_STATS_HIST_BUCKETS];
+};
+
+/** Access statistics of one register offset of emulated device */
+struct vmm_devemu_offset_stats {
+	physical_addr_t offset;
+	u64 reads;
+	u64 writes;
+	u64 total_nsecs;
+};
+
+/** Access statistics of emulated device
+ *  Offsets are kept in a small open addressed table so accesses to
+ *  offsets not fitting in the table are only counted as overflow.
+ */
+struct vmm_devemu_stats {
+	struct vmm_devemu_access_stats read;
+	struct vmm_devemu_access_stats write;
+	u32 offset_count;
+	u64 offset_overflow;
+	struct vmm_devemu_offset_stats offsets[VMM_DEVEMU_STATS_OFFSETS];
+};
+
+/** Entry of per-CPU emulated access trace
+ *  The value holds raw bytes of guest data hence it is only
+ *  meaningful for successful accesses.
+ */
+struct vmm_devemu_trace_entry {
+	u64 timestamp;
+	u64 gphys_addr;
+	u64 value;
+	u32 nsecs;
+	u32 vcpu_id;
+	u8 len;
+	u8 flags;
+};
+
+#endif
+
 struct vmm_emudev {
+	struct dlist head;
 	vmm_spinlock_t lock;
 	struct vmm_devtree_node *node;
 	struct vmm_region *reg;
 	struct vmm_emulator *emu;
 	void *priv;
+#ifdef CONFIG_DEVEMU_STATS
+	vmm_spinlock_t stats_lock;
+	struct vmm_devemu_stats stats;
+#endif
 };
 
 struct vmm_devemu_irqchip {
@@ -169,6 +235,53 @@ struct vmm_emulator *vmm_devemu_emulator(int index);
 /** Count available emulators */
 u32 vmm_devemu_emulator_count(void);
 
+/** Iterate over all probed emulated devices
+ *  Note: The iterator is called with devemu lock held so it must
+ *  not probe or remove emulated devices.
+ */
+int vmm_devemu_iterate_emudev(int (*iter)(struct vmm_emudev *, void *),
+			      void *priv);
+
+#ifdef CONFIG_DEVEMU_STATS
+
+/** Get snapshot of access statistics of emulated device */
+int vmm_devemu_stats_get(struct vmm_emudev *edev,
+			 struct vmm_devemu_stats *stats);
+
+/** Clear access statistics of emulated device */
+int vmm_devemu_stats_clear(struct vmm_emudev *edev);
+
+/** Check status of emulated access trace */
+bool vmm_devemu_trace_isactive(void);
+
+/**
+ * Start emulated access trace on all host CPUs.
+ * Entries recorded by previous run are discarded.
+ */
+int vmm_devemu_trace_start(void);
+
+/** Stop emulated access trace */
+int vmm_devemu_trace_stop(void);
+
+/** Get maximum number of trace entries per host CPU */
+u32 vmm_devemu_trace_max_entries(void);
+
+/** Get number of trace entries available on given host CPU */
+u32 vmm_devemu_trace_count(u32 cpu);
+
+/** Get number of trace entries overwritten on given host CPU */
+u64 vmm_devemu_trace_lost(u32 cpu);
+
+/**
+ * Get trace entry of given host CPU (index zero is oldest entry).
+ * Note: Trace entries are overwritten while trace is running so
+ * trace should be stopped for a consistent view.
+ */
+int vmm_devemu_trace_entry(u32 cpu, u32 index,
+			   struct vmm_devemu_trace_entry *entry);
+
+#endif
+
 /** Reset context for given guest */
 int vmm_devemu_reset_context(struct vmm_guest *guest);
 
@@ -52,6 +52,17 @@ struct vmm_region *vmm_guest_find_region(struct vmm_guest *guest,
 					 physical_addr_t gphys_addr,
 					 u32 reg_flags, bool resolve_alias);
 
+/** Find region corresponding to a guest physical address using
+ *  region cache of given VCPU. Must be called from the context of
+ *  given VCPU.
+ */
+struct vmm_region *vmm_vcpu_find_region(struct vmm_vcpu *vcpu,
+					physical_addr_t gphys_addr,
+					u32 reg_flags, bool resolve_alias);
+
+/** Flush region cache of given VCPU */
+void vmm_vcpu_region_cache_flush(struct vmm_vcpu *vcpu);
+
 /** Read from guest memory regions (i.e. RAM or ROM regions) */
 u32 vmm_guest_memory_read(struct vmm_guest *guest, 
 			  physical_addr_t gphys_addr, 
@@ -62,7 +73,49 @@ u32 vmm_guest_memory_write(struct vmm_guest *guest,
 			   physical_addr_t gphys_addr, 
 			   void *src, u32 len, bool cacheable);
 
-/** Map guest physical address to some host physical address */
+/** Guest physical scatter-gather element */
+struct vmm_guest_iovec {
+	physical_addr_t addr;
+	u32 len;
+};
+
+/** Guest memory copy context
+ *  Remembers last resolved guest region so that consecutive copies
+ *  to/from same guest region don't look-up region tree again.
+ */
+struct vmm_guest_memcopy {
+	struct vmm_guest *guest;
+	struct vmm_region *reg;
+	bool cacheable;
+};
+
+/** Initialize guest memory copy context */
+void vmm_guest_memcopy_init(struct vmm_guest_memcopy *mc,
+			    struct vmm_guest *guest, bool cacheable);
+
+/** Read from guest memory regions using copy context */
+u32 vmm_guest_memcopy_read(struct vmm_guest_memcopy *mc,
+			   physical_addr_t gphys_addr, void *dst, u32 len);
+
+/** Write to guest memory regions using copy context */
+u32 vmm_guest_memcopy_write(struct vmm_guest_memcopy *mc,
+			    physical_addr_t gphys_addr, void *src, u32 len);
+
+/** Read from guest scatter-gather list to a buffer */
+u32 vmm_guest_memory_readv(struct vmm_guest *guest,
+			   const struct vmm_guest_iovec *iov, u32 iov_cnt,
+			   void *dst, u32 len, bool cacheable);
+
+/** Write from a buffer to guest scatter-gather list */
+u32 vmm_guest_memory_writev(struct vmm_guest *guest,
+			    const struct vmm_guest_iovec *iov, u32 iov_cnt,
+			    void *src, u32 len, bool cacheable);
+
+/** Map guest physical address to some host physical address
+ *  (a demand allocated chunk stays pinned till vmm_guest_physical_unmap()
+ *  is called with same guest physical address, so every successful map
+ *  must be paired with an unmap once host stops using the mapping)
+ */
 int vmm_guest_physical_map(struct vmm_guest *guest,
 			   physical_addr_t gphys_addr,
 			   physical_size_t gphys_size,
@@ -70,11 +123,93 @@ int vmm_guest_physical_map(struct vmm_guest *guest,
 			   physical_size_t *hphys_size,
 			   u32 *reg_flags);
 
-/** Unmap guest physical address */
+/** Unmap guest physical address mapped by vmm_guest_physical_map()
+ *  (drops pin of demand allocated chunk and releases its host RAM if
+ *  guest discarded the chunk while it was pinned)
+ */
 int vmm_guest_physical_unmap(struct vmm_guest *guest,
 			     physical_addr_t gphys_addr,
 			     physical_size_t gphys_size);
 
+/** Mark guest pages as not used by guest and release host RAM of
+ *  demand allocated chunks having all pages discarded. When track is
+ *  FALSE the guest may reuse pages without undiscard so pages are not
+ *  remembered and only chunks fully covered by the range are released.
+ *  @returns number of bytes of host RAM released
+ */
+physical_size_t vmm_guest_physical_discard(struct vmm_guest *guest,
+					   physical_addr_t gphys_addr,
+					   physical_size_t gphys_size,
+					   bool track);
+
+/** Mark guest pages as used by guest again */
+void vmm_guest_physical_undiscard(struct vmm_guest *guest,
+				  physical_addr_t gphys_addr,
+				  physical_size_t gphys_size);
+
+/** Check whether guest physical address is backed by host RAM
+ *  (always TRUE for memory regions which are not demand allocated)
+ */
+bool vmm_guest_physical_populated(struct vmm_guest *guest,
+				  physical_addr_t gphys_addr);
+
+/** Memory statistics reported by guest memory balloon */
+enum vmm_guest_balloon_stat {
+	VMM_GUEST_BALLOON_STAT_SWAP_IN=0,
+	VMM_GUEST_BALLOON_STAT_SWAP_OUT,
+	VMM_GUEST_BALLOON_STAT_MAJFLT,
+	VMM_GUEST_BALLOON_STAT_MINFLT,
+	VMM_GUEST_BALLOON_STAT_MEMFREE,
+	VMM_GUEST_BALLOON_STAT_MEMTOT,
+	VMM_GUEST_BALLOON_STAT_AVAIL,
+	VMM_GUEST_BALLOON_STAT_CACHES,
+	VMM_GUEST_BALLOON_STAT_HTLB_PGALLOC,
+	VMM_GUEST_BALLOON_STAT_HTLB_PGFAIL,
+	VMM_GUEST_BALLOON_STAT_MAX
+};
+
+/** Memory balloon of a guest
+ *
+ * A guest memory balloon (usually an emulated device) asks guest to
+ * give back memory. The target and actual sizes are in bytes of guest
+ * memory given back and released is the host RAM freed because of it.
+ */
+struct vmm_guest_balloon {
+	struct vmm_guest *guest;
+	physical_size_t target;
+	physical_size_t actual;
+	physical_size_t released;
+	bool stats_valid;
+	u64 stats[VMM_GUEST_BALLOON_STAT_MAX];
+	int (*set_target)(struct vmm_guest_balloon *b,
+			  physical_size_t target);
+	void (*update_stats)(struct vmm_guest_balloon *b);
+	void *priv;
+};
+
+/** Register memory balloon of a guest (one balloon per guest) */
+int vmm_guest_balloon_register(struct vmm_guest_balloon *b);
+
+/** Unregister memory balloon of a guest */
+void vmm_guest_balloon_unregister(struct vmm_guest_balloon *b);
+
+/** Get snapshot of guest memory balloon state
+ *  (also asks the guest to refresh memory statistics)
+ */
+int vmm_guest_balloon_info(struct vmm_guest *guest,
+			   struct vmm_guest_balloon *info);
+
+/** Set guest memory balloon target size in bytes */
+int vmm_guest_balloon_set_target(struct vmm_guest *guest,
+				 physical_size_t target);
+
+/** Get host RAM committed to a guest and host RAM actually resident
+ *  (differs only for demand allocated RAM regions)
+ */
+int vmm_guest_ram_usage(struct vmm_guest *guest,
+			physical_size_t *committed,
+			physical_size_t *resident);
+
 /** Add a new region from a given node in DTS */
 int vmm_guest_add_region_from_node(struct vmm_guest *guest,
 				   struct vmm_devtree_node *node,
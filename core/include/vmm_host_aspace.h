@@ -133,6 +133,17 @@ virtual_addr_t vmm_host_alloc_pages(u32 page_count, u32 mem_flags);
 /** Free pages back to host memory */
 int vmm_host_free_pages(virtual_addr_t page_va, u32 page_count);
 
+/** Map physical pages at given page aligned virtual address
+ *  NOTE: Virtual address must be allocated by caller from VAPOOL
+ *  NOTE: Such mappings are not tracked hence vmm_host_pa2va()
+ *  won't work for them.
+ */
+int vmm_host_map_pages(virtual_addr_t va, physical_addr_t pa,
+		       u32 page_count, u32 mem_flags);
+
+/** Unmap pages mapped using vmm_host_map_pages() */
+int vmm_host_unmap_pages(virtual_addr_t va, u32 page_count);
+
 /** Convert virtual address to its physical address */
 int vmm_host_va2pa(virtual_addr_t va, physical_addr_t *pa);
 
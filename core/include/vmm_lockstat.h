@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_lockstat.h
+ * @author Xvisor Developers
+ * @brief header file of spinlock contention statistics.
+ */
+
+#ifndef _VMM_LOCKSTAT_H__
+#define _VMM_LOCKSTAT_H__
+
+#include <vmm_types.h>
+
+/** Type of lock operation which was contended */
+enum vmm_lockstat_type {
+	VMM_LOCKSTAT_SPIN=0,
+	VMM_LOCKSTAT_READ=1,
+	VMM_LOCKSTAT_WRITE=2,
+};
+
+/** Contention statistics of one lock class
+ *  Spinlocks carry no class information so a lock class is the
+ *  hypervisor address from where the lock was taken. It can be
+ *  symbolized using kallsyms.
+ */
+struct vmm_lockstat_info {
+	virtual_addr_t site;
+	u32 type;
+	u64 contended;
+	u64 wait_nsecs;
+	u64 wait_max_nsecs;
+};
+
+/** Take spinlock and account contention (used by vmm_spinlocks.h) */
+void vmm_lockstat_spin_lock(arch_spinlock_t *lock);
+
+/** Take read lock and account contention (used by vmm_spinlocks.h) */
+void vmm_lockstat_read_lock(arch_rwlock_t *lock);
+
+/** Take write lock and account contention (used by vmm_spinlocks.h) */
+void vmm_lockstat_write_lock(arch_rwlock_t *lock);
+
+/** Check whether contention is being recorded */
+bool vmm_lockstat_isactive(void);
+
+/** Start or stop recording contention */
+void vmm_lockstat_set_active(bool active);
+
+/** Maximum number of lock classes */
+u32 vmm_lockstat_max_count(void);
+
+/** Number of contentions dropped because lock class table was full */
+u64 vmm_lockstat_dropped(void);
+
+/** Get statistics of a lock class
+ *  @index lock class index less than vmm_lockstat_max_count()
+ *  @info pointer to statistics filled by this function
+ *  Returns VMM_ENOTAVAIL if no lock class uses given index.
+ */
+int vmm_lockstat_get(u32 index, struct vmm_lockstat_info *info);
+
+/** Clear statistics of all lock classes */
+void vmm_lockstat_clear(void);
+
+#endif /* _VMM_LOCKSTAT_H__ */
@@ -50,6 +50,7 @@ enum vmm_region_flags {
 	VMM_REGION_ISRESERVED=0x00001000,
 	VMM_REGION_ISALLOCED=0x00002000,
 	VMM_REGION_ISDYNAMIC=0x00004000,
+	VMM_REGION_ISDEMAND=0x00008000,
 };
 
 #define VMM_REGION_MANIFEST_MASK	(VMM_REGION_REAL | \
@@ -72,6 +73,13 @@ struct vmm_region {
 	physical_size_t phys_size;
 	u32 align_order;
 	u32 flags;
+	u32 demand_order;
+	u32 demand_resident;
+	physical_addr_t *demand_map;
+	u32 *demand_pins;
+	unsigned long *demand_deferred;
+	unsigned long *demand_discard;
+	vmm_spinlock_t demand_lock;
 	void *devemu_priv;
 	void *priv;
 };
@@ -85,6 +93,8 @@ struct vmm_region {
 #define VMM_REGION_HPHYS_TO_GPHYS(reg, hphys)	\
 			((reg)->gphys_addr + ((hphys) - (reg)->hphys_addr))
 
+struct vmm_guest_balloon;
+
 struct vmm_guest_aspace {
 	struct vmm_devtree_node *node;
 	struct vmm_guest *guest;
@@ -95,7 +105,9 @@ struct vmm_guest_aspace {
 	vmm_rwlock_t reg_memtree_lock;
 	struct rb_root reg_memtree;
 	struct dlist reg_memprobe_list;
+	atomic_t reg_gen;
 	void *devemu_priv;
+	struct vmm_guest_balloon *balloon;
 };
 
 struct vmm_guest_request {
@@ -176,6 +188,31 @@ enum vmm_vcpu_states {
 #define VMM_VCPU_DEF_DEADLINE		(VMM_VCPU_DEF_TIME_SLICE * 10)
 #define VMM_VCPU_DEF_PERIODICITY	(VMM_VCPU_DEF_DEADLINE * 10)
 
+struct vmm_vcpu_region_cache_entry {
+	physical_addr_t gphys_start;
+	physical_addr_t gphys_end;
+	u32 reg_flags;
+	bool resolve_alias;
+	struct vmm_region *reg;
+};
+
+struct vmm_vcpu_region_cache {
+	u32 gen;
+	u32 victim;
+	struct vmm_vcpu_region_cache_entry ent[CONFIG_VGPA2REG_CACHE_SIZE];
+};
+
+/** Scheduling statistics of VCPU (protected by sched_lock) */
+struct vmm_vcpu_sched_stats {
+	u64 dispatch_count;
+	u64 preempted_count;
+	u64 migrate_count;
+	u64 wait_nsecs;
+	u64 wait_max_nsecs;
+	u64 slice_nsecs;
+	u64 slice_used_nsecs;
+};
+
 struct vmm_vcpu {
 	struct dlist head;
 
@@ -208,6 +245,7 @@ struct vmm_vcpu {
 	u32 preempt_count;
 	bool resumed;
 	void *sched_priv;
+	struct vmm_vcpu_sched_stats sched_stats;
 
 	/* Scheduler static context */
 	u8 priority;
@@ -222,6 +260,9 @@ struct vmm_vcpu {
 	/* Virtual IRQ context */
 	struct vmm_vcpu_irqs irqs;
 
+	/* Guest physical address to region cache */
+	struct vmm_vcpu_region_cache reg_cache;
+
 	/* Waitqueue parameters */
 	struct dlist wq_head;
 	void *wq_priv;
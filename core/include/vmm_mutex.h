@@ -71,4 +71,14 @@ int vmm_mutex_lock(struct vmm_mutex *mut);
 /** Lock mutex with timeout */
 int vmm_mutex_lock_timeout(struct vmm_mutex *mut, u64 *timeout);
 
+/** Get maximum time in nanosecs spent spinning on a mutex
+ *  owned by a running VCPU before going to sleep
+ */
+u64 vmm_mutex_get_spin_nsecs(void);
+
+/** Set maximum time in nanosecs spent spinning on a mutex
+ *  owned by a running VCPU before going to sleep (0 disables)
+ */
+void vmm_mutex_set_spin_nsecs(u64 nsecs);
+
 #endif /* __VMM_MUTEX_H__ */
@@ -26,44 +26,78 @@
 
 #include <vmm_types.h>
 
-#define VMM_PROFILE_ARRAY_SIZE		15
-#define VMM_PROFILE_OTHER_INDEX		(VMM_PROFILE_ARRAY_SIZE - 1)
-#define VMM_PROFILE_OTHER_PARENT	0xffffffff
-
-struct vmm_profiler_counter {
-        u32 index;
-        u32 parent_index;
-        atomic_t count;
-        atomic64_t total_time;
-        atomic64_t time_per_call;
+#define VMM_PROFILER_DEFAULT_PERIOD_NSECS	1000000ULL
+#define VMM_PROFILER_MIN_PERIOD_NSECS		10000ULL
+#ifdef CONFIG_PROFILE_STACK_DEPTH
+#define VMM_PROFILER_MAX_DEPTH			CONFIG_PROFILE_STACK_DEPTH
+#else
+#define VMM_PROFILER_MAX_DEPTH			1
+#endif
+#define VMM_PROFILER_NO_VCPU			0xffffffff
+
+/** Context interrupted by a profiler sample */
+enum vmm_profiler_sample_type {
+	VMM_PROFILER_SAMPLE_HOST=0,
+	VMM_PROFILER_SAMPLE_GUEST=1,
 };
 
-struct vmm_profiler_stat {
-        struct vmm_profiler_counter counter[VMM_PROFILE_ARRAY_SIZE];
+/** Profiler sample recorded by timer interrupt
+ *  For host samples the pc and stack entries are hypervisor addresses
+ *  which can be symbolized using kallsyms. For guest samples the pc is
+ *  the guest address of the interrupted Normal VCPU and no stack is
+ *  recorded.
+ */
+struct vmm_profiler_sample {
+	u32 type;
+	u32 vcpu_id;
+	u32 depth;
+	virtual_addr_t pc;
+	virtual_addr_t stack[VMM_PROFILER_MAX_DEPTH];
 };
 
 /**
- * Check status of function level profiling.
+ * Check status of sampling profiler.
  * Called from somewhere (usually cmd_profile).
  */
 bool vmm_profiler_isactive(void);
 
 /**
- * Start function level profiling.
+ * Start sampling profiler on all online host CPUs.
+ * Samples recorded by previous run are discarded.
+ * @period_nsecs sampling period (zero for default period)
+ * @stack_depth number of stack entries to unwind (zero to disable)
  * Called from some where (usually cmd_profile).
  */
-int vmm_profiler_start(void); 
+int vmm_profiler_start(u64 period_nsecs, u32 stack_depth);
 
 /**
- * Stop function level profiling. 
+ * Stop sampling profiler.
  * Called from some where (usually cmd_profile).
  */
-int vmm_profiler_stop(void); 
+int vmm_profiler_stop(void);
+
+/** Get sampling period of current (or last) run */
+u64 vmm_profiler_period(void);
+
+/** Get stack unwind depth of current (or last) run */
+u32 vmm_profiler_stack_depth(void);
+
+/** Get maximum number of samples per host CPU */
+u32 vmm_profiler_max_samples(void);
+
+/** Get number of samples recorded by given host CPU */
+u32 vmm_profiler_sample_count(u32 cpu);
+
+/** Get number of samples dropped by given host CPU */
+u32 vmm_profiler_dropped_count(u32 cpu);
 
 /**
- * Get the base of the stat data array
+ * Get sample recorded by given host CPU.
+ * Note: Samples below vmm_profiler_sample_count() are never
+ * overwritten while profiler is running so they can be read
+ * without any locking.
  */
-struct vmm_profiler_stat *vmm_profiler_get_stat_array(void);
+struct vmm_profiler_sample *vmm_profiler_sample(u32 cpu, u32 index);
 
 /**
  * Initialize Profiler. 
@@ -26,6 +26,24 @@
 #include <vmm_types.h>
 #include <vmm_manager.h>
 
+#define VMM_SCHEDULER_HIST_BUCKETS	20
+#define VMM_SCHEDULER_HIST_SHIFT	10
+
+/** Scheduling statistics of host CPU
+ *  The wait histogram counts latency from VCPU becoming ready to
+ *  VCPU running and the slice histogram counts time spent running
+ *  per dispatch. Bucket 0 of a histogram counts values below
+ *  2^VMM_SCHEDULER_HIST_SHIFT nsecs and every next bucket doubles
+ *  the upper bound. Last bucket has no upper bound.
+ */
+struct vmm_scheduler_stats {
+	u64 switch_count;
+	u64 preempt_count;
+	u64 migrate_count;
+	u64 wait_hist[VMM_SCHEDULER_HIST_BUCKETS];
+	u64 slice_hist[VMM_SCHEDULER_HIST_BUCKETS];
+};
+
 /** Disable pre-emption of current VCPU */
 void vmm_scheduler_preempt_disable(void);
 
@@ -63,6 +81,9 @@ void vmm_scheduler_irq_exit(arch_regs_t *regs);
 /** Check whether we are in IRQ context */
 bool vmm_scheduler_irq_context(void);
 
+/** Retrive registers saved by current IRQ (NULL outside IRQ) */
+arch_regs_t *vmm_scheduler_irq_regs(void);
+
 /** Check whether we are in Orphan VCPU context */
 bool vmm_scheduler_orphan_context(void);
 
@@ -84,6 +105,19 @@ u64 vmm_scheduler_irq_time(u32 hcpu);
 /** Last sampled idle time in nanosecs for given host CPU */
 u64 vmm_scheduler_idle_time(u32 hcpu);
 
+/** Retrive scheduling statistics of given VCPU */
+int vmm_scheduler_vcpu_stats(struct vmm_vcpu *vcpu,
+			     struct vmm_vcpu_sched_stats *stats);
+
+/** Retrive scheduling statistics of given host CPU
+ *  Note: The statistics are updated without any locking by the
+ *  owning host CPU so the snapshot is not atomic.
+ */
+int vmm_scheduler_stats(u32 hcpu, struct vmm_scheduler_stats *stats);
+
+/** Clear scheduling statistics of given host CPU */
+int vmm_scheduler_stats_clear(u32 hcpu);
+
 /** Retrive idle vcpu for given host CPU */
 struct vmm_vcpu *vmm_scheduler_idle_vcpu(u32 hcpu);
 
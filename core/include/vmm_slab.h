@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_slab.h
+ * @author Xvisor Developers
+ * @brief header file for object cache (slab) interface
+ */
+#ifndef _VMM_SLAB_H__
+#define _VMM_SLAB_H__
+
+#include <vmm_types.h>
+#include <vmm_limits.h>
+#include <vmm_cache.h>
+#include <vmm_spinlocks.h>
+#include <libs/list.h>
+
+struct vmm_chardev;
+
+/** Minimum number of objects carved out of one slab */
+#define VMM_SLAB_MIN_OBJS		8
+
+/** Maximum number of free objects cached per host CPU */
+#define VMM_SLAB_CPU_CACHE_SIZE		32
+
+/** Number of objects moved between per-CPU cache and depot */
+#define VMM_SLAB_CPU_BATCH		(VMM_SLAB_CPU_CACHE_SIZE / 2)
+
+/** Per-CPU free list of an object cache
+ *  Each slot has its own cache line so that host CPUs updating their
+ *  own free list don't bounce cache lines of other host CPUs.
+ */
+struct vmm_slab_cpu {
+	void *free;
+	u32 count;
+	u64 alloc_hit;
+	u64 alloc_miss;
+	u64 free_hit;
+	u64 flush;
+} __cacheline_aligned;
+
+/** Object cache
+ *
+ * Objects are carved out of slabs (contiguous pages obtained using
+ * vmm_host_alloc_pages). Free objects are linked using a pointer at
+ * free_off which is placed after the object itself when a constructor
+ * is provided so that constructed state survives free and re-alloc.
+ *
+ * Each host CPU has its own free list which is accessed with interrupts
+ * disabled. Free objects overflowing a per-CPU free list are moved in
+ * batches to the depot free list protected by depot_lock.
+ *
+ * Slab pages are only returned to host when the cache is destroyed
+ * hence objects of a cache never fragment the buddy heap.
+ */
+struct vmm_slab_cache {
+	struct dlist head;
+	char name[VMM_FIELD_NAME_SIZE];
+	u32 obj_size;
+	u32 obj_align;
+	u32 obj_stride;
+	u32 free_off;
+	u32 slab_pages;
+	u32 slab_objs;
+	void (*ctor)(void *obj);
+	vmm_spinlock_t depot_lock;
+	void *depot_free;
+	u32 depot_count;
+	struct dlist slab_list;
+	u32 slab_count;
+	struct vmm_slab_cpu cpu[CONFIG_CPU_COUNT];
+};
+
+/** Create a new object cache
+ *  @name name of the cache
+ *  @obj_size size of each object
+ *  @obj_align alignment of each object (zero for pointer alignment)
+ *  @ctor optional constructor called once for each new object
+ *  @returns pointer to new cache or NULL on failure
+ */
+struct vmm_slab_cache *vmm_slab_cache_create(const char *name,
+					     u32 obj_size, u32 obj_align,
+					     void (*ctor)(void *obj));
+
+/** Destroy an object cache and free all slab pages
+ *  NOTE: All objects must be freed before destroying the cache
+ */
+void vmm_slab_cache_destroy(struct vmm_slab_cache *cache);
+
+/** Allocate an object from object cache */
+void *vmm_slab_alloc(struct vmm_slab_cache *cache);
+
+/** Allocate an object from object cache and zero set
+ *  NOTE: Not allowed for caches having a constructor (returns NULL)
+ */
+void *vmm_slab_zalloc(struct vmm_slab_cache *cache);
+
+/** Free an object back to object cache */
+void vmm_slab_free(struct vmm_slab_cache *cache, void *obj);
+
+/** Total number of objects in object cache */
+u32 vmm_slab_cache_total_objs(struct vmm_slab_cache *cache);
+
+/** Number of free objects in object cache */
+u32 vmm_slab_cache_free_objs(struct vmm_slab_cache *cache);
+
+/** Print usage of all object caches */
+int vmm_slab_print_state(struct vmm_chardev *cdev);
+
+#endif /* _VMM_SLAB_H__ */
@@ -29,6 +29,17 @@
 #include <arch_locks.h>
 #include <vmm_types.h>
 
+#if defined(CONFIG_LOCKSTAT)
+#include <vmm_lockstat.h>
+#define __vmm_spin_lock(tlock)		vmm_lockstat_spin_lock(tlock)
+#define __vmm_write_lock(tlock)		vmm_lockstat_write_lock(tlock)
+#define __vmm_read_lock(tlock)		vmm_lockstat_read_lock(tlock)
+#else
+#define __vmm_spin_lock(tlock)		arch_spin_lock(tlock)
+#define __vmm_write_lock(tlock)		arch_write_lock(tlock)
+#define __vmm_read_lock(tlock)		arch_read_lock(tlock)
+#endif
+
 #if defined(CONFIG_SMP)
 
 /* 
@@ -104,15 +115,15 @@ extern void vmm_scheduler_preempt_enable(void);
 #if defined(CONFIG_SMP)
 #define vmm_spin_lock(lock)		do { \
 					vmm_scheduler_preempt_disable(); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_write_lock(lock)		do { \
 					vmm_scheduler_preempt_disable(); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_read_lock(lock)		do { \
 					vmm_scheduler_preempt_disable(); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_lock(&(lock)->__tlock); \
 					} while (0)
 #else
 #define vmm_spin_lock(lock)		do { \
@@ -202,17 +213,17 @@ extern void vmm_scheduler_preempt_enable(void);
 #define vmm_spin_lock_irq(lock) 	do { \
 					arch_cpu_irq_disable(); \
 					vmm_scheduler_preempt_disable(); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_write_lock_irq(lock) 	do { \
 					arch_cpu_irq_disable(); \
 					vmm_scheduler_preempt_disable(); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_read_lock_irq(lock) 	do { \
 					arch_cpu_irq_disable(); \
 					vmm_scheduler_preempt_disable(); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_lock(&(lock)->__tlock); \
 					} while (0)
 #else
 #define vmm_spin_lock_irq(lock) 	do { \
@@ -323,19 +334,19 @@ extern void vmm_scheduler_preempt_enable(void);
 					do { \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_write_lock_irqsave(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_read_lock_irqsave(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_lock(&(lock)->__tlock); \
 					} while (0)
 #else
 #define vmm_spin_lock_irqsave(lock, flags) \
@@ -389,17 +400,17 @@ extern void vmm_scheduler_preempt_enable(void);
 #define vmm_spin_lock_irqsave_lite(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_write_lock_irqsave_lite(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_lock(&(lock)->__tlock); \
 					} while (0)
 #define vmm_read_lock_irqsave_lite(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_lock(&(lock)->__tlock); \
 					} while (0)
 #else
 #define vmm_spin_lock_irqsave_lite(lock, flags) \
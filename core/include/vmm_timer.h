@@ -26,6 +26,7 @@
 #include <vmm_types.h>
 #include <vmm_spinlocks.h>
 #include <libs/list.h>
+#include <libs/rbtree.h>
 
 struct vmm_timer_event;
 
@@ -38,7 +39,7 @@ struct vmm_timer_event {
 	/* Internal house-keeping info */
 	vmm_spinlock_t active_lock;
 	bool active_state;
-	struct dlist active_head;
+	struct rb_node active_node;
 	u32 active_hcpu;
 };
 
@@ -49,7 +50,7 @@ struct vmm_timer_event {
 					(ev)->handler = _hndl; \
 					(ev)->priv = _priv; \
 					INIT_SPIN_LOCK(&(ev)->active_lock); \
-					INIT_LIST_HEAD(&(ev)->active_head); \
+					RB_CLEAR_NODE(&(ev)->active_node); \
 					(ev)->active_state = FALSE; \
 					(ev)->active_hcpu = 0; \
 				} while (0)
@@ -61,7 +62,7 @@ struct vmm_timer_event {
 		.handler = _hndl,					\
 		.priv = _priv,						\
 		.active_lock = __SPINLOCK_INITIALIZER((ev).active_lock),\
-		.active_head = { &(ev).head, &(ev).head },		\
+		.active_node = { 0, NULL, NULL },			\
 		.active_state = FALSE,					\
 		.active_hcpu = 0,					\
 	}
@@ -84,14 +85,17 @@ int vmm_timer_event_restart(struct vmm_timer_event *ev);
 /** Stop a timer event */
 int vmm_timer_event_stop(struct vmm_timer_event *ev);
 
+/** Number of active timer events on given host CPU */
+u32 vmm_timer_event_count(u32 hcpu);
+
+/** Absolute timestamp of next timer event on given host CPU
+ *  (zero when host CPU has no active timer events)
+ */
+u64 vmm_timer_next_event(u32 hcpu);
+
 /** Current global timestamp (nanoseconds elapsed) */
 u64 vmm_timer_timestamp(void);
 
-#if defined(CONFIG_PROFILE)
-/** Special version for profile */
-u64 vmm_timer_timestamp_for_profile(void);
-#endif
-
 /** Check if timer subsystem is running on current host CPU */
 bool vmm_timer_started(void);
 
@@ -26,6 +26,7 @@
 #include <vmm_stdio.h>
 #include <vmm_timer.h>
 #include <vmm_devdrv.h>
+#include <arch_barrier.h>
 #include <net/vmm_protocol.h>
 #include <net/vmm_mbuf.h>
 #include <net/vmm_netswitch.h>
@@ -41,39 +42,174 @@
 #define DPRINTF(fmt, ...) do {} while(0)
 #endif
 
-#define BRIDGE_MAC_TABLE_SZ	32
+#define BRIDGE_MAC_HASH_BITS	8
+#define BRIDGE_MAC_HASH_SZ	(1 << BRIDGE_MAC_HASH_BITS)
+#define BRIDGE_MAC_HASH_WAYS	4
+#define BRIDGE_MAC_TABLE_SZ	(BRIDGE_MAC_HASH_SZ * BRIDGE_MAC_HASH_WAYS)
 #define BRIDGE_MAC_EXPIRY	30000000000LLU
 
+/* Aging is done in steps where each step covers a slice of buckets */
+#define BRIDGE_MAC_AGE_STEPS	8
+#define BRIDGE_MAC_AGE_PERIOD	(BRIDGE_MAC_EXPIRY / BRIDGE_MAC_AGE_STEPS)
+
 /* We maintain a table of learned mac addresses 
  * (please note that the mac of the immediate netports are not 
- * kept in this table) */
+ * kept in this table)
+ *
+ * The table is a set-associative hash where mac address selects a
+ * bucket of BRIDGE_MAC_HASH_WAYS entries. Readers don't take any lock
+ * instead they use the per-entry sequence counter to detect a writer
+ * updating the entry in-between. Writers are serialized using
+ * mac_table_lock.
+ */
 struct bridge_mac_entry {
+	u32 seq;
+	u32 age;
 	struct vmm_netport *port;
 	u8 macaddr[6];
-	u64 timestamp;
 };
 
 struct bridge_ctrl {
 	struct vmm_netswitch *nsw;
 	struct vmm_timer_event ev;
-	vmm_rwlock_t mac_table_lock;
-	u32 mac_table_sz;
+	vmm_spinlock_t mac_table_lock;
+	u32 mac_table_age;
+	u32 mac_table_age_pos;
 	struct bridge_mac_entry *mac_table;
 };
 
+static inline struct bridge_mac_entry *bridge_mactable_bucket(
+						struct bridge_ctrl *br,
+						const u8 *mac)
+{
+	u32 hash;
+
+	hash = ((u32)mac[2] << 24) | ((u32)mac[3] << 16) |
+	       ((u32)mac[4] << 8) | (u32)mac[5];
+	hash ^= ((u32)mac[0] << 8) | (u32)mac[1];
+	hash *= 0x9E3779B1;
+	hash >>= (32 - BRIDGE_MAC_HASH_BITS);
+
+	return &br->mac_table[hash * BRIDGE_MAC_HASH_WAYS];
+}
+
+static inline u32 bridge_mac_read_begin(struct bridge_mac_entry *m)
+{
+	u32 seq;
+
+	while ((seq = *(volatile u32 *)&m->seq) & 0x1) ;
+	arch_smp_rmb();
+
+	return seq;
+}
+
+static inline bool bridge_mac_read_retry(struct bridge_mac_entry *m,
+					 u32 seq)
+{
+	arch_smp_rmb();
+
+	return (*(volatile u32 *)&m->seq != seq) ? TRUE : FALSE;
+}
+
+/* NOTE: This function must be called with mac_table_lock held */
+static void bridge_mac_write(struct bridge_mac_entry *m,
+			     const u8 *mac, struct vmm_netport *port,
+			     u32 age)
+{
+	m->seq++;
+	arch_smp_wmb();
+
+	m->port = port;
+	if (mac) {
+		memcpy(m->macaddr, mac, 6);
+	} else {
+		memset(m->macaddr, 0, 6);
+	}
+	m->age = age;
+
+	arch_smp_wmb();
+	m->seq++;
+}
+
+/* Lock-free lookup of port and entry for given mac address */
+static struct vmm_netport *bridge_mactable_find(struct bridge_ctrl *br,
+						const u8 *mac,
+						struct bridge_mac_entry **ent)
+{
+	u32 i, seq;
+	bool match;
+	struct vmm_netport *port;
+	struct bridge_mac_entry *m = bridge_mactable_bucket(br, mac);
+
+	for (i = 0; i < BRIDGE_MAC_HASH_WAYS; i++, m++) {
+		do {
+			seq = bridge_mac_read_begin(m);
+			port = m->port;
+			match = (port &&
+				 !compare_ether_addr(m->macaddr, mac)) ?
+				 TRUE : FALSE;
+		} while (bridge_mac_read_retry(m, seq));
+
+		if (match) {
+			if (ent) {
+				*ent = m;
+			}
+			return port;
+		}
+	}
+
+	return NULL;
+}
+
+static void bridge_mactable_learn(struct bridge_ctrl *br,
+				  const u8 *mac, struct vmm_netport *port)
+{
+	u32 i;
+	irq_flags_t f;
+	struct bridge_mac_entry *m, *victim = NULL;
+
+	m = bridge_mactable_bucket(br, mac);
+
+	vmm_spin_lock_irqsave_lite(&br->mac_table_lock, f);
+
+	/* Update existing entry or take free entry or
+	 * replace least recently seen entry of bucket
+	 */
+	for (i = 0; i < BRIDGE_MAC_HASH_WAYS; i++, m++) {
+		if (m->port && !compare_ether_addr(m->macaddr, mac)) {
+			victim = m;
+			break;
+		}
+		if (!m->port) {
+			if (!victim || victim->port) {
+				victim = m;
+			}
+		} else if (!victim ||
+			   (victim->port &&
+			    ((br->mac_table_age - victim->age) <
+			     (br->mac_table_age - m->age)))) {
+			victim = m;
+		}
+	}
+
+	bridge_mac_write(victim, mac, port, br->mac_table_age);
+
+	vmm_spin_unlock_irqrestore_lite(&br->mac_table_lock, f);
+}
+
 static void bridge_mactable_cleanup_port(struct bridge_ctrl *br,
 					 struct vmm_netport *port)
 {
 	u32 m;
 	irq_flags_t f;
 
-	vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-	for (m = 0; m < br->mac_table_sz; m++) {
+	vmm_spin_lock_irqsave_lite(&br->mac_table_lock, f);
+	for (m = 0; m < BRIDGE_MAC_TABLE_SZ; m++) {
 		if (br->mac_table[m].port == port) {
-			br->mac_table[m].port = NULL;
+			bridge_mac_write(&br->mac_table[m], NULL, NULL, 0);
 		}
 	}
-	vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	vmm_spin_unlock_irqrestore_lite(&br->mac_table_lock, f);
 }
 
 static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
@@ -81,93 +217,23 @@ static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
 						      const u8 *srcmac,
 						      struct vmm_netport *src)
 {
-	u32 i;
-	u64 tstamp;
-	irq_flags_t f;
-	bool learn, update, found;
-	struct vmm_netport *dst;
-	struct bridge_mac_entry *m;
+	struct vmm_netport *dst, *port;
+	struct bridge_mac_entry *m = NULL;
 
-	/* Acquire read lock */
-	vmm_read_lock_irqsave_lite(&br->mac_table_lock, f);
+	/* Find port matching dstmac */
+	dst = bridge_mactable_find(br, dstmac, NULL);
 
-	/* Check for for dstmac and whether we need
-	 * to Learn (srcmac, src) mapping ??
+	/* Check whether we need to Learn (srcmac, src) mapping ??
+	 * If already known then only mark it as recently seen. A racy
+	 * update of age is harmless because it only delays aging.
 	 */
-	learn = TRUE;
-	dst = NULL;
-	for (i = 0; i < br->mac_table_sz; i++) {
-		m = &br->mac_table[i];
-		/* If mac table entry is unused then continue */
-		if (!m->port) {
-			continue;
-		}
-		/* Match (srcmac, srcport) */
-		if (learn &&
-		    !compare_ether_addr(m->macaddr, srcmac) &&
-		    (m->port == src)) {
-			learn = FALSE;
-		}
-		/* Match (dstmac) */
-		if (!dst &&
-		    !compare_ether_addr(m->macaddr, dstmac)) {
-			dst = m->port;
+	port = bridge_mactable_find(br, srcmac, &m);
+	if (port == src) {
+		if (m->age != br->mac_table_age) {
+			m->age = br->mac_table_age;
 		}
-		/* If no need to learn and found
-		 * destination port then break
-		 */
-		if (!learn && dst) {
-			break;
-		}
-	}
-
-	/* Release read lock */
-	vmm_read_unlock_irqrestore_lite(&br->mac_table_lock, f);
-
-	/* If leaning required then update mac table */
-	if (learn) {
-		/* Retrive current timestamp */
-		tstamp = vmm_timer_timestamp();
-
-		/* Acquire write lock */
-		vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-
-		/* If mac entry already exist then
-		 * update only port and timestamp
-		 */
-		update = TRUE;
-		for (i = 0; i < br->mac_table_sz; i++) {
-			m = &br->mac_table[i];
-			if (!compare_ether_addr(m->macaddr, srcmac)) {
-				m->port = src;
-				m->timestamp = tstamp;
-				update = FALSE;
-				break;
-			}
-		}
-
-		/* If mac entry does not exist then
-		 * save (mac, port, timestamp) in a
-		 * free mac table entry.
-		 */
-		if (update) {
-			found = FALSE;
-			for (i = 0; i < br->mac_table_sz; i++) {
-				m = &br->mac_table[i];
-				if (m->port == NULL) {
-					found = TRUE;
-					break;
-				}
-			}
-			if (found) {
-				m->port = src;
-				memcpy(m->macaddr, srcmac, 6);
-				m->timestamp = tstamp;
-			}
-		}
-
-		/* Release write lock */
-		vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	} else {
+		bridge_mactable_learn(br, srcmac, src);
 	}
 
 	return dst;
@@ -175,55 +241,52 @@ static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
 
 static void bridge_timer_event(struct vmm_timer_event *ev)
 {
-	u32 i;
-	u64 tstamp;
+	u32 i, b, end;
 	irq_flags_t f;
 	struct bridge_ctrl *br = ev->priv;
 	struct bridge_mac_entry *m;
 
-	DPRINTF("%s: bridge expiry event nsw=%s\n",
+	DPRINTF("%s: bridge aging event nsw=%s\n",
 		__func__, br->nsw->name);
 
-	/* Retrive current timestamp */
-	tstamp = vmm_timer_timestamp();
-
 	/* Acquire write lock */
-	vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-
-	/* Purge old enteries */
-	for (i = 0; i < br->mac_table_sz; i++) {
-		m = &br->mac_table[i];
-		if (m->port &&
-		    ((m->timestamp - tstamp) > BRIDGE_MAC_EXPIRY)) {
-			DPRINTF("%s: purge port=%s\n",
-				__func__, m->port->name);
-			m->port = NULL;
-			memset(m->macaddr, 0, 6);
-			m->timestamp = 0;
+	vmm_spin_lock_irqsave_lite(&br->mac_table_lock, f);
+
+	br->mac_table_age++;
+
+	/* Purge old enteries from next slice of buckets */
+	b = br->mac_table_age_pos;
+	end = b + (BRIDGE_MAC_HASH_SZ / BRIDGE_MAC_AGE_STEPS);
+	for ( ; b < end; b++) {
+		m = &br->mac_table[b * BRIDGE_MAC_HASH_WAYS];
+		for (i = 0; i < BRIDGE_MAC_HASH_WAYS; i++, m++) {
+			if (m->port &&
+			    ((br->mac_table_age - m->age) >
+						BRIDGE_MAC_AGE_STEPS)) {
+				DPRINTF("%s: purge port=%s\n",
+					__func__, m->port->name);
+				bridge_mac_write(m, NULL, NULL, 0);
+			}
 		}
 	}
+	br->mac_table_age_pos = (end < BRIDGE_MAC_HASH_SZ) ? end : 0;
 
 	/* Release write lock */
-	vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	vmm_spin_unlock_irqrestore_lite(&br->mac_table_lock, f);
 
 	/* Again start the bridge timer event */
-	vmm_timer_event_start(&br->ev, BRIDGE_MAC_EXPIRY);
+	vmm_timer_event_start(&br->ev, BRIDGE_MAC_AGE_PERIOD);
 }
 
-/**
- *  Thread body responsible for sending the RX buffer packets
- *  to the destination port(s)
+/* Find destination port of a frame. Returns NULL if the frame
+ * has to be broadcasted.
  */
-static int bridge_rx_handler(struct vmm_netswitch *nsw,
-			     struct vmm_netport *src,
-			     struct vmm_mbuf *mbuf)
+static struct vmm_netport *bridge_rx_lookup(struct bridge_ctrl *br,
+					    struct vmm_netport *src,
+					    struct vmm_mbuf *mbuf)
 {
-	irq_flags_t f;
 	const u8 *srcmac, *dstmac;
-	bool broadcast = TRUE;
-	struct dlist *l, *l1;
-	struct vmm_netport *dst, *port;
-	struct bridge_ctrl *br = nsw->priv;
+	struct vmm_netport *dst;
 
 	/* Get source and destination mac addresses */
 	srcmac = ether_srcmac(mtod(mbuf, u8 *));
@@ -234,38 +297,82 @@ static int bridge_rx_handler(struct vmm_netswitch *nsw,
 	 */
 	dst = bridge_mactable_learn_find(br, dstmac, srcmac, src);
 
-	/* If the frame below cases then it should be unicast.
-	 * 
-	 * Case 1: destination MAC address is not broadcast address
-	 * Case 2: We found port matching destination mac address
+	/* Frame should be unicast only if destination MAC address is
+	 * not broadcast address and we found port matching it.
 	 */
-	if (!is_broadcast_ether_addr(dstmac) && dst) {
-		/* Find port fordestination mac address */
-		broadcast = FALSE;
+	if (is_broadcast_ether_addr(dstmac)) {
+		return NULL;
 	}
 
-	/* Transfer mbuf to appropriate ports */
-	if (broadcast) {
-		DPRINTF("%s: broadcasting\n", __func__);
-		vmm_read_lock_irqsave_lite(&nsw->port_list_lock, f);
-		list_for_each_safe(l, l1, &nsw->port_list) {
-			port = list_port(l);
-			if (port == src) {
-				continue;
-			}
-			vmm_read_unlock_irqrestore_lite(&nsw->port_list_lock, f);
-			vmm_switch2port_xfer_mbuf(nsw, port, mbuf);
-			vmm_read_lock_irqsave_lite(&nsw->port_list_lock, f);
+	return dst;
+}
+
+static void bridge_rx_broadcast(struct vmm_netswitch *nsw,
+				struct vmm_netport *src,
+				struct vmm_mbuf **mbufs, u32 count)
+{
+	irq_flags_t f;
+	struct dlist *l, *l1;
+	struct vmm_netport *port;
+
+	DPRINTF("%s: broadcasting\n", __func__);
+	vmm_read_lock_irqsave_lite(&nsw->port_list_lock, f);
+	list_for_each_safe(l, l1, &nsw->port_list) {
+		port = list_port(l);
+		if (port == src) {
+			continue;
 		}
 		vmm_read_unlock_irqrestore_lite(&nsw->port_list_lock, f);
-	} else {
-		DPRINTF("%s: unicasting to \"%s\"\n", __func__, dst->name);
-		vmm_switch2port_xfer_mbuf(nsw, dst, mbuf);
+		vmm_switch2port_xfer_burst(nsw, port, mbufs, count);
+		vmm_read_lock_irqsave_lite(&nsw->port_list_lock, f);
+	}
+	vmm_read_unlock_irqrestore_lite(&nsw->port_list_lock, f);
+}
+
+/**
+ *  Thread body responsible for sending burst of RX buffer packets
+ *  to the destination port(s)
+ */
+static int bridge_rx_burst_handler(struct vmm_netswitch *nsw,
+				   struct vmm_netport *src,
+				   struct vmm_mbuf **mbufs, u32 count)
+{
+	u32 i, j;
+	struct bridge_ctrl *br = nsw->priv;
+	struct vmm_netport *dsts[VMM_NETPORT_MAX_BURST];
+
+	if (VMM_NETPORT_MAX_BURST < count) {
+		return VMM_EINVALID;
+	}
+
+	for (i = 0; i < count; i++) {
+		dsts[i] = bridge_rx_lookup(br, src, mbufs[i]);
+	}
+
+	/* Transfer runs of mbufs going to same port(s) together */
+	for (i = 0; i < count; i = j) {
+		for (j = i + 1; (j < count) && (dsts[j] == dsts[i]); j++) ;
+
+		if (dsts[i]) {
+			DPRINTF("%s: unicasting to \"%s\"\n",
+				__func__, dsts[i]->name);
+			vmm_switch2port_xfer_burst(nsw, dsts[i],
+						   &mbufs[i], j - i);
+		} else {
+			bridge_rx_broadcast(nsw, src, &mbufs[i], j - i);
+		}
 	}
 
 	return VMM_OK;
 }
 
+static int bridge_rx_handler(struct vmm_netswitch *nsw,
+			     struct vmm_netport *src,
+			     struct vmm_mbuf *mbuf)
+{
+	return bridge_rx_burst_handler(nsw, src, &mbuf, 1);
+}
+
 static int bridge_port_add(struct vmm_netswitch *nsw, 
 			   struct vmm_netport *port)
 {
@@ -297,6 +404,7 @@ static int bridge_probe(struct vmm_device *dev,
 		goto bridge_netswitch_alloc_failed;
 	}
 	nsw->port2switch_xfer = bridge_rx_handler;
+	nsw->port2switch_xfer_burst = bridge_rx_burst_handler;
 	nsw->port_add = bridge_port_add;
 	nsw->port_remove = bridge_port_remove;
 
@@ -310,10 +418,11 @@ static int bridge_probe(struct vmm_device *dev,
 
 	br->nsw = nsw;
 	INIT_TIMER_EVENT(&br->ev, bridge_timer_event, br);
-	INIT_RW_LOCK(&br->mac_table_lock);
-	br->mac_table_sz = BRIDGE_MAC_TABLE_SZ;
+	INIT_SPIN_LOCK(&br->mac_table_lock);
+	br->mac_table_age = 0;
+	br->mac_table_age_pos = 0;
 	br->mac_table = vmm_zalloc(sizeof(struct bridge_mac_entry) *
-				   br->mac_table_sz);
+				   BRIDGE_MAC_TABLE_SZ);
 	if (!br->mac_table) {
 		rc = VMM_ENOMEM;
 		goto bridge_alloc_mac_table_fail;
@@ -324,7 +433,7 @@ static int bridge_probe(struct vmm_device *dev,
 		goto bridge_netswitch_register_fail;
 	}
 
-	vmm_timer_event_start(&br->ev, BRIDGE_MAC_EXPIRY);
+	vmm_timer_event_start(&br->ev, BRIDGE_MAC_AGE_PERIOD);
 
 	return VMM_OK;
 
@@ -90,6 +90,7 @@
 #include <vmm_stdio.h>
 #include <vmm_heap.h>
 #include <vmm_host_aspace.h>
+#include <vmm_slab.h>
 #include <vmm_modules.h>
 #include <net/vmm_mbuf.h>
 #include <libs/list.h>
@@ -104,9 +105,17 @@
 
 #define EPOOL_SLAB_COUNT		4
 
+/*
+ * Pre-allocated mempools are used first. When they run dry we fall back
+ * to object caches instead of normal heap so that bursts of network
+ * traffic don't fragment the heap. Only ext buffers larger than the
+ * biggest slab size are allocated from normal heap.
+ */
 struct vmm_mbufpool_ctrl {
 	struct mempool *mpool;
 	struct mempool *epool_slabs[EPOOL_SLAB_COUNT];
+	struct vmm_slab_cache *mcache;
+	struct vmm_slab_cache *ecache_slabs[EPOOL_SLAB_COUNT];
 };
 
 static struct vmm_mbufpool_ctrl mbpctrl;
@@ -167,6 +176,7 @@ static u32 epool_slab_buf_count(u32 pool_sz, u32 slab)
 int __init vmm_mbufpool_init(void)
 {
 	u32 slab, b_size, b_count, epool_sz;
+	char name[VMM_FIELD_NAME_SIZE];
 
 	memset(&mbpctrl, 0, sizeof(mbpctrl));
 
@@ -180,6 +190,13 @@ int __init vmm_mbufpool_init(void)
 		return VMM_ENOMEM;
 	}
 
+	/* Create mbuf object cache */
+	mbpctrl.mcache = vmm_slab_cache_create("mbuf", b_size, 0, NULL);
+	if (!mbpctrl.mcache) {
+		mempool_destroy(mbpctrl.mpool);
+		return VMM_ENOMEM;
+	}
+
 	/* Create ext slab pools */
 	epool_sz = (CONFIG_NET_MBUF_EXT_POOL_SIZE_KB * 1024);
 	for (slab = 0; slab < EPOOL_SLAB_COUNT; slab++) {
@@ -193,6 +210,9 @@ int __init vmm_mbufpool_init(void)
 		} else {
 			mbpctrl.epool_slabs[slab] = NULL;
 		}
+		vmm_snprintf(name, sizeof(name), "mbuf-ext-%d", b_size);
+		mbpctrl.ecache_slabs[slab] =
+				vmm_slab_cache_create(name, b_size, 0, NULL);
 	}
 
 	return VMM_OK;
@@ -206,12 +226,14 @@ void __exit vmm_mbufpool_exit(void)
 	if (mbpctrl.mpool) {
 		mempool_destroy(mbpctrl.mpool);
 	}
+	vmm_slab_cache_destroy(mbpctrl.mcache);
 
 	/* Destroy ext slab pools */
 	for (slab = 0; slab < EPOOL_SLAB_COUNT; slab++) {
 		if (mbpctrl.epool_slabs[slab]) {
 			mempool_destroy(mbpctrl.epool_slabs[slab]);
 		}
+		vmm_slab_cache_destroy(mbpctrl.ecache_slabs[slab]);
 	}
 }
 
@@ -256,9 +278,9 @@ static void mbuf_pool_free(struct vmm_mbuf *m)
 	mempool_free(mbpctrl.mpool, m);
 }
 
-static void mbuf_heap_free(struct vmm_mbuf *m)
+static void mbuf_slab_free(struct vmm_mbuf *m)
 {
-	vmm_free(m);
+	vmm_slab_free(mbpctrl.mcache, m);
 }
 
 /*
@@ -275,8 +297,8 @@ struct vmm_mbuf *m_get(int nowait, int flags)
 	m = mempool_zalloc(mbpctrl.mpool);
 	if (m) {
 		m->m_freefn = mbuf_pool_free;
-	} else if (NULL != (m = vmm_zalloc(sizeof(struct vmm_mbuf)))) {
-		m->m_freefn = mbuf_heap_free;
+	} else if (NULL != (m = vmm_slab_zalloc(mbpctrl.mcache))) {
+		m->m_freefn = mbuf_slab_free;
 	} else {
 		return NULL;
 	}
@@ -287,7 +309,7 @@ struct vmm_mbuf *m_get(int nowait, int flags)
 	m->m_len = 0;
 	m->m_flags = flags;
 	if (flags & M_PKTHDR) {
-		m->m_pktlen = 0;
+		memset(&m->m_pkthdr, 0, sizeof(m->m_pkthdr));
 	}
 	m->m_ref = 1;
 
@@ -302,6 +324,13 @@ static void ext_pool_free(struct vmm_mbuf *m, void *ptr, u32 size, void *arg)
 	mempool_free(mp, ptr);
 }
 
+static void ext_slab_free(struct vmm_mbuf *m, void *ptr, u32 size, void *arg)
+{
+	struct vmm_slab_cache *cache = arg;
+
+	vmm_slab_free(cache, ptr);
+}
+
 static void ext_heap_free(struct vmm_mbuf *m, void *ptr, u32 size, void *arg)
 {
 	vmm_free(ptr);
@@ -317,6 +346,7 @@ void *m_ext_get(struct vmm_mbuf *m, u32 size, enum vmm_mbuf_alloc_types how)
 	void *buf;
 	u32 slab;
 	struct mempool *mp = NULL;
+	struct vmm_slab_cache *cache = NULL;
 
 	if (VMM_MBUF_ALLOC_DMA == how) {
 		buf = vmm_dma_malloc(size);
@@ -329,6 +359,7 @@ void *m_ext_get(struct vmm_mbuf *m, u32 size, enum vmm_mbuf_alloc_types how)
 		for (slab = 0; slab < EPOOL_SLAB_COUNT; slab++) {
 			if (size <= epool_slab_buf_size(slab)) {
 				mp = mbpctrl.epool_slabs[slab];
+				cache = mbpctrl.ecache_slabs[slab];
 				break;
 			}
 		}
@@ -336,6 +367,9 @@ void *m_ext_get(struct vmm_mbuf *m, u32 size, enum vmm_mbuf_alloc_types how)
 		if (mp && (buf = mempool_malloc(mp))) {
 			m->m_flags |= M_EXT_POOL;
 			MEXTADD(m, buf, size, ext_pool_free, mp);
+		} else if (cache && (buf = vmm_slab_alloc(cache))) {
+			m->m_flags |= M_EXT_SLAB;
+			MEXTADD(m, buf, size, ext_slab_free, cache);
 		} else if ((buf = vmm_malloc(size))) {
 			m->m_flags |= M_EXT_HEAP;
 			MEXTADD(m, buf, size, ext_heap_free, NULL);
@@ -0,0 +1,478 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netoffload.c
+ * @author Xvisor Developers
+ * @brief Software fallback for checksum and segmentation offloads.
+ *
+ * Frames carrying a partial checksum or a large segment are passed
+ * untouched between ports which can accept them. For any other port
+ * the checksum is completed and the large segment is split here into
+ * wire sized frames.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <arch_atomic.h>
+#include <net/vmm_mbuf.h>
+#include <net/vmm_protocol.h>
+#include <net/vmm_netoffload.h>
+#include <libs/stringlib.h>
+
+#define NETOFFLOAD_ETH_P_IP		0x0800
+#define NETOFFLOAD_ETH_P_IPV6		0x86DD
+#define NETOFFLOAD_ETH_P_8021Q		0x8100
+#define NETOFFLOAD_VLAN_HLEN		4
+
+#define NETOFFLOAD_IPPROTO_TCP		6
+#define NETOFFLOAD_IPPROTO_UDP		17
+#define NETOFFLOAD_IPPROTO_FRAGMENT	44
+
+#define NETOFFLOAD_IP_MF		0x2000
+#define NETOFFLOAD_IP6_HLEN		40
+#define NETOFFLOAD_IP6_FRAG_HLEN	8
+
+#define NETOFFLOAD_TCP_FIN		0x01
+#define NETOFFLOAD_TCP_PSH		0x08
+#define NETOFFLOAD_TCP_CWR		0x80
+#define NETOFFLOAD_TCP_FLAGS		13
+#define NETOFFLOAD_TCP_CSUM		16
+
+#define NETOFFLOAD_UDP_HLEN		8
+#define NETOFFLOAD_UDP_CSUM		6
+
+/* Linear view of a frame with offsets of its headers */
+struct netoffload_frame {
+	const u8 *buf;
+	u32 len;
+	u32 l3off;
+	u32 l4off;
+	u32 hlen;
+	bool ipv6;
+	u8 proto;
+};
+
+/* Identification for IPv6 fragments */
+static atomic_t netoffload_frag_id;
+
+static inline u16 netoffload_get16(const u8 *p)
+{
+	return ((u16)p[0] << 8) | p[1];
+}
+
+static inline void netoffload_put16(u8 *p, u16 val)
+{
+	p[0] = val >> 8;
+	p[1] = val;
+}
+
+static inline u32 netoffload_get32(const u8 *p)
+{
+	return ((u32)netoffload_get16(p) << 16) | netoffload_get16(p + 2);
+}
+
+static inline void netoffload_put32(u8 *p, u32 val)
+{
+	netoffload_put16(p, val >> 16);
+	netoffload_put16(p + 2, val);
+}
+
+/* One's complement sum of big-endian 16-bit words. Only the last
+ * buffer added to a sum can have odd length.
+ */
+static u32 netoffload_csum_add(u32 sum, const u8 *buf, u32 len)
+{
+	u32 i;
+
+	for (i = 0; (i + 1) < len; i += 2) {
+		sum += ((u32)buf[i] << 8) | buf[i + 1];
+		if (sum & 0x80000000) {
+			sum = (sum & 0xffff) + (sum >> 16);
+		}
+	}
+	if (len & 1) {
+		sum += (u32)buf[len - 1] << 8;
+	}
+
+	return sum;
+}
+
+static u16 netoffload_csum_fold(u32 sum)
+{
+	while (sum >> 16) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+
+	return ~sum & 0xffff;
+}
+
+/* Sum of pseudo header used by TCP and UDP checksums */
+static u32 netoffload_csum_pseudo(struct netoffload_frame *f,
+				  const u8 *p, u32 l4len)
+{
+	u32 sum;
+
+	if (f->ipv6) {
+		sum = netoffload_csum_add(0, p + f->l3off + 8, 32);
+	} else {
+		sum = netoffload_csum_add(0, p + f->l3off + 12, 8);
+	}
+
+	return sum + f->proto + (l4len >> 16) + (l4len & 0xffff);
+}
+
+static void netoffload_fix_ipv4(u8 *p, u32 ihl, u16 tot_len,
+				u16 id, u16 frag)
+{
+	netoffload_put16(p + 2, tot_len);
+	netoffload_put16(p + 4, id);
+	netoffload_put16(p + 6, frag);
+	netoffload_put16(p + 10, 0);
+	netoffload_put16(p + 10,
+		netoffload_csum_fold(netoffload_csum_add(0, p, ihl)));
+}
+
+static struct vmm_mbuf *netoffload_alloc(u32 len)
+{
+	struct vmm_mbuf *m;
+
+	MGETHDR(m, 0, 0);
+	if (!m) {
+		return NULL;
+	}
+
+	if (!MEXTMALLOC(m, len, 0)) {
+		m_freem(m);
+		return NULL;
+	}
+	m->m_len = m->m_pktlen = len;
+
+	return m;
+}
+
+static int netoffload_parse(struct netoffload_frame *f)
+{
+	u16 type;
+	u32 off = ETHER_HLEN, thl;
+	const u8 *buf = f->buf;
+
+	if (f->len < ETHER_HLEN) {
+		return VMM_EINVALID;
+	}
+
+	type = netoffload_get16(buf + 12);
+	if (type == NETOFFLOAD_ETH_P_8021Q) {
+		if (f->len < (off + NETOFFLOAD_VLAN_HLEN)) {
+			return VMM_EINVALID;
+		}
+		type = netoffload_get16(buf + off + 2);
+		off += NETOFFLOAD_VLAN_HLEN;
+	}
+	f->l3off = off;
+
+	switch (type) {
+	case NETOFFLOAD_ETH_P_IP:
+		if (f->len < (off + IP4_HLEN)) {
+			return VMM_EINVALID;
+		}
+		f->ipv6 = FALSE;
+		f->proto = buf[off + 9];
+		f->l4off = off + (buf[off] & 0xf) * 4;
+		if ((f->l4off < (off + IP4_HLEN)) || (f->len < f->l4off)) {
+			return VMM_EINVALID;
+		}
+		break;
+	case NETOFFLOAD_ETH_P_IPV6:
+		/* Extension headers are not supported */
+		if (f->len < (off + NETOFFLOAD_IP6_HLEN)) {
+			return VMM_EINVALID;
+		}
+		f->ipv6 = TRUE;
+		f->proto = buf[off + 6];
+		f->l4off = off + NETOFFLOAD_IP6_HLEN;
+		break;
+	default:
+		return VMM_EINVALID;
+	}
+
+	switch (f->proto) {
+	case NETOFFLOAD_IPPROTO_TCP:
+		if (f->len < (f->l4off + TCP_HLEN)) {
+			return VMM_EINVALID;
+		}
+		thl = (buf[f->l4off + 12] >> 4) * 4;
+		if ((thl < TCP_HLEN) || (f->len < (f->l4off + thl))) {
+			return VMM_EINVALID;
+		}
+		f->hlen = f->l4off + thl;
+		break;
+	case NETOFFLOAD_IPPROTO_UDP:
+		if (f->len < (f->l4off + NETOFFLOAD_UDP_HLEN)) {
+			return VMM_EINVALID;
+		}
+		f->hlen = f->l4off + NETOFFLOAD_UDP_HLEN;
+		break;
+	default:
+		return VMM_EINVALID;
+	}
+
+	return VMM_OK;
+}
+
+/* Complete partial checksum in a linear copy of the frame */
+static int netoffload_csum(struct vmm_mbuf *m,
+			   int (*xfer)(struct vmm_mbuf *, void *),
+			   void *arg)
+{
+	u8 *p;
+	u16 csum;
+	u32 len = m->m_pktlen;
+	u32 start = m->m_csum_start;
+	u32 pos = start + m->m_csum_offset;
+	struct vmm_mbuf *n;
+
+	if ((len < start) || (len < (pos + 2))) {
+		return VMM_EINVALID;
+	}
+
+	n = netoffload_alloc(len);
+	if (!n) {
+		return VMM_ENOMEM;
+	}
+	p = mtod(n, u8 *);
+	m_copydata(m, 0, len, p);
+
+	/* Checksum field already holds pseudo header sum */
+	csum = netoffload_csum_fold(netoffload_csum_add(0, p + start,
+							len - start));
+	netoffload_put16(p + pos, (csum) ? csum : 0xffff);
+
+	return xfer(n, arg);
+}
+
+/* Split a TCP large segment into segments of gso_size payload */
+static int netoffload_tso(struct vmm_mbuf *m, struct netoffload_frame *f,
+			  int (*xfer)(struct vmm_mbuf *, void *),
+			  void *arg)
+{
+	int rc;
+	u8 *p, *tcp;
+	u16 ip_id = 0, ip_frag = 0;
+	u32 i, off, seg, seq, l4len, sum, mss = m->m_gso_size;
+	const u8 *buf = f->buf;
+	struct vmm_mbuf *n;
+
+	if ((f->proto != NETOFFLOAD_IPPROTO_TCP) || !mss) {
+		return VMM_EINVALID;
+	}
+
+	if (!f->ipv6) {
+		ip_id = netoffload_get16(buf + f->l3off + 4);
+		ip_frag = netoffload_get16(buf + f->l3off + 6);
+	}
+	seq = netoffload_get32(buf + f->l4off + 4);
+
+	off = f->hlen;
+	i = 0;
+	do {
+		seg = min(mss, f->len - off);
+		n = netoffload_alloc(f->hlen + seg);
+		if (!n) {
+			return VMM_ENOMEM;
+		}
+		p = mtod(n, u8 *);
+		memcpy(p, buf, f->hlen);
+		memcpy(p + f->hlen, buf + off, seg);
+
+		l4len = f->hlen - f->l4off + seg;
+		if (f->ipv6) {
+			netoffload_put16(p + f->l3off + 4,
+				f->l4off - f->l3off - NETOFFLOAD_IP6_HLEN + l4len);
+		} else {
+			netoffload_fix_ipv4(p + f->l3off, f->l4off - f->l3off,
+					    f->l4off - f->l3off + l4len,
+					    ip_id + i, ip_frag);
+		}
+
+		tcp = p + f->l4off;
+		netoffload_put32(tcp + 4, seq + (off - f->hlen));
+		if ((off + seg) < f->len) {
+			tcp[NETOFFLOAD_TCP_FLAGS] &=
+				~(NETOFFLOAD_TCP_FIN | NETOFFLOAD_TCP_PSH);
+		}
+		if (i) {
+			tcp[NETOFFLOAD_TCP_FLAGS] &= ~NETOFFLOAD_TCP_CWR;
+		}
+		netoffload_put16(tcp + NETOFFLOAD_TCP_CSUM, 0);
+		sum = netoffload_csum_pseudo(f, p, l4len);
+		sum = netoffload_csum_add(sum, tcp, l4len);
+		netoffload_put16(tcp + NETOFFLOAD_TCP_CSUM,
+				 netoffload_csum_fold(sum));
+
+		rc = xfer(n, arg);
+		if (rc) {
+			return rc;
+		}
+
+		off += seg;
+		i++;
+	} while (off < f->len);
+
+	return VMM_OK;
+}
+
+/* Split a large UDP datagram into IP fragments of gso_size payload */
+static int netoffload_ufo(struct vmm_mbuf *m, struct netoffload_frame *f,
+			  int (*xfer)(struct vmm_mbuf *, void *),
+			  void *arg)
+{
+	int rc;
+	bool more;
+	u8 *p, *x;
+	u16 csum, ip_id = 0;
+	u32 id = 0, off, seg, foff, xhlen, fsz = m->m_gso_size & ~0x7;
+	const u8 *buf = f->buf;
+	struct vmm_mbuf *n;
+
+	if ((f->proto != NETOFFLOAD_IPPROTO_UDP) || !fsz) {
+		return VMM_EINVALID;
+	}
+
+	/* Checksum covers whole datagram so it is completed up front
+	 * and placed in the first fragment.
+	 */
+	csum = netoffload_get16(buf + f->l4off + NETOFFLOAD_UDP_CSUM);
+	if (m->m_csum_flags & M_CSUM_PARTIAL) {
+		if ((m->m_csum_start != f->l4off) ||
+		    (m->m_csum_offset != NETOFFLOAD_UDP_CSUM)) {
+			return VMM_EINVALID;
+		}
+		csum = netoffload_csum_fold(netoffload_csum_add(0,
+					buf + f->l4off, f->len - f->l4off));
+		csum = (csum) ? csum : 0xffff;
+	}
+
+	if (f->ipv6) {
+		id = arch_atomic_add_return(&netoffload_frag_id, 1);
+		xhlen = NETOFFLOAD_IP6_FRAG_HLEN;
+	} else {
+		ip_id = netoffload_get16(buf + f->l3off + 4);
+		xhlen = 0;
+	}
+
+	for (off = f->l4off; off < f->len; off += seg) {
+		seg = min(fsz, f->len - off);
+		more = ((off + seg) < f->len) ? TRUE : FALSE;
+		foff = off - f->l4off;
+
+		n = netoffload_alloc(f->l4off + xhlen + seg);
+		if (!n) {
+			return VMM_ENOMEM;
+		}
+		p = mtod(n, u8 *);
+		memcpy(p, buf, f->l4off);
+		memcpy(p + f->l4off + xhlen, buf + off, seg);
+		if (!foff) {
+			netoffload_put16(p + f->l4off + xhlen +
+					 NETOFFLOAD_UDP_CSUM, csum);
+		}
+
+		if (f->ipv6) {
+			x = p + f->l4off;
+			x[0] = NETOFFLOAD_IPPROTO_UDP;
+			x[1] = 0;
+			netoffload_put16(x + 2, foff | ((more) ? 1 : 0));
+			netoffload_put32(x + 4, id);
+			p[f->l3off + 6] = NETOFFLOAD_IPPROTO_FRAGMENT;
+			netoffload_put16(p + f->l3off + 4, xhlen + seg);
+		} else {
+			netoffload_fix_ipv4(p + f->l3off, f->l4off - f->l3off,
+					    f->l4off - f->l3off + seg, ip_id,
+					    (foff >> 3) |
+					    ((more) ? NETOFFLOAD_IP_MF : 0));
+		}
+
+		rc = xfer(n, arg);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+int vmm_netoffload_resolve(struct vmm_mbuf *m,
+			   int (*xfer)(struct vmm_mbuf *, void *),
+			   void *arg)
+{
+	int rc;
+	u8 *lbuf = NULL;
+	struct netoffload_frame f;
+
+	if (!m || !xfer || !(m->m_flags & M_PKTHDR)) {
+		return VMM_EFAIL;
+	}
+
+	if (m->m_gso_type == M_GSO_NONE) {
+		return netoffload_csum(m, xfer, arg);
+	}
+
+	/* Segments are built from a linear view of the frame */
+	memset(&f, 0, sizeof(f));
+	f.len = m->m_pktlen;
+	if (!m->m_next && (m->m_len == f.len)) {
+		f.buf = mtod(m, const u8 *);
+	} else {
+		lbuf = vmm_malloc(f.len);
+		if (!lbuf) {
+			return VMM_ENOMEM;
+		}
+		m_copydata(m, 0, f.len, lbuf);
+		f.buf = lbuf;
+	}
+
+	rc = netoffload_parse(&f);
+	if (rc) {
+		goto done;
+	}
+
+	switch (m->m_gso_type & ~M_GSO_ECN) {
+	case M_GSO_TCPV4:
+		rc = (f.ipv6) ? VMM_EINVALID : netoffload_tso(m, &f, xfer, arg);
+		break;
+	case M_GSO_TCPV6:
+		rc = (f.ipv6) ? netoffload_tso(m, &f, xfer, arg) : VMM_EINVALID;
+		break;
+	case M_GSO_UDP:
+		rc = netoffload_ufo(m, &f, xfer, arg);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	}
+
+done:
+	if (lbuf) {
+		vmm_free(lbuf);
+	}
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_netoffload_resolve);
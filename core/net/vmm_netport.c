@@ -51,10 +51,41 @@ struct vmm_netport_xfer *vmm_netport_alloc_xfer(struct vmm_netport *port)
 	port->free_count--;
 	vmm_spin_unlock_irqrestore(&port->free_list_lock, flags);
 
+	xfer->burst = NULL;
+
 	return xfer;
 }
 VMM_EXPORT_SYMBOL(vmm_netport_alloc_xfer);
 
+struct vmm_netport_xfer *vmm_netport_alloc_xfer_burst(
+					struct vmm_netport *port)
+{
+	struct vmm_netport_xfer *xfer;
+	irq_flags_t flags;
+
+	if (!port) {
+		return NULL;
+	}
+
+	vmm_spin_lock_irqsave(&port->free_list_lock, flags);
+	if (list_empty(&port->free_list) ||
+	    list_empty(&port->burst_free_list)) {
+		vmm_spin_unlock_irqrestore(&port->free_list_lock, flags);
+		return NULL;
+	}
+	xfer = list_first_entry(&port->free_list,
+				struct vmm_netport_xfer, head);
+	list_del(&xfer->head);
+	port->free_count--;
+	xfer->burst = list_first_entry(&port->burst_free_list,
+				       struct vmm_netport_burst, head);
+	list_del(&xfer->burst->head);
+	vmm_spin_unlock_irqrestore(&port->free_list_lock, flags);
+
+	return xfer;
+}
+VMM_EXPORT_SYMBOL(vmm_netport_alloc_xfer_burst);
+
 void vmm_netport_free_xfer(struct vmm_netport *port,
 			   struct vmm_netport_xfer *xfer)
 {
@@ -65,6 +96,10 @@ void vmm_netport_free_xfer(struct vmm_netport *port,
 	}
 
 	vmm_spin_lock_irqsave(&port->free_list_lock, flags);
+	if (xfer->burst) {
+		list_add_tail(&xfer->burst->head, &port->burst_free_list);
+		xfer->burst = NULL;
+	}
 	list_add_tail(&xfer->head, &port->free_list);
 	port->free_count++;
 	vmm_spin_unlock_irqrestore(&port->free_list_lock, flags);
@@ -102,6 +137,12 @@ struct vmm_netport *vmm_netport_alloc(char *name, u32 queue_size)
 		list_add_tail(l, &port->free_list);
 	}
 
+	INIT_LIST_HEAD(&port->burst_free_list);
+	for (i = 0; i < VMM_NETPORT_BURST_POOL_SIZE; i++) {
+		l = &((port->burst_pool + i)->head);
+		list_add_tail(l, &port->burst_free_list);
+	}
+
 	INIT_SPIN_LOCK(&port->switch2port_xfer_lock);
 
 	return port;
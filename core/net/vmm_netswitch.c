@@ -33,10 +33,12 @@
 #include <vmm_modules.h>
 #include <vmm_threads.h>
 #include <vmm_completion.h>
+#include <vmm_mutex.h>
 #include <net/vmm_mbuf.h>
 #include <net/vmm_protocol.h>
 #include <net/vmm_netswitch.h>
 #include <net/vmm_netport.h>
+#include <net/vmm_netoffload.h>
 #include <libs/list.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
@@ -127,11 +129,38 @@ if (ether_type(mtod(mbuf, u8 *)) == 0x0806	/* ARP */) {		\
 #define DUMP_NETSWITCH_PKT(mbuf)
 #endif
 
+/* Max number of xfer requests taken from xfer list at a time */
+#define NETSWITCH_BH_BATCH		16
+
+struct vmm_netswitch_bh_work {
+	struct vmm_netport *port;
+	struct vmm_netswitch *nsw;
+	enum vmm_netport_xfer_type type;
+	u32 mbuf_count;
+	struct vmm_mbuf *mbufs[VMM_NETPORT_MAX_BURST];
+	int lazy_budget;
+	void *lazy_arg;
+	void (*lazy_xfer)(struct vmm_netport *, void *, int);
+};
+
 struct vmm_netswitch_bh_ctrl {
 	struct vmm_thread *thread;
 	struct vmm_completion xfer_cmpl;
 	vmm_spinlock_t xfer_list_lock;
 	struct dlist xfer_list;
+
+	/* Held by bottom-half thread from dequeue till its burst is
+	 * flushed so that port flush can wait for in-flight work
+	 */
+	struct vmm_mutex work_lock;
+
+	/* Only accessed by bottom-half thread with work_lock held */
+	u32 work_count;
+	struct vmm_netswitch_bh_work work[NETSWITCH_BH_BATCH];
+	struct vmm_netport *burst_port;
+	struct vmm_netswitch *burst_nsw;
+	u32 burst_count;
+	struct vmm_mbuf *burst[VMM_NETPORT_MAX_BURST];
 };
 
 static DEFINE_PER_CPU(struct vmm_netswitch_bh_ctrl, nbctrl);
@@ -141,6 +170,11 @@ static void __init netswitch_bh_init(struct vmm_netswitch_bh_ctrl *nbp)
 	INIT_COMPLETION(&nbp->xfer_cmpl);
 	INIT_SPIN_LOCK(&nbp->xfer_list_lock);
 	INIT_LIST_HEAD(&nbp->xfer_list);
+	INIT_MUTEX(&nbp->work_lock);
+	nbp->work_count = 0;
+	nbp->burst_port = NULL;
+	nbp->burst_nsw = NULL;
+	nbp->burst_count = 0;
 }
 
 static int netswitch_bh_enqueue(struct vmm_netswitch_bh_ctrl *nbp,
@@ -157,11 +191,28 @@ static int netswitch_bh_enqueue(struct vmm_netswitch_bh_ctrl *nbp,
 	return VMM_OK;
 }
 
-static struct vmm_netport_xfer *netswitch_bh_dequeue(
-				struct vmm_netswitch_bh_ctrl *nbp)
+static int netswitch_bh_enqueue_list(struct vmm_netswitch_bh_ctrl *nbp,
+				     struct dlist *xfers)
+{
+	irq_flags_t flags;
+
+	if (list_empty(xfers)) {
+		return VMM_OK;
+	}
+
+	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
+	list_splice_tail(xfers, &nbp->xfer_list);
+	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
+
+	vmm_completion_complete_once(&nbp->xfer_cmpl);
+
+	return VMM_OK;
+}
+
+/* Wait till xfer list of bottom-half has xfer requests */
+static void netswitch_bh_wait(struct vmm_netswitch_bh_ctrl *nbp)
 {
 	irq_flags_t flags;
-	struct vmm_netport_xfer *xfer;
 
 	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
 
@@ -171,101 +222,206 @@ static struct vmm_netport_xfer *netswitch_bh_dequeue(
 		vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
 	}
 
-	xfer = list_entry(list_pop(&nbp->xfer_list),
-			  struct vmm_netport_xfer, head);
+	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
+}
+
+/* Move upto NETSWITCH_BH_BATCH xfer requests from xfer list to work
+ * array of bottom-half. The xfer requests are freed while xfer list
+ * lock is held so that port flush never misses any of them.
+ * NOTE: This function must be called with work_lock held
+ */
+static u32 netswitch_bh_dequeue(struct vmm_netswitch_bh_ctrl *nbp)
+{
+	irq_flags_t flags;
+	struct vmm_netport_xfer *xfer;
+	struct vmm_netswitch_bh_work *w;
+
+	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
+
+	nbp->work_count = 0;
+	while (!list_empty(&nbp->xfer_list) &&
+	       (nbp->work_count < NETSWITCH_BH_BATCH)) {
+		xfer = list_entry(list_pop(&nbp->xfer_list),
+				  struct vmm_netport_xfer, head);
+
+		w = &nbp->work[nbp->work_count++];
+		w->port = xfer->port;
+		w->nsw = (xfer->port) ? xfer->port->nsw : NULL;
+		w->type = xfer->type;
+		switch (xfer->type) {
+		case VMM_NETPORT_XFER_MBUF:
+			w->mbuf_count = 1;
+			w->mbufs[0] = xfer->mbuf;
+			break;
+		case VMM_NETPORT_XFER_BURST:
+			w->mbuf_count = xfer->mbuf_count;
+			memcpy(w->mbufs, xfer->burst->mbufs,
+			       xfer->mbuf_count * sizeof(*w->mbufs));
+			break;
+		default:
+			w->mbuf_count = 0;
+			break;
+		};
+		w->lazy_budget = xfer->lazy_budget;
+		w->lazy_arg = xfer->lazy_arg;
+		w->lazy_xfer = xfer->lazy_xfer;
+
+		vmm_netport_free_xfer(xfer->port, xfer);
+	}
 
 	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
 
-	return xfer;
+	return nbp->work_count;
 }
 
+/* Drop all xfer requests of a port from bottom-half. The work array
+ * and pending burst of bottom-half are empty whenever work_lock is
+ * free so taking work_lock also waits for in-flight xfer requests
+ * of the port.
+ */
 static void netswitch_bh_port_flush(struct vmm_netswitch_bh_ctrl *nbp,
 					 struct vmm_netport *port)
 {
+	u32 i;
 	irq_flags_t flags;
 	struct vmm_netport_xfer *xfer, *nxfer;
 
+	vmm_mutex_lock(&nbp->work_lock);
 	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
 
 	list_for_each_entry_safe(xfer, nxfer, &nbp->xfer_list, head) {
 		if (xfer->port == port) {
 			list_del(&xfer->head);
-			if (xfer->mbuf) {
+			if ((xfer->type == VMM_NETPORT_XFER_MBUF) &&
+			    xfer->mbuf) {
 				m_freem(xfer->mbuf);
 			}
+			if (xfer->type == VMM_NETPORT_XFER_BURST) {
+				for (i = 0; i < xfer->mbuf_count; i++) {
+					m_freem(xfer->burst->mbufs[i]);
+				}
+			}
 			vmm_netport_free_xfer(xfer->port, xfer);
 		}
 	}
 
 	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
+	vmm_mutex_unlock(&nbp->work_lock);
 }
 
-static int netswitch_bh_main(void *param)
+/* Hand over pending burst of bottom-half to its netswitch */
+static void netswitch_bh_burst_flush(struct vmm_netswitch_bh_ctrl *nbp)
 {
-	struct vmm_netport *xfer_port;
-	struct vmm_netswitch *xfer_nsw;
-	enum vmm_netport_xfer_type xfer_type;
-	struct vmm_mbuf *xfer_mbuf;
-	int xfer_lazy_budget;
-	void *xfer_lazy_arg;
-	void (*xfer_lazy_xfer)(struct vmm_netport *, void *, int);
-	struct vmm_netport_xfer *xfer;
-	struct vmm_netswitch_bh_ctrl *nbp = param;
+	u32 i;
+	struct vmm_netport *port = nbp->burst_port;
+	struct vmm_netswitch *nsw = nbp->burst_nsw;
 
-	while (1) {
-		/* Try to get xfer request from xfer ring */
-		xfer = netswitch_bh_dequeue(nbp);
-		if (!xfer) {
-			continue;
+	if (!nbp->burst_count) {
+		return;
+	}
+
+	/* Print debug info */
+	DPRINTF("%s: nsw=%s src=%s count=%d\n", __func__,
+		nsw->name, port->name, nbp->burst_count);
+
+	if (nsw->port2switch_xfer_burst) {
+		nsw->port2switch_xfer_burst(nsw, port,
+					    nbp->burst, nbp->burst_count);
+	} else {
+		for (i = 0; i < nbp->burst_count; i++) {
+			nsw->port2switch_xfer(nsw, port, nbp->burst[i]);
 		}
+	}
 
-		/* Extract info from xfer request */
-		xfer_port = xfer->port;
-		xfer_nsw = xfer->port->nsw;
-		xfer_type = xfer->type;
-		xfer_mbuf = xfer->mbuf;
-		xfer_lazy_budget = xfer->lazy_budget;
-		xfer_lazy_arg = xfer->lazy_arg;
-		xfer_lazy_xfer = xfer->lazy_xfer;
+	/* Free mbufs of the burst */
+	for (i = 0; i < nbp->burst_count; i++) {
+		m_freem(nbp->burst[i]);
+		nbp->burst[i] = NULL;
+	}
 
-		/* Free netport xfer request */
-		vmm_netport_free_xfer(xfer->port, xfer);
+	nbp->burst_count = 0;
+	nbp->burst_port = NULL;
+	nbp->burst_nsw = NULL;
+}
 
-		/* Port might have been removed from netswitch */
-		if (!xfer_port || !xfer_nsw) {
-			if (xfer_mbuf) {
-				m_freem(xfer_mbuf);
-			}
-			continue;
-		}
+/* Add mbuf to pending burst of bottom-half. Consecutive mbufs from
+ * same port are handed over to netswitch together.
+ */
+static void netswitch_bh_burst_add(struct vmm_netswitch_bh_ctrl *nbp,
+				   struct vmm_netswitch *nsw,
+				   struct vmm_netport *port,
+				   struct vmm_mbuf *mbuf)
+{
+	if ((nbp->burst_port != port) ||
+	    (nbp->burst_count == VMM_NETPORT_MAX_BURST)) {
+		netswitch_bh_burst_flush(nbp);
+	}
 
-		/* Print debug info */
-		DPRINTF("%s: nsw=%s xfer_type=%d\n", __func__,
-			xfer_nsw->name, xfer_type);
+	/* Dump packet */
+	DUMP_NETSWITCH_PKT(mbuf);
 
-		/* Process xfer request */
-		switch (xfer_type) {
-		case VMM_NETPORT_XFER_LAZY:
-			/* Call lazy xfer function */
-			xfer_lazy_xfer(xfer_port,
-					xfer_lazy_arg,
-					xfer_lazy_budget);
+	nbp->burst_port = port;
+	nbp->burst_nsw = nsw;
+	nbp->burst[nbp->burst_count++] = mbuf;
+}
 
-			break;
-		case VMM_NETPORT_XFER_MBUF:
-			/* Dump packet */
-			DUMP_NETSWITCH_PKT(xfer_mbuf);
+static int netswitch_bh_main(void *param)
+{
+	u32 i, j, count;
+	struct vmm_netswitch_bh_work *w;
+	struct vmm_netswitch_bh_ctrl *nbp = param;
 
-			/* Call the rx function of net switch */
-			xfer_nsw->port2switch_xfer(xfer_nsw, xfer_port, xfer_mbuf);
+	while (1) {
+		/* Wait for xfer requests without holding work_lock */
+		netswitch_bh_wait(nbp);
+
+		/* Try to get xfer requests from xfer list */
+		vmm_mutex_lock(&nbp->work_lock);
+		count = netswitch_bh_dequeue(nbp);
+
+		for (i = 0; i < count; i++) {
+			w = &nbp->work[i];
+
+			/* Port might have been removed from netswitch */
+			if (!w->port || !w->nsw) {
+				for (j = 0; j < w->mbuf_count; j++) {
+					m_freem(w->mbufs[j]);
+				}
+				continue;
+			}
 
-			/* Free mbuf in xfer request */
-			m_freem(xfer_mbuf);
+			/* Print debug info */
+			DPRINTF("%s: nsw=%s xfer_type=%d\n", __func__,
+				w->nsw->name, w->type);
+
+			/* Process xfer request */
+			switch (w->type) {
+			case VMM_NETPORT_XFER_LAZY:
+				/* Keep packet order w.r.t. lazy xfer */
+				netswitch_bh_burst_flush(nbp);
+
+				/* Call lazy xfer function */
+				w->lazy_xfer(w->port,
+					     w->lazy_arg,
+					     w->lazy_budget);
+
+				break;
+			case VMM_NETPORT_XFER_MBUF:
+			case VMM_NETPORT_XFER_BURST:
+				for (j = 0; j < w->mbuf_count; j++) {
+					netswitch_bh_burst_add(nbp, w->nsw,
+							w->port, w->mbufs[j]);
+				}
+
+				break;
+			default:
+				break;
+			};
+		}
 
-			break;
-		default:
-			break;
-		};
+		/* Don't hold packets while waiting for xfer requests */
+		netswitch_bh_burst_flush(nbp);
+		vmm_mutex_unlock(&nbp->work_lock);
 	}
 
 	return VMM_OK;
@@ -318,9 +474,90 @@ int vmm_port2switch_xfer_mbuf(struct vmm_netport *src, struct vmm_mbuf *mbuf)
 }
 VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_mbuf);
 
+int vmm_port2switch_xfer_burst(struct vmm_netport *src,
+			       struct vmm_mbuf **mbufs, u32 count)
+{
+	int rc = VMM_OK;
+	u32 i, n;
+	struct dlist xfers;
+	struct vmm_netport_xfer *xfer;
+	struct vmm_netswitch *nsw;
+	struct vmm_netswitch_bh_ctrl *nbp;
+
+	if (!mbufs || !count) {
+		return VMM_EFAIL;
+	}
+	if (!src || !src->nsw) {
+		vmm_printf("%s: invalid source port.\n", __func__);
+		for (i = 0; i < count; i++) {
+			m_freem(mbufs[i]);
+		}
+		return VMM_EFAIL;
+	}
+	nsw = src->nsw;
+	nbp = &this_cpu(nbctrl);
+
+	/* Print debug info */
+	DPRINTF("%s: nsw=%s src=%s count=%d\n",
+		__func__, nsw->name, src->name, count);
+
+	/* Pack mbufs into as few xfer requests as possible */
+	INIT_LIST_HEAD(&xfers);
+	for (i = 0; i < count; i += n) {
+		n = min(count - i, (u32)VMM_NETPORT_MAX_BURST);
+
+		/* Alloc netport burst xfer request */
+		xfer = (1 < n) ? vmm_netport_alloc_xfer_burst(src) : NULL;
+		if (xfer) {
+			xfer->port = src;
+			xfer->type = VMM_NETPORT_XFER_BURST;
+			xfer->mbuf = NULL;
+			xfer->mbuf_count = n;
+			memcpy(xfer->burst->mbufs, &mbufs[i],
+			       n * sizeof(*mbufs));
+			list_add_tail(&xfer->head, &xfers);
+			continue;
+		}
+
+		/* No burst mbuf array available so use one xfer per mbuf */
+		n = 1;
+		xfer = vmm_netport_alloc_xfer(src);
+		if (!xfer) {
+			vmm_printf("%s: nsw=%s src=%s xfer alloc failed.\n",
+				   __func__, nsw->name, src->name);
+			for ( ; i < count; i++) {
+				m_freem(mbufs[i]);
+			}
+			rc = VMM_ENOMEM;
+			break;
+		}
+
+		/* Fill-up xfer request */
+		xfer->port = src;
+		xfer->type = VMM_NETPORT_XFER_MBUF;
+		xfer->mbuf = mbufs[i];
+		list_add_tail(&xfer->head, &xfers);
+	}
+
+	/* Add all xfer requests to xfer list in one go */
+	netswitch_bh_enqueue_list(nbp, &xfers);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_burst);
+
 int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
 			 void *lazy_arg, int lazy_budget)
+{
+	return vmm_port2switch_xfer_lazy_oncpu(src, vmm_smp_processor_id(),
+					lazy_xfer, lazy_arg, lazy_budget);
+}
+VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_lazy);
+
+int vmm_port2switch_xfer_lazy_oncpu(struct vmm_netport *src, u32 cpu,
+			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
+			 void *lazy_arg, int lazy_budget)
 {
 	int rc;
 	struct vmm_netport_xfer *xfer;
@@ -333,7 +570,10 @@ int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 		return VMM_EFAIL;
 	}
 	nsw = src->nsw;
-	nbp = &this_cpu(nbctrl);
+	if ((CONFIG_CPU_COUNT <= cpu) || !vmm_cpu_online(cpu)) {
+		cpu = vmm_smp_processor_id();
+	}
+	nbp = &per_cpu(nbctrl, cpu);
 
 	/* Print debug info */
 	DPRINTF("%s: nsw=%s src=%s\n", __func__, nsw->name, src->name);
@@ -363,7 +603,47 @@ int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 
 	return rc;
 }
-VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_lazy);
+VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_lazy_oncpu);
+
+static int switch2port_xfer_resolved(struct vmm_mbuf *mbuf, void *arg)
+{
+	int rc;
+	irq_flags_t f;
+	struct vmm_netport *dst = arg;
+
+	vmm_spin_lock_irqsave_lite(&dst->switch2port_xfer_lock, f);
+	rc = dst->switch2port_xfer(dst, mbuf);
+	vmm_spin_unlock_irqrestore_lite(&dst->switch2port_xfer_lock, f);
+
+	return rc;
+}
+
+/* Deliver burst of mbufs to port under single acquisition of
+ * port lock. References of mbufs are consumed.
+ */
+static int switch2port_xfer_burst(struct vmm_netport *dst,
+				  struct vmm_mbuf **mbufs, u32 count)
+{
+	int rc = VMM_OK;
+	u32 i;
+	irq_flags_t f;
+
+	if (!count) {
+		return VMM_OK;
+	}
+
+	vmm_spin_lock_irqsave_lite(&dst->switch2port_xfer_lock, f);
+	if (dst->switch2port_xfer_burst) {
+		rc = dst->switch2port_xfer_burst(dst, mbufs, count);
+	} else {
+		for (i = 0; i < count; i++) {
+			rc = dst->switch2port_xfer(dst, mbufs[i]);
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&dst->switch2port_xfer_lock, f);
+
+	return rc;
+}
 
 int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 			      struct vmm_netport *dst,
@@ -383,6 +663,14 @@ int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 		return VMM_OK;
 	}
 
+	/* Port cannot take the offload info so hand it over
+	 * checksummed and segmented copies instead.
+	 */
+	if (vmm_netoffload_needed(dst, mbuf)) {
+		return vmm_netoffload_resolve(mbuf,
+					      switch2port_xfer_resolved, dst);
+	}
+
 	MADDREFERENCE(mbuf);
 	MCLADDREFERENCE(mbuf);
 
@@ -394,6 +682,56 @@ int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 }
 VMM_EXPORT_SYMBOL(vmm_switch2port_xfer_mbuf);
 
+int vmm_switch2port_xfer_burst(struct vmm_netswitch *nsw,
+			       struct vmm_netport *dst,
+			       struct vmm_mbuf **mbufs, u32 count)
+{
+	int rc = VMM_OK;
+	u32 i, n = 0;
+	struct vmm_mbuf *mbuf, *burst[VMM_NETPORT_MAX_BURST];
+
+	if (!nsw || !dst || !mbufs) {
+		return VMM_EFAIL;
+	}
+
+	/* Print debug info */
+	DPRINTF("%s: nsw=%s dst=%s count=%d\n",
+		__func__, nsw->name, dst->name, count);
+
+	if (dst->can_receive && !dst->can_receive(dst)) {
+		return VMM_OK;
+	}
+
+	for (i = 0; i < count; i++) {
+		mbuf = mbufs[i];
+
+		/* Resolved copies must not overtake earlier packets */
+		if (vmm_netoffload_needed(dst, mbuf)) {
+			rc = switch2port_xfer_burst(dst, burst, n);
+			n = 0;
+			vmm_netoffload_resolve(mbuf,
+					       switch2port_xfer_resolved, dst);
+			continue;
+		}
+
+		MADDREFERENCE(mbuf);
+		MCLADDREFERENCE(mbuf);
+
+		burst[n++] = mbuf;
+		if (n == VMM_NETPORT_MAX_BURST) {
+			rc = switch2port_xfer_burst(dst, burst, n);
+			n = 0;
+		}
+	}
+
+	if (n) {
+		rc = switch2port_xfer_burst(dst, burst, n);
+	}
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_switch2port_xfer_burst);
+
 struct vmm_netswitch *vmm_netswitch_alloc(char *name)
 {
 	struct vmm_netswitch *nsw;
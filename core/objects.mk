@@ -23,6 +23,7 @@
 
 core-objs-y+= vmm_main.o
 core-objs-y+= vmm_heap.o
+core-objs-y+= vmm_slab.o
 core-objs-y+= vmm_stdio.o
 core-objs-y+= vmm_cpumask.o
 core-objs-y+= vmm_devtree.o
@@ -62,5 +63,6 @@ core-objs-y+= vmm_chardev.o
 core-objs-y+= vmm_modules.o
 core-objs-y+= vmm_params.o
 core-objs-$(CONFIG_PROFILE)+= vmm_profiler.o
+core-objs-$(CONFIG_LOCKSTAT)+= vmm_lockstat.o
 core-objs-$(CONFIG_IOMMU)+= vmm_iommu.o
 core-objs-y+= vmm_extable.o
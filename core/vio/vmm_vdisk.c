@@ -67,18 +67,33 @@ int vmm_vdisk_unregister_client(struct vmm_notifier_block *nb)
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_unregister_client);
 
+static void vdisk_submit_deferred(struct vmm_vdisk *vdisk);
+
+static void vdisk_req_done(struct vmm_vdisk *vdisk)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave_lite(&vdisk->inflight_lock, flags);
+	vdisk->inflight--;
+	vmm_spin_unlock_irqrestore_lite(&vdisk->inflight_lock, flags);
+}
+
 static void vdisk_req_completed(struct vmm_request *r)
 {
 	struct vmm_vdisk_request *vreq =
 			container_of(r, struct vmm_vdisk_request, r);
 	struct vmm_vdisk *vdisk = vreq->vdisk;
 
+	vdisk_req_done(vdisk);
+
 	if (vdisk->completed) {
 		vdisk->completed(vdisk, vreq);
 	}
 
 	DPRINTF("%s: vdisk=%s lba=0x%llx bcnt=%d\n",
 		__func__, vdisk->name, (u64)r->lba, r->bcnt);
+
+	vdisk_submit_deferred(vdisk);
 }
 
 static void vdisk_req_failed(struct vmm_request *r)
@@ -87,12 +102,75 @@ static void vdisk_req_failed(struct vmm_request *r)
 			container_of(r, struct vmm_vdisk_request, r);
 	struct vmm_vdisk *vdisk = vreq->vdisk;
 
+	vdisk_req_done(vdisk);
+
 	if (vdisk->failed) {
 		vdisk->failed(vdisk, vreq);
 	}
 
 	DPRINTF("%s: vdisk=%s lba=0x%llx bcnt=%d\n",
 		__func__, vdisk->name, (u64)r->lba, r->bcnt);
+
+	vdisk_submit_deferred(vdisk);
+}
+
+static void vdisk_submit_one(struct vmm_vdisk *vdisk,
+			     struct vmm_vdisk_request *vreq)
+{
+	int rc;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+	if (vdisk->blk) {
+		/* Note: Block device will call failed() on error */
+		rc = vmm_blockdev_submit_request(vdisk->blk, &vreq->r);
+	} else {
+		rc = VMM_ENODEV;
+	}
+	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
+
+	if (rc == VMM_ENODEV) {
+		vdisk_req_failed(&vreq->r);
+	}
+
+	DPRINTF("%s: vdisk=%s lba=0x%llx bcnt=%d rc=%d\n",
+		__func__, vdisk->name, (u64)vreq->r.lba, vreq->r.bcnt, rc);
+}
+
+/* Submit deferred requests till in-flight limit is reached. Only one
+ * context submits at a time so that completions called synchronously
+ * from block device submit path do not recurse back into it.
+ */
+static void vdisk_submit_deferred(struct vmm_vdisk *vdisk)
+{
+	irq_flags_t flags;
+	struct vmm_vdisk_request *vreq;
+
+	vmm_spin_lock_irqsave_lite(&vdisk->inflight_lock, flags);
+
+	if (vdisk->submitting) {
+		vmm_spin_unlock_irqrestore_lite(&vdisk->inflight_lock, flags);
+		return;
+	}
+	vdisk->submitting = TRUE;
+
+	while (!list_empty(&vdisk->deferred_list) &&
+	       (!vdisk->max_inflight ||
+		(vdisk->inflight < vdisk->max_inflight))) {
+		vreq = list_first_entry(&vdisk->deferred_list,
+					struct vmm_vdisk_request, head);
+		list_del(&vreq->head);
+		vdisk->inflight++;
+		vmm_spin_unlock_irqrestore_lite(&vdisk->inflight_lock, flags);
+
+		vdisk_submit_one(vdisk, vreq);
+
+		vmm_spin_lock_irqsave_lite(&vdisk->inflight_lock, flags);
+	}
+
+	vdisk->submitting = FALSE;
+
+	vmm_spin_unlock_irqrestore_lite(&vdisk->inflight_lock, flags);
 }
 
 void vmm_vdisk_set_request_type(struct vmm_vdisk_request *vreq,
@@ -181,7 +259,6 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 			     enum vmm_vdisk_request_type type,
 			     u64 lba, void *data, u32 data_len)
 {
-	int rc;
 	irq_flags_t flags;
 
 	if (!vdisk || !vreq || !data) {
@@ -196,37 +273,34 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 	}
 
 	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
-	if (vdisk->blk) {
-		vreq->vdisk = vdisk;
-		switch (type) {
-		case VMM_VDISK_REQUEST_READ:
-			vreq->r.type = VMM_REQUEST_READ;
-			break;
-		case VMM_VDISK_REQUEST_WRITE:
-			vreq->r.type = VMM_REQUEST_WRITE;
-			break;
-		default:
-			vreq->r.type = VMM_REQUEST_UNKNOWN;
-			break;
-		};
-		vreq->r.lba = lba * vdisk->blk_factor;
-		vreq->r.bcnt =
-			udiv32(data_len, vdisk->block_size) * vdisk->blk_factor;
-		vreq->r.data = data;
-		vreq->r.completed = vdisk_req_completed;
-		vreq->r.failed = vdisk_req_failed;
-		vreq->r.priv = NULL;
-		rc = vmm_blockdev_submit_request(vdisk->blk, &vreq->r);
-	} else {
-		vdisk->failed(vdisk, vreq);
-		rc = VMM_ENODEV;
-	}
+	vreq->vdisk = vdisk;
+	switch (type) {
+	case VMM_VDISK_REQUEST_READ:
+		vreq->r.type = VMM_REQUEST_READ;
+		break;
+	case VMM_VDISK_REQUEST_WRITE:
+		vreq->r.type = VMM_REQUEST_WRITE;
+		break;
+	default:
+		vreq->r.type = VMM_REQUEST_UNKNOWN;
+		break;
+	};
+	vreq->r.lba = lba * vdisk->blk_factor;
+	vreq->r.bcnt =
+		udiv32(data_len, vdisk->block_size) * vdisk->blk_factor;
+	vreq->r.data = data;
+	vreq->r.completed = vdisk_req_completed;
+	vreq->r.failed = vdisk_req_failed;
+	vreq->r.priv = NULL;
 	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
 
-	DPRINTF("%s: vdisk=%s lba=0x%llx bcnt=%d rc=%d\n",
-		__func__, vdisk->name, (u64)vreq->r.lba, vreq->r.bcnt, rc);
+	vmm_spin_lock_irqsave_lite(&vdisk->inflight_lock, flags);
+	list_add_tail(&vreq->head, &vdisk->deferred_list);
+	vmm_spin_unlock_irqrestore_lite(&vdisk->inflight_lock, flags);
 
-	return rc;
+	vdisk_submit_deferred(vdisk);
+
+	return VMM_OK;
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_submit_request);
 
@@ -234,7 +308,9 @@ int vmm_vdisk_abort_request(struct vmm_vdisk *vdisk,
 			    struct vmm_vdisk_request *vreq)
 {
 	int rc;
+	bool found = FALSE;
 	irq_flags_t flags;
+	struct vmm_vdisk_request *dreq;
 
 	if (!vdisk || !vreq) {
 		return VMM_EINVALID;
@@ -243,6 +319,22 @@ int vmm_vdisk_abort_request(struct vmm_vdisk *vdisk,
 		return VMM_EINVALID;
 	}
 
+	/* Deferred requests never reached block device */
+	vmm_spin_lock_irqsave_lite(&vdisk->inflight_lock, flags);
+	list_for_each_entry(dreq, &vdisk->deferred_list, head) {
+		if (dreq == vreq) {
+			list_del(&vreq->head);
+			found = TRUE;
+			break;
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&vdisk->inflight_lock, flags);
+
+	if (found) {
+		vdisk->failed(vdisk, vreq);
+		return VMM_OK;
+	}
+
 	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
 	if (vdisk->blk) {
 		rc = vmm_blockdev_abort_request(&vreq->r);
@@ -282,6 +374,31 @@ int vmm_vdisk_flush_cache(struct vmm_vdisk *vdisk)
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_flush_cache);
 
+u32 vmm_vdisk_get_max_inflight(struct vmm_vdisk *vdisk)
+{
+	return (vdisk) ? vdisk->max_inflight : 0;
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_get_max_inflight);
+
+int vmm_vdisk_set_max_inflight(struct vmm_vdisk *vdisk, u32 max_inflight)
+{
+	irq_flags_t flags;
+
+	if (!vdisk) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave_lite(&vdisk->inflight_lock, flags);
+	vdisk->max_inflight = max_inflight;
+	vmm_spin_unlock_irqrestore_lite(&vdisk->inflight_lock, flags);
+
+	/* Higher limit may allow deferred requests to proceed */
+	vdisk_submit_deferred(vdisk);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_set_max_inflight);
+
 u64 vmm_vdisk_capacity(struct vmm_vdisk *vdisk)
 {
 	u64 ret = 0;
@@ -453,6 +570,11 @@ struct vmm_vdisk *vmm_vdisk_create(const char *name, u32 block_size,
 	INIT_SPIN_LOCK(&vdisk->blk_lock);
 	vdisk->blk = NULL;
 	vdisk->blk_factor = 1;
+	INIT_SPIN_LOCK(&vdisk->inflight_lock);
+	vdisk->max_inflight = 0;
+	vdisk->inflight = 0;
+	vdisk->submitting = FALSE;
+	INIT_LIST_HEAD(&vdisk->deferred_list);
 	vdisk->priv = priv;
 
 	list_add_tail(&vdisk->head, &vdctrl.vdisk_list);
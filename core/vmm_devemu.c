@@ -29,6 +29,14 @@
 #include <vmm_mutex.h>
 #include <vmm_guest_aspace.h>
 #include <vmm_devemu.h>
+#ifdef CONFIG_DEVEMU_STATS
+#include <vmm_timer.h>
+#include <vmm_percpu.h>
+#include <vmm_cpumask.h>
+#include <vmm_host_aspace.h>
+#include <arch_cpu_irq.h>
+#include <arch_barrier.h>
+#endif
 #include <libs/stringlib.h>
 
 struct vmm_devemu_guest_irq {
@@ -46,10 +54,181 @@ struct vmm_devemu_ctrl {
 	enum vmm_devemu_endianness host_endian;
 	struct vmm_mutex emu_lock;
         struct dlist emu_list;
+	struct vmm_mutex edev_lock;
+	struct dlist edev_list;
+#ifdef CONFIG_DEVEMU_STATS
+	bool trace_active;
+	u32 trace_max;
+	u32 trace_page_count;
+#endif
 };
 
 static struct vmm_devemu_ctrl dectrl;
 
+#ifdef CONFIG_DEVEMU_STATS
+
+/** Per host CPU trace ring
+ *  Entries are written only by emulated accesses on owning host CPU
+ *  with interrupts disabled. The head is the slot of next entry and
+ *  total is the number of entries recorded since trace start.
+ */
+struct vmm_devemu_trace_cpu {
+	struct vmm_devemu_trace_entry *entries;
+	u32 head;
+	u64 total;
+};
+
+static DEFINE_PER_CPU(struct vmm_devemu_trace_cpu, dtrace);
+
+static void devemu_trace_record(struct vmm_vcpu *vcpu,
+				physical_addr_t gphys_addr,
+				void *data, u32 len, u32 flags,
+				u64 tstamp, u64 nsecs)
+{
+	irq_flags_t f;
+	struct vmm_devemu_trace_cpu *t;
+	struct vmm_devemu_trace_entry *e;
+
+	if (!dectrl.trace_active) {
+		return;
+	}
+
+	arch_cpu_irq_save(f);
+
+	t = &this_cpu(dtrace);
+	if (t->entries) {
+		e = &t->entries[t->head];
+		e->timestamp = tstamp;
+		e->gphys_addr = gphys_addr;
+		e->value = 0;
+		if (!(flags & VMM_DEVEMU_TRACE_ERROR) &&
+		    (len <= sizeof(e->value))) {
+			memcpy(&e->value, data, len);
+		}
+		e->nsecs = (nsecs < 0xffffffffULL) ? nsecs : 0xffffffff;
+		e->vcpu_id = vcpu->id;
+		e->len = len;
+		e->flags = flags;
+
+		/* Publish entry only after it is completely written */
+		arch_smp_wmb();
+		t->head = (t->head + 1 < dectrl.trace_max) ? t->head + 1 : 0;
+		t->total++;
+	}
+
+	arch_cpu_irq_restore(f);
+}
+
+static struct vmm_devemu_offset_stats *devemu_stats_offset(
+					struct vmm_devemu_stats *s,
+					physical_addr_t offset)
+{
+	u32 i, idx;
+	struct vmm_devemu_offset_stats *o;
+
+	idx = ((u32)offset * 0x9E3779B1) >>
+				(32 - VMM_DEVEMU_STATS_OFFSETS_SHIFT);
+	for (i = 0; i < VMM_DEVEMU_STATS_OFFSETS; i++) {
+		o = &s->offsets[(idx + i) & (VMM_DEVEMU_STATS_OFFSETS - 1)];
+		if (!o->reads && !o->writes) {
+			o->offset = offset;
+			s->offset_count++;
+			return o;
+		}
+		if (o->offset == offset) {
+			return o;
+		}
+	}
+
+	return NULL;
+}
+
+static inline u64 devemu_stats_timestamp(void)
+{
+	return vmm_timer_timestamp();
+}
+
+static void devemu_stats_account(struct vmm_vcpu *vcpu,
+				 struct vmm_region *reg,
+				 physical_addr_t gphys_addr,
+				 void *data, u32 len, u32 flags,
+				 u64 tstamp, int rc)
+{
+	u32 b;
+	u64 nsecs, tmp;
+	irq_flags_t f;
+	struct vmm_emudev *edev;
+	struct vmm_devemu_stats *s;
+	struct vmm_devemu_access_stats *a;
+	struct vmm_devemu_offset_stats *o;
+
+	nsecs = vmm_timer_timestamp() - tstamp;
+	if (rc) {
+		flags |= VMM_DEVEMU_TRACE_ERROR;
+	}
+
+	devemu_trace_record(vcpu, gphys_addr, data, len, flags,
+			    tstamp, nsecs);
+
+	edev = (reg) ? reg->devemu_priv : NULL;
+	if (!edev) {
+		return;
+	}
+
+	b = 0;
+	tmp = nsecs >> VMM_DEVEMU_STATS_HIST_SHIFT;
+	while (tmp && (b < (VMM_DEVEMU_STATS_HIST_BUCKETS - 1))) {
+		tmp >>= 1;
+		b++;
+	}
+
+	s = &edev->stats;
+
+	vmm_spin_lock_irqsave_lite(&edev->stats_lock, f);
+
+	a = (flags & VMM_DEVEMU_TRACE_WRITE) ? &s->write : &s->read;
+	a->count++;
+	if (rc) {
+		a->errors++;
+	}
+	a->total_nsecs += nsecs;
+	if (a->max_nsecs < nsecs) {
+		a->max_nsecs = nsecs;
+	}
+	a->hist[b]++;
+
+	o = devemu_stats_offset(s, gphys_addr - reg->gphys_addr);
+	if (o) {
+		if (flags & VMM_DEVEMU_TRACE_WRITE) {
+			o->writes++;
+		} else {
+			o->reads++;
+		}
+		o->total_nsecs += nsecs;
+	} else {
+		s->offset_overflow++;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&edev->stats_lock, f);
+}
+
+#else
+
+static inline u64 devemu_stats_timestamp(void)
+{
+	return 0;
+}
+
+static inline void devemu_stats_account(struct vmm_vcpu *vcpu,
+					struct vmm_region *reg,
+					physical_addr_t gphys_addr,
+					void *data, u32 len, u32 flags,
+					u64 tstamp, int rc)
+{
+}
+
+#endif
+
 static int devemu_doread(struct vmm_emudev *edev,
 			 physical_addr_t offset,
 			 void *dst, u32 dst_len,
@@ -342,13 +521,16 @@ int vmm_devemu_emulate_read(struct vmm_vcpu *vcpu,
 			    enum vmm_devemu_endianness dst_endian)
 {
 	int rc;
+	u64 tstamp;
 	struct vmm_region *reg;
 
 	if (!vcpu || !vcpu->guest) {
 		return VMM_EFAIL;
 	}
 
-	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
+	tstamp = devemu_stats_timestamp();
+
+	reg = vmm_vcpu_find_region(vcpu, gphys_addr,
 			VMM_REGION_VIRTUAL | VMM_REGION_MEMORY, FALSE);
 	if (!reg) {
 		rc = VMM_ENOTAVAIL;
@@ -359,6 +541,9 @@ int vmm_devemu_emulate_read(struct vmm_vcpu *vcpu,
 			   gphys_addr - reg->gphys_addr,
 			   dst, dst_len, dst_endian);
 skip:
+	devemu_stats_account(vcpu, reg, gphys_addr, dst, dst_len,
+			     0, tstamp, rc);
+
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%llx dst_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -375,13 +560,16 @@ int vmm_devemu_emulate_write(struct vmm_vcpu *vcpu,
 			     enum vmm_devemu_endianness src_endian)
 {
 	int rc;
+	u64 tstamp;
 	struct vmm_region *reg;
 
 	if (!vcpu || !vcpu->guest) {
 		return VMM_EFAIL;
 	}
 
-	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
+	tstamp = devemu_stats_timestamp();
+
+	reg = vmm_vcpu_find_region(vcpu, gphys_addr,
 			VMM_REGION_VIRTUAL | VMM_REGION_MEMORY, FALSE);
 	if (!reg) {
 		rc = VMM_ENOTAVAIL;
@@ -392,6 +580,9 @@ int vmm_devemu_emulate_write(struct vmm_vcpu *vcpu,
 			    gphys_addr - reg->gphys_addr,
 			    src, src_len, src_endian);
 skip:
+	devemu_stats_account(vcpu, reg, gphys_addr, src, src_len,
+			     VMM_DEVEMU_TRACE_WRITE, tstamp, rc);
+
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%llx src_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -408,13 +599,16 @@ int vmm_devemu_emulate_ioread(struct vmm_vcpu *vcpu,
 			      enum vmm_devemu_endianness dst_endian)
 {
 	int rc;
+	u64 tstamp;
 	struct vmm_region *reg;
 
 	if (!vcpu || !vcpu->guest) {
 		return VMM_EFAIL;
 	}
 
-	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
+	tstamp = devemu_stats_timestamp();
+
+	reg = vmm_vcpu_find_region(vcpu, gphys_addr,
 			VMM_REGION_VIRTUAL | VMM_REGION_IO, FALSE);
 	if (!reg) {
 		rc = VMM_ENOTAVAIL;
@@ -425,6 +619,9 @@ int vmm_devemu_emulate_ioread(struct vmm_vcpu *vcpu,
 			   gphys_addr - reg->gphys_addr,
 			   dst, dst_len, dst_endian);
 skip:
+	devemu_stats_account(vcpu, reg, gphys_addr, dst, dst_len,
+			     VMM_DEVEMU_TRACE_IO, tstamp, rc);
+
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%llx dst_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -441,13 +638,16 @@ int vmm_devemu_emulate_iowrite(struct vmm_vcpu *vcpu,
 			       enum vmm_devemu_endianness src_endian)
 {
 	int rc;
+	u64 tstamp;
 	struct vmm_region *reg;
 
 	if (!vcpu || !vcpu->guest) {
 		return VMM_EFAIL;
 	}
 
-	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
+	tstamp = devemu_stats_timestamp();
+
+	reg = vmm_vcpu_find_region(vcpu, gphys_addr,
 			VMM_REGION_VIRTUAL | VMM_REGION_IO, FALSE);
 	if (!reg) {
 		rc = VMM_ENOTAVAIL;
@@ -458,6 +658,10 @@ int vmm_devemu_emulate_iowrite(struct vmm_vcpu *vcpu,
 			    gphys_addr - reg->gphys_addr,
 			    src, src_len, src_endian);
 skip:
+	devemu_stats_account(vcpu, reg, gphys_addr, src, src_len,
+			     VMM_DEVEMU_TRACE_WRITE | VMM_DEVEMU_TRACE_IO,
+			     tstamp, rc);
+
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%llx src_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -791,6 +995,174 @@ u32 vmm_devemu_emulator_count(void)
 	return retval;
 }
 
+int vmm_devemu_iterate_emudev(int (*iter)(struct vmm_emudev *, void *),
+			      void *priv)
+{
+	int rc = VMM_OK;
+	struct vmm_emudev *edev;
+
+	if (!iter) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&dectrl.edev_lock);
+
+	list_for_each_entry(edev, &dectrl.edev_list, head) {
+		rc = iter(edev, priv);
+		if (rc) {
+			break;
+		}
+	}
+
+	vmm_mutex_unlock(&dectrl.edev_lock);
+
+	return rc;
+}
+
+#ifdef CONFIG_DEVEMU_STATS
+
+int vmm_devemu_stats_get(struct vmm_emudev *edev,
+			 struct vmm_devemu_stats *stats)
+{
+	irq_flags_t f;
+
+	if (!edev || !stats) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave_lite(&edev->stats_lock, f);
+	memcpy(stats, &edev->stats, sizeof(*stats));
+	vmm_spin_unlock_irqrestore_lite(&edev->stats_lock, f);
+
+	return VMM_OK;
+}
+
+int vmm_devemu_stats_clear(struct vmm_emudev *edev)
+{
+	irq_flags_t f;
+
+	if (!edev) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave_lite(&edev->stats_lock, f);
+	memset(&edev->stats, 0, sizeof(edev->stats));
+	vmm_spin_unlock_irqrestore_lite(&edev->stats_lock, f);
+
+	return VMM_OK;
+}
+
+bool vmm_devemu_trace_isactive(void)
+{
+	return dectrl.trace_active;
+}
+
+int vmm_devemu_trace_start(void)
+{
+	u32 cpu;
+	struct vmm_devemu_trace_cpu *t;
+
+	if (vmm_devemu_trace_isactive()) {
+		return VMM_EBUSY;
+	}
+
+	/* Trace buffers are allocated on first use and never freed */
+	for_each_online_cpu(cpu) {
+		t = &per_cpu(dtrace, cpu);
+		t->head = 0;
+		t->total = 0;
+		if (t->entries) {
+			continue;
+		}
+		t->entries = (struct vmm_devemu_trace_entry *)
+			vmm_host_alloc_pages(dectrl.trace_page_count,
+					     VMM_MEMORY_FLAGS_NORMAL);
+		if (!t->entries) {
+			return VMM_ENOMEM;
+		}
+	}
+
+	arch_smp_wmb();
+	dectrl.trace_active = TRUE;
+
+	return VMM_OK;
+}
+
+int vmm_devemu_trace_stop(void)
+{
+	if (!vmm_devemu_trace_isactive()) {
+		return VMM_EFAIL;
+	}
+
+	dectrl.trace_active = FALSE;
+	arch_smp_wmb();
+
+	return VMM_OK;
+}
+
+u32 vmm_devemu_trace_max_entries(void)
+{
+	return dectrl.trace_max;
+}
+
+u32 vmm_devemu_trace_count(u32 cpu)
+{
+	u64 total;
+	struct vmm_devemu_trace_cpu *t;
+
+	if (CONFIG_CPU_COUNT <= cpu) {
+		return 0;
+	}
+
+	t = &per_cpu(dtrace, cpu);
+	total = (t->entries) ? t->total : 0;
+	arch_smp_rmb();
+
+	return (total < dectrl.trace_max) ? (u32)total : dectrl.trace_max;
+}
+
+u64 vmm_devemu_trace_lost(u32 cpu)
+{
+	u64 total;
+
+	if (CONFIG_CPU_COUNT <= cpu) {
+		return 0;
+	}
+
+	total = per_cpu(dtrace, cpu).total;
+
+	return (total > dectrl.trace_max) ? total - dectrl.trace_max : 0;
+}
+
+int vmm_devemu_trace_entry(u32 cpu, u32 index,
+			   struct vmm_devemu_trace_entry *entry)
+{
+	u32 count, pos;
+	struct vmm_devemu_trace_cpu *t;
+
+	if (!entry) {
+		return VMM_EINVALID;
+	}
+
+	count = vmm_devemu_trace_count(cpu);
+	if (count <= index) {
+		return VMM_ENOTAVAIL;
+	}
+
+	/* Oldest entry is at head once the ring has wrapped */
+	t = &per_cpu(dtrace, cpu);
+	pos = (count < dectrl.trace_max) ? 0 : t->head;
+	pos += index;
+	if (dectrl.trace_max <= pos) {
+		pos -= dectrl.trace_max;
+	}
+	memcpy(entry, &t->entries[pos], sizeof(*entry));
+
+	return VMM_OK;
+}
+
+#endif
+
 int vmm_devemu_reset_context(struct vmm_guest *guest)
 {
 	if (!guest) {
@@ -855,7 +1227,11 @@ int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg)
 			vmm_mutex_unlock(&dectrl.emu_lock);
 			return VMM_ENOMEM;
 		}
+		INIT_LIST_HEAD(&einst->head);
 		INIT_SPIN_LOCK(&einst->lock);
+#ifdef CONFIG_DEVEMU_STATS
+		INIT_SPIN_LOCK(&einst->stats_lock);
+#endif
 		vmm_devtree_ref_node(reg->node);
 		einst->node = reg->node;
 		einst->reg = reg;
@@ -885,6 +1261,9 @@ int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg)
 			reg->devemu_priv = NULL;
 			return rc;
 		}
+		vmm_mutex_lock(&dectrl.edev_lock);
+		list_add_tail(&einst->head, &dectrl.edev_list);
+		vmm_mutex_unlock(&dectrl.edev_lock);
 		vmm_mutex_lock(&dectrl.emu_lock);
 		break;
 	}
@@ -917,9 +1296,13 @@ int vmm_devemu_remove_region(struct vmm_guest *guest, struct vmm_region *reg)
 	if (reg->devemu_priv) {
 		einst = reg->devemu_priv;
 
+		vmm_mutex_lock(&dectrl.edev_lock);
 		if ((rc = einst->emu->remove(einst))) {
+			vmm_mutex_unlock(&dectrl.edev_lock);
 			return rc;
 		}
+		list_del(&einst->head);
+		vmm_mutex_unlock(&dectrl.edev_lock);
 
 		vmm_devtree_dref_node(einst->node);
 		einst->node = NULL;
@@ -1006,6 +1389,11 @@ int vmm_devemu_deinit_context(struct vmm_guest *guest)
 
 int __init vmm_devemu_init(void)
 {
+#ifdef CONFIG_DEVEMU_STATS
+	u32 cpu;
+	struct vmm_devemu_trace_cpu *t;
+#endif
+
 	memset(&dectrl, 0, sizeof(dectrl));
 
 #ifdef CONFIG_CPU_BE
@@ -1016,6 +1404,23 @@ int __init vmm_devemu_init(void)
 
 	INIT_MUTEX(&dectrl.emu_lock);
 	INIT_LIST_HEAD(&dectrl.emu_list);
+	INIT_MUTEX(&dectrl.edev_lock);
+	INIT_LIST_HEAD(&dectrl.edev_list);
+
+#ifdef CONFIG_DEVEMU_STATS
+	dectrl.trace_active = FALSE;
+	dectrl.trace_page_count = VMM_SIZE_TO_PAGE(CONFIG_DEVEMU_TRACE_ENTRIES *
+				sizeof(struct vmm_devemu_trace_entry));
+	dectrl.trace_max = (dectrl.trace_page_count * VMM_PAGE_SIZE) /
+				sizeof(struct vmm_devemu_trace_entry);
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		t = &per_cpu(dtrace, cpu);
+		t->entries = NULL;
+		t->head = 0;
+		t->total = 0;
+	}
+#endif
 
 	return VMM_OK;
 }
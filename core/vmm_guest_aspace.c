@@ -27,6 +27,7 @@
 
 #include <vmm_error.h>
 #include <vmm_heap.h>
+#include <vmm_mutex.h>
 #include <vmm_devtree.h>
 #include <vmm_devemu.h>
 #include <vmm_host_ram.h>
@@ -35,9 +36,11 @@
 #include <vmm_stdio.h>
 #include <vmm_notifier.h>
 #include <arch_guest.h>
+#include <libs/bitmap.h>
 #include <libs/stringlib.h>
 
 static BLOCKING_NOTIFIER_CHAIN(guest_aspace_notifier_chain);
+static DEFINE_MUTEX(guest_balloon_lock);
 
 int vmm_guest_aspace_register_client(struct vmm_notifier_block *nb)
 {
@@ -151,80 +154,531 @@ done:
 	return reg;
 }
 
-u32 vmm_guest_memory_read(struct vmm_guest *guest, 
-			  physical_addr_t gphys_addr, 
-			  void *dst, u32 len, bool cacheable)
+/*
+ * Each VCPU caches last few region lookups done by it. The cache is
+ * only accessed from the context of its VCPU so it does not need any
+ * lock. Entries are dropped whenever generation counter of guest
+ * address space changes (i.e. a region was added or deleted).
+ */
+struct vmm_region *vmm_vcpu_find_region(struct vmm_vcpu *vcpu,
+					physical_addr_t gphys_addr,
+					u32 reg_flags, bool resolve_alias)
 {
-	u32 bytes_read = 0, to_read;
-	physical_addr_t hphys_addr;
-	struct vmm_region *reg = NULL;
+	u32 i, gen;
+	struct vmm_region *reg;
+	struct vmm_vcpu_region_cache *c;
+	struct vmm_vcpu_region_cache_entry *e;
 
-	if (!guest || !guest->aspace.initialized || !dst || !len) {
-		return 0;
+	if (!vcpu || !vcpu->guest) {
+		return NULL;
+	}
+	if (!vcpu->guest->aspace.initialized) {
+		return NULL;
 	}
+	c = &vcpu->reg_cache;
 
-	while (bytes_read < len) {
-		reg = vmm_guest_find_region(guest, gphys_addr, 
-				VMM_REGION_REAL | VMM_REGION_MEMORY, TRUE);
+	gen = arch_atomic_read(&vcpu->guest->aspace.reg_gen);
+	if (c->gen != gen) {
+		vmm_vcpu_region_cache_flush(vcpu);
+		c->gen = gen;
+	}
+
+	for (i = 0; i < CONFIG_VGPA2REG_CACHE_SIZE; i++) {
+		e = &c->ent[i];
+		if (e->reg &&
+		    (e->gphys_start <= gphys_addr) &&
+		    (gphys_addr < e->gphys_end) &&
+		    (e->reg_flags == reg_flags) &&
+		    (e->resolve_alias == resolve_alias)) {
+			return e->reg;
+		}
+	}
+
+	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
+				    reg_flags, resolve_alias);
+
+	/* Only cache regions which contain the looked-up address
+	 * because resolved alias regions cover different addresses.
+	 */
+	if (reg &&
+	    (VMM_REGION_GPHYS_START(reg) <= gphys_addr) &&
+	    (gphys_addr < VMM_REGION_GPHYS_END(reg))) {
+		e = &c->ent[c->victim];
+		e->gphys_start = VMM_REGION_GPHYS_START(reg);
+		e->gphys_end = VMM_REGION_GPHYS_END(reg);
+		e->reg_flags = reg_flags;
+		e->resolve_alias = resolve_alias;
+		e->reg = reg;
+		c->victim++;
+		if (c->victim == CONFIG_VGPA2REG_CACHE_SIZE) {
+			c->victim = 0;
+		}
+	}
+
+	return reg;
+}
+
+void vmm_vcpu_region_cache_flush(struct vmm_vcpu *vcpu)
+{
+	u32 i;
+
+	if (!vcpu) {
+		return;
+	}
+
+	for (i = 0; i < CONFIG_VGPA2REG_CACHE_SIZE; i++) {
+		vcpu->reg_cache.ent[i].reg = NULL;
+	}
+	vcpu->reg_cache.victim = 0;
+}
+
+/* Get host physical address of a chunk of demand allocated region
+ * and allocate the chunk on first access when populate is TRUE. With
+ * pin == TRUE a populated chunk is also pinned so that it is not
+ * released till region_demand_unpin() is called.
+ */
+static int region_demand_chunk(struct vmm_region *reg, u32 chunk,
+			       bool populate, bool pin,
+			       physical_addr_t *hphys_addr)
+{
+	irq_flags_t flags;
+	physical_addr_t pa, cur;
+	physical_size_t chunk_size = (physical_size_t)1 << reg->demand_order;
+
+	vmm_spin_lock_irqsave_lite(&reg->demand_lock, flags);
+	pa = reg->demand_map[chunk];
+	if (pa && pin) {
+		reg->demand_pins[chunk]++;
+	}
+	if (pa && populate) {
+		/* Chunk is used again so forget deferred release */
+		__clear_bit(chunk, reg->demand_deferred);
+	}
+	vmm_spin_unlock_irqrestore_lite(&reg->demand_lock, flags);
+	if (pa || !populate) {
+		*hphys_addr = pa;
+		return (pa) ? VMM_OK : VMM_ENOENT;
+	}
+
+	/* Allocate and clear chunk without holding demand lock */
+	if (!vmm_host_ram_alloc(&pa, chunk_size, reg->demand_order)) {
+		return VMM_ENOMEM;
+	}
+	vmm_host_memory_set(pa, 0, chunk_size, FALSE);
+
+	/* Somebody else might have populated the chunk meanwhile */
+	vmm_spin_lock_irqsave_lite(&reg->demand_lock, flags);
+	cur = reg->demand_map[chunk];
+	if (!cur) {
+		reg->demand_map[chunk] = pa;
+		reg->demand_resident++;
+	}
+	if (pin) {
+		reg->demand_pins[chunk]++;
+	}
+	__clear_bit(chunk, reg->demand_deferred);
+	vmm_spin_unlock_irqrestore_lite(&reg->demand_lock, flags);
+
+	if (cur) {
+		vmm_host_ram_free(pa, chunk_size);
+		pa = cur;
+	}
+
+	*hphys_addr = pa;
+
+	return VMM_OK;
+}
+
+/* Translate guest physical address within a real region to host
+ * physical address. The avail_size is the number of bytes contiguous
+ * in host physical address space starting from returned address.
+ */
+static int region_gphys_to_hphys(struct vmm_region *reg,
+				 physical_addr_t gphys_addr,
+				 bool populate, bool pin,
+				 physical_addr_t *hphys_addr,
+				 physical_size_t *avail_size)
+{
+	int rc;
+	physical_addr_t pa, off, chunk_mask;
+
+	if (!(reg->flags & VMM_REGION_ISDEMAND)) {
+		*hphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr);
+		*avail_size = VMM_REGION_GPHYS_END(reg) - gphys_addr;
+		return VMM_OK;
+	}
+
+	off = gphys_addr - reg->gphys_addr;
+	chunk_mask = ((physical_addr_t)1 << reg->demand_order) - 1;
+	rc = region_demand_chunk(reg, off >> reg->demand_order,
+				 populate, pin, &pa);
+	*avail_size = (chunk_mask + 1) - (off & chunk_mask);
+	if (rc) {
+		return rc;
+	}
+
+	*hphys_addr = pa + (off & chunk_mask);
+
+	return VMM_OK;
+}
+
+/* Free all populated chunks of demand allocated region */
+static void region_demand_free(struct vmm_region *reg)
+{
+	u32 i, count;
+	physical_size_t chunk_size = (physical_size_t)1 << reg->demand_order;
+
+	if (!reg->demand_map) {
+		return;
+	}
+
+	count = reg->phys_size >> reg->demand_order;
+	for (i = 0; i < count; i++) {
+		if (reg->demand_map[i]) {
+			vmm_host_ram_free(reg->demand_map[i], chunk_size);
+			reg->demand_map[i] = 0;
+		}
+	}
+	reg->demand_resident = 0;
+
+	vmm_free(reg->demand_discard);
+	reg->demand_discard = NULL;
+	vmm_free(reg->demand_deferred);
+	reg->demand_deferred = NULL;
+	vmm_free(reg->demand_pins);
+	reg->demand_pins = NULL;
+	vmm_free(reg->demand_map);
+	reg->demand_map = NULL;
+}
+
+/* Release host RAM of a populated chunk of demand allocated region.
+ * The chunk is unmapped from guest before and after dropping it from
+ * chunk map so that a racing guest fault can't keep using it. A chunk
+ * pinned by host mappings or in-flight copies is only marked and gets
+ * released when last pin is dropped.
+ */
+static int region_demand_release(struct vmm_guest *guest,
+				 struct vmm_region *reg, u32 chunk)
+{
+	int rc;
+	irq_flags_t flags;
+	physical_addr_t pa, gpa;
+	physical_size_t chunk_size = (physical_size_t)1 << reg->demand_order;
+
+	gpa = reg->gphys_addr + ((physical_addr_t)chunk << reg->demand_order);
+
+	rc = arch_guest_unmap_memory(guest, gpa, chunk_size);
+	if (rc) {
+		return rc;
+	}
+
+	vmm_spin_lock_irqsave_lite(&reg->demand_lock, flags);
+	pa = reg->demand_map[chunk];
+	if (pa && reg->demand_pins[chunk]) {
+		__set_bit(chunk, reg->demand_deferred);
+		rc = VMM_EBUSY;
+	} else if (pa) {
+		reg->demand_map[chunk] = 0;
+		reg->demand_resident--;
+		__clear_bit(chunk, reg->demand_deferred);
+	} else {
+		rc = VMM_ENOENT;
+	}
+	vmm_spin_unlock_irqrestore_lite(&reg->demand_lock, flags);
+
+	if (rc) {
+		return rc;
+	}
+
+	arch_guest_unmap_memory(guest, gpa, chunk_size);
+	vmm_host_ram_free(pa, chunk_size);
+
+	return VMM_OK;
+}
+
+/* Drop pin of chunk having given guest physical address and do the
+ * release deferred by region_demand_release() if this was last pin.
+ */
+static void region_demand_unpin(struct vmm_guest *guest,
+				struct vmm_region *reg,
+				physical_addr_t gphys_addr)
+{
+	u32 chunk;
+	bool release;
+	irq_flags_t flags;
+
+	chunk = (gphys_addr - reg->gphys_addr) >> reg->demand_order;
+
+	vmm_spin_lock_irqsave_lite(&reg->demand_lock, flags);
+	if (reg->demand_pins[chunk]) {
+		reg->demand_pins[chunk]--;
+	}
+	release = (!reg->demand_pins[chunk] &&
+		   test_bit(chunk, reg->demand_deferred)) ? TRUE : FALSE;
+	vmm_spin_unlock_irqrestore_lite(&reg->demand_lock, flags);
+
+	if (release) {
+		region_demand_release(guest, reg, chunk);
+	}
+}
+
+/* Discard guest pages of demand allocated region in [start, end)
+ * and release host RAM of chunks without any page in use. With
+ * track == FALSE the pages are not remembered so only chunks fully
+ * covered by [start, end) are released.
+ */
+static physical_size_t region_demand_discard(struct vmm_guest *guest,
+					     struct vmm_region *reg,
+					     physical_addr_t start,
+					     physical_addr_t end,
+					     bool track)
+{
+	bool release;
+	irq_flags_t flags;
+	u32 chunk, first, last, pg, pg_end;
+	physical_size_t ret = 0;
+	physical_addr_t off_start, off_end;
+	u32 chunk_pages = 1 << (reg->demand_order - VMM_PAGE_SHIFT);
+
+	off_start = start - reg->gphys_addr;
+	off_end = end - reg->gphys_addr;
+	first = off_start >> reg->demand_order;
+	last = (off_end + ((physical_addr_t)1 << reg->demand_order) - 1) >>
+							reg->demand_order;
+
+	if (track) {
+		vmm_spin_lock_irqsave_lite(&reg->demand_lock, flags);
+		bitmap_set(reg->demand_discard, off_start >> VMM_PAGE_SHIFT,
+			   (off_end - off_start) >> VMM_PAGE_SHIFT);
+		vmm_spin_unlock_irqrestore_lite(&reg->demand_lock, flags);
+	}
+
+	for (chunk = first; chunk < last; chunk++) {
+		pg = chunk * chunk_pages;
+		pg_end = pg + chunk_pages;
+		if (track) {
+			vmm_spin_lock_irqsave_lite(&reg->demand_lock, flags);
+			release = (find_next_zero_bit(reg->demand_discard,
+						pg_end, pg) >= pg_end) ?
+						TRUE : FALSE;
+			vmm_spin_unlock_irqrestore_lite(&reg->demand_lock,
+							flags);
+		} else {
+			release = ((off_start >> VMM_PAGE_SHIFT) <= pg) &&
+				  (pg_end <= (off_end >> VMM_PAGE_SHIFT));
+		}
+		if (release &&
+		    (region_demand_release(guest, reg, chunk) == VMM_OK)) {
+			ret += (physical_size_t)1 << reg->demand_order;
+		}
+	}
+
+	return ret;
+}
+
+static physical_size_t guest_demand_discard(struct vmm_guest *guest,
+					    physical_addr_t gphys_addr,
+					    physical_size_t gphys_size,
+					    bool track)
+{
+	struct vmm_region *reg;
+	physical_size_t ret = 0;
+	physical_addr_t start, end;
+
+	gphys_size += gphys_addr & VMM_PAGE_MASK;
+	gphys_addr &= ~(physical_addr_t)VMM_PAGE_MASK;
+	gphys_size &= ~(physical_size_t)VMM_PAGE_MASK;
+
+	while (gphys_size) {
+		reg = vmm_guest_find_region(guest, gphys_addr,
+					    VMM_REGION_MEMORY, FALSE);
 		if (!reg) {
-			break;
+			gphys_addr += VMM_PAGE_SIZE;
+			gphys_size -= VMM_PAGE_SIZE;
+			continue;
 		}
 
-		hphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr);
-		to_read = (reg->gphys_addr + reg->phys_size - gphys_addr);
-		to_read = ((len - bytes_read) < to_read) ? 
-			  (len - bytes_read) : to_read;
+		start = gphys_addr;
+		end = VMM_REGION_GPHYS_END(reg);
+		if ((gphys_addr + gphys_size) < end) {
+			end = gphys_addr + gphys_size;
+		}
 
-		to_read = vmm_host_memory_read(hphys_addr,
-					       dst, to_read, cacheable);
-		if (!to_read) {
-			break;
+		if (reg->flags & VMM_REGION_ISDEMAND) {
+			ret += region_demand_discard(guest, reg,
+						     start, end, track);
 		}
 
-		gphys_addr += to_read;
-		bytes_read += to_read;
-		dst += to_read;
+		gphys_size -= end - start;
+		gphys_addr = end;
 	}
 
-	return bytes_read;
+	return ret;
 }
 
-u32 vmm_guest_memory_write(struct vmm_guest *guest, 
-			   physical_addr_t gphys_addr, 
-			   void *src, u32 len, bool cacheable)
+void vmm_guest_memcopy_init(struct vmm_guest_memcopy *mc,
+			    struct vmm_guest *guest, bool cacheable)
 {
-	u32 bytes_written = 0, to_write;
+	mc->guest = guest;
+	mc->reg = NULL;
+	mc->cacheable = cacheable;
+}
+
+static u32 guest_memcopy_rw(struct vmm_guest_memcopy *mc,
+			    physical_addr_t gphys_addr,
+			    void *buf, u32 len, bool is_write)
+{
+	int rc;
+	u32 done = 0, chunk;
 	physical_addr_t hphys_addr;
-	struct vmm_region *reg = NULL;
+	physical_size_t avail_size;
+	struct vmm_region *reg;
 
-	if (!guest || !guest->aspace.initialized || !src || !len) {
+	if (!mc || !mc->guest || !mc->guest->aspace.initialized ||
+	    !buf || !len) {
 		return 0;
 	}
 
-	while (bytes_written < len) {
-		reg = vmm_guest_find_region(guest, gphys_addr, 
+	while (done < len) {
+		/* Re-use last region if it covers guest physical address */
+		reg = mc->reg;
+		if (!reg ||
+		    (gphys_addr < VMM_REGION_GPHYS_START(reg)) ||
+		    (VMM_REGION_GPHYS_END(reg) <= gphys_addr)) {
+			reg = vmm_guest_find_region(mc->guest, gphys_addr,
 				VMM_REGION_REAL | VMM_REGION_MEMORY, TRUE);
-		if (!reg) {
+			if (!reg) {
+				break;
+			}
+			if ((VMM_REGION_GPHYS_START(reg) <= gphys_addr) &&
+			    (gphys_addr < VMM_REGION_GPHYS_END(reg))) {
+				mc->reg = reg;
+			}
+		}
+
+		/* Reads of unpopulated demand chunks return zeros and
+		 * populated chunks stay pinned while being copied.
+		 */
+		rc = region_gphys_to_hphys(reg, gphys_addr, is_write, TRUE,
+					   &hphys_addr, &avail_size);
+		chunk = ((len - done) < avail_size) ?
+					(len - done) : avail_size;
+
+		if (rc == VMM_ENOENT) {
+			memset(buf, 0, chunk);
+		} else if (rc) {
+			break;
+		} else if (is_write) {
+			chunk = vmm_host_memory_write(hphys_addr, buf,
+						      chunk, mc->cacheable);
+		} else {
+			chunk = vmm_host_memory_read(hphys_addr, buf,
+						     chunk, mc->cacheable);
+		}
+		if (!rc && (reg->flags & VMM_REGION_ISDEMAND)) {
+			region_demand_unpin(mc->guest, reg, gphys_addr);
+		}
+		if (!chunk) {
 			break;
 		}
 
-		hphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr);
-		to_write = (reg->gphys_addr + reg->phys_size - gphys_addr);
-		to_write = ((len - bytes_written) < to_write) ? 
-			   (len - bytes_written) : to_write;
+		gphys_addr += chunk;
+		done += chunk;
+		buf += chunk;
+	}
+
+	return done;
+}
+
+u32 vmm_guest_memcopy_read(struct vmm_guest_memcopy *mc,
+			   physical_addr_t gphys_addr, void *dst, u32 len)
+{
+	return guest_memcopy_rw(mc, gphys_addr, dst, len, FALSE);
+}
+
+u32 vmm_guest_memcopy_write(struct vmm_guest_memcopy *mc,
+			    physical_addr_t gphys_addr, void *src, u32 len)
+{
+	return guest_memcopy_rw(mc, gphys_addr, src, len, TRUE);
+}
 
-		to_write = vmm_host_memory_write(hphys_addr,
-						 src, to_write, cacheable);
-		if (!to_write) {
+static u32 guest_memory_rwv(struct vmm_guest *guest,
+			    const struct vmm_guest_iovec *iov, u32 iov_cnt,
+			    void *buf, u32 buf_len, bool cacheable,
+			    bool is_write)
+{
+	u32 i, len, pos = 0;
+	struct vmm_guest_memcopy mc;
+
+	vmm_guest_memcopy_init(&mc, guest, cacheable);
+
+	for (i = 0; (i < iov_cnt) && (pos < buf_len); i++) {
+		len = ((buf_len - pos) < iov[i].len) ?
+					(buf_len - pos) : iov[i].len;
+		len = guest_memcopy_rw(&mc, iov[i].addr,
+				       buf + pos, len, is_write);
+		pos += len;
+		if (len < iov[i].len) {
 			break;
 		}
+	}
+
+	return pos;
+}
+
+u32 vmm_guest_memory_readv(struct vmm_guest *guest,
+			   const struct vmm_guest_iovec *iov, u32 iov_cnt,
+			   void *dst, u32 len, bool cacheable)
+{
+	return guest_memory_rwv(guest, iov, iov_cnt,
+				dst, len, cacheable, FALSE);
+}
+
+u32 vmm_guest_memory_writev(struct vmm_guest *guest,
+			    const struct vmm_guest_iovec *iov, u32 iov_cnt,
+			    void *src, u32 len, bool cacheable)
+{
+	return guest_memory_rwv(guest, iov, iov_cnt,
+				src, len, cacheable, TRUE);
+}
 
-		gphys_addr += to_write;
-		bytes_written += to_write;
-		src += to_write;
+u32 vmm_guest_memory_read(struct vmm_guest *guest, 
+			  physical_addr_t gphys_addr, 
+			  void *dst, u32 len, bool cacheable)
+{
+	struct vmm_guest_memcopy mc;
+
+	vmm_guest_memcopy_init(&mc, guest, cacheable);
+
+	return guest_memcopy_rw(&mc, gphys_addr, dst, len, FALSE);
+}
+
+u32 vmm_guest_memory_write(struct vmm_guest *guest, 
+			   physical_addr_t gphys_addr, 
+			   void *src, u32 len, bool cacheable)
+{
+	struct vmm_guest_memcopy mc;
+
+	vmm_guest_memcopy_init(&mc, guest, cacheable);
+
+	return guest_memcopy_rw(&mc, gphys_addr, src, len, TRUE);
+}
+
+/* Find memory region of guest physical address with aliases resolved */
+static struct vmm_region *guest_physical_region(struct vmm_guest *guest,
+						physical_addr_t *gphys_addr)
+{
+	struct vmm_region *reg;
+
+	reg = vmm_guest_find_region(guest, *gphys_addr,
+				    VMM_REGION_MEMORY, FALSE);
+	while (reg && (reg->flags & VMM_REGION_ALIAS)) {
+		*gphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, *gphys_addr);
+		reg = vmm_guest_find_region(guest, *gphys_addr,
+					    VMM_REGION_MEMORY, FALSE);
 	}
 
-	return bytes_written;
+	return reg;
 }
 
 int vmm_guest_physical_map(struct vmm_guest *guest,
@@ -234,6 +688,8 @@ int vmm_guest_physical_map(struct vmm_guest *guest,
 			   physical_size_t *hphys_size,
 			   u32 *reg_flags)
 {
+	int rc;
+	physical_size_t avail_size;
 	struct vmm_region *reg = NULL;
 
 	if (!guest || !hphys_addr) {
@@ -243,24 +699,19 @@ int vmm_guest_physical_map(struct vmm_guest *guest,
 		return VMM_ENOTAVAIL;
 	}
 
-	reg = vmm_guest_find_region(guest, gphys_addr, 
-				    VMM_REGION_MEMORY, FALSE);
+	reg = guest_physical_region(guest, &gphys_addr);
 	if (!reg) {
 		return VMM_EFAIL;
 	}
-	while (reg->flags & VMM_REGION_ALIAS) {
-		gphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr);
-		reg = vmm_guest_find_region(guest, gphys_addr, 
-					    VMM_REGION_MEMORY, FALSE);
-		if (!reg) {
-			return VMM_EFAIL;
-		}
-	}
 
-	*hphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr);
+	rc = region_gphys_to_hphys(reg, gphys_addr, TRUE, TRUE,
+				   hphys_addr, &avail_size);
+	if (rc) {
+		return rc;
+	}
 
 	if (hphys_size) {
-		*hphys_size = reg->gphys_addr + reg->phys_size - gphys_addr;
+		*hphys_size = avail_size;
 		if (gphys_size < *hphys_size) {
 			*hphys_size = gphys_size;
 		}
@@ -277,9 +728,225 @@ int vmm_guest_physical_unmap(struct vmm_guest *guest,
 			     physical_addr_t gphys_addr,
 			     physical_size_t gphys_size)
 {
-	/* We don't have dynamic host RAM allocation so
-	 * Nothing to do here.
-	 */
+	struct vmm_region *reg;
+
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+	if (!guest->aspace.initialized) {
+		return VMM_ENOTAVAIL;
+	}
+
+	reg = guest_physical_region(guest, &gphys_addr);
+	if (!reg) {
+		return VMM_EFAIL;
+	}
+
+	/* Only chunks of demand allocated regions are pinned */
+	if (reg->flags & VMM_REGION_ISDEMAND) {
+		region_demand_unpin(guest, reg, gphys_addr);
+	}
+
+	return VMM_OK;
+}
+
+physical_size_t vmm_guest_physical_discard(struct vmm_guest *guest,
+					   physical_addr_t gphys_addr,
+					   physical_size_t gphys_size,
+					   bool track)
+{
+	if (!guest || !guest->aspace.initialized) {
+		return 0;
+	}
+
+	return guest_demand_discard(guest, gphys_addr, gphys_size, track);
+}
+
+void vmm_guest_physical_undiscard(struct vmm_guest *guest,
+				  physical_addr_t gphys_addr,
+				  physical_size_t gphys_size)
+{
+	irq_flags_t flags, rflags;
+	struct rb_node *node;
+	struct vmm_region *reg;
+	physical_addr_t start, end;
+	physical_size_t len;
+
+	if (!guest || !guest->aspace.initialized) {
+		return;
+	}
+
+	gphys_size += gphys_addr & VMM_PAGE_MASK;
+	gphys_addr &= ~(physical_addr_t)VMM_PAGE_MASK;
+	end = gphys_addr + (gphys_size & ~(physical_size_t)VMM_PAGE_MASK);
+	if (end < gphys_addr) {
+		end = ~(physical_addr_t)VMM_PAGE_MASK;
+	}
+
+	vmm_read_lock_irqsave_lite(&guest->aspace.reg_memtree_lock, rflags);
+	for (node = rb_first(&guest->aspace.reg_memtree); node;
+	     node = rb_next(node)) {
+		reg = rb_entry(node, struct vmm_region, head);
+		if (!(reg->flags & VMM_REGION_ISDEMAND) ||
+		    (end <= VMM_REGION_GPHYS_START(reg)) ||
+		    (VMM_REGION_GPHYS_END(reg) <= gphys_addr)) {
+			continue;
+		}
+		start = (gphys_addr < VMM_REGION_GPHYS_START(reg)) ?
+			VMM_REGION_GPHYS_START(reg) : gphys_addr;
+		start -= reg->gphys_addr;
+		if (end < VMM_REGION_GPHYS_END(reg)) {
+			len = end - reg->gphys_addr - start;
+		} else {
+			len = reg->phys_size - start;
+		}
+		vmm_spin_lock_irqsave_lite(&reg->demand_lock, flags);
+		bitmap_clear(reg->demand_discard, start >> VMM_PAGE_SHIFT,
+			     len >> VMM_PAGE_SHIFT);
+		vmm_spin_unlock_irqrestore_lite(&reg->demand_lock, flags);
+	}
+	vmm_read_unlock_irqrestore_lite(&guest->aspace.reg_memtree_lock,
+					rflags);
+}
+
+bool vmm_guest_physical_populated(struct vmm_guest *guest,
+				  physical_addr_t gphys_addr)
+{
+	physical_addr_t hphys_addr;
+	struct vmm_region *reg;
+
+	if (!guest || !guest->aspace.initialized) {
+		return FALSE;
+	}
+
+	reg = vmm_guest_find_region(guest, gphys_addr,
+				    VMM_REGION_MEMORY, TRUE);
+	if (!reg) {
+		return FALSE;
+	}
+	if (!(reg->flags & VMM_REGION_ISDEMAND)) {
+		return TRUE;
+	}
+
+	return (region_demand_chunk(reg,
+			(gphys_addr - reg->gphys_addr) >> reg->demand_order,
+			FALSE, FALSE, &hphys_addr) == VMM_OK) ? TRUE : FALSE;
+}
+
+int vmm_guest_balloon_register(struct vmm_guest_balloon *b)
+{
+	int rc = VMM_OK;
+
+	if (!b || !b->guest || !b->set_target) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&guest_balloon_lock);
+	if (b->guest->aspace.balloon) {
+		rc = VMM_EEXIST;
+	} else {
+		b->guest->aspace.balloon = b;
+	}
+	vmm_mutex_unlock(&guest_balloon_lock);
+
+	return rc;
+}
+
+void vmm_guest_balloon_unregister(struct vmm_guest_balloon *b)
+{
+	if (!b || !b->guest) {
+		return;
+	}
+
+	vmm_mutex_lock(&guest_balloon_lock);
+	if (b->guest->aspace.balloon == b) {
+		b->guest->aspace.balloon = NULL;
+	}
+	vmm_mutex_unlock(&guest_balloon_lock);
+}
+
+int vmm_guest_balloon_info(struct vmm_guest *guest,
+			   struct vmm_guest_balloon *info)
+{
+	int rc = VMM_OK;
+	struct vmm_guest_balloon *b;
+
+	if (!guest || !info) {
+		return VMM_EFAIL;
+	}
+
+	vmm_mutex_lock(&guest_balloon_lock);
+	b = guest->aspace.balloon;
+	if (b) {
+		memcpy(info, b, sizeof(*info));
+		/* Ask guest for fresh statistics */
+		if (b->update_stats) {
+			b->update_stats(b);
+		}
+	} else {
+		rc = VMM_ENOTAVAIL;
+	}
+	vmm_mutex_unlock(&guest_balloon_lock);
+
+	return rc;
+}
+
+int vmm_guest_balloon_set_target(struct vmm_guest *guest,
+				 physical_size_t target)
+{
+	int rc;
+	struct vmm_guest_balloon *b;
+
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+
+	vmm_mutex_lock(&guest_balloon_lock);
+	b = guest->aspace.balloon;
+	rc = (b) ? b->set_target(b, target) : VMM_ENOTAVAIL;
+	vmm_mutex_unlock(&guest_balloon_lock);
+
+	return rc;
+}
+
+int vmm_guest_ram_usage(struct vmm_guest *guest,
+			physical_size_t *committed,
+			physical_size_t *resident)
+{
+	irq_flags_t flags;
+	struct rb_node *node;
+	struct vmm_region *reg;
+	physical_size_t c = 0, r = 0;
+
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+	if (!guest->aspace.initialized) {
+		return VMM_ENOTAVAIL;
+	}
+
+	vmm_read_lock_irqsave_lite(&guest->aspace.reg_memtree_lock, flags);
+	for (node = rb_first(&guest->aspace.reg_memtree); node;
+	     node = rb_next(node)) {
+		reg = rb_entry(node, struct vmm_region, head);
+		if (reg->flags & VMM_REGION_ISDEMAND) {
+			c += reg->phys_size;
+			r += (physical_size_t)reg->demand_resident <<
+							reg->demand_order;
+		} else if (reg->flags & VMM_REGION_ISHOSTRAM) {
+			c += reg->phys_size;
+			r += reg->phys_size;
+		}
+	}
+	vmm_read_unlock_irqrestore_lite(&guest->aspace.reg_memtree_lock, flags);
+
+	if (committed) {
+		*committed = c;
+	}
+	if (resident) {
+		*resident = r;
+	}
+
 	return VMM_OK;
 }
 
@@ -563,6 +1230,37 @@ static int region_add(struct vmm_guest *guest,
 		reg->align_order = 0;
 	}
 
+	/* Alloced RAM regions with demand_order attribute get host RAM
+	 * allocated in chunks of 2^demand_order bytes on first access.
+	 * The chunk order is reduced until region is chunk aligned.
+	 */
+	if ((reg->flags & VMM_REGION_REAL) &&
+	    (reg->flags & VMM_REGION_ISRAM) &&
+	    (reg->flags & VMM_REGION_ISALLOCED) &&
+	    !vmm_devtree_read_u32(reg->node,
+				  VMM_DEVTREE_DEMAND_ORDER_ATTR_NAME,
+				  &reg->demand_order)) {
+		if (reg->demand_order < VMM_PAGE_SHIFT) {
+			reg->demand_order = VMM_PAGE_SHIFT;
+		}
+		if ((sizeof(physical_addr_t) * 8) <= reg->demand_order) {
+			reg->demand_order = sizeof(physical_addr_t) * 8 - 1;
+		}
+		while ((VMM_PAGE_SHIFT < reg->demand_order) &&
+		       ((reg->gphys_addr | reg->phys_size) &
+			(((physical_addr_t)1 << reg->demand_order) - 1))) {
+			reg->demand_order--;
+		}
+		if ((reg->gphys_addr | reg->phys_size) &
+		    (((physical_addr_t)1 << reg->demand_order) - 1)) {
+			vmm_printf("%s: %s/%s is not page aligned\n",
+				   __func__, guest->name, reg->node->name);
+			rc = VMM_EINVALID;
+			goto region_free_fail;
+		}
+		reg->flags |= VMM_REGION_ISDEMAND;
+	}
+
 	reg->devemu_priv = NULL;
 	reg->priv = rpriv;
 
@@ -590,10 +1288,45 @@ static int region_add(struct vmm_guest *guest,
 		}
 	}
 
+	/* Setup chunk map for demand allocated RAM regions */
+	if (reg->flags & VMM_REGION_ISDEMAND) {
+		INIT_SPIN_LOCK(&reg->demand_lock);
+		reg->demand_resident = 0;
+		reg->demand_map = vmm_zalloc(sizeof(physical_addr_t) *
+				(reg->phys_size >> reg->demand_order));
+		if (!reg->demand_map) {
+			rc = VMM_ENOMEM;
+			goto region_free_fail;
+		}
+		reg->demand_pins = vmm_zalloc(sizeof(u32) *
+				(reg->phys_size >> reg->demand_order));
+		reg->demand_deferred = vmm_zalloc(bitmap_estimate_size(
+				reg->phys_size >> reg->demand_order));
+		reg->demand_discard = vmm_zalloc(bitmap_estimate_size(
+				reg->phys_size >> VMM_PAGE_SHIFT));
+		if (!reg->demand_pins || !reg->demand_deferred ||
+		    !reg->demand_discard) {
+			if (reg->demand_discard) {
+				vmm_free(reg->demand_discard);
+			}
+			if (reg->demand_deferred) {
+				vmm_free(reg->demand_deferred);
+			}
+			if (reg->demand_pins) {
+				vmm_free(reg->demand_pins);
+			}
+			vmm_free(reg->demand_map);
+			rc = VMM_ENOMEM;
+			goto region_free_fail;
+		}
+		reg->hphys_addr = 0;
+	}
+
 	/* Allocate host RAM for alloced RAM/ROM regions */
 	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
 	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
-	    (reg->flags & VMM_REGION_ISALLOCED)) {
+	    (reg->flags & VMM_REGION_ISALLOCED) &&
+	    !(reg->flags & VMM_REGION_ISDEMAND)) {
 		if (!vmm_host_ram_alloc(&reg->hphys_addr,
 					reg->phys_size,
 					reg->align_order)) {
@@ -672,6 +1405,9 @@ static int region_add(struct vmm_guest *guest,
 	}
 	vmm_write_unlock_irqrestore_lite(root_lock, flags);
 
+	/* Invalidate region cache of all VCPUs */
+	arch_atomic_inc(&aspace->reg_gen);
+
 	if (new_reg) {
 		*new_reg = reg;
 	}
@@ -696,6 +1432,9 @@ region_ram_free_fail:
 		vmm_host_ram_free(reg->hphys_addr,
 				  reg->phys_size);
 	}
+	if (reg->flags & VMM_REGION_ISDEMAND) {
+		region_demand_free(reg);
+	}
 region_free_fail:
 	vmm_free(reg);
 region_fail:
@@ -741,6 +1480,9 @@ static int region_del(struct vmm_guest *guest,
 		vmm_write_unlock_irqrestore_lite(root_lock, flags);
 	}
 
+	/* Invalidate region cache of all VCPUs */
+	arch_atomic_inc(&aspace->reg_gen);
+
 	/* Call arch specific del region callback */
 	rc = arch_guest_del_region(guest, reg);
 	if (rc) {
@@ -773,6 +1515,11 @@ static int region_del(struct vmm_guest *guest,
 		}
 	}
 
+	/* Free populated chunks of demand allocated RAM region */
+	if (reg->flags & VMM_REGION_ISDEMAND) {
+		region_demand_free(reg);
+	}
+
 	/* Free the region */
 	vmm_free(reg);
 
@@ -1084,7 +1831,9 @@ int vmm_guest_aspace_init(struct vmm_guest *guest)
 	INIT_RW_LOCK(&aspace->reg_memtree_lock);
 	aspace->reg_memtree = RB_ROOT;
 	INIT_LIST_HEAD(&aspace->reg_memprobe_list);
+	ARCH_ATOMIC_INIT(&aspace->reg_gen, 0);
 	guest->aspace.devemu_priv = NULL;
+	guest->aspace.balloon = NULL;
 
 	/* Initialize device emulation context */
 	if ((rc = vmm_devemu_init_context(guest))) {
@@ -27,15 +27,22 @@
 #include <vmm_error.h>
 #include <vmm_cache.h>
 #include <vmm_heap.h>
+#include <vmm_percpu.h>
+#include <vmm_smp.h>
 #include <vmm_stdio.h>
 #include <vmm_host_aspace.h>
+#include <arch_cpu_irq.h>
 #include <libs/stringlib.h>
 #include <libs/buddy.h>
 
 struct vmm_heap_control {
 	struct buddy_allocator ba;
+	u8 *mag_map;
+	unsigned long mag_map_size;
 	void *hk_start;
 	unsigned long hk_size;
+	void *map_start;
+	unsigned long map_size;
 	void *mem_start;
 	unsigned long mem_size;
 	void *heap_start;
@@ -49,16 +56,279 @@ static struct vmm_heap_control dma_heap;
 #define HEAP_MIN_BIN		(VMM_CACHE_LINE_SHIFT)
 #define HEAP_MAX_BIN		(VMM_PAGE_SHIFT)
 
+#ifdef CONFIG_HEAP_MAGAZINE
+
+/*
+ * Per-CPU magazines sit in front of the buddy allocator of normal heap.
+ *
+ * Each power-of-two size class between HEAP_MIN_BIN and HEAP_MAG_MAX_BIN
+ * has one magazine per host CPU. Objects in a magazine are still alloced
+ * in buddy allocator so vmm_alloc_size() keeps working for them. The
+ * mag_map has one byte per minimum block of heap memory which holds
+ * (size class + 1) for objects owned by magazines and zero otherwise.
+ * This allows vmm_free() to find size class of an object without
+ * looking-up buddy allocator.
+ *
+ * Magazines are only accessed by their own host CPU with interrupts
+ * disabled so we don't need any lock for them.
+ */
+
+#define HEAP_MAG_MAX_BIN	(HEAP_MAX_BIN - 1)
+#define HEAP_MAG_CLASS_COUNT	(HEAP_MAG_MAX_BIN - HEAP_MIN_BIN + 1)
+#define HEAP_MAG_CLASS_SIZE(c)	(0x1UL << ((c) + HEAP_MIN_BIN))
+#define HEAP_MAG_SIZE		CONFIG_HEAP_MAGAZINE_SIZE
+#define HEAP_MAG_BATCH		(HEAP_MAG_SIZE / 2)
+#define HEAP_MAG_MAP_INDEX(heap, addr)	\
+	(((unsigned long)(addr) - (unsigned long)(heap)->mem_start) >> \
+	 HEAP_MIN_BIN)
+
+struct heap_mag {
+	unsigned long count;
+	void *objs[HEAP_MAG_SIZE];
+	u64 alloc_hit;
+	u64 alloc_miss;
+	u64 refill;
+	u64 free_hit;
+	u64 flush;
+};
+
+struct heap_mag_cpu {
+	struct heap_mag mags[HEAP_MAG_CLASS_COUNT];
+};
+
+static DEFINE_PER_CPU(struct heap_mag_cpu, hmag);
+
+static int heap_mag_class(virtual_size_t size)
+{
+	int c;
+
+	for (c = 0; c < HEAP_MAG_CLASS_COUNT; c++) {
+		if (size <= HEAP_MAG_CLASS_SIZE(c)) {
+			return c;
+		}
+	}
+
+	return -1;
+}
+
+/* NOTE: This function must be called with interrupts disabled */
+static void heap_mag_refill(struct vmm_heap_control *heap,
+			    struct heap_mag *m, int c)
+{
+	unsigned long i, addr;
+
+	for (i = 0; i < HEAP_MAG_BATCH; i++) {
+		if (buddy_mem_alloc(&heap->ba, HEAP_MAG_CLASS_SIZE(c), &addr)) {
+			break;
+		}
+		heap->mag_map[HEAP_MAG_MAP_INDEX(heap, addr)] = c + 1;
+		m->objs[m->count++] = (void *)addr;
+	}
+
+	if (m->count) {
+		m->refill++;
+	}
+}
+
+/* NOTE: This function must be called with interrupts disabled */
+static void heap_mag_flush(struct vmm_heap_control *heap,
+			   struct heap_mag *m, unsigned long count)
+{
+	void *obj;
+
+	while (m->count && count) {
+		obj = m->objs[--m->count];
+		heap->mag_map[HEAP_MAG_MAP_INDEX(heap, obj)] = 0;
+		buddy_mem_free(&heap->ba, (unsigned long)obj);
+		count--;
+	}
+
+	m->flush++;
+}
+
+static void *heap_mag_alloc(struct vmm_heap_control *heap,
+			    virtual_size_t size)
+{
+	int c;
+	void *ret = NULL;
+	irq_flags_t flags;
+	struct heap_mag *m;
+
+	c = heap_mag_class(size);
+	if (c < 0) {
+		return NULL;
+	}
+
+	arch_cpu_irq_save(flags);
+
+	m = &this_cpu(hmag).mags[c];
+	if (m->count) {
+		m->alloc_hit++;
+	} else {
+		m->alloc_miss++;
+		heap_mag_refill(heap, m, c);
+	}
+	if (m->count) {
+		ret = m->objs[--m->count];
+	}
+
+	arch_cpu_irq_restore(flags);
+
+	return ret;
+}
+
+static bool heap_mag_free(struct vmm_heap_control *heap, void *ptr)
+{
+	int c;
+	irq_flags_t flags;
+	struct heap_mag *m;
+
+	c = heap->mag_map[HEAP_MAG_MAP_INDEX(heap, ptr)];
+	if (!c) {
+		return FALSE;
+	}
+	c--;
+
+	arch_cpu_irq_save(flags);
+
+	m = &this_cpu(hmag).mags[c];
+	if (m->count == HEAP_MAG_SIZE) {
+		heap_mag_flush(heap, m, HEAP_MAG_BATCH);
+	} else {
+		m->free_hit++;
+	}
+	m->objs[m->count++] = ptr;
+
+	arch_cpu_irq_restore(flags);
+
+	return TRUE;
+}
+
+static unsigned long heap_mag_cached_space(struct vmm_heap_control *heap)
+{
+	int c;
+	u32 cpu;
+	unsigned long ret = 0;
+
+	if (!heap->mag_map) {
+		return 0;
+	}
+
+	for_each_online_cpu(cpu) {
+		for (c = 0; c < HEAP_MAG_CLASS_COUNT; c++) {
+			ret += per_cpu(hmag, cpu).mags[c].count *
+						HEAP_MAG_CLASS_SIZE(c);
+		}
+	}
+
+	return ret;
+}
+
+static void heap_mag_print_state(struct vmm_heap_control *heap,
+				 struct vmm_chardev *cdev, const char *name)
+{
+	int c;
+	u32 cpu;
+	struct heap_mag *m;
+	unsigned long count;
+	u64 alloc_hit, alloc_miss, refill, free_hit, flush;
+
+	if (!heap->mag_map) {
+		return;
+	}
+
+	vmm_cprintf(cdev, "%s Heap Magazine State\n", name);
+	vmm_cprintf(cdev, "  %-12s %6s %10s %10s %8s %10s %8s\n",
+		    "Size Class", "Cached", "Alloc Hit", "Alloc Miss",
+		    "Refill", "Free Hit", "Flush");
+
+	for (c = 0; c < HEAP_MAG_CLASS_COUNT; c++) {
+		count = 0;
+		alloc_hit = alloc_miss = refill = free_hit = flush = 0;
+		for_each_online_cpu(cpu) {
+			m = &per_cpu(hmag, cpu).mags[c];
+			count += m->count;
+			alloc_hit += m->alloc_hit;
+			alloc_miss += m->alloc_miss;
+			refill += m->refill;
+			free_hit += m->free_hit;
+			flush += m->flush;
+		}
+		if (HEAP_MAG_CLASS_SIZE(c) < 1024) {
+			vmm_cprintf(cdev, "  [BLOCK %4luB]",
+				    HEAP_MAG_CLASS_SIZE(c));
+		} else {
+			vmm_cprintf(cdev, "  [BLOCK %4luK]",
+				    HEAP_MAG_CLASS_SIZE(c) >> 10);
+		}
+		vmm_cprintf(cdev, " %6lu %10llu %10llu %8llu %10llu %8llu\n",
+			    count, alloc_hit, alloc_miss,
+			    refill, free_hit, flush);
+	}
+}
+
+static int heap_mag_init(struct vmm_heap_control *heap)
+{
+	heap->mag_map_size = heap->mem_size >> HEAP_MIN_BIN;
+	heap->mag_map = (u8 *)vmm_host_alloc_pages(
+				VMM_SIZE_TO_PAGE(heap->mag_map_size),
+				VMM_MEMORY_FLAGS_NORMAL);
+	if (!heap->mag_map) {
+		return VMM_ENOMEM;
+	}
+	memset(heap->mag_map, 0, heap->mag_map_size);
+
+	return VMM_OK;
+}
+
+#else
+
+static void *heap_mag_alloc(struct vmm_heap_control *heap,
+			    virtual_size_t size)
+{
+	return NULL;
+}
+
+static bool heap_mag_free(struct vmm_heap_control *heap, void *ptr)
+{
+	return FALSE;
+}
+
+static unsigned long heap_mag_cached_space(struct vmm_heap_control *heap)
+{
+	return 0;
+}
+
+static void heap_mag_print_state(struct vmm_heap_control *heap,
+				 struct vmm_chardev *cdev, const char *name)
+{
+}
+
+static int heap_mag_init(struct vmm_heap_control *heap)
+{
+	return VMM_OK;
+}
+
+#endif
+
 static void *heap_malloc(struct vmm_heap_control *heap,
 			 virtual_size_t size)
 {
 	int rc;
+	void *ret;
 	unsigned long addr;
 
 	if (!size) {
 		return NULL;
 	}
 
+	if (heap->mag_map) {
+		ret = heap_mag_alloc(heap, size);
+		if (ret) {
+			return ret;
+		}
+	}
+
 	rc = buddy_mem_alloc(&heap->ba, size, &addr);
 	if (rc) {
 		vmm_printf("%s: Failed to alloc size=%d (error %d)\n",
@@ -96,6 +366,10 @@ static void heap_free(struct vmm_heap_control *heap, void *ptr)
 	BUG_ON(ptr < heap->mem_start);
 	BUG_ON((heap->mem_start + heap->mem_size) <= ptr);
 
+	if (heap->mag_map && heap_mag_free(heap, ptr)) {
+		return;
+	}
+
 	rc = buddy_mem_free(&heap->ba, (unsigned long)ptr);
 	if (rc) {
 		vmm_printf("%s: Failed to free ptr=%p (error %d)\n",
@@ -159,6 +433,8 @@ static int heap_print_state(struct vmm_heap_control *heap,
 		    buddy_hk_area_free(&heap->ba),
 		    buddy_hk_area_total(&heap->ba));
 
+	heap_mag_print_state(heap, cdev, name);
+
 	return VMM_OK;
 }
 
@@ -202,10 +478,31 @@ static int heap_init(struct vmm_heap_control *heap,
 		heap->mem_size = heap->heap_size;
 	}
 
-	return buddy_allocator_init(&heap->ba,
+#ifdef CONFIG_HEAP_ALLOC_MAP
+	heap->map_size = buddy_alloc_map_size(heap->mem_size, HEAP_MIN_BIN);
+	heap->map_start = (void *)vmm_host_alloc_pages(
+					VMM_SIZE_TO_PAGE(heap->map_size),
+					VMM_MEMORY_FLAGS_NORMAL);
+	if (!heap->map_start) {
+		return VMM_ENOMEM;
+	}
+#endif
+
+	rc = buddy_allocator_init(&heap->ba,
 			  heap->hk_start, heap->hk_size,
+			  heap->map_start, heap->map_size,
 			  (unsigned long)heap->mem_start, heap->mem_size,
 			  HEAP_MIN_BIN, HEAP_MAX_BIN);
+	if (rc) {
+		return rc;
+	}
+
+	/* Per-CPU magazines only for normal heap */
+	if (is_normal) {
+		rc = heap_mag_init(heap);
+	}
+
+	return rc;
 }
 
 void *vmm_malloc(virtual_size_t size)
@@ -251,7 +548,8 @@ virtual_size_t vmm_normal_heap_hksize(void)
 
 virtual_size_t vmm_normal_heap_free_size(void)
 {
-	return buddy_bins_free_space(&normal_heap.ba);
+	return buddy_bins_free_space(&normal_heap.ba) +
+	       heap_mag_cached_space(&normal_heap);
 }
 
 int vmm_normal_heap_print_state(struct vmm_chardev *cdev)
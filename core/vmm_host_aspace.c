@@ -35,6 +35,22 @@
 #include <libs/stringlib.h>
 #include <libs/rbtree_augmented.h>
 
+/* Maximum number of pages accessed in one interrupt disabled section
+ * by physical memory read/write. Without arch specific memory read/write
+ * all these pages are mapped at once in a per-host CPU window otherwise
+ * arch code accesses them ARCH_MEMORY_READWRITE_PAGES pages at a time.
+ */
+#define HOST_MEM_RW_PAGES		16
+#if !defined(ARCH_HAS_MEMORY_READWRITE)
+#define HOST_MEM_RW_VA_SIZE		(HOST_MEM_RW_PAGES * VMM_PAGE_SIZE)
+#else
+#if !defined(ARCH_MEMORY_READWRITE_PAGES)
+#define ARCH_MEMORY_READWRITE_PAGES	1
+#endif
+#define HOST_MEM_RW_VA_SIZE		(ARCH_MEMORY_READWRITE_PAGES * \
+					 VMM_PAGE_SIZE)
+#endif
+
 static virtual_addr_t host_mem_rw_va[CONFIG_CPU_COUNT];
 
 struct host_mhash_entry {
@@ -241,10 +257,10 @@ static int host_mhash_pa2va(physical_addr_t pa,
 	e = __host_mhash_find(pa);
 	if (e) {
 		if (va) {
-			*va = e->va + (e->pa - pa);
+			*va = e->va + (pa - e->pa);
 		}
 		if (sz) {
-			*sz = e->sz - (e->pa - pa);
+			*sz = e->sz - (pa - e->pa);
 		}
 		if (mem_flags) {
 			*mem_flags = e->mem_flags;
@@ -435,6 +451,50 @@ int vmm_host_free_pages(virtual_addr_t page_va, u32 page_count)
 	return vmm_host_ram_free(pa, page_count * VMM_PAGE_SIZE);
 }
 
+int vmm_host_map_pages(virtual_addr_t va, physical_addr_t pa,
+		       u32 page_count, u32 mem_flags)
+{
+	int rc;
+	u32 ite;
+
+	if ((va & VMM_PAGE_MASK) || (pa & VMM_PAGE_MASK)) {
+		return VMM_EINVALID;
+	}
+
+	for (ite = 0; ite < page_count; ite++) {
+		rc = arch_cpu_aspace_map(va + ite * VMM_PAGE_SIZE,
+					 pa + ite * VMM_PAGE_SIZE,
+					 mem_flags);
+		if (rc) {
+			while (ite--) {
+				arch_cpu_aspace_unmap(va + ite * VMM_PAGE_SIZE);
+			}
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+int vmm_host_unmap_pages(virtual_addr_t va, u32 page_count)
+{
+	int rc, ret = VMM_OK;
+	u32 ite;
+
+	if (va & VMM_PAGE_MASK) {
+		return VMM_EINVALID;
+	}
+
+	for (ite = 0; ite < page_count; ite++) {
+		rc = arch_cpu_aspace_unmap(va + ite * VMM_PAGE_SIZE);
+		if (rc) {
+			ret = rc;
+		}
+	}
+
+	return ret;
+}
+
 int vmm_host_va2pa(virtual_addr_t va, physical_addr_t *pa)
 {
 	int rc = VMM_OK;
@@ -468,110 +528,147 @@ int vmm_host_pa2va(physical_addr_t pa, virtual_addr_t *va)
 	return VMM_OK;
 }
 
-u32 vmm_host_memory_read(physical_addr_t hpa,
-			 void *dst, u32 len, bool cacheable)
+/* Access physical memory using existing hypervisor mapping (if any) */
+static u32 host_memory_direct_rw(physical_addr_t hpa, void *buf, u32 len,
+				 bool cacheable, bool is_write)
 {
-	int rc;
-	irq_flags_t flags;
-	u32 bytes_read = 0, page_offset, page_read;
-	virtual_addr_t tmp_va = host_mem_rw_va[vmm_smp_processor_id()];
-
-	/* Read one page at time with irqs disabled since, we use
-	 * one virtual address per-host CPU to do read/write.
-	 */
-	while (bytes_read < len) {
-		page_offset = hpa & VMM_PAGE_MASK;
-
-		page_read = VMM_PAGE_SIZE - page_offset;
-		page_read = (page_read < (len - bytes_read)) ?
-			     page_read : (len - bytes_read);
-
-		arch_cpu_irq_save(flags);
-
-#if !defined(ARCH_HAS_MEMORY_READWRITE)
-		rc = arch_cpu_aspace_map(tmp_va, hpa & ~VMM_PAGE_MASK,
-					 (cacheable) ?
-					 VMM_MEMORY_FLAGS_NORMAL :
-					 VMM_MEMORY_FLAGS_NORMAL_NOCACHE);
-		if (rc) {
-			break;
-		}
+	u32 mem_flags;
+	virtual_addr_t va;
+	virtual_size_t sz;
 
-		memcpy(dst, (void *)(tmp_va + page_offset), page_read);
+	if (host_mhash_pa2va(hpa, &va, &sz, &mem_flags)) {
+		return 0;
+	}
 
-		rc = arch_cpu_aspace_unmap(tmp_va);
-		if (rc) {
-			break;
-		}
-#else
-		rc = arch_cpu_aspace_memory_read(tmp_va, hpa,
-						 dst, page_read, cacheable);
-		if (rc) {
-			break;
-		}
-#endif
+	if (!(mem_flags & VMM_MEMORY_READABLE) ||
+	    (is_write && !(mem_flags & VMM_MEMORY_WRITEABLE)) ||
+	    ((mem_flags & VMM_MEMORY_CACHEABLE) ? !cacheable : cacheable)) {
+		return 0;
+	}
 
-		arch_cpu_irq_restore(flags);
+	if (sz < len) {
+		len = sz;
+	}
 
-		hpa += page_read;
-		bytes_read += page_read;
-		dst += page_read;
+	if (is_write) {
+		memcpy((void *)va, buf, len);
+	} else {
+		memcpy(buf, (void *)va, len);
 	}
 
-	return bytes_read;
+	return len;
 }
 
-u32 vmm_host_memory_write(physical_addr_t hpa,
-			  void *src, u32 len, bool cacheable)
+/* Access physical memory using per-host CPU temporary mapping window
+ * of HOST_MEM_RW_PAGES pages with interrupts disabled.
+ */
+static u32 host_memory_window_rw(physical_addr_t hpa, void *buf, u32 len,
+				 bool cacheable, bool is_write)
 {
 	int rc;
 	irq_flags_t flags;
-	u32 bytes_written = 0, page_offset, page_write;
-	virtual_addr_t tmp_va = host_mem_rw_va[vmm_smp_processor_id()];
-
-	/* Write one page at time with irqs disabled since, we use
-	 * one virtual address per-host CPU to do read/write.
-	 */
-	while (bytes_written < len) {
-		page_offset = hpa & VMM_PAGE_MASK;
+	virtual_addr_t tmp_va;
+	u32 done = 0, page_offset, chunk;
+#if !defined(ARCH_HAS_MEMORY_READWRITE)
+	u32 i, pages;
+#else
+	u32 pages = 0;
+#endif
 
-		page_write = VMM_PAGE_SIZE - page_offset;
-		page_write = (page_write < (len - bytes_written)) ?
-			      page_write : (len - bytes_written);
+	arch_cpu_irq_save(flags);
 
-		arch_cpu_irq_save(flags);
+	tmp_va = host_mem_rw_va[vmm_smp_processor_id()];
 
 #if !defined(ARCH_HAS_MEMORY_READWRITE)
-		rc = arch_cpu_aspace_map(tmp_va, hpa & ~VMM_PAGE_MASK,
-					 (cacheable) ?
-					 VMM_MEMORY_FLAGS_NORMAL :
-					 VMM_MEMORY_FLAGS_NORMAL_NOCACHE);
+	page_offset = hpa & VMM_PAGE_MASK;
+	pages = VMM_SIZE_TO_PAGE(page_offset + len);
+	if (HOST_MEM_RW_PAGES < pages) {
+		pages = HOST_MEM_RW_PAGES;
+	}
+
+	for (i = 0; i < pages; i++) {
+		rc = arch_cpu_aspace_map(tmp_va + i * VMM_PAGE_SIZE,
+				(hpa & ~VMM_PAGE_MASK) + i * VMM_PAGE_SIZE,
+				(cacheable) ? VMM_MEMORY_FLAGS_NORMAL :
+					      VMM_MEMORY_FLAGS_NORMAL_NOCACHE);
 		if (rc) {
 			break;
 		}
+	}
+	pages = i;
 
-		memcpy((void *)(tmp_va + page_offset), src, page_write);
-
-		rc = arch_cpu_aspace_unmap(tmp_va);
-		if (rc) {
-			break;
+	if (pages) {
+		chunk = pages * VMM_PAGE_SIZE - page_offset;
+		done = (chunk < len) ? chunk : len;
+		if (is_write) {
+			memcpy((void *)(tmp_va + page_offset), buf, done);
+		} else {
+			memcpy(buf, (void *)(tmp_va + page_offset), done);
 		}
+	}
+
+	for (i = 0; i < pages; i++) {
+		arch_cpu_aspace_unmap(tmp_va + i * VMM_PAGE_SIZE);
+	}
 #else
-		rc = arch_cpu_aspace_memory_write(tmp_va, hpa,
-						  src, page_write, cacheable);
+	while ((done < len) && (pages < HOST_MEM_RW_PAGES)) {
+		page_offset = (hpa + done) & VMM_PAGE_MASK;
+		chunk = HOST_MEM_RW_VA_SIZE - page_offset;
+		chunk = (chunk < (len - done)) ? chunk : (len - done);
+
+		if (is_write) {
+			rc = arch_cpu_aspace_memory_write(tmp_va, hpa + done,
+						buf + done, chunk, cacheable);
+		} else {
+			rc = arch_cpu_aspace_memory_read(tmp_va, hpa + done,
+						buf + done, chunk, cacheable);
+		}
 		if (rc) {
 			break;
 		}
+
+		done += chunk;
+		pages += VMM_SIZE_TO_PAGE(page_offset + chunk);
+	}
 #endif
 
-		arch_cpu_irq_restore(flags);
+	arch_cpu_irq_restore(flags);
 
-		hpa += page_write;
-		bytes_written += page_write;
-		src += page_write;
+	return done;
+}
+
+static u32 host_memory_rw(physical_addr_t hpa, void *buf, u32 len,
+			  bool cacheable, bool is_write)
+{
+	u32 done = 0, chunk;
+
+	while (done < len) {
+		chunk = host_memory_direct_rw(hpa + done, buf + done,
+					      len - done, cacheable, is_write);
+		if (!chunk) {
+			chunk = host_memory_window_rw(hpa + done, buf + done,
+						len - done, cacheable, is_write);
+		}
+		if (!chunk) {
+			break;
+		}
+
+		done += chunk;
 	}
 
-	return bytes_written;
+	return done;
+}
+
+u32 vmm_host_memory_read(physical_addr_t hpa,
+			 void *dst, u32 len, bool cacheable)
+{
+	return host_memory_rw(hpa, dst, len, cacheable, FALSE);
+}
+
+u32 vmm_host_memory_write(physical_addr_t hpa,
+			  void *src, u32 len, bool cacheable)
+{
+	return host_memory_rw(hpa, src, len, cacheable, TRUE);
 }
 
 u32 vmm_host_memory_set(physical_addr_t hpa,
@@ -826,7 +923,7 @@ int __cpuinit vmm_host_aspace_init(void)
 	/* Setup temporary virtual address for physical read/write */
 	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
 		rc = vmm_host_vapool_alloc(&host_mem_rw_va[cpu],
-					   VMM_PAGE_SIZE);
+					   HOST_MEM_RW_VA_SIZE);
 		if (rc) {
 			return rc;
 		}
@@ -32,6 +32,10 @@
 #include <libs/mathlib.h>
 #include <libs/bitmap.h>
 
+/* Frames of a bank are tracked by a bitmap (one bit per frame) and a
+ * summary bitmap (one bit per bitmap word) which marks fully allocated
+ * bitmap words so that searching for free frames can skip them.
+ */
 struct vmm_host_ram_bank {
 	physical_addr_t start;
 	physical_size_t size;
@@ -41,6 +45,9 @@ struct vmm_host_ram_bank {
 	unsigned long *bmap;
 	u32 bmap_sz;
 	u32 bmap_free;
+	unsigned long *smap;
+	u32 smap_count;
+	u32 smap_sz;
 
 	struct vmm_resource res;
 };
@@ -52,12 +59,105 @@ struct vmm_host_ram_ctrl {
 
 static struct vmm_host_ram_ctrl rctrl;
 
+/* Set or clear frames of a bank one bitmap word at a time */
+static void host_ram_bank_mark(struct vmm_host_ram_bank *bank,
+			       u32 bpos, u32 bcnt, bool used)
+{
+	u32 w, wend;
+	unsigned long mask;
+
+	if (!bcnt) {
+		return;
+	}
+
+	w = BIT_WORD(bpos);
+	wend = BIT_WORD(bpos + bcnt - 1);
+	for (; w <= wend; w++) {
+		mask = ~0UL;
+		if (w == BIT_WORD(bpos)) {
+			mask &= BITMAP_FIRST_WORD_MASK(bpos);
+		}
+		if (w == wend) {
+			mask &= BITMAP_LAST_WORD_MASK(bpos + bcnt);
+		}
+
+		if (used) {
+			bank->bmap[w] |= mask;
+			if (bank->bmap[w] == ~0UL) {
+				bitmap_setbit(bank->smap, w);
+			}
+		} else {
+			bank->bmap[w] &= ~mask;
+			bitmap_clearbit(bank->smap, w);
+		}
+	}
+}
+
+/* Find first free frame at or after given frame of a bank */
+static u32 host_ram_bank_next_free(struct vmm_host_ram_bank *bank, u32 bpos)
+{
+	u32 w, wlast;
+
+	while (bpos < bank->frame_count) {
+		w = find_next_zero_bit(bank->smap, bank->smap_count,
+				       BIT_WORD(bpos));
+		if (bank->smap_count <= w) {
+			break;
+		}
+
+		if (BIT_WORD(bpos) < w) {
+			bpos = w * BITS_PER_LONG;
+		}
+
+		wlast = (w + 1) * BITS_PER_LONG;
+		if (bank->frame_count < wlast) {
+			wlast = bank->frame_count;
+		}
+
+		bpos = find_next_zero_bit(bank->bmap, wlast, bpos);
+		if (bpos < wlast) {
+			return bpos;
+		}
+	}
+
+	return bank->frame_count;
+}
+
+/* Find first run of free frames with given frame alignment in a bank */
+static bool host_ram_bank_find(struct vmm_host_ram_bank *bank,
+			       u32 bcnt, u64 binc, u32 *bpos_out)
+{
+	u64 bpos = 0, boff, bused;
+	u64 start_frame = bank->start >> VMM_PAGE_SHIFT;
+
+	while (1) {
+		bpos = host_ram_bank_next_free(bank, (u32)bpos);
+
+		boff = (start_frame + bpos) & (binc - 1);
+		if (boff) {
+			bpos += binc - boff;
+		}
+
+		if (bank->frame_count < (bpos + bcnt)) {
+			return FALSE;
+		}
+
+		bused = find_next_bit(bank->bmap, bpos + bcnt, bpos);
+		if ((bpos + bcnt) <= bused) {
+			*bpos_out = bpos;
+			return TRUE;
+		}
+
+		bpos = bused + 1;
+	}
+}
+
 physical_size_t vmm_host_ram_alloc(physical_addr_t *pa,
 				   physical_size_t sz,
 				   u32 align_order)
 {
 	irq_flags_t flags;
-	u32 i, found, bn, binc, bcnt, bpos, bfree;
+	u32 bn, bcnt, bpos;
 	struct vmm_host_ram_bank *bank;
 
 	if ((sz == 0) ||
@@ -74,37 +174,16 @@ physical_size_t vmm_host_ram_alloc(physical_addr_t *pa,
 
 		vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
 
-		if (bank->bmap_free < bcnt) {
+		if ((bank->bmap_free < bcnt) ||
+		    !host_ram_bank_find(bank, bcnt,
+				order_size(align_order) >> VMM_PAGE_SHIFT,
+				&bpos)) {
 			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 			continue;
 		}
 
-		found = 0;
-		binc = order_size(align_order) >> VMM_PAGE_SHIFT;
-		bpos = bank->start & order_mask(align_order);
-		if (bpos) {
-			bpos = VMM_SIZE_TO_PAGE(order_size(align_order) - bpos);
-		}
-		for (; bpos < (bank->size >> VMM_PAGE_SHIFT); bpos += binc) {
-			bfree = 0;
-			for (i = bpos; i < (bpos + bcnt); i++) {
-				if (bitmap_isset(bank->bmap, i)) {
-					break;
-				}
-				bfree++;
-			}
-			if (bfree == bcnt) {
-				found = 1;
-				break;
-			}
-		}
-		if (!found) {
-			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
-			continue;
-		}
-
-		*pa = bank->start + bpos * VMM_PAGE_SIZE;
-		bitmap_set(bank->bmap, bpos, bcnt);
+		*pa = bank->start + (physical_addr_t)bpos * VMM_PAGE_SIZE;
+		host_ram_bank_mark(bank, bpos, bcnt, TRUE);
 		bank->bmap_free -= bcnt;
 
 		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
@@ -118,7 +197,7 @@ physical_size_t vmm_host_ram_alloc(physical_addr_t *pa,
 int vmm_host_ram_reserve(physical_addr_t pa, physical_size_t sz)
 {
 	int rc = VMM_EINVALID;
-	u32 i, bn, bcnt, bpos, bfree;
+	u32 bn, bcnt, bpos;
 	irq_flags_t flags;
 	struct vmm_host_ram_bank *bank;
 
@@ -141,21 +220,14 @@ int vmm_host_ram_reserve(physical_addr_t pa, physical_size_t sz)
 			break;
 		}
 
-		bfree = 0;
-		for (i = bpos; i < (bpos + bcnt); i++) {
-			if (bitmap_isset(bank->bmap, i)) {
-				break;
-			}
-			bfree++;
-		}
-
-		if (bfree != bcnt) {
+		if (find_next_bit(bank->bmap, bpos + bcnt, bpos) <
+							(bpos + bcnt)) {
 			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 			rc = VMM_ENOSPC;
 			break;
 		}
 
-		bitmap_set(bank->bmap, bpos, bcnt);
+		host_ram_bank_mark(bank, bpos, bcnt, TRUE);
 		bank->bmap_free -= bcnt;
 
 		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
@@ -187,7 +259,7 @@ int vmm_host_ram_free(physical_addr_t pa, physical_size_t sz)
 
 		vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
 
-		bitmap_clear(bank->bmap, bpos, bcnt);
+		host_ram_bank_mark(bank, bpos, bcnt, FALSE);
 		bank->bmap_free += bcnt;
 
 		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
@@ -312,7 +384,7 @@ u32 vmm_host_ram_bank_free_frames(u32 bank)
 virtual_size_t vmm_host_ram_estimate_hksize(void)
 {
 	int rc;
-	u32 bn, count;
+	u32 bn, count, frames;
 	virtual_size_t ret;
 	physical_size_t size;
 
@@ -329,7 +401,9 @@ virtual_size_t vmm_host_ram_estimate_hksize(void)
 			return ret;
 		}
 
-		ret += bitmap_estimate_size(size >> VMM_PAGE_SHIFT);
+		frames = size >> VMM_PAGE_SHIFT;
+		ret += bitmap_estimate_size(frames);
+		ret += bitmap_estimate_size(BITS_TO_LONGS(frames));
 	}
 
 	return ret;
@@ -379,6 +453,12 @@ int __init vmm_host_ram_init(virtual_addr_t hkbase)
 
 		bitmap_zero(bank->bmap, bank->frame_count);
 
+		bank->smap = (unsigned long *)(hkbase + bank->bmap_sz);
+		bank->smap_count = BITS_TO_LONGS(bank->frame_count);
+		bank->smap_sz = bitmap_estimate_size(bank->smap_count);
+
+		bitmap_zero(bank->smap, bank->smap_count);
+
 		bank->res.start = bank->start;
 		bank->res.end = bank->start + bank->size - 1;
 		bank->res.name = "System RAM";
@@ -388,7 +468,7 @@ int __init vmm_host_ram_init(virtual_addr_t hkbase)
 			return rc;
 		}
 
-		hkbase += bank->bmap_sz;
+		hkbase += bank->bmap_sz + bank->smap_sz;
 	}
 
 	return VMM_OK;
@@ -206,7 +206,7 @@ int __init vmm_host_vapool_init(virtual_addr_t base,
 
 	rc = buddy_allocator_init(&vpctrl.ba, (void *)hkbase,
 				  vmm_host_vapool_estimate_hksize(size),
-				  base, size, VAPOOL_MIN_BIN, VAPOOL_MAX_BIN);
+				  NULL, 0, base, size, VAPOOL_MIN_BIN, VAPOOL_MAX_BIN);
 	if (rc) {
 		return rc;
 	}
@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_lockstat.c
+ * @author Xvisor Developers
+ * @brief source file of spinlock contention statistics.
+ *
+ * Lock operations first try to take the lock. Only when that fails
+ * the wait time is measured and accounted to the lock class of the
+ * caller, so uncontended locks pay for one extra function call.
+ *
+ * NOTE: This file must not use vmm_spinlock_t because that would
+ * recurse into itself.
+ */
+
+#include <vmm_error.h>
+#include <vmm_smp.h>
+#include <vmm_timer.h>
+#include <vmm_compiler.h>
+#include <vmm_lockstat.h>
+#include <arch_cpu_irq.h>
+#include <arch_barrier.h>
+#include <arch_locks.h>
+#include <libs/stringlib.h>
+
+#define LOCKSTAT_SITES		CONFIG_LOCKSTAT_SITES
+
+/** Contention counters of one host CPU
+ *  Only updated by owning host CPU with interrupts disabled.
+ */
+struct lockstat_cpu {
+	u64 contended;
+	u64 wait_nsecs;
+	u64 wait_max_nsecs;
+};
+
+/** Lock class entry
+ *  An entry is claimed under table lock and never released except
+ *  by clear. Readers find claimed entries without any locking by
+ *  checking site which is published after type.
+ */
+struct lockstat_entry {
+	virtual_addr_t site;
+	u32 type;
+	struct lockstat_cpu cpu[CONFIG_CPU_COUNT];
+};
+
+struct lockstat_ctrl {
+	bool active;
+	arch_spinlock_t lock;
+	u64 dropped;
+	struct lockstat_entry table[LOCKSTAT_SITES];
+};
+
+static struct lockstat_ctrl lsctrl = {
+	.active = TRUE,
+	.lock = ARCH_SPIN_LOCK_INITIALIZER,
+};
+
+static u32 lockstat_hash(virtual_addr_t site, u32 type)
+{
+	u32 h = (u32)(site >> 2) ^ (type << 29);
+
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+
+	return h;
+}
+
+static struct lockstat_entry *lockstat_find(virtual_addr_t site, u32 type)
+{
+	u32 i, pos;
+	irq_flags_t flags;
+	struct lockstat_entry *e;
+
+	pos = lockstat_hash(site, type) % LOCKSTAT_SITES;
+
+	/* Lockless lookup of already claimed entry */
+	for (i = 0; i < LOCKSTAT_SITES; i++) {
+		e = &lsctrl.table[(pos + i) % LOCKSTAT_SITES];
+		if (!e->site) {
+			break;
+		}
+		arch_smp_rmb();
+		if ((e->site == site) && (e->type == type)) {
+			return e;
+		}
+	}
+
+	/* Claim new entry */
+	arch_cpu_irq_save(flags);
+	arch_spin_lock(&lsctrl.lock);
+	for (i = 0; i < LOCKSTAT_SITES; i++) {
+		e = &lsctrl.table[(pos + i) % LOCKSTAT_SITES];
+		if (!e->site) {
+			e->type = type;
+			arch_smp_wmb();
+			e->site = site;
+			break;
+		}
+		if ((e->site == site) && (e->type == type)) {
+			break;
+		}
+	}
+	if (i == LOCKSTAT_SITES) {
+		lsctrl.dropped++;
+		e = NULL;
+	}
+	arch_spin_unlock(&lsctrl.lock);
+	arch_cpu_irq_restore(flags);
+
+	return e;
+}
+
+static void lockstat_account(virtual_addr_t site, u32 type, u64 tstamp)
+{
+	u64 wait;
+	irq_flags_t flags;
+	struct lockstat_cpu *c;
+	struct lockstat_entry *e;
+
+	wait = vmm_timer_timestamp();
+	wait = (tstamp < wait) ? (wait - tstamp) : 0;
+
+	e = lockstat_find(site, type);
+	if (!e) {
+		return;
+	}
+
+	arch_cpu_irq_save(flags);
+	c = &e->cpu[vmm_smp_processor_id()];
+	c->contended++;
+	c->wait_nsecs += wait;
+	if (c->wait_max_nsecs < wait) {
+		c->wait_max_nsecs = wait;
+	}
+	arch_cpu_irq_restore(flags);
+}
+
+void __noinline vmm_lockstat_spin_lock(arch_spinlock_t *lock)
+{
+	u64 tstamp;
+
+	if (arch_spin_trylock(lock)) {
+		return;
+	}
+
+	if (!lsctrl.active) {
+		arch_spin_lock(lock);
+		return;
+	}
+
+	tstamp = vmm_timer_timestamp();
+	arch_spin_lock(lock);
+	lockstat_account((virtual_addr_t)__builtin_return_address(0),
+			 VMM_LOCKSTAT_SPIN, tstamp);
+}
+
+void __noinline vmm_lockstat_read_lock(arch_rwlock_t *lock)
+{
+	u64 tstamp;
+
+	if (arch_read_trylock(lock)) {
+		return;
+	}
+
+	if (!lsctrl.active) {
+		arch_read_lock(lock);
+		return;
+	}
+
+	tstamp = vmm_timer_timestamp();
+	arch_read_lock(lock);
+	lockstat_account((virtual_addr_t)__builtin_return_address(0),
+			 VMM_LOCKSTAT_READ, tstamp);
+}
+
+void __noinline vmm_lockstat_write_lock(arch_rwlock_t *lock)
+{
+	u64 tstamp;
+
+	if (arch_write_trylock(lock)) {
+		return;
+	}
+
+	if (!lsctrl.active) {
+		arch_write_lock(lock);
+		return;
+	}
+
+	tstamp = vmm_timer_timestamp();
+	arch_write_lock(lock);
+	lockstat_account((virtual_addr_t)__builtin_return_address(0),
+			 VMM_LOCKSTAT_WRITE, tstamp);
+}
+
+bool vmm_lockstat_isactive(void)
+{
+	return lsctrl.active;
+}
+
+void vmm_lockstat_set_active(bool active)
+{
+	lsctrl.active = active;
+	arch_smp_wmb();
+}
+
+u32 vmm_lockstat_max_count(void)
+{
+	return LOCKSTAT_SITES;
+}
+
+u64 vmm_lockstat_dropped(void)
+{
+	return lsctrl.dropped;
+}
+
+int vmm_lockstat_get(u32 index, struct vmm_lockstat_info *info)
+{
+	u32 c;
+	struct lockstat_entry *e;
+
+	if ((LOCKSTAT_SITES <= index) || !info) {
+		return VMM_EINVALID;
+	}
+
+	e = &lsctrl.table[index];
+	if (!e->site) {
+		return VMM_ENOTAVAIL;
+	}
+	arch_smp_rmb();
+
+	memset(info, 0, sizeof(*info));
+	info->site = e->site;
+	info->type = e->type;
+	for (c = 0; c < CONFIG_CPU_COUNT; c++) {
+		info->contended += e->cpu[c].contended;
+		info->wait_nsecs += e->cpu[c].wait_nsecs;
+		if (info->wait_max_nsecs < e->cpu[c].wait_max_nsecs) {
+			info->wait_max_nsecs = e->cpu[c].wait_max_nsecs;
+		}
+	}
+
+	return VMM_OK;
+}
+
+void vmm_lockstat_clear(void)
+{
+	bool active;
+	irq_flags_t flags;
+
+	/* Entries can be updated by other host CPUs while we clear
+	 * them so stop recording till we are done.
+	 */
+	active = lsctrl.active;
+	vmm_lockstat_set_active(FALSE);
+
+	arch_cpu_irq_save(flags);
+	arch_spin_lock(&lsctrl.lock);
+	memset(lsctrl.table, 0, sizeof(lsctrl.table));
+	lsctrl.dropped = 0;
+	arch_spin_unlock(&lsctrl.lock);
+	arch_cpu_irq_restore(flags);
+
+	vmm_lockstat_set_active(active);
+}
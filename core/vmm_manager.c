@@ -1241,6 +1241,9 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 		vcpu->cpu_affinity = cpu_online_mask;
 		vcpu->sched_priv = NULL;
 
+		/* Initialize guest region cache */
+		memset(&vcpu->reg_cache, 0, sizeof(vcpu->reg_cache));
+
 		/* Initialize static scheduling context */
 		if (vmm_devtree_read_u32(vnode,
 			VMM_DEVTREE_PRIORITY_ATTR_NAME, &val)) {
@@ -23,9 +23,24 @@
 
 #include <vmm_error.h>
 #include <vmm_stdio.h>
+#include <vmm_smp.h>
+#include <vmm_timer.h>
 #include <vmm_scheduler.h>
 #include <vmm_mutex.h>
 #include <arch_cpu_irq.h>
+#include <arch_barrier.h>
+
+static u64 mutex_spin_nsecs = CONFIG_MUTEX_SPIN_NSECS;
+
+u64 vmm_mutex_get_spin_nsecs(void)
+{
+	return mutex_spin_nsecs;
+}
+
+void vmm_mutex_set_spin_nsecs(u64 nsecs)
+{
+	mutex_spin_nsecs = nsecs;
+}
 
 bool vmm_mutex_avail(struct vmm_mutex *mut)
 {
@@ -100,6 +115,64 @@ int vmm_mutex_trylock(struct vmm_mutex *mut)
 	return ret;
 }
 
+/* Spin while mutex owner is running on some other host CPU because
+ * it will most likely release the mutex before we are done with
+ * sleeping and waking up. Returns TRUE if mutex was acquired.
+ */
+static bool mutex_optimistic_spin(struct vmm_mutex *mut, u64 *timeout)
+{
+	bool ret = FALSE;
+	u64 tstamp, now, spin_nsecs = mutex_spin_nsecs;
+	struct vmm_vcpu *owner, *current;
+
+	if (timeout && (*timeout < spin_nsecs)) {
+		spin_nsecs = *timeout;
+	}
+	if (!spin_nsecs || (vmm_num_online_cpus() < 2)) {
+		return FALSE;
+	}
+
+	tstamp = vmm_timer_timestamp();
+	if (!tstamp) {
+		return FALSE;
+	}
+
+	current = vmm_scheduler_current_vcpu();
+	now = tstamp;
+	while ((now - tstamp) < spin_nsecs) {
+		if (!mut->lock) {
+			if (vmm_mutex_trylock(mut)) {
+				ret = TRUE;
+				break;
+			}
+		} else {
+			/* Owner is read without holding wait queue lock
+			 * so it can be stale. This is harmless because
+			 * VCPU instances are never freed (they live in
+			 * manager VCPU array). Owner is NULL for a short
+			 * window while mutex is being taken.
+			 */
+			owner = mut->owner;
+			if (owner == current) {
+				break;
+			}
+			if (owner && (vmm_manager_vcpu_get_state(owner) !=
+						VMM_VCPU_STATE_RUNNING)) {
+				break;
+			}
+		}
+		arch_cpu_relax();
+		now = vmm_timer_timestamp();
+	}
+
+	if (timeout) {
+		*timeout -= ((now - tstamp) < *timeout) ?
+						(now - tstamp) : *timeout;
+	}
+
+	return ret;
+}
+
 static int mutex_lock_common(struct vmm_mutex *mut, u64 *timeout)
 {
 	int rc = VMM_OK;
@@ -108,6 +181,10 @@ static int mutex_lock_common(struct vmm_mutex *mut, u64 *timeout)
 	BUG_ON(!mut);
 	BUG_ON(!vmm_scheduler_orphan_context());
 
+	if (mut->lock && mutex_optimistic_spin(mut, timeout)) {
+		return VMM_OK;
+	}
+
 	vmm_spin_lock_irqsave(&mut->wq.lock, flags);
 
 	while (mut->lock) {
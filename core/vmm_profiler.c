@@ -22,201 +22,241 @@
  */
 
 #include <vmm_profiler.h>
-#include <vmm_heap.h>
 #include <vmm_error.h>
+#include <vmm_host_aspace.h>
 #include <vmm_timer.h>
-#include <vmm_stdio.h>
 #include <vmm_smp.h>
-#include <arch_cpu.h>
-#include <arch_atomic.h>
-#include <arch_atomic64.h>
-#include <libs/stringlib.h>
-#include <libs/kallsyms.h>
-
-typedef void (*vmm_profile_callback_t) (void *, void *);
+#include <vmm_percpu.h>
+#include <vmm_cpumask.h>
+#include <vmm_manager.h>
+#include <vmm_scheduler.h>
+#include <arch_regs.h>
+#include <arch_vcpu.h>
+#include <arch_barrier.h>
+#include <libs/stacktrace.h>
+
+/** Per host CPU profiler state
+ *  Samples are written only by timer interrupt of owning host CPU
+ *  and the sample count is published after sample contents so that
+ *  readers don't need any locking.
+ */
+struct vmm_profiler_cpu {
+	struct vmm_timer_event ev;
+	struct vmm_profiler_sample *samples;
+	u32 count;
+	u32 dropped;
+};
 
 struct vmm_profiler_ctrl {
 	bool is_active;
-	bool is_in_trace[CONFIG_CPU_COUNT];
-	struct vmm_profiler_stat *stat;
+	u64 period_nsecs;
+	u32 stack_depth;
+	u32 max_samples;
+	u32 sample_page_count;
 };
 
 static struct vmm_profiler_ctrl pctrl;
+static DEFINE_PER_CPU(struct vmm_profiler_cpu, pcpu);
 
-static __notrace void vmm_profile_none(void *ip, void *parent_ip)
+static void profiler_record(struct vmm_profiler_cpu *p)
 {
-	// Default NULL function
-}
+	arch_regs_t *regs;
+	struct vmm_vcpu *vcpu;
+	struct stack_trace trace;
+	struct vmm_profiler_sample *s;
 
-static vmm_profile_callback_t _vmm_profile_enter = vmm_profile_none;
-static vmm_profile_callback_t _vmm_profile_exit = vmm_profile_none;
+	regs = vmm_scheduler_irq_regs();
+	if (!regs) {
+		return;
+	}
 
-void __notrace __cyg_profile_func_enter(void *ip, void *parent_ip)
-{
-	(*_vmm_profile_enter) (ip, parent_ip);
-}
+	if (p->count >= pctrl.max_samples) {
+		p->dropped++;
+		return;
+	}
 
-void __notrace __cyg_profile_func_exit(void *ip, void *parent_ip)
-{
-	(*_vmm_profile_exit) (ip, parent_ip);
+	s = &p->samples[p->count];
+	vcpu = vmm_scheduler_current_vcpu();
+	s->vcpu_id = (vcpu) ? vcpu->id : VMM_PROFILER_NO_VCPU;
+	s->pc = arch_regs_pc(regs);
+	s->depth = 0;
+
+	if (vcpu && vcpu->is_normal) {
+		s->type = VMM_PROFILER_SAMPLE_GUEST;
+	} else {
+		s->type = VMM_PROFILER_SAMPLE_HOST;
+		if (pctrl.stack_depth) {
+			trace.nr_entries = 0;
+			trace.max_entries = pctrl.stack_depth;
+			trace.entries = (unsigned long *)s->stack;
+			trace.skip = 0;
+			arch_save_stacktrace_regs(regs, &trace);
+			s->depth = trace.nr_entries;
+		}
+	}
+
+	/* Publish sample only after it is completely written */
+	arch_smp_wmb();
+	p->count++;
 }
 
-static void __notrace vmm_profile_enter(void *ip, void *parent_ip)
+static void profiler_sample_event(struct vmm_timer_event *ev)
 {
-	int index, parent_index, i;
-	struct vmm_profiler_counter *ptr;
-	int cpu_id = vmm_smp_processor_id();
+	struct vmm_profiler_cpu *p = ev->priv;
 
-	if (pctrl.is_in_trace[cpu_id])
+	if (!pctrl.is_active) {
 		return;
+	}
 
-	pctrl.is_in_trace[cpu_id] = TRUE;
-
-	index = kallsyms_get_symbol_pos((long unsigned int)ip, NULL, NULL);
-	parent_index =
-	    kallsyms_get_symbol_pos((long unsigned int)parent_ip, NULL, NULL);
-
- retry:
-	i = 0;
+	profiler_record(p);
 
-	while (pctrl.stat[index].counter[i].parent_index
-	       && (i < (VMM_PROFILE_OTHER_INDEX))) {
-		if (pctrl.stat[index].counter[i].parent_index == parent_index) {
-			break;
-		}
-		i++;
-	}
+	vmm_timer_event_start(ev, pctrl.period_nsecs);
+}
 
-	if (i < VMM_PROFILE_OTHER_INDEX) {
-		if (pctrl.stat[index].counter[i].parent_index == 0) {
-			pctrl.stat[index].counter[i].parent_index =
-			    parent_index;
-			goto retry;
-		} else {
-			ptr = &pctrl.stat[index].counter[i];
-		}
-	} else {
-		ptr = &pctrl.stat[index].counter[VMM_PROFILE_OTHER_INDEX];
-	}
+static void profiler_start_local(void *arg0, void *arg1, void *arg2)
+{
+	struct vmm_profiler_cpu *p = &this_cpu(pcpu);
 
-	arch_atomic_add(&ptr->count, 1);
-	/*
-	 * we use time_per_call as a temporary variable, it will be
-	 * filled in later on with a meaningfull value.
-	 */
-	arch_atomic64_add(&ptr->time_per_call, vmm_timer_timestamp_for_profile());
+	p->count = 0;
+	p->dropped = 0;
+	arch_smp_wmb();
 
-	pctrl.is_in_trace[cpu_id] = FALSE;
+	vmm_timer_event_start(&p->ev, pctrl.period_nsecs);
 }
 
-static void __notrace vmm_profile_exit(void *ip, void *parent_ip)
+bool vmm_profiler_isactive(void)
 {
-	int index, parent_index, i;
-	u64 time, previous;
-	struct vmm_profiler_counter *ptr;
-	int cpu_id = vmm_smp_processor_id();
-
-	if (pctrl.is_in_trace[cpu_id])
-		return;
+	return pctrl.is_active;
+}
 
-	pctrl.is_in_trace[cpu_id] = TRUE;
+int vmm_profiler_start(u64 period_nsecs, u32 stack_depth)
+{
+	u32 cpu;
+	struct vmm_profiler_cpu *p;
 
-	index = kallsyms_get_symbol_pos((long unsigned int)ip, NULL, NULL);
-	parent_index =
-	    kallsyms_get_symbol_pos((long unsigned int)parent_ip, NULL, NULL);
+	if (vmm_profiler_isactive()) {
+		return VMM_EBUSY;
+	}
 
-	i = 0;
+	if (!period_nsecs) {
+		period_nsecs = VMM_PROFILER_DEFAULT_PERIOD_NSECS;
+	}
+	if (period_nsecs < VMM_PROFILER_MIN_PERIOD_NSECS) {
+		return VMM_EINVALID;
+	}
+	if (stack_depth > VMM_PROFILER_MAX_DEPTH) {
+		return VMM_EINVALID;
+	}
 
-	while (pctrl.stat[index].counter[i].parent_index
-	       && (i < (VMM_PROFILE_OTHER_INDEX))) {
-		if (pctrl.stat[index].counter[i].parent_index == parent_index) {
-			break;
+	/* Sample buffers are allocated on first use and never freed */
+	for_each_online_cpu(cpu) {
+		p = &per_cpu(pcpu, cpu);
+		if (p->samples) {
+			continue;
+		}
+		p->samples = (struct vmm_profiler_sample *)
+			vmm_host_alloc_pages(pctrl.sample_page_count,
+					     VMM_MEMORY_FLAGS_NORMAL);
+		if (!p->samples) {
+			return VMM_ENOMEM;
 		}
-		i++;
 	}
 
-	if (i < VMM_PROFILE_OTHER_INDEX) {
-		if (pctrl.stat[index].counter[i].parent_index == 0) {
-			goto out;
-		} else {
-			ptr = &pctrl.stat[index].counter[i];
-		}
-	} else {
-		ptr = &pctrl.stat[index].counter[VMM_PROFILE_OTHER_INDEX];
+	pctrl.period_nsecs = period_nsecs;
+	pctrl.stack_depth = stack_depth;
+	arch_smp_wmb();
+	pctrl.is_active = TRUE;
+
+	return vmm_smp_ipi_sync_call(cpu_online_mask, 1000,
+				     profiler_start_local, NULL, NULL, NULL);
+}
+
+int vmm_profiler_stop(void)
+{
+	u32 cpu;
+
+	if (!vmm_profiler_isactive()) {
+		return VMM_EFAIL;
 	}
 
-	time = vmm_timer_timestamp_for_profile();
-	previous = arch_atomic64_read(&ptr->time_per_call);
+	pctrl.is_active = FALSE;
+	arch_smp_wmb();
 
-	/*
-	 * we use time_per_call as a temporary variable, it will be
-	 * filled in later on with a meaningfull value.
-	 */
-	if (time >= previous) {
-		arch_atomic64_add(&ptr->total_time, time - previous);
-		arch_atomic64_sub(&ptr->time_per_call, previous);
-	} else {
-		arch_atomic64_sub(&ptr->time_per_call, time);
+	for_each_possible_cpu(cpu) {
+		vmm_timer_event_stop(&per_cpu(pcpu, cpu).ev);
 	}
 
- out:
-	pctrl.is_in_trace[cpu_id] = FALSE;
+	return VMM_OK;
 }
 
-bool __notrace vmm_profiler_isactive(void)
+u64 vmm_profiler_period(void)
 {
-	return pctrl.is_active;
+	return pctrl.period_nsecs;
 }
 
-int __notrace vmm_profiler_start(void)
+u32 vmm_profiler_stack_depth(void)
 {
-	if (!vmm_profiler_isactive()) {
-		int i;
-
-		for (i = 0; i < CONFIG_CPU_COUNT; i++) {
-			pctrl.is_in_trace[i] = FALSE;
-		}
+	return pctrl.stack_depth;
+}
 
-		memset(pctrl.stat, 0,
-		       sizeof(struct vmm_profiler_stat) * kallsyms_num_syms);
+u32 vmm_profiler_max_samples(void)
+{
+	return pctrl.max_samples;
+}
 
-		_vmm_profile_enter = vmm_profile_enter;
-		_vmm_profile_exit = vmm_profile_exit;
+u32 vmm_profiler_sample_count(u32 cpu)
+{
+	u32 ret;
+	struct vmm_profiler_cpu *p;
 
-		pctrl.is_active = TRUE;
-	} else {
-		return VMM_EFAIL;
+	if (CONFIG_CPU_COUNT <= cpu) {
+		return 0;
 	}
 
-	return VMM_OK;
+	p = &per_cpu(pcpu, cpu);
+	ret = (p->samples) ? p->count : 0;
+	arch_smp_rmb();
+
+	return ret;
 }
 
-int __notrace vmm_profiler_stop(void)
+u32 vmm_profiler_dropped_count(u32 cpu)
 {
-	if (vmm_profiler_isactive()) {
-		pctrl.is_active = FALSE;
-
-		_vmm_profile_enter = vmm_profile_none;
-		_vmm_profile_exit = vmm_profile_none;
-	} else {
-		return VMM_EFAIL;
+	if (CONFIG_CPU_COUNT <= cpu) {
+		return 0;
 	}
 
-	return VMM_OK;
+	return per_cpu(pcpu, cpu).dropped;
 }
 
-struct vmm_profiler_stat *vmm_profiler_get_stat_array(void)
+struct vmm_profiler_sample *vmm_profiler_sample(u32 cpu, u32 index)
 {
-	return pctrl.stat;
+	if (vmm_profiler_sample_count(cpu) <= index) {
+		return NULL;
+	}
+
+	return &per_cpu(pcpu, cpu).samples[index];
 }
 
 int __init vmm_profiler_init(void)
 {
-	pctrl.stat =
-	    vmm_zalloc(sizeof(struct vmm_profiler_stat) * kallsyms_num_syms);
-
-	if (pctrl.stat == NULL) {
-		return VMM_EFAIL;
+	u32 cpu;
+	struct vmm_profiler_cpu *p;
+
+	pctrl.is_active = FALSE;
+	pctrl.period_nsecs = VMM_PROFILER_DEFAULT_PERIOD_NSECS;
+	pctrl.stack_depth = 0;
+	pctrl.sample_page_count = VMM_SIZE_TO_PAGE(CONFIG_PROFILE_SAMPLES *
+					sizeof(struct vmm_profiler_sample));
+	pctrl.max_samples = (pctrl.sample_page_count * VMM_PAGE_SIZE) /
+					sizeof(struct vmm_profiler_sample);
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		p = &per_cpu(pcpu, cpu);
+		INIT_TIMER_EVENT(&p->ev, profiler_sample_event, p);
+		p->samples = NULL;
+		p->count = 0;
+		p->dropped = 0;
 	}
 
 	return VMM_OK;
@@ -64,6 +64,9 @@ struct vmm_scheduler_ctrl {
 	u64 sample_idle_last_ns;
 	u64 sample_irq_ns;
 	u64 sample_irq_last_ns;
+	u64 dispatch_tstamp;
+	u64 dispatch_slice_ns;
+	struct vmm_scheduler_stats stats;
 };
 
 static DEFINE_PER_CPU(struct vmm_scheduler_ctrl, sched);
@@ -134,6 +137,65 @@ static u32 rq_length(struct vmm_scheduler_ctrl *schedp, u32 priority)
 	return ret;
 }
 
+static u32 sched_stats_bucket(u64 nsecs)
+{
+	u32 b = 0;
+
+	nsecs >>= VMM_SCHEDULER_HIST_SHIFT;
+	while (nsecs && (b < (VMM_SCHEDULER_HIST_BUCKETS - 1))) {
+		nsecs >>= 1;
+		b++;
+	}
+
+	return b;
+}
+
+/* NOTE: Must be called on owning host CPU with next->sched_lock held
+ * and before next->state_tstamp is updated
+ */
+static void sched_stats_dispatch(struct vmm_scheduler_ctrl *schedp,
+				 struct vmm_vcpu *next,
+				 u64 tstamp, u64 time_slice, bool switched)
+{
+	u64 wait_ns = tstamp - next->state_tstamp;
+	struct vmm_vcpu_sched_stats *vs = &next->sched_stats;
+
+	schedp->dispatch_tstamp = tstamp;
+	schedp->dispatch_slice_ns = time_slice;
+
+	/* Current VCPU picked again only gets a new time slice */
+	if (!switched) {
+		return;
+	}
+
+	vs->dispatch_count++;
+	vs->wait_nsecs += wait_ns;
+	if (vs->wait_max_nsecs < wait_ns) {
+		vs->wait_max_nsecs = wait_ns;
+	}
+
+	/* Idle VCPU waiting in ready queue is not a latency */
+	if (next != schedp->idle_vcpu) {
+		schedp->stats.wait_hist[sched_stats_bucket(wait_ns)]++;
+	}
+}
+
+/* NOTE: Must be called on owning host CPU with current->sched_lock held */
+static void sched_stats_undispatch(struct vmm_scheduler_ctrl *schedp,
+				   struct vmm_vcpu *current, u64 tstamp)
+{
+	u64 used_ns = tstamp - schedp->dispatch_tstamp;
+	struct vmm_vcpu_sched_stats *vs = &current->sched_stats;
+
+	vs->slice_nsecs += schedp->dispatch_slice_ns;
+	vs->slice_used_nsecs += (used_ns < schedp->dispatch_slice_ns) ?
+					used_ns : schedp->dispatch_slice_ns;
+
+	if (current != schedp->idle_vcpu) {
+		schedp->stats.slice_hist[sched_stats_bucket(used_ns)]++;
+	}
+}
+
 /* Should not be called from anywhere else */
 static struct vmm_vcpu *__vmm_scheduler_next1(struct vmm_scheduler_ctrl *schedp,
 					      arch_regs_t *regs)
@@ -153,6 +215,7 @@ static struct vmm_vcpu *__vmm_scheduler_next1(struct vmm_scheduler_ctrl *schedp,
 	vmm_write_lock_irqsave_lite(&next->sched_lock, nf);
 
 	arch_vcpu_switch(NULL, next, regs);
+	sched_stats_dispatch(schedp, next, tstamp, next_time_slice, TRUE);
 	next->state_ready_nsecs += tstamp - next->state_tstamp;
 	arch_atomic_write(&next->state, VMM_VCPU_STATE_RUNNING);
 	next->resumed = FALSE;
@@ -174,6 +237,7 @@ static struct vmm_vcpu *__vmm_scheduler_next2(struct vmm_scheduler_ctrl *schedp,
 	int rc;
 	irq_flags_t nf = 0;
 	u32 current_state;
+	bool requeued = FALSE;
 	u64 tstamp = vmm_timer_timestamp();
 	u64 next_time_slice = VMM_VCPU_DEF_TIME_SLICE;
 	struct vmm_vcpu *next = NULL;
@@ -183,6 +247,7 @@ static struct vmm_vcpu *__vmm_scheduler_next2(struct vmm_scheduler_ctrl *schedp,
 	current_state = arch_atomic_read(&current->state);
 
 	if (current_state & VMM_VCPU_STATE_SAVEABLE) {
+		sched_stats_undispatch(schedp, current, tstamp);
 		if (current_state == VMM_VCPU_STATE_RUNNING) {
 			current->state_running_nsecs +=
 				tstamp - current->state_tstamp;
@@ -192,6 +257,7 @@ static struct vmm_vcpu *__vmm_scheduler_next2(struct vmm_scheduler_ctrl *schedp,
 			arch_atomic_write(&current->state, VMM_VCPU_STATE_READY);
 			current->state_tstamp = tstamp;
 			rq_enqueue(schedp, current);
+			requeued = TRUE;
 		}
 		tcurrent = current;
 	}
@@ -205,8 +271,15 @@ static struct vmm_vcpu *__vmm_scheduler_next2(struct vmm_scheduler_ctrl *schedp,
 	if (next != current) {
 		vmm_write_lock_irqsave_lite(&next->sched_lock, nf);
 		arch_vcpu_switch(tcurrent, next, regs);
+		schedp->stats.switch_count++;
+		if (requeued) {
+			current->sched_stats.preempted_count++;
+			schedp->stats.preempt_count++;
+		}
 	}
 
+	sched_stats_dispatch(schedp, next, tstamp, next_time_slice,
+			     (next != current) ? TRUE : FALSE);
 	next->state_ready_nsecs += tstamp - next->state_tstamp;
 	arch_atomic_write(&next->state, VMM_VCPU_STATE_RUNNING);
 	next->resumed = FALSE;
@@ -489,6 +562,8 @@ int vmm_scheduler_state_change(struct vmm_vcpu *vcpu, u32 new_state,
 			vcpu->state_running_nsecs = 0;
 			vcpu->state_paused_nsecs = 0;
 			vcpu->state_halted_nsecs = 0;
+			memset(&vcpu->sched_stats, 0,
+			       sizeof(vcpu->sched_stats));
 			vcpu->reset_tstamp = tstamp;
 		}
 		arch_atomic_write(&vcpu->state, new_state);
@@ -583,6 +658,8 @@ static void scheduler_ipi_migrate_vcpu(void *arg0, void *arg1, void *arg2)
 	/* Enqueue VCPU to new hcpu ready queue */
 	vcpu->hcpu = new_hcpu;
 	rq_enqueue(&per_cpu(sched, new_hcpu), vcpu);
+	vcpu->sched_stats.migrate_count++;
+	per_cpu(sched, old_hcpu).stats.migrate_count++;
 
 	/* Trigger re-scheduling on new hcpu */
 	vmm_scheduler_force_resched(new_hcpu);
@@ -627,6 +704,7 @@ int vmm_scheduler_set_hcpu(struct vmm_vcpu *vcpu, u32 hcpu)
 		migrate_vcpu = TRUE;
 	} else {
 		vcpu->hcpu = hcpu;
+		vcpu->sched_stats.migrate_count++;
 	}
 
 	/* Unlock VCPU scheduling */
@@ -700,6 +778,11 @@ bool vmm_scheduler_irq_context(void)
 	return this_cpu(sched).irq_context;
 }
 
+arch_regs_t *vmm_scheduler_irq_regs(void)
+{
+	return this_cpu(sched).irq_regs;
+}
+
 bool vmm_scheduler_orphan_context(void)
 {
 	bool ret = FALSE;
@@ -854,6 +937,63 @@ u64 vmm_scheduler_idle_time(u32 hcpu)
 	return ret;
 }
 
+int vmm_scheduler_vcpu_stats(struct vmm_vcpu *vcpu,
+			     struct vmm_vcpu_sched_stats *stats)
+{
+	irq_flags_t flags;
+
+	if (!vcpu || !stats) {
+		return VMM_EFAIL;
+	}
+
+	vmm_read_lock_irqsave_lite(&vcpu->sched_lock, flags);
+	memcpy(stats, &vcpu->sched_stats, sizeof(*stats));
+	vmm_read_unlock_irqrestore_lite(&vcpu->sched_lock, flags);
+
+	return VMM_OK;
+}
+
+int vmm_scheduler_stats(u32 hcpu, struct vmm_scheduler_stats *stats)
+{
+	if (!stats) {
+		return VMM_EFAIL;
+	}
+	if ((CONFIG_CPU_COUNT <= hcpu) ||
+	    !vmm_cpu_online(hcpu)) {
+		return VMM_EINVALID;
+	}
+
+	memcpy(stats, &per_cpu(sched, hcpu).stats, sizeof(*stats));
+
+	return VMM_OK;
+}
+
+static void scheduler_ipi_stats_clear(void *dummy0, void *dummy1,
+				      void *dummy2)
+{
+	irq_flags_t flags;
+	struct vmm_scheduler_ctrl *schedp = &this_cpu(sched);
+
+	/* Statistics are only written by owning host CPU
+	 * with interrupts disabled so clear them the same way.
+	 */
+	arch_cpu_irq_save(flags);
+	memset(&schedp->stats, 0, sizeof(schedp->stats));
+	arch_cpu_irq_restore(flags);
+}
+
+int vmm_scheduler_stats_clear(u32 hcpu)
+{
+	if ((CONFIG_CPU_COUNT <= hcpu) ||
+	    !vmm_cpu_online(hcpu)) {
+		return VMM_EINVALID;
+	}
+
+	return vmm_smp_ipi_sync_call(vmm_cpumask_of(hcpu), 1000,
+				     scheduler_ipi_stats_clear,
+				     NULL, NULL, NULL);
+}
+
 struct vmm_vcpu *vmm_scheduler_idle_vcpu(u32 hcpu)
 {
 	if ((CONFIG_CPU_COUNT <= hcpu) ||
@@ -967,6 +1107,11 @@ int __cpuinit vmm_scheduler_init(void)
 	schedp->sample_irq_ns = 0;
 	schedp->sample_irq_last_ns = 0;
 
+	/* Initialize scheduling statistics (Per Host CPU) */
+	schedp->dispatch_tstamp = 0;
+	schedp->dispatch_slice_ns = 0;
+	memset(&schedp->stats, 0, sizeof(schedp->stats));
+
 	/* Create idle orphan vcpu with default time slice. (Per Host CPU) */
 	vmm_snprintf(vcpu_name, sizeof(vcpu_name), "idle/%d", cpu);
 	schedp->idle_vcpu = vmm_manager_vcpu_orphan_create(vcpu_name,
@@ -0,0 +1,350 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_slab.c
+ * @author Xvisor Developers
+ * @brief object cache (slab) allocator built on host pages
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_smp.h>
+#include <vmm_stdio.h>
+#include <vmm_host_aspace.h>
+#include <vmm_slab.h>
+#include <arch_cpu_irq.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+
+/** Slab header placed at the start of slab pages */
+struct vmm_slab {
+	struct dlist head;
+	virtual_addr_t base;
+};
+
+#define SLAB_NEXT(cache, obj)	\
+	(*(void **)((virtual_addr_t)(obj) + (cache)->free_off))
+
+static LIST_HEAD(slab_cache_list);
+static DEFINE_SPINLOCK(slab_cache_lock);
+
+static u32 slab_hdr_size(struct vmm_slab_cache *cache)
+{
+	return align(sizeof(struct vmm_slab), cache->obj_align);
+}
+
+/* NOTE: This function must be called with depot_lock held */
+static int slab_grow(struct vmm_slab_cache *cache)
+{
+	u32 i;
+	void *obj;
+	virtual_addr_t va;
+	struct vmm_slab *slab;
+
+	va = vmm_host_alloc_pages(cache->slab_pages,
+				  VMM_MEMORY_FLAGS_NORMAL);
+	if (!va) {
+		return VMM_ENOMEM;
+	}
+
+	slab = (struct vmm_slab *)va;
+	INIT_LIST_HEAD(&slab->head);
+	slab->base = va;
+
+	obj = (void *)(va + slab_hdr_size(cache));
+	for (i = 0; i < cache->slab_objs; i++) {
+		if (cache->ctor) {
+			cache->ctor(obj);
+		}
+		SLAB_NEXT(cache, obj) = cache->depot_free;
+		cache->depot_free = obj;
+		cache->depot_count++;
+		obj = (void *)((virtual_addr_t)obj + cache->obj_stride);
+	}
+
+	list_add_tail(&slab->head, &cache->slab_list);
+	cache->slab_count++;
+
+	return VMM_OK;
+}
+
+/* NOTE: This function must be called with interrupts disabled */
+static void slab_refill(struct vmm_slab_cache *cache,
+			struct vmm_slab_cpu *c)
+{
+	u32 i;
+	void *obj;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave_lite(&cache->depot_lock, flags);
+
+	if (!cache->depot_count) {
+		slab_grow(cache);
+	}
+
+	for (i = 0; (i < VMM_SLAB_CPU_BATCH) && cache->depot_count; i++) {
+		obj = cache->depot_free;
+		cache->depot_free = SLAB_NEXT(cache, obj);
+		cache->depot_count--;
+		SLAB_NEXT(cache, obj) = c->free;
+		c->free = obj;
+		c->count++;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&cache->depot_lock, flags);
+}
+
+/* NOTE: This function must be called with interrupts disabled */
+static void slab_flush(struct vmm_slab_cache *cache,
+		       struct vmm_slab_cpu *c, u32 count)
+{
+	void *obj;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave_lite(&cache->depot_lock, flags);
+
+	while (c->count && count) {
+		obj = c->free;
+		c->free = SLAB_NEXT(cache, obj);
+		c->count--;
+		SLAB_NEXT(cache, obj) = cache->depot_free;
+		cache->depot_free = obj;
+		cache->depot_count++;
+		count--;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&cache->depot_lock, flags);
+
+	c->flush++;
+}
+
+void *vmm_slab_alloc(struct vmm_slab_cache *cache)
+{
+	void *obj;
+	irq_flags_t flags;
+	struct vmm_slab_cpu *c;
+
+	if (!cache) {
+		return NULL;
+	}
+
+	arch_cpu_irq_save(flags);
+
+	c = &cache->cpu[vmm_smp_processor_id()];
+	if (c->free) {
+		c->alloc_hit++;
+	} else {
+		c->alloc_miss++;
+		slab_refill(cache, c);
+	}
+
+	obj = c->free;
+	if (obj) {
+		c->free = SLAB_NEXT(cache, obj);
+		c->count--;
+	}
+
+	arch_cpu_irq_restore(flags);
+
+	return obj;
+}
+
+void *vmm_slab_zalloc(struct vmm_slab_cache *cache)
+{
+	void *obj;
+
+	/* Zero set would wipe out state built by constructor */
+	if (!cache || cache->ctor) {
+		return NULL;
+	}
+
+	obj = vmm_slab_alloc(cache);
+	if (obj) {
+		memset(obj, 0, cache->obj_size);
+	}
+
+	return obj;
+}
+
+void vmm_slab_free(struct vmm_slab_cache *cache, void *obj)
+{
+	irq_flags_t flags;
+	struct vmm_slab_cpu *c;
+
+	if (!cache || !obj) {
+		return;
+	}
+
+	arch_cpu_irq_save(flags);
+
+	c = &cache->cpu[vmm_smp_processor_id()];
+	if (c->count >= VMM_SLAB_CPU_CACHE_SIZE) {
+		slab_flush(cache, c, VMM_SLAB_CPU_BATCH);
+	} else {
+		c->free_hit++;
+	}
+
+	SLAB_NEXT(cache, obj) = c->free;
+	c->free = obj;
+	c->count++;
+
+	arch_cpu_irq_restore(flags);
+}
+
+u32 vmm_slab_cache_total_objs(struct vmm_slab_cache *cache)
+{
+	return (cache) ? cache->slab_count * cache->slab_objs : 0;
+}
+
+u32 vmm_slab_cache_free_objs(struct vmm_slab_cache *cache)
+{
+	u32 cpu, ret;
+
+	if (!cache) {
+		return 0;
+	}
+
+	ret = cache->depot_count;
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		ret += cache->cpu[cpu].count;
+	}
+
+	return ret;
+}
+
+struct vmm_slab_cache *vmm_slab_cache_create(const char *name,
+					     u32 obj_size, u32 obj_align,
+					     void (*ctor)(void *obj))
+{
+	u32 hdr_size;
+	irq_flags_t flags;
+	struct vmm_slab_cache *cache;
+
+	if (!name || !obj_size || (obj_align & (obj_align - 1))) {
+		return NULL;
+	}
+
+	if (obj_align < sizeof(void *)) {
+		obj_align = sizeof(void *);
+	}
+
+	cache = vmm_zalloc(sizeof(*cache));
+	if (!cache) {
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&cache->head);
+	strncpy(cache->name, name, sizeof(cache->name));
+	cache->name[sizeof(cache->name) - 1] = '\0';
+	cache->obj_size = obj_size;
+	cache->obj_align = obj_align;
+	cache->ctor = ctor;
+
+	/* Keep free pointer outside constructed objects */
+	if (ctor) {
+		cache->free_off = align(obj_size, sizeof(void *));
+		cache->obj_stride = align(cache->free_off + sizeof(void *),
+					  obj_align);
+	} else {
+		cache->free_off = 0;
+		cache->obj_stride = align(max(obj_size, (u32)sizeof(void *)),
+					  obj_align);
+	}
+
+	hdr_size = slab_hdr_size(cache);
+	cache->slab_pages = VMM_SIZE_TO_PAGE(hdr_size +
+				cache->obj_stride * VMM_SLAB_MIN_OBJS);
+	cache->slab_objs = udiv32(cache->slab_pages * VMM_PAGE_SIZE - hdr_size,
+				  cache->obj_stride);
+
+	INIT_SPIN_LOCK(&cache->depot_lock);
+	cache->depot_free = NULL;
+	cache->depot_count = 0;
+	INIT_LIST_HEAD(&cache->slab_list);
+	cache->slab_count = 0;
+
+	vmm_spin_lock_irqsave_lite(&slab_cache_lock, flags);
+	list_add_tail(&cache->head, &slab_cache_list);
+	vmm_spin_unlock_irqrestore_lite(&slab_cache_lock, flags);
+
+	return cache;
+}
+
+void vmm_slab_cache_destroy(struct vmm_slab_cache *cache)
+{
+	irq_flags_t flags;
+	struct vmm_slab *slab, *slab_next;
+
+	if (!cache) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&slab_cache_lock, flags);
+	list_del(&cache->head);
+	vmm_spin_unlock_irqrestore_lite(&slab_cache_lock, flags);
+
+	if (vmm_slab_cache_free_objs(cache) !=
+				vmm_slab_cache_total_objs(cache)) {
+		vmm_printf("%s: cache %s destroyed with %d objects in use\n",
+			   __func__, cache->name,
+			   vmm_slab_cache_total_objs(cache) -
+			   vmm_slab_cache_free_objs(cache));
+	}
+
+	list_for_each_entry_safe(slab, slab_next, &cache->slab_list, head) {
+		list_del(&slab->head);
+		vmm_host_free_pages(slab->base, cache->slab_pages);
+	}
+
+	vmm_free(cache);
+}
+
+int vmm_slab_print_state(struct vmm_chardev *cdev)
+{
+	u32 cpu, total, nfree;
+	u64 alloc_hit, alloc_miss;
+	irq_flags_t flags;
+	struct vmm_slab_cache *cache;
+
+	vmm_cprintf(cdev, "%-20s %6s %8s %8s %8s %6s %8s %10s %10s\n",
+		    "Name", "Size", "Total", "InUse", "Free", "Slabs",
+		    "Mem(KB)", "Alloc Hit", "Alloc Miss");
+
+	vmm_spin_lock_irqsave_lite(&slab_cache_lock, flags);
+
+	list_for_each_entry(cache, &slab_cache_list, head) {
+		total = vmm_slab_cache_total_objs(cache);
+		nfree = vmm_slab_cache_free_objs(cache);
+		alloc_hit = alloc_miss = 0;
+		for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+			alloc_hit += cache->cpu[cpu].alloc_hit;
+			alloc_miss += cache->cpu[cpu].alloc_miss;
+		}
+		vmm_cprintf(cdev, "%-20s %6u %8u %8u %8u %6u %8u "
+			    "%10llu %10llu\n", cache->name,
+			    cache->obj_size, total, total - nfree, nfree,
+			    cache->slab_count,
+			    (cache->slab_count * cache->slab_pages *
+			     VMM_PAGE_SIZE) >> 10,
+			    alloc_hit, alloc_miss);
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&slab_cache_lock, flags);
+
+	return VMM_OK;
+}
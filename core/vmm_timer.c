@@ -32,7 +32,12 @@
 #include <arch_cpu_irq.h>
 #include <libs/stringlib.h>
 
-/** Control structure for Timer Subsystem */
+/** Control structure for Timer Subsystem
+ *
+ * Active events of a host CPU are kept in a red-black tree sorted by
+ * expiry time with a cached pointer to the earliest event. This gives
+ * O(log n) start/stop and O(1) lookup of next event to be programmed.
+ */
 struct vmm_timer_local_ctrl {
 	struct vmm_timecounter tc;
 	struct vmm_clockchip *cc;
@@ -41,18 +46,13 @@ struct vmm_timer_local_ctrl {
 	u64 next_event;
 	struct vmm_timer_event *curr;
 	vmm_rwlock_t event_list_lock;
-	struct dlist event_list;
+	struct rb_root event_tree;
+	struct vmm_timer_event *event_first;
+	u32 event_count;
 };
 
 static DEFINE_PER_CPU(struct vmm_timer_local_ctrl, tlc);
 
-#if defined(CONFIG_PROFILE)
-u64 __notrace vmm_timer_timestamp_for_profile(void)
-{
-	return vmm_timecounter_read_for_profile(&this_cpu(tlc).tc);
-}
-#endif
-
 u64 vmm_timer_timestamp(void)
 {
 	u64 ret;
@@ -65,6 +65,57 @@ u64 vmm_timer_timestamp(void)
 	return ret;
 }
 
+/* Note: This function must be called with tlcp->event_list_lock
+ * held for writing.
+ */
+static void __timer_event_enqueue(struct vmm_timer_local_ctrl *tlcp,
+				  struct vmm_timer_event *ev)
+{
+	bool leftmost = TRUE;
+	struct rb_node **new = &tlcp->event_tree.rb_node, *parent = NULL;
+	struct vmm_timer_event *e;
+
+	/* Events with same expiry expire in the order they were started */
+	while (*new) {
+		parent = *new;
+		e = rb_entry(parent, struct vmm_timer_event, active_node);
+		if (ev->expiry_tstamp < e->expiry_tstamp) {
+			new = &parent->rb_left;
+		} else {
+			new = &parent->rb_right;
+			leftmost = FALSE;
+		}
+	}
+
+	rb_link_node(&ev->active_node, parent, new);
+	rb_insert_color(&ev->active_node, &tlcp->event_tree);
+
+	if (leftmost) {
+		tlcp->event_first = ev;
+	}
+	tlcp->event_count++;
+}
+
+/* Note: This function must be called with tlcp->event_list_lock
+ * held for writing.
+ */
+static void __timer_event_dequeue(struct vmm_timer_local_ctrl *tlcp,
+				  struct vmm_timer_event *ev)
+{
+	struct rb_node *next;
+
+	if (tlcp->event_first == ev) {
+		next = rb_next(&ev->active_node);
+		tlcp->event_first = (next) ?
+			rb_entry(next, struct vmm_timer_event, active_node) :
+			NULL;
+	}
+
+	rb_erase(&ev->active_node, &tlcp->event_tree);
+	RB_CLEAR_NODE(&ev->active_node);
+	tlcp->event_count--;
+}
+
 /* Note: This function must be called with tlcp->event_list_lock held. */
 static void __timer_schedule_next_event(struct vmm_timer_local_ctrl *tlcp)
 {
@@ -77,15 +128,11 @@ static void __timer_schedule_next_event(struct vmm_timer_local_ctrl *tlcp)
 	}
 
 	/* If no events, we give up */
-	if (list_empty(&tlcp->event_list)) {
+	e = tlcp->event_first;
+	if (!e) {
 		return;
 	}
 
-	/* Retrieve first event from list of active events */
-	e = list_entry(list_first(&tlcp->event_list), 
-		       struct vmm_timer_event,
-		       active_head);
-
 	/* Configure clockevent device for first event */
 	tlcp->curr = e;
 	tstamp = vmm_timer_timestamp();
@@ -114,7 +161,7 @@ static void __timer_event_stop(struct vmm_timer_event *ev)
 	vmm_write_lock_irqsave_lite(&tlcp->event_list_lock, flags);
 
 	ev->active_state = FALSE;
-	list_del(&ev->active_head);
+	__timer_event_dequeue(tlcp, ev);
 	ev->expiry_tstamp = 0;
 
 	vmm_write_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
@@ -125,6 +172,7 @@ static void __timer_event_stop(struct vmm_timer_event *ev)
  */
 static void timer_clockchip_event_handler(struct vmm_clockchip *cc)
 {
+	u64 tstamp;
 	irq_flags_t flags, flags1;
 	struct vmm_timer_event *e;
 	struct vmm_timer_local_ctrl *tlcp = &this_cpu(tlc);
@@ -133,12 +181,15 @@ static void timer_clockchip_event_handler(struct vmm_clockchip *cc)
 
 	tlcp->inprocess = TRUE;
 
-	/* Process expired active events */
-	while (!list_empty(&tlcp->event_list)) {
-		e = list_entry(list_first(&tlcp->event_list),
-			       struct vmm_timer_event, active_head);
-		/* Current timestamp */
-		if (e->expiry_tstamp <= vmm_timer_timestamp()) {
+	/* Process expired active events in batches where the
+	 * timestamp is only read again once current batch is over.
+	 */
+	tstamp = vmm_timer_timestamp();
+	while ((e = tlcp->event_first)) {
+		if (tstamp < e->expiry_tstamp) {
+			tstamp = vmm_timer_timestamp();
+		}
+		if (e->expiry_tstamp <= tstamp) {
 			/* Unlock event list for processing expired event */
 			vmm_read_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
 			/* Set current CPU event to NULL */
@@ -201,9 +252,7 @@ int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs)
 {
 	u32 hcpu;
 	u64 tstamp;
-	bool found_pos = FALSE;
 	irq_flags_t flags, flags1;
-	struct vmm_timer_event *e = NULL;
 	struct vmm_timer_local_ctrl *tlcp;
 
 	if (!ev) {
@@ -225,21 +274,13 @@ int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs)
 
 	vmm_write_lock_irqsave_lite(&tlcp->event_list_lock, flags1);
 
-	list_for_each_entry(e, &tlcp->event_list, active_head) {
-		if (ev->expiry_tstamp < e->expiry_tstamp) {
-			found_pos = TRUE;
-			break;
-		}
-	}
+	__timer_event_enqueue(tlcp, ev);
 
-	if (!found_pos) {
-		list_add_tail(&ev->active_head, &tlcp->event_list);
-	} else {
-		list_add_tail(&ev->active_head, &e->active_head);
+	/* Reprogram clockchip only if new event is the earliest one */
+	if (tlcp->event_first == ev) {
+		__timer_schedule_next_event(tlcp);
 	}
 
-	__timer_schedule_next_event(tlcp);
-
 	vmm_write_unlock_irqrestore_lite(&tlcp->event_list_lock, flags1);
 
 	vmm_spin_unlock_irqrestore_lite(&ev->active_lock, flags);
@@ -273,6 +314,36 @@ int vmm_timer_event_stop(struct vmm_timer_event *ev)
 	return VMM_OK;
 }
 
+u32 vmm_timer_event_count(u32 hcpu)
+{
+	if (CONFIG_CPU_COUNT <= hcpu) {
+		return 0;
+	}
+
+	return per_cpu(tlc, hcpu).event_count;
+}
+
+u64 vmm_timer_next_event(u32 hcpu)
+{
+	u64 ret = 0;
+	irq_flags_t flags;
+	struct vmm_timer_local_ctrl *tlcp;
+
+	if (CONFIG_CPU_COUNT <= hcpu) {
+		return 0;
+	}
+
+	tlcp = &per_cpu(tlc, hcpu);
+
+	vmm_read_lock_irqsave_lite(&tlcp->event_list_lock, flags);
+	if (tlcp->event_first) {
+		ret = tlcp->event_first->expiry_tstamp;
+	}
+	vmm_read_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
+
+	return ret;
+}
+
 bool vmm_timer_started(void)
 {
 	return this_cpu(tlc).started;
@@ -320,9 +391,11 @@ int __cpuinit vmm_timer_init(void)
 	/* Initialize Per CPU current event pointer */
 	tlcp->curr = NULL;
 
-	/* Initialize Per CPU event list */
+	/* Initialize Per CPU event tree */
 	INIT_RW_LOCK(&tlcp->event_list_lock);
-	INIT_LIST_HEAD(&tlcp->event_list);
+	tlcp->event_tree = RB_ROOT;
+	tlcp->event_first = NULL;
+	tlcp->event_count = 0;
 
 	/* Bind suitable clockchip to current host CPU */
 	tlcp->cc = vmm_clockchip_bind_best(cpu);
@@ -42,10 +42,8 @@
 static LIST_HEAD(rbd_list);
 static DEFINE_SPINLOCK(rbd_list_lock);
 
-static int rbd_make_request(struct vmm_request_queue *rq,
-			    struct vmm_request *r)
+static int rbd_rw(struct rbd *d, struct vmm_request *r)
 {
-	struct rbd *d = rq->priv;
 	physical_addr_t pa;
 	physical_size_t sz;
 
@@ -55,25 +53,27 @@ static int rbd_make_request(struct vmm_request_queue *rq,
 	switch (r->type) {
 	case VMM_REQUEST_READ:
 		vmm_host_memory_read(pa, r->data, sz, TRUE);
-		vmm_blockdev_complete_request(r);
 		break;
 	case VMM_REQUEST_WRITE:
 		vmm_host_memory_write(pa, r->data, sz, TRUE);
-		vmm_blockdev_complete_request(r);
 		break;
 	default:
-		vmm_blockdev_fail_request(r);
-		break;
+		return VMM_EINVALID;
 	};
 
 	return VMM_OK;
 }
 
-static int rbd_abort_request(struct vmm_request_queue *rq,
-			     struct vmm_request *r)
+static int rbd_read(struct vmm_blockrq_mq *rqmq,
+		    struct vmm_request *r, void *priv)
 {
-	/* Do nothing to abort */
-	return VMM_OK;
+	return rbd_rw(priv, r);
+}
+
+static int rbd_write(struct vmm_blockrq_mq *rqmq,
+		     struct vmm_request *r, void *priv)
+{
+	return rbd_rw(priv, r);
 }
 
 static struct rbd *__rbd_create(struct vmm_device *dev,
@@ -112,15 +112,16 @@ static struct rbd *__rbd_create(struct vmm_device *dev,
 	d->bdev->num_blocks = udiv64(d->size, RBD_BLOCK_SIZE);
 	d->bdev->block_size = RBD_BLOCK_SIZE;
 
-	/* Setup request queue for block device instance */
-	d->bdev->rq = vmm_zalloc(sizeof(struct vmm_request_queue));
-	if (!d->bdev->rq) {
+	/* Setup request queue for block device instance
+	 * Note: Copies are done by one worker per host CPU instead of
+	 * the submitting context. Merging is pointless for RAM.
+	 */
+	d->rqmq = vmm_blockrq_mq_create(name, RBD_MAX_PENDING, 0, 0,
+					rbd_read, rbd_write, NULL, d);
+	if (!d->rqmq) {
 		goto free_bdev;
 	}
-	INIT_REQUEST_QUEUE(d->bdev->rq);
-	d->bdev->rq->make_request = rbd_make_request;
-	d->bdev->rq->abort_request = rbd_abort_request;
-	d->bdev->rq->priv = d;
+	d->bdev->rq = vmm_blockrq_mq_to_rq(d->rqmq);
 
 	/* Register block device instance */
 	if (vmm_blockdev_register(d->bdev)) {
@@ -155,7 +156,7 @@ static struct rbd *__rbd_create(struct vmm_device *dev,
 unreg_bdev:
 	vmm_blockdev_unregister(d->bdev);
 free_bdev_rq:
-	vmm_free(d->bdev->rq);
+	vmm_blockrq_mq_destroy(d->rqmq);
 free_bdev:
 	vmm_blockdev_free(d->bdev);
 free_rbd:
@@ -193,8 +194,8 @@ void rbd_destroy(struct rbd *d)
 	/* Unregister block device */
 	vmm_blockdev_unregister(d->bdev);
 
-	/* Free block device request queue */
-	vmm_free(d->bdev->rq);
+	/* Destroy block device request queue */
+	vmm_blockrq_mq_destroy(d->rqmq);
 
 	/* Free block device */
 	vmm_blockdev_free(d->bdev);
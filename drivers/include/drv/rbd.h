@@ -27,14 +27,17 @@
 #include <vmm_types.h>
 #include <libs/list.h>
 #include <block/vmm_blockdev.h>
+#include <block/vmm_blockrq_mq.h>
 
 #define RBD_IPRIORITY			(VMM_BLOCKDEV_CLASS_IPRIORITY+1)
 #define RBD_BLOCK_SIZE			512
+#define RBD_MAX_PENDING			128
 
 /* RAM backed device (RBD) context */
 struct rbd {
 	struct dlist head;
 	struct vmm_blockdev *bdev;
+	struct vmm_blockrq_mq *rqmq;
 	physical_addr_t addr;
 	physical_size_t size;
 };
@@ -146,6 +146,13 @@ struct net_device {
 
 	struct vmm_device *vmm_dev;
 	struct netdev_queue _tx;
+
+	/* RX frames collected during NAPI poll are sent to
+	 * netswitch in bursts.
+	 */
+	bool rx_burst_active;
+	unsigned int rx_burst_count;
+	struct sk_buff *rx_burst[VMM_NETPORT_MAX_BURST];
 };
 
 /*
@@ -302,6 +309,9 @@ static inline void *netdev_priv(struct net_device *ndev)
 	return NULL;
 }
 
+/** Send RX frames collected during NAPI poll to netswitch */
+void netif_rx_flush(struct net_device *dev);
+
 static inline int netif_rx(struct sk_buff *mb, struct net_device *dev)
 {
 	struct vmm_netport *port = dev->nsw_priv;
@@ -313,6 +323,14 @@ static inline int netif_rx(struct sk_buff *mb, struct net_device *dev)
 		return VMM_EINVALID;
 	}
 
+	if (dev->rx_burst_active) {
+		dev->rx_burst[dev->rx_burst_count++] = mb;
+		if (dev->rx_burst_count == VMM_NETPORT_MAX_BURST) {
+			netif_rx_flush(dev);
+		}
+		return VMM_OK;
+	}
+
 	vmm_port2switch_xfer_mbuf(port, mb);
 
 	return VMM_OK;
@@ -362,6 +380,8 @@ void netdev_set_link(struct vmm_netport *port);
 int netdev_can_receive(struct vmm_netport *port);
 int netdev_switch2port_xfer(struct vmm_netport *port,
 			struct vmm_mbuf *mbuf);
+int netdev_switch2port_xfer_burst(struct vmm_netport *port,
+			struct vmm_mbuf **mbufs, u32 count);
 struct net_device *alloc_etherdev(int sizeof_priv);
 
 #define netdev_msg(level, ndev, msg...)					\
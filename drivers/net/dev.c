@@ -28,11 +28,27 @@
 
 int netdev_budget __read_mostly = 300;
 
+void netif_rx_flush(struct net_device *dev)
+{
+	struct vmm_netport *port = dev->nsw_priv;
+
+	if (!dev->rx_burst_count) {
+		return;
+	}
+
+	vmm_port2switch_xfer_burst(port, dev->rx_burst, dev->rx_burst_count);
+	dev->rx_burst_count = 0;
+}
+EXPORT_SYMBOL(netif_rx_flush);
+
 static void lazy_xfer2napi_poll(struct vmm_netport *port, void *arg, int budget)
 {
 	struct napi_struct *napi = arg;
 
+	napi->dev->rx_burst_active = TRUE;
 	napi->poll(napi, budget);
+	netif_rx_flush(napi->dev);
+	napi->dev->rx_burst_active = FALSE;
 }
 
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
@@ -49,6 +65,7 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	napi->xfer.port = port;
 	napi->xfer.type = VMM_NETPORT_XFER_LAZY;
 	napi->xfer.mbuf = NULL;
+	napi->xfer.mbuf_count = 0;
 	napi->xfer.lazy_budget = netdev_budget;
 	napi->xfer.lazy_arg = NULL;
 	napi->xfer.lazy_xfer = lazy_xfer2napi_poll;
@@ -64,6 +64,7 @@ static int netdev_register_port(struct net_device *ndev)
         port->link_changed = netdev_set_link;
         port->can_receive = netdev_can_receive;
         port->switch2port_xfer = netdev_switch2port_xfer;
+        port->switch2port_xfer_burst = netdev_switch2port_xfer_burst;
         port->priv = ndev;
         memcpy(port->macaddr, ndev->dev_addr, ETH_ALEN);
 
@@ -186,6 +187,24 @@ int netdev_switch2port_xfer(struct vmm_netport *port,
 	return rc;
 }
 
+int netdev_switch2port_xfer_burst(struct vmm_netport *port,
+		struct vmm_mbuf **mbufs, u32 count)
+{
+	u32 i;
+	struct net_device *dev = (struct net_device *) port->priv;
+
+	for (i = 0; i < count; i++) {
+		/* Drop rest of the burst once device queue is stopped */
+		if (netif_queue_stopped(dev)) {
+			m_freem(mbufs[i]);
+			continue;
+		}
+		netdev_switch2port_xfer(port, mbufs[i]);
+	}
+
+	return VMM_OK;
+}
+
 struct net_device *alloc_etherdev(int sizeof_priv)
 {
 	struct net_device *ndev;
@@ -23,10 +23,14 @@
 
 #include <vmm_error.h>
 #include <vmm_heap.h>
+#include <vmm_slab.h>
 #include <vmm_stdio.h>
 #include <vmm_spinlocks.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_host_aspace.h>
+#include <vmm_host_vapool.h>
 #include <vio/vmm_vdisk.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
@@ -54,6 +58,10 @@
 #define VIRTIO_BLK_NUM_QUEUES		1
 #define VIRTIO_BLK_SECTOR_SIZE		512
 #define VIRTIO_BLK_DISK_SEG_MAX		(VIRTIO_BLK_QUEUE_SIZE - 2)
+#define VIRTIO_BLK_ZC_SLOTS		8
+#define VIRTIO_BLK_ZC_SLOT_PAGES	32
+#define VIRTIO_BLK_ZC_SLOT_SIZE		\
+			(VIRTIO_BLK_ZC_SLOT_PAGES * VMM_PAGE_SIZE)
 
 struct virtio_blk_dev_req {
 	struct virtio_queue		*vq;
@@ -63,6 +71,8 @@ struct virtio_blk_dev_req {
 	u32				len;
 	struct virtio_iovec		status_iov;
 	void				*data;
+	u32				zc_slot;
+	u32				zc_pages;
 	struct vmm_vdisk_request	r;
 };
 
@@ -75,18 +85,30 @@ struct virtio_blk_dev {
 	struct virtio_blk_config 	config;
 	u32 				features;
 
+	/* Protects zero-copy windows */
+	vmm_spinlock_t			zc_lock;
+	virtual_addr_t			zc_va;
+	u32				zc_free_count;
+	u8				zc_free[VIRTIO_BLK_ZC_SLOTS];
+
+	/* Guest mappings pinned by each zero-copy window */
+	u32				zc_maps[VIRTIO_BLK_ZC_SLOTS];
+	physical_addr_t			zc_gpa[VIRTIO_BLK_ZC_SLOTS]
+					      [VIRTIO_BLK_ZC_SLOT_PAGES];
+
 	struct vmm_vdisk		*vdisk;
 };
 
+/* Object cache for read_iov arrays of requests */
+static struct vmm_slab_cache *virtio_blk_iov_cache;
+
 static u32 virtio_blk_get_host_features(struct virtio_device *dev)
 {
 	return	1UL << VIRTIO_BLK_F_SEG_MAX
 		| 1UL << VIRTIO_BLK_F_BLK_SIZE
 		| 1UL << VIRTIO_BLK_F_FLUSH
-		| 1UL << VIRTIO_RING_F_EVENT_IDX;
-#if 0
+		| 1UL << VIRTIO_RING_F_EVENT_IDX
 		| 1UL << VIRTIO_RING_F_INDIRECT_DESC;
-#endif
 }
 
 static void virtio_blk_set_guest_features(struct virtio_device *dev,
@@ -98,16 +120,14 @@ static void virtio_blk_set_guest_features(struct virtio_device *dev,
 }
 
 static int virtio_blk_init_vq(struct virtio_device *dev,
-			      u32 vq, u32 page_size, u32 align,
-			      u32 pfn)
+			      u32 vq, struct virtio_queue_layout *layout)
 {
 	int rc;
 	struct virtio_blk_dev *vbdev = dev->emu_data;
 
 	switch (vq) {
 	case VIRTIO_BLK_IO_QUEUE:
-		rc = virtio_queue_setup(&vbdev->vqs[vq], dev->guest,
-				pfn, page_size, VIRTIO_BLK_QUEUE_SIZE, align);
+		rc = virtio_queue_setup(&vbdev->vqs[vq], dev->guest, layout);
 		break;
 	default:
 		rc = VMM_EINVALID;
@@ -156,12 +176,147 @@ static int virtio_blk_set_size_vq(struct virtio_device *dev, u32 vq, int size)
 	return size;
 }
 
+/* Drop guest mappings pinned by a zero-copy window */
+static void virtio_blk_zc_unpin(struct virtio_blk_dev *vbdev, u32 slot)
+{
+	while (vbdev->zc_maps[slot]) {
+		vbdev->zc_maps[slot]--;
+		vmm_guest_physical_unmap(vbdev->vdev->guest,
+			vbdev->zc_gpa[slot][vbdev->zc_maps[slot]],
+			VMM_PAGE_SIZE);
+	}
+}
+
+/* Map guest pages of request data into a window of host virtual
+ * address space so that block device reads or writes guest memory
+ * directly. This works only when data is in guest RAM and every
+ * break between host physical chunks is on a page boundary. Guest
+ * mappings stay pinned till the window is unmapped.
+ */
+static bool virtio_blk_zc_map(struct virtio_blk_dev *vbdev,
+			      struct virtio_blk_dev_req *req,
+			      struct virtio_iovec *iov, u32 iov_cnt)
+{
+	bool first = TRUE;
+	u32 i, slot, pages = 0, count, reg_flags;
+	irq_flags_t flags;
+	physical_addr_t gpa, hpa, map_pa, pa_end = 0;
+	physical_size_t hsz, glen;
+	virtual_addr_t base, va = 0, map_va, end_va;
+
+	if (!vbdev->zc_va || !req->len) {
+		return FALSE;
+	}
+
+	vmm_spin_lock_irqsave(&vbdev->zc_lock, flags);
+	if (!vbdev->zc_free_count) {
+		vmm_spin_unlock_irqrestore(&vbdev->zc_lock, flags);
+		return FALSE;
+	}
+	slot = vbdev->zc_free[--vbdev->zc_free_count];
+	vmm_spin_unlock_irqrestore(&vbdev->zc_lock, flags);
+
+	base = vbdev->zc_va + slot * VIRTIO_BLK_ZC_SLOT_SIZE;
+	for (i = 0; i < iov_cnt; i++) {
+		gpa = iov[i].addr;
+		glen = iov[i].len;
+		while (glen) {
+			if (VIRTIO_BLK_ZC_SLOT_PAGES <= vbdev->zc_maps[slot]) {
+				goto fail;
+			}
+			if (vmm_guest_physical_map(vbdev->vdev->guest,
+						   gpa, glen, &hpa, &hsz,
+						   &reg_flags)) {
+				goto fail;
+			}
+			vbdev->zc_gpa[slot][vbdev->zc_maps[slot]++] = gpa;
+			if (!hsz ||
+			    !(reg_flags & VMM_REGION_ISRAM) ||
+			    !(reg_flags & VMM_REGION_REAL)) {
+				goto fail;
+			}
+			hsz = min(hsz, glen);
+
+			if (first) {
+				va = base + (hpa & VMM_PAGE_MASK);
+				first = FALSE;
+			} else if (((hpa ^ va) & VMM_PAGE_MASK) ||
+				   ((va & VMM_PAGE_MASK) && (hpa != pa_end))) {
+				goto fail;
+			}
+
+			/* Map pages of this chunk not mapped so far */
+			map_va = base + pages * VMM_PAGE_SIZE;
+			end_va = VMM_ROUNDUP2_PAGE_SIZE(va + hsz);
+			if ((base + VIRTIO_BLK_ZC_SLOT_SIZE) < end_va) {
+				goto fail;
+			}
+			if (map_va < end_va) {
+				map_pa = hpa + map_va - va;
+				count = (end_va - map_va) >> VMM_PAGE_SHIFT;
+				if (vmm_host_map_pages(map_va, map_pa, count,
+						VMM_MEMORY_FLAGS_NORMAL)) {
+					goto fail;
+				}
+				pages += count;
+			}
+
+			va += hsz;
+			pa_end = hpa + hsz;
+			gpa += hsz;
+			glen -= hsz;
+		}
+	}
+
+	req->data = (void *)(va - req->len);
+	req->zc_slot = slot;
+	req->zc_pages = pages;
+
+	return TRUE;
+
+fail:
+	if (pages) {
+		vmm_host_unmap_pages(base, pages);
+	}
+	virtio_blk_zc_unpin(vbdev, slot);
+	vmm_spin_lock_irqsave(&vbdev->zc_lock, flags);
+	vbdev->zc_free[vbdev->zc_free_count++] = slot;
+	vmm_spin_unlock_irqrestore(&vbdev->zc_lock, flags);
+
+	return FALSE;
+}
+
+static void virtio_blk_zc_unmap(struct virtio_blk_dev *vbdev,
+				struct virtio_blk_dev_req *req)
+{
+	irq_flags_t flags;
+
+	if (!req->zc_pages) {
+		return;
+	}
+
+	vmm_host_unmap_pages(vbdev->zc_va +
+			     req->zc_slot * VIRTIO_BLK_ZC_SLOT_SIZE,
+			     req->zc_pages);
+	virtio_blk_zc_unpin(vbdev, req->zc_slot);
+
+	vmm_spin_lock_irqsave(&vbdev->zc_lock, flags);
+	vbdev->zc_free[vbdev->zc_free_count++] = req->zc_slot;
+	vmm_spin_unlock_irqrestore(&vbdev->zc_lock, flags);
+
+	req->zc_pages = 0;
+	req->data = NULL;
+}
+
 static void virtio_blk_req_done(struct virtio_blk_dev *vbdev,
 				struct virtio_blk_dev_req *req, u8 status)
 {
 	struct virtio_device *dev = vbdev->vdev;
 	int queueid = req->vq - vbdev->vqs;
 
+	/* Zero-copy data is already in guest memory */
+	virtio_blk_zc_unmap(vbdev, req);
+
 	if (req->read_iov && req->len && req->data &&
 	    (status == VIRTIO_BLK_S_OK) &&
 	    (vmm_vdisk_get_request_type(&req->r) == VMM_VDISK_REQUEST_READ)) {
@@ -173,7 +328,7 @@ static void virtio_blk_req_done(struct virtio_blk_dev *vbdev,
 	}
 
 	if (req->read_iov) {
-		vmm_free(req->read_iov);
+		vmm_slab_free(virtio_blk_iov_cache, req->read_iov);
 		req->read_iov = NULL;
 		req->read_iov_cnt = 0;
 	}
@@ -254,10 +409,17 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 		head = virtio_queue_get_head_iovec(vq, head, vbdev->iov,
 						   &iov_cnt, &len);
 
+		if (iov_cnt < 2) {
+			virtio_queue_set_used_elem(vq, head, 0);
+			continue;
+		}
+
 		req->vq = vq;
 		req->head = head;
 		req->read_iov = NULL;
 		req->read_iov_cnt = 0;
+		req->data = NULL;
+		req->zc_pages = 0;
 		req->len = 0;
 		for (i = 1; i < (iov_cnt - 1); i++) {
 			req->len += vbdev->iov[i].len;
@@ -277,14 +439,17 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 		case VIRTIO_BLK_T_IN:
 			vmm_vdisk_set_request_type(&req->r,
 						   VMM_VDISK_REQUEST_READ);
+			if (virtio_blk_zc_map(vbdev, req, &vbdev->iov[1],
+					      iov_cnt - 2)) {
+				goto submit_read;
+			}
 			req->data = vmm_malloc(req->len);
 			if (!req->data) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
 				continue;
 			}
-			len = sizeof(struct virtio_iovec) * (iov_cnt - 2);
-			req->read_iov = vmm_malloc(len);
+			req->read_iov = vmm_slab_alloc(virtio_blk_iov_cache);
 			if (!req->read_iov) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
@@ -295,6 +460,7 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 				req->read_iov[i].addr = vbdev->iov[i + 1].addr;
 				req->read_iov[i].len = vbdev->iov[i + 1].len;
 			}
+submit_read:
 			DPRINTF("%s: VIRTIO_BLK_T_IN dev=%s "
 				"hdr.sector=%ll req->len=%d\n",
 				__func__, dev->name,
@@ -309,6 +475,10 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 		case VIRTIO_BLK_T_OUT:
 			vmm_vdisk_set_request_type(&req->r,
 						   VMM_VDISK_REQUEST_WRITE);
+			if (virtio_blk_zc_map(vbdev, req, &vbdev->iov[1],
+					      iov_cnt - 2)) {
+				goto submit_write;
+			}
 			req->data = vmm_malloc(req->len);
 			if (!req->data) {
 				virtio_blk_req_done(vbdev, req,
@@ -321,6 +491,7 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 							 req->data,
 							 req->len);
 			}
+submit_write:
 			DPRINTF("%s: VIRTIO_BLK_T_OUT dev=%s "
 				"hdr.sector=%ll req->len=%d\n",
 				__func__, dev->name,
@@ -355,7 +526,7 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 						    VIRTIO_BLK_S_IOERR);
 				continue;
 			}
-			req->read_iov = vmm_malloc(sizeof(struct virtio_iovec));
+			req->read_iov = vmm_slab_alloc(virtio_blk_iov_cache);
 			if (!req->read_iov) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
@@ -448,6 +619,7 @@ static int virtio_blk_reset(struct virtio_device *dev)
 					VMM_VDISK_REQUEST_UNKNOWN) {
 			vmm_vdisk_abort_request(vbdev->vdisk, &req->r);
 		}
+		virtio_blk_zc_unmap(vbdev, req);
 		memset(req, 0, sizeof(*req));
 		vmm_vdisk_set_request_type(&req->r,
 					   VMM_VDISK_REQUEST_UNKNOWN);
@@ -461,9 +633,19 @@ static int virtio_blk_reset(struct virtio_device *dev)
 	return VMM_OK;
 }
 
+static void virtio_blk_free(struct virtio_blk_dev *vbdev)
+{
+	if (vbdev->zc_va) {
+		vmm_host_vapool_free(vbdev->zc_va, VIRTIO_BLK_ZC_SLOTS *
+						   VIRTIO_BLK_ZC_SLOT_SIZE);
+	}
+	vmm_free(vbdev);
+}
+
 static int virtio_blk_connect(struct virtio_device *dev,
 			      struct virtio_emulator *emu)
 {
+	u32 i, max_inflight;
 	const char *attr;
 	struct virtio_blk_dev *vbdev;
 
@@ -476,6 +658,18 @@ static int virtio_blk_connect(struct virtio_device *dev,
 	}
 	vbdev->vdev = dev;
 
+	/* Zero-copy is optional so carry on without it */
+	INIT_SPIN_LOCK(&vbdev->zc_lock);
+	if (vmm_host_vapool_alloc(&vbdev->zc_va, VIRTIO_BLK_ZC_SLOTS *
+					VIRTIO_BLK_ZC_SLOT_SIZE)) {
+		vbdev->zc_va = 0;
+	} else {
+		for (i = 0; i < VIRTIO_BLK_ZC_SLOTS; i++) {
+			vbdev->zc_free[i] = i;
+		}
+		vbdev->zc_free_count = VIRTIO_BLK_ZC_SLOTS;
+	}
+
 	vbdev->config.capacity = 0;
 	vbdev->config.seg_max = VIRTIO_BLK_DISK_SEG_MAX,
 	vbdev->config.blk_size = VIRTIO_BLK_SECTOR_SIZE;
@@ -487,10 +681,18 @@ static int virtio_blk_connect(struct virtio_device *dev,
 					virtio_blk_req_failed,
 					vbdev);
 	if (!vbdev->vdisk) {
-		vmm_free(vbdev);
+		virtio_blk_free(vbdev);
 		return VMM_EFAIL;
 	}
 
+	/* Limit in-flight requests so that one guest cannot hog the
+	 * request queue of a block device shared with other guests.
+	 */
+	if (vmm_devtree_read_u32(dev->edev->node,
+				 "max_inflight", &max_inflight) == VMM_OK) {
+		vmm_vdisk_set_max_inflight(vbdev->vdisk, max_inflight);
+	}
+
 	/* Attach block device */
 	if (vmm_devtree_read_string(dev->edev->node,
 				    "blkdev", &attr) != VMM_OK) {
@@ -510,7 +712,7 @@ static void virtio_blk_disconnect(struct virtio_device *dev)
 	DPRINTF("%s: dev=%s\n", __func__, dev->name);
 
 	vmm_vdisk_destroy(vbdev->vdisk);
-	vmm_free(vbdev);
+	virtio_blk_free(vbdev);
 }
 
 struct virtio_device_id virtio_blk_emu_id[] = {
@@ -541,12 +743,27 @@ struct virtio_emulator virtio_blk = {
 
 static int __init virtio_blk_init(void)
 {
-	return virtio_register_emulator(&virtio_blk);
+	int rc;
+
+	virtio_blk_iov_cache = vmm_slab_cache_create("virtio_blk_iov",
+				sizeof(struct virtio_iovec) *
+				VIRTIO_BLK_DISK_SEG_MAX, 0, NULL);
+	if (!virtio_blk_iov_cache) {
+		return VMM_ENOMEM;
+	}
+
+	rc = virtio_register_emulator(&virtio_blk);
+	if (rc) {
+		vmm_slab_cache_destroy(virtio_blk_iov_cache);
+	}
+
+	return rc;
 }
 
 static void __exit virtio_blk_exit(void)
 {
 	virtio_unregister_emulator(&virtio_blk);
+	vmm_slab_cache_destroy(virtio_blk_iov_cache);
 }
 
 VMM_DECLARE_MODULE(MODULE_DESC,
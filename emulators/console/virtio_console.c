@@ -47,6 +47,7 @@
 #define VIRTIO_CONSOLE_TX_QUEUE		1
 
 #define VIRTIO_CONSOLE_VSERIAL_FIFO_SZ	1024
+#define VIRTIO_CONSOLE_TX_BUF_SZ	128
 
 struct virtio_console_dev {
 	struct virtio_device *vdev;
@@ -75,7 +76,7 @@ static void virtio_console_set_guest_features(struct virtio_device *dev,
 }
 
 static int virtio_console_init_vq(struct virtio_device *dev,
-				  u32 vq, u32 page_size, u32 align, u32 pfn)
+				  u32 vq, struct virtio_queue_layout *layout)
 {
 	int rc;
 	struct virtio_console_dev *cdev = dev->emu_data;
@@ -83,8 +84,7 @@ static int virtio_console_init_vq(struct virtio_device *dev,
 	switch (vq) {
 	case VIRTIO_CONSOLE_RX_QUEUE:
 	case VIRTIO_CONSOLE_TX_QUEUE:
-		rc = virtio_queue_setup(&cdev->vqs[vq], dev->guest, 
-			pfn, page_size, VIRTIO_CONSOLE_QUEUE_SIZE, align);
+		rc = virtio_queue_setup(&cdev->vqs[vq], dev->guest, layout);
 		break;
 	default:
 		rc = VMM_EINVALID;
@@ -138,7 +138,7 @@ static int virtio_console_set_size_vq(struct virtio_device *dev, u32 vq, int siz
 static int virtio_console_do_tx(struct virtio_device *dev,
 				struct virtio_console_dev *cdev)
 {
-	u8 buf[8];
+	u8 buf[VIRTIO_CONSOLE_TX_BUF_SZ];
 	u16 head = 0;
 	u32 i, len, iov_cnt = 0, total_len = 0;
 	struct virtio_queue *vq = &cdev->vqs[VIRTIO_CONSOLE_TX_QUEUE];
@@ -195,30 +195,41 @@ static bool virtio_console_vserial_can_send(struct vmm_vserial *vser)
 	return TRUE;
 }
 
-static int virtio_console_vserial_send(struct vmm_vserial *vser, u8 data)
+static u32 virtio_console_vserial_send_buf(struct vmm_vserial *vser,
+					   u8 *src, u32 len)
 {
 	u16 head = 0;
-	u32 iov_cnt = 0, total_len = 0;
+	u32 done = 0, wlen, iov_cnt = 0, total_len = 0;
 	struct virtio_console_dev *cdev = vmm_vserial_priv(vser);
 	struct virtio_queue *vq = &cdev->vqs[VIRTIO_CONSOLE_RX_QUEUE];
 	struct virtio_iovec *iov = cdev->rx_iov;
 	struct virtio_device *dev = cdev->vdev;
 
-	fifo_enqueue(cdev->emerg_rd, &data, TRUE);
+	fifo_enqueue_bulk(cdev->emerg_rd, src, len, TRUE);
 
-	if (virtio_queue_available(vq)) {
+	/* Fill as many Rx buffers as needed and signal guest once */
+	while ((done < len) && virtio_queue_available(vq)) {
 		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+		wlen = 0;
 		if (iov_cnt) {
-			virtio_buf_to_iovec_write(dev, &iov[0], 1, &data, 1);
-
-			virtio_queue_set_used_elem(vq, head, 1);
-
-			if (virtio_queue_should_signal(vq)) {
-				dev->tra->notify(dev, VIRTIO_CONSOLE_RX_QUEUE);
-			}
+			wlen = virtio_buf_to_iovec_write(dev, iov, iov_cnt,
+							 src + done, len - done);
 		}
+		virtio_queue_set_used_elem(vq, head, wlen);
+		done += wlen;
+	}
+
+	if (done && virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_CONSOLE_RX_QUEUE);
 	}
 
+	return len;
+}
+
+static int virtio_console_vserial_send(struct vmm_vserial *vser, u8 data)
+{
+	virtio_console_vserial_send_buf(vser, &data, 1);
+
 	return VMM_OK;
 }
 
@@ -325,6 +336,7 @@ static int virtio_console_connect(struct virtio_device *dev,
 	cdev->vser = vmm_vserial_create(cdev->name, 
 					&virtio_console_vserial_can_send, 
 					&virtio_console_vserial_send, 
+					&virtio_console_vserial_send_buf,
 					VIRTIO_CONSOLE_VSERIAL_FIFO_SZ, cdev);
 	if (!cdev->vser) {
 		return VMM_EFAIL;
@@ -95,6 +95,10 @@ struct pl110_state {
 	u32 palette16[256];
 	u32 palette32[256];
 	u32 raw_palette[128];
+
+	/* Frame buffer mapping handed out last (stays pinned) */
+	bool fb_pinned;
+	physical_addr_t fb_gpa;
 };
 
 #define BITS 8
@@ -173,9 +177,21 @@ static int pl110_display_pixeldata(struct vmm_vdisplay *vdis,
 	if (!(flags & VMM_REGION_REAL) ||
 	    !(flags & VMM_REGION_MEMORY) ||
 	    !(flags & VMM_REGION_ISRAM)) {
+		vmm_guest_physical_unmap(s->guest, gpa, gsz);
 		return VMM_EINVALID;
 	}
 
+	/* Users of frame buffer have no release hook so keep the
+	 * last handed out mapping pinned and drop the previous one.
+	 */
+	vmm_spin_lock(&s->lock);
+	if (s->fb_pinned) {
+		vmm_guest_physical_unmap(s->guest, s->fb_gpa, gsz);
+	}
+	s->fb_pinned = TRUE;
+	s->fb_gpa = gpa;
+	vmm_spin_unlock(&s->lock);
+
 	vmm_pixelformat_init_default(pf, bits_per_pixel);
 	*rows = s->rows;
 	*cols = s->cols;
@@ -727,6 +743,9 @@ static int pl110_emulator_remove(struct vmm_emudev *edev)
 					      &pl110_mux_in_irqchip, s);
 	}
 	vmm_vdisplay_destroy(s->vdis);
+	if (s->fb_pinned) {
+		vmm_guest_physical_unmap(s->guest, s->fb_gpa, 0);
+	}
 	vmm_free(s);
 
 	return rc;
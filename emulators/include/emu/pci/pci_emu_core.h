@@ -34,6 +34,9 @@
 /* PCI HEADER_TYPE */
 #define  PCI_HEADER_TYPE_MULTI_FUNCTION 0x80
 
+/* PCI STATUS */
+#define  PCI_STATUS_CAP_LIST		0x10
+
 /* Size of the standard PCI config header */
 #define PCI_CONFIG_HEADER_SIZE 0x40
 /* Size of the standard PCI config space */
@@ -33,6 +33,18 @@
 
 #define VIRTIO_DEVICE_MAX_NAME_LEN			64
 
+/* Device status bits */
+#define VIRTIO_CONFIG_S_ACKNOWLEDGE			1
+#define VIRTIO_CONFIG_S_DRIVER				2
+#define VIRTIO_CONFIG_S_DRIVER_OK			4
+#define VIRTIO_CONFIG_S_FEATURES_OK			8
+#define VIRTIO_CONFIG_S_NEEDS_RESET			0x40
+#define VIRTIO_CONFIG_S_FAILED				0x80
+
+/* Transport feature bits (device specific ones are below 24) */
+#define VIRTIO_F_VERSION_1				32
+#define VIRTIO_F_RING_PACKED				34
+
 enum virtio_id {
 	VIRTIO_ID_NET = 1,
 	VIRTIO_ID_BLOCK,
@@ -61,6 +73,11 @@ struct virtio_device {
 	struct virtio_emulator *emu;
 	void *emu_data;
 
+	/* Set by transport for modern (virtio 1.0) interface */
+	bool modern;
+	/* Features negotiated with guest including transport features */
+	u64 features;
+
 	struct dlist node;
 	struct vmm_guest *guest;
 };
@@ -69,6 +86,7 @@ struct virtio_transport {
 	const char *name;
 
 	int  (*notify)(struct virtio_device *, u32 vq);
+	int  (*notify_config)(struct virtio_device *);
 };
 
 struct virtio_emulator {
@@ -78,8 +96,8 @@ struct virtio_emulator {
 	/* VirtIO operations */
 	u32 (*get_host_features) (struct virtio_device *dev);
 	void (*set_guest_features) (struct virtio_device *dev, u32 features);
-	int (*init_vq) (struct virtio_device *dev, u32 vq, u32 page_size,
-				u32 align, u32 pfn);
+	int (*init_vq) (struct virtio_device *dev, u32 vq,
+				struct virtio_queue_layout *layout);
 	int (*get_pfn_vq) (struct virtio_device *dev, u32 vq);
 	int (*get_size_vq) (struct virtio_device *dev, u32 vq);
 	int (*set_size_vq) (struct virtio_device *dev, u32 vq, int size);
@@ -105,6 +123,15 @@ int virtio_config_write(struct virtio_device *dev,
 
 int virtio_reset(struct virtio_device *dev);
 
+/** Get features offered to guest including transport features */
+u64 virtio_host_features(struct virtio_device *dev);
+
+/** Set features accepted by guest including transport features */
+void virtio_guest_features(struct virtio_device *dev, u64 features);
+
+/** Check whether a feature was negotiated with guest */
+bool virtio_has_feature(struct virtio_device *dev, u32 bit);
+
 int virtio_register_device(struct virtio_device *dev);
 
 void virtio_unregister_device(struct virtio_device *dev);
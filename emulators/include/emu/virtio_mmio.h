@@ -72,6 +72,9 @@
 /* Guest's PFN for the currently selected queue - Read Write */
 #define VIRTIO_MMIO_QUEUE_PFN		0x040
 
+/* Ready bit for the currently selected queue - Read Write (version 2) */
+#define VIRTIO_MMIO_QUEUE_READY		0x044
+
 /* Queue notifier - Write Only */
 #define VIRTIO_MMIO_QUEUE_NOTIFY	0x050
 
@@ -84,6 +87,24 @@
 /* Device status register - Read Write */
 #define VIRTIO_MMIO_STATUS		0x070
 
+/* Selected queue's Descriptor Table address, 64 bits in two halves
+ * - Write Only (version 2) */
+#define VIRTIO_MMIO_QUEUE_DESC_LOW	0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH	0x084
+
+/* Selected queue's Available Ring address, 64 bits in two halves
+ * - Write Only (version 2) */
+#define VIRTIO_MMIO_QUEUE_AVAIL_LOW	0x090
+#define VIRTIO_MMIO_QUEUE_AVAIL_HIGH	0x094
+
+/* Selected queue's Used Ring address, 64 bits in two halves
+ * - Write Only (version 2) */
+#define VIRTIO_MMIO_QUEUE_USED_LOW	0x0a0
+#define VIRTIO_MMIO_QUEUE_USED_HIGH	0x0a4
+
+/* Configuration atomicity value - Read Only (version 2) */
+#define VIRTIO_MMIO_CONFIG_GENERATION	0x0fc
+
 /* The config space is defined by each driver as
  * the per-driver configuration space - Read Write */
 #define VIRTIO_MMIO_CONFIG		0x100
@@ -99,6 +120,11 @@
 #define VIRTIO_MMIO_MAX_VQ      3
 #define VIRTIO_MMIO_MAX_CONFIG  1
 #define VIRTIO_MMIO_IO_SIZE     0x200
+#define VIRTIO_MMIO_QUEUE_MAX	64
+
+/* Legacy (PFN based) and modern (virtio 1.0) register layouts */
+#define VIRTIO_MMIO_VERSION_LEGACY	1
+#define VIRTIO_MMIO_VERSION_MODERN	2
 
 struct virtio_mmio_config {
 	char    magic[4];
@@ -126,10 +152,22 @@ struct virtio_mmio_config {
 	u32     status;
 } __attribute__((packed));
 
+/* Queue registers of modern layout which are latched per queue */
+struct virtio_mmio_queue {
+	u32	num;
+	u32	ready;
+	u64	desc;
+	u64	avail;
+	u64	used;
+};
+
 struct virtio_mmio_dev {
 	struct vmm_guest *guest;
 	struct virtio_device dev;
 	struct virtio_mmio_config config;
+	u64 guest_features;
+	u32 config_generation;
+	struct virtio_mmio_queue queues[VIRTIO_MMIO_QUEUE_MAX];
 	u32 irq;
 	u32 addr;
 };
@@ -74,6 +74,87 @@
 #define VIRTIO_PCI_IO_SIZE		VIRTIO_PCI_REGION_SIZE
 #define VIRTIO_PCI_PAGE_SIZE		(0x1UL << VIRTIO_PCI_QUEUE_ADDR_SHIFT)
 
+/* Legacy (I/O registers) and modern (virtio 1.0 capabilities) interfaces */
+#define VIRTIO_PCI_VERSION_LEGACY	1
+#define VIRTIO_PCI_VERSION_MODERN	2
+
+/* from Linux's uapi/linux/virtio_pci.h */
+
+/* Common configuration */
+#define VIRTIO_PCI_CAP_COMMON_CFG	1
+/* Notifications */
+#define VIRTIO_PCI_CAP_NOTIFY_CFG	2
+/* ISR access */
+#define VIRTIO_PCI_CAP_ISR_CFG		3
+/* Device specific configuration */
+#define VIRTIO_PCI_CAP_DEVICE_CFG	4
+/* PCI configuration access */
+#define VIRTIO_PCI_CAP_PCI_CFG		5
+
+/* This is the PCI capability header: */
+struct virtio_pci_cap {
+	u8 cap_vndr;		/* Generic PCI field: PCI_CAP_ID_VNDR */
+	u8 cap_next;		/* Generic PCI field: next ptr. */
+	u8 cap_len;		/* Generic PCI field: capability length */
+	u8 cfg_type;		/* Identifies the structure. */
+	u8 bar;			/* Where to find it. */
+	u8 id;			/* Multiple capabilities of the same type */
+	u8 padding[2];		/* Pad to full dword. */
+	u32 offset;		/* Offset within bar. */
+	u32 length;		/* Length of the structure, in bytes. */
+} __attribute__((packed));
+
+struct virtio_pci_notify_cap {
+	struct virtio_pci_cap cap;
+	u32 notify_off_multiplier;	/* Multiplier for queue_notify_off. */
+} __attribute__((packed));
+
+/* Offsets of fields in VIRTIO_PCI_CAP_COMMON_CFG */
+#define VIRTIO_PCI_COMMON_DFSELECT	0
+#define VIRTIO_PCI_COMMON_DF		4
+#define VIRTIO_PCI_COMMON_GFSELECT	8
+#define VIRTIO_PCI_COMMON_GF		12
+#define VIRTIO_PCI_COMMON_MSIX		16
+#define VIRTIO_PCI_COMMON_NUMQ		18
+#define VIRTIO_PCI_COMMON_STATUS	20
+#define VIRTIO_PCI_COMMON_CFGGENERATION	21
+#define VIRTIO_PCI_COMMON_Q_SELECT	22
+#define VIRTIO_PCI_COMMON_Q_SIZE	24
+#define VIRTIO_PCI_COMMON_Q_MSIX	26
+#define VIRTIO_PCI_COMMON_Q_ENABLE	28
+#define VIRTIO_PCI_COMMON_Q_NOFF	30
+#define VIRTIO_PCI_COMMON_Q_DESCLO	32
+#define VIRTIO_PCI_COMMON_Q_DESCHI	36
+#define VIRTIO_PCI_COMMON_Q_AVAILLO	40
+#define VIRTIO_PCI_COMMON_Q_AVAILHI	44
+#define VIRTIO_PCI_COMMON_Q_USEDLO	48
+#define VIRTIO_PCI_COMMON_Q_USEDHI	52
+#define VIRTIO_PCI_COMMON_SIZE		56
+
+/* Vector value used to disable MSI for queue */
+#define VIRTIO_MSI_NO_VECTOR		0xffff
+
+/* Vendor specific PCI capability ID */
+#define VIRTIO_PCI_CAP_ID_VNDR		0x09
+/* Config space offset where virtio capabilities start */
+#define VIRTIO_PCI_CAP_OFFSET		0x40
+
+/* PCI device ID of modern device is this plus virtio device type */
+#define VIRTIO_PCI_MODERN_DEVICE_ID	0x1040
+
+/* BAR layout of modern device */
+#define VIRTIO_PCI_MODERN_COMMON_OFFSET	0x000
+#define VIRTIO_PCI_MODERN_ISR_OFFSET	0x040
+#define VIRTIO_PCI_MODERN_ISR_SIZE	0x004
+#define VIRTIO_PCI_MODERN_DEVICE_OFFSET	0x100
+#define VIRTIO_PCI_MODERN_DEVICE_SIZE	0x100
+#define VIRTIO_PCI_MODERN_NOTIFY_OFFSET	0x200
+#define VIRTIO_PCI_MODERN_NOTIFY_MULT	4
+#define VIRTIO_PCI_MODERN_NOTIFY_SIZE	(VIRTIO_PCI_QUEUE_MAX * \
+					 VIRTIO_PCI_MODERN_NOTIFY_MULT)
+#define VIRTIO_PCI_MODERN_BAR_SIZE	(VIRTIO_PCI_MODERN_NOTIFY_OFFSET + \
+					 VIRTIO_PCI_MODERN_NOTIFY_SIZE)
+
 struct virtio_pci_config {
 	u32     host_features;
 	u32	guest_features;
@@ -85,10 +166,24 @@ struct virtio_pci_config {
 	u8	interrupt_state;
 } __attribute__((packed));
 
+/* Queue registers of modern interface which are latched per queue */
+struct virtio_pci_queue {
+	u16	size;
+	u16	enable;
+	u64	desc;
+	u64	avail;
+	u64	used;
+};
+
 struct virtio_pci_dev {
 	struct vmm_guest *guest;
 	struct virtio_device dev;
 	struct virtio_pci_config config;
+	u32 host_features_sel;
+	u32 guest_features_sel;
+	u64 guest_features;
+	u8 config_generation;
+	struct virtio_pci_queue queues[VIRTIO_PCI_QUEUE_MAX];
 	u32 irq;
 	u32 addr;
 };
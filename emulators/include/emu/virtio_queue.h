@@ -33,9 +33,39 @@
 #define VIRTIO_PCI_O_CONFIG     0
 #define VIRTIO_PCI_O_MSIX       1
 
+#define VIRTIO_QUEUE_MAX_DESC	32768
+#define VIRTIO_QUEUE_MAX_MAPS	3
+
 struct vmm_guest;
 struct virtio_device;
 
+/** Guest placement of a queue as programmed through transport
+ *
+ * Legacy transports place a split ring in one contiguous area given by
+ * page frame number (see virtio_queue_layout_legacy()) whereas modern
+ * transports give separate addresses for descriptor area, driver area
+ * (available ring or driver event suppression) and device area (used
+ * ring or device event suppression).
+ */
+struct virtio_queue_layout {
+	u32			desc_count;
+	bool			packed;
+	physical_addr_t		guest_pfn;
+	physical_size_t		guest_page_size;
+	u32			align;
+	physical_addr_t		desc_addr;
+	physical_addr_t		driver_addr;
+	physical_addr_t		device_addr;
+};
+
+/** Device side state of a buffer taken from packed ring */
+struct virtio_queue_pbuf {
+	struct vring_used_elem	used;
+	u16			slot;
+	u16			num;
+	bool			wrap;
+};
+
 struct virtio_queue {
 	/* The last_avail_idx field is an index to ->ring of struct vring_avail.
 	   It's where we assume the next request index is at.  */
@@ -44,6 +74,28 @@ struct virtio_queue {
 
 	struct vring		vring;
 
+	/* For packed ring last_avail_idx and last_used_signalled are
+	 * descriptor slots and used_idx is the slot where next used
+	 * descriptor is written. Buffer IDs popped from ring are
+	 * returned as heads so that split and packed rings look the
+	 * same to emulators.
+	 */
+	bool			packed;
+	bool			avail_wrap;
+	bool			used_wrap;
+	u16			used_idx;
+	u16			pop_count;
+	struct vring_packed	pvring;
+	struct virtio_queue_pbuf *pbufs;
+	u16			*pop_ids;
+	u16			*fill_ids;
+
+	u32			map_count;
+	struct vmm_guest	*map_guest;
+	void			*map_va[VIRTIO_QUEUE_MAX_MAPS];
+	physical_addr_t		map_gpa[VIRTIO_QUEUE_MAX_MAPS];
+	physical_size_t		map_size[VIRTIO_QUEUE_MAX_MAPS];
+
 	void			*addr;
 	struct vmm_guest	*guest;
 	u32			desc_count;
@@ -55,6 +107,11 @@ struct virtio_queue {
 	physical_size_t		total_size;
 };
 
+/** Check whether queue uses packed ring
+ *  Note: only available after queue setup is done
+ */
+bool virtio_queue_packed(struct virtio_queue *vq);
+
 /** Get mapped base address of queue
  *  Note: only available after queue setup is done
  */
@@ -105,8 +162,15 @@ physical_size_t virtio_queue_total_size(struct virtio_queue *vq);
  */
 u16 virtio_queue_pop(struct virtio_queue *vq);
 
+/** Push back last count popped descriptors so that they are
+ *  popped again later
+ *  Note: works only after queue setup is done
+ */
+void virtio_queue_rewind(struct virtio_queue *vq, u16 count);
+
 /** Retrive vring descriptor at given index
  *  Note: works only after queue setup is done
+ *  Note: returns NULL for packed ring
  */
 struct vring_desc *virtio_queue_get_desc(struct virtio_queue *vq, u16 indx);
 
@@ -126,6 +190,19 @@ bool virtio_queue_should_signal(struct virtio_queue *vq);
 struct vring_used_elem *virtio_queue_set_used_elem(struct virtio_queue *vq,
 						   u32 head, u32 len);
 
+/** Fill used element at given offset from current used idx without
+ *  making it visible to guest
+ *  Note: works only after queue setup is done
+ */
+struct vring_used_elem *virtio_queue_fill_used_elem(struct virtio_queue *vq,
+						    u32 offset,
+						    u32 head, u32 len);
+
+/** Make count filled used elements visible to guest at once
+ *  Note: works only after queue setup is done
+ */
+void virtio_queue_flush_used(struct virtio_queue *vq, u32 count);
+
 /** Check whether queue setup is done by guest or not */
 bool virtio_queue_setup_done(struct virtio_queue *vq);
 
@@ -134,14 +211,19 @@ bool virtio_queue_setup_done(struct virtio_queue *vq);
  */
 int virtio_queue_cleanup(struct virtio_queue *vq);
 
+/** Fill queue layout of a split ring placed by legacy transport */
+void virtio_queue_layout_legacy(struct virtio_queue_layout *layout,
+				u32 desc_count,
+				physical_addr_t guest_pfn,
+				physical_size_t guest_page_size,
+				u32 align);
+
 /** Setup or initialize the queue 
  *  Note: If queue was already setup then it will cleanup first.
  */
 int virtio_queue_setup(struct virtio_queue *vq,
 			struct vmm_guest *guest,
-			physical_addr_t guest_pfn,
-			physical_size_t guest_page_size,
-			u32 desc_count, u32 align);
+			struct virtio_queue_layout *layout);
 
 /** Get guest IO vectors based on given head
  *  Note: works only after queue setup is done
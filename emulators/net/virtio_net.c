@@ -23,8 +23,16 @@
 
 #include <vmm_error.h>
 #include <vmm_heap.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_spinlocks.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_host_aspace.h>
+#include <vmm_host_vapool.h>
+#include <libs/mathlib.h>
 
 #include <net/vmm_protocol.h>
 #include <net/vmm_mbuf.h>
@@ -44,23 +52,93 @@
 #define MODULE_EXIT			virtio_net_exit
 
 #define VIRTIO_NET_QUEUE_SIZE		256
-#define VIRTIO_NET_NUM_QUEUES		2
-#define VIRTIO_NET_RX_QUEUE		0
-#define VIRTIO_NET_TX_QUEUE		1
+#define VIRTIO_NET_CTRL_QUEUE_SIZE	64
+
+/* Queue pair N uses virtqueue 2N for RX and virtqueue 2N+1 for TX */
+#define VIRTIO_NET_MAX_QUEUE_PAIRS	8
+#define VIRTIO_NET_RX_VQ(pair)		((pair) * 2)
+#define VIRTIO_NET_TX_VQ(pair)		((pair) * 2 + 1)
 
 #define VIRTIO_NET_MTU			1514
+#define VIRTIO_NET_MAX_FRAME		(65535 + 14)
+
+/* Number of RX frames held back while guest RX ring is empty */
+#define VIRTIO_NET_RX_BACKLOG		VIRTIO_NET_QUEUE_SIZE
 
 #define VIRTIO_NET_TX_LAZY_BUDGET	(VIRTIO_NET_QUEUE_SIZE / 4)
+#define VIRTIO_NET_RX_LAZY_BUDGET	VIRTIO_NET_RX_BACKLOG
 
-struct virtio_net_dev {
-	struct virtio_device *vdev;
+/* Zero-copy TX maps guest frame pages in a per-device window. Each
+ * slot covers a frame of upto VIRTIO_NET_MTU bytes at any offset.
+ */
+#define VIRTIO_NET_TX_ZC_SLOTS		64
+#define VIRTIO_NET_TX_ZC_SLOT_PAGES	2
+#define VIRTIO_NET_TX_ZC_SLOT_SIZE	\
+			(VIRTIO_NET_TX_ZC_SLOT_PAGES * VMM_PAGE_SIZE)
+
+struct virtio_net_dev;
 
-	struct virtio_queue vqs[VIRTIO_NET_NUM_QUEUES];
+/* RX and TX virtqueue pair. Lazy TX work and deferred RX delivery
+ * of a queue pair are always done by netswitch bottom-half of the
+ * host CPU to which the queue pair is bound.
+ */
+struct virtio_net_queue {
+	struct virtio_net_dev *ndev;
+	u32 index;
+	u32 cpu;
+
+	struct virtio_queue rx_vq;
 	struct virtio_iovec rx_iov[VIRTIO_NET_QUEUE_SIZE];
+	struct virtio_iovec rx_iov_next[VIRTIO_NET_QUEUE_SIZE];
+
+	/* Protects RX used ring and RX backlog */
+	vmm_spinlock_t rx_lock;
+	bool rx_kick;
+	u32 rx_backlog_head;
+	u32 rx_backlog_count;
+	struct vmm_mbuf *rx_backlog[VIRTIO_NET_RX_BACKLOG];
+
+	struct virtio_queue tx_vq;
 	struct virtio_iovec tx_iov[VIRTIO_NET_QUEUE_SIZE];
+
+	/* Protects TX used ring */
+	vmm_spinlock_t tx_lock;
+	u32 tx_epoch;
+};
+
+struct virtio_net_tx_zc {
+	struct virtio_net_queue *q;
+	struct vmm_guest *guest;
+	virtual_addr_t va;
+	physical_addr_t gpa;
+	u32 pages;
+	u16 head;
+	u32 len;
+	u32 epoch;
+};
+
+struct virtio_net_dev {
+	struct virtio_device *vdev;
+
 	struct virtio_net_config config;
 	u32 features;
 
+	u32 max_pairs;
+	u32 curr_pairs;
+	struct virtio_net_queue *qs;
+
+	struct virtio_queue ctrl_vq;
+	struct virtio_iovec ctrl_iov[VIRTIO_NET_CTRL_QUEUE_SIZE];
+
+	/* Protects zero-copy TX slots */
+	vmm_spinlock_t tx_zc_lock;
+	bool tx_dead;
+	virtual_addr_t tx_zc_va;
+	u32 tx_zc_inflight;
+	u32 tx_zc_free_count;
+	u8 tx_zc_free[VIRTIO_NET_TX_ZC_SLOTS];
+	struct virtio_net_tx_zc tx_zc[VIRTIO_NET_TX_ZC_SLOTS];
+
 	int mode;
 	struct vmm_netport *port;
 	char name[VIRTIO_DEVICE_MAX_NAME_LEN];
@@ -68,21 +146,31 @@ struct virtio_net_dev {
 
 static u32 virtio_net_get_host_features(struct virtio_device *dev)
 {
-	return 1UL << VIRTIO_NET_F_MAC
-#if 0
+	struct virtio_net_dev *ndev = dev->emu_data;
+	u32 features;
+
+	features = 1UL << VIRTIO_NET_F_MAC
+		| 1UL << VIRTIO_NET_F_MRG_RXBUF
 		| 1UL << VIRTIO_NET_F_CSUM
+		| 1UL << VIRTIO_NET_F_GUEST_CSUM
 		| 1UL << VIRTIO_NET_F_HOST_UFO
 		| 1UL << VIRTIO_NET_F_HOST_TSO4
 		| 1UL << VIRTIO_NET_F_HOST_TSO6
 		| 1UL << VIRTIO_NET_F_GUEST_UFO
 		| 1UL << VIRTIO_NET_F_GUEST_TSO4
 		| 1UL << VIRTIO_NET_F_GUEST_TSO6
-#endif
 		| 1UL << VIRTIO_RING_F_EVENT_IDX
 #if 0
 		| 1UL << VIRTIO_RING_F_INDIRECT_DESC
 #endif
 		;
+
+	if (1 < ndev->max_pairs) {
+		features |= 1UL << VIRTIO_NET_F_CTRL_VQ
+			 | 1UL << VIRTIO_NET_F_MQ;
+	}
+
+	return features;
 }
 
 static void virtio_net_set_guest_features(struct virtio_device *dev,
@@ -91,136 +179,559 @@ static void virtio_net_set_guest_features(struct virtio_device *dev,
 	struct virtio_net_dev *ndev = dev->emu_data;
 
 	ndev->features = features;
+
+	/* Offloaded frames are sent to guest only if it can take them
+	 * otherwise netswitch resolves them in software.
+	 */
+	ndev->port->features = 0;
+	if (features & (1UL << VIRTIO_NET_F_GUEST_CSUM)) {
+		ndev->port->features |= VMM_NETPORT_F_CSUM;
+		if (features & (1UL << VIRTIO_NET_F_GUEST_TSO4)) {
+			ndev->port->features |= VMM_NETPORT_F_TSO4;
+		}
+		if (features & (1UL << VIRTIO_NET_F_GUEST_TSO6)) {
+			ndev->port->features |= VMM_NETPORT_F_TSO6;
+		}
+		if (features & (1UL << VIRTIO_NET_F_GUEST_UFO)) {
+			ndev->port->features |= VMM_NETPORT_F_UFO;
+		}
+	}
+}
+
+/* Control virtqueue comes after all queue pairs only if VIRTIO_NET_F_MQ
+ * is negotiated otherwise it comes after first queue pair.
+ */
+static u32 virtio_net_ctrl_vq_index(struct virtio_net_dev *ndev)
+{
+	if (ndev->features & (1UL << VIRTIO_NET_F_MQ)) {
+		return ndev->max_pairs * 2;
+	}
+
+	return 2;
+}
+
+static bool virtio_net_is_ctrl_vq(struct virtio_net_dev *ndev, u32 vq)
+{
+	if (!(ndev->features & (1UL << VIRTIO_NET_F_CTRL_VQ))) {
+		return FALSE;
+	}
+
+	return (vq == virtio_net_ctrl_vq_index(ndev)) ? TRUE : FALSE;
+}
+
+static struct virtio_queue *virtio_net_get_vq(struct virtio_net_dev *ndev,
+					      u32 vq)
+{
+	if (virtio_net_is_ctrl_vq(ndev, vq)) {
+		return &ndev->ctrl_vq;
+	}
+
+	if (vq < (ndev->max_pairs * 2)) {
+		return (vq & 0x1) ? &ndev->qs[vq >> 1].tx_vq :
+				    &ndev->qs[vq >> 1].rx_vq;
+	}
+
+	return NULL;
 }
 
 static int virtio_net_init_vq(struct virtio_device *dev,
-			      u32 vq, u32 page_size, u32 align, u32 pfn)
+			      u32 vq, struct virtio_queue_layout *layout)
 {
-	int rc;
 	struct virtio_net_dev *ndev = dev->emu_data;
+	struct virtio_queue *q = virtio_net_get_vq(ndev, vq);
 
-	switch (vq) {
-	case VIRTIO_NET_TX_QUEUE:
-	case VIRTIO_NET_RX_QUEUE:
-		rc = virtio_queue_setup(&ndev->vqs[vq], dev->guest, 
-				pfn, page_size, VIRTIO_NET_QUEUE_SIZE, align);
-		break;
-	default:
-		rc = VMM_EINVALID;
-		break;
+	if (!q) {
+		return VMM_EINVALID;
 	}
 
-	return rc;
+	return virtio_queue_setup(q, dev->guest, layout);
 }
 
 static int virtio_net_get_pfn_vq(struct virtio_device *dev, u32 vq)
 {
-	int rc;
 	struct virtio_net_dev *ndev = dev->emu_data;
+	struct virtio_queue *q = virtio_net_get_vq(ndev, vq);
+
+	if (!q) {
+		return VMM_EINVALID;
+	}
+
+	return virtio_queue_guest_pfn(q);
+}
+
+static int virtio_net_get_size_vq(struct virtio_device *dev, u32 vq)
+{
+	struct virtio_net_dev *ndev = dev->emu_data;
+	struct virtio_queue *q = virtio_net_get_vq(ndev, vq);
+
+	if (!q) {
+		return 0;
+	}
+
+	return (q == &ndev->ctrl_vq) ? VIRTIO_NET_CTRL_QUEUE_SIZE :
+				       VIRTIO_NET_QUEUE_SIZE;
+}
+
+static int virtio_net_set_size_vq(struct virtio_device *dev, u32 vq, int size)
+{
+	/* FIXME: dynamic */
+	return size;
+}
+
+static void virtio_net_tx_poke(struct virtio_net_queue *q);
+static void virtio_net_rx_poke(struct virtio_net_queue *q);
+
+static void virtio_net_tx_done(struct virtio_net_queue *q,
+			       u16 head, u32 len)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&q->tx_lock, flags);
+	virtio_queue_set_used_elem(&q->tx_vq, head, len);
+	vmm_spin_unlock_irqrestore(&q->tx_lock, flags);
+}
+
+static void virtio_net_tx_signal(struct virtio_net_queue *q)
+{
+	irq_flags_t flags;
+	struct virtio_device *dev = q->ndev->vdev;
+
+	vmm_spin_lock_irqsave(&q->tx_lock, flags);
+	if (virtio_queue_should_signal(&q->tx_vq)) {
+		dev->tra->notify(dev, VIRTIO_NET_TX_VQ(q->index));
+	}
+	vmm_spin_unlock_irqrestore(&q->tx_lock, flags);
+}
+
+static void virtio_net_free(struct virtio_net_dev *ndev)
+{
+	if (ndev->tx_zc_va) {
+		vmm_host_vapool_free(ndev->tx_zc_va, VIRTIO_NET_TX_ZC_SLOTS *
+						     VIRTIO_NET_TX_ZC_SLOT_SIZE);
+	}
+	vmm_free(ndev->qs);
+	vmm_free(ndev);
+}
 
-	switch (vq) {
-	case VIRTIO_NET_TX_QUEUE:
-	case VIRTIO_NET_RX_QUEUE:
-		rc = virtio_queue_guest_pfn(&ndev->vqs[vq]);
+/* Called when last reference to a zero-copy TX frame is dropped */
+static void virtio_net_tx_zc_free(struct vmm_mbuf *m,
+				  void *ptr, u32 size, void *arg)
+{
+	bool free_ndev = FALSE;
+	irq_flags_t flags;
+	struct virtio_net_tx_zc *zc = arg;
+	struct virtio_net_queue *q = zc->q;
+	struct virtio_net_dev *ndev = q->ndev;
+	struct virtio_device *dev;
+
+	/*
+	 * NOTE: We can be called after disconnect has freed the virtio
+	 * device so only the guest saved in the slot is used here and
+	 * the device is touched only under tx_lock with a matching epoch.
+	 */
+	vmm_host_unmap_pages(zc->va, zc->pages);
+	vmm_guest_physical_unmap(zc->guest, zc->gpa, zc->len);
+
+	vmm_spin_lock_irqsave(&q->tx_lock, flags);
+
+	/* Skip used ring update if device was reset in-between */
+	if (zc->epoch == q->tx_epoch) {
+		dev = ndev->vdev;
+		virtio_queue_set_used_elem(&q->tx_vq, zc->head, zc->len);
+		if (virtio_queue_should_signal(&q->tx_vq)) {
+			dev->tra->notify(dev, VIRTIO_NET_TX_VQ(q->index));
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&q->tx_lock, flags);
+
+	vmm_spin_lock_irqsave(&ndev->tx_zc_lock, flags);
+
+	ndev->tx_zc_free[ndev->tx_zc_free_count++] = zc - ndev->tx_zc;
+	ndev->tx_zc_inflight--;
+	if (ndev->tx_dead && !ndev->tx_zc_inflight) {
+		free_ndev = TRUE;
+	}
+
+	vmm_spin_unlock_irqrestore(&ndev->tx_zc_lock, flags);
+
+	if (free_ndev) {
+		virtio_net_free(ndev);
+	}
+}
+
+/* Length of virtio_net_hdr in front of every frame */
+static u32 virtio_net_hdr_len(struct virtio_net_dev *ndev)
+{
+	if ((ndev->features & (1UL << VIRTIO_NET_F_MRG_RXBUF)) ||
+	    virtio_has_feature(ndev->vdev, VIRTIO_F_VERSION_1)) {
+		return sizeof(struct virtio_net_hdr_mrg_rxbuf);
+	}
+
+	return sizeof(struct virtio_net_hdr);
+}
+
+/* Copy offload info of guest TX frame to mbuf. Only the offloads
+ * negotiated with guest are honoured.
+ */
+static void virtio_net_tx_offload(struct virtio_net_dev *ndev,
+				  struct virtio_net_hdr *hdr,
+				  struct vmm_mbuf *mb)
+{
+	u32 f = ndev->features;
+
+	if ((hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) &&
+	    (f & (1UL << VIRTIO_NET_F_CSUM))) {
+		mb->m_csum_flags = M_CSUM_PARTIAL;
+		mb->m_csum_start = hdr->csum_start;
+		mb->m_csum_offset = hdr->csum_offset;
+	}
+
+	switch (hdr->gso_type & ~VIRTIO_NET_HDR_GSO_ECN) {
+	case VIRTIO_NET_HDR_GSO_TCPV4:
+		if (f & (1UL << VIRTIO_NET_F_HOST_TSO4)) {
+			mb->m_gso_type = M_GSO_TCPV4;
+		}
+		break;
+	case VIRTIO_NET_HDR_GSO_TCPV6:
+		if (f & (1UL << VIRTIO_NET_F_HOST_TSO6)) {
+			mb->m_gso_type = M_GSO_TCPV6;
+		}
+		break;
+	case VIRTIO_NET_HDR_GSO_UDP:
+		if (f & (1UL << VIRTIO_NET_F_HOST_UFO)) {
+			mb->m_gso_type = M_GSO_UDP;
+		}
 		break;
 	default:
-		rc = VMM_EINVALID;
 		break;
 	}
 
-	return rc;
+	if (mb->m_gso_type != M_GSO_NONE) {
+		if (hdr->gso_type & VIRTIO_NET_HDR_GSO_ECN) {
+			mb->m_gso_type |= M_GSO_ECN;
+		}
+		mb->m_gso_size = hdr->gso_size;
+		mb->m_hdr_len = hdr->hdr_len;
+	}
 }
 
-static int virtio_net_get_size_vq(struct virtio_device *dev, u32 vq)
+/* Fill offload info of guest RX frame from mbuf. Netswitch only
+ * hands over offloads which guest has negotiated.
+ */
+static void virtio_net_rx_offload(struct virtio_net_dev *ndev,
+				  struct vmm_mbuf *mb,
+				  struct virtio_net_hdr *hdr)
 {
-	int rc;
+	if (!(ndev->features & (1UL << VIRTIO_NET_F_GUEST_CSUM))) {
+		return;
+	}
+
+	if (mb->m_csum_flags & M_CSUM_PARTIAL) {
+		hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		hdr->csum_start = mb->m_csum_start;
+		hdr->csum_offset = mb->m_csum_offset;
+	} else if (mb->m_csum_flags & M_CSUM_VALID) {
+		hdr->flags = VIRTIO_NET_HDR_F_DATA_VALID;
+	}
 
-	switch (vq) {
-	case VIRTIO_NET_TX_QUEUE:
-	case VIRTIO_NET_RX_QUEUE:
-		rc = VIRTIO_NET_QUEUE_SIZE;
+	switch (mb->m_gso_type & ~M_GSO_ECN) {
+	case M_GSO_TCPV4:
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
 		break;
-	default:
-		rc = 0;
+	case M_GSO_TCPV6:
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+		break;
+	case M_GSO_UDP:
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_UDP;
 		break;
+	default:
+		return;
 	}
 
-	return rc;
+	if (mb->m_gso_type & M_GSO_ECN) {
+		hdr->gso_type |= VIRTIO_NET_HDR_GSO_ECN;
+	}
+	hdr->gso_size = mb->m_gso_size;
+	hdr->hdr_len = mb->m_hdr_len;
 }
 
-static int virtio_net_set_size_vq(struct virtio_device *dev, u32 vq, int size)
+/* Skip virtio_net_hdr at start of TX IO vectors. With VIRTIO_F_VERSION_1
+ * header can share descriptor with frame data so IO vectors are trimmed.
+ * Returns index of first IO vector having frame data.
+ */
+static u32 virtio_net_tx_skip_hdr(struct virtio_iovec *iov, u32 iov_cnt,
+				  u32 hdr_len)
 {
-	/* FIXME: dynamic */
-	return size;
+	u32 i, skip;
+
+	for (i = 0; (i < iov_cnt) && hdr_len; i++) {
+		skip = min(iov[i].len, hdr_len);
+		iov[i].addr += skip;
+		iov[i].len -= skip;
+		hdr_len -= skip;
+		if (iov[i].len) {
+			break;
+		}
+	}
+
+	return i;
 }
 
-static void virtio_net_tx_poke(struct virtio_net_dev *ndev);
+/* Try to build a TX frame without copying it out of guest memory.
+ * This works only when frame is in one descriptor which maps to
+ * contiguous guest RAM. Returns NULL if frame has to be copied.
+ */
+static struct vmm_mbuf *virtio_net_tx_zc_xfer(struct virtio_net_queue *q,
+				  struct virtio_iovec *iov, u32 iov_cnt,
+				  struct virtio_net_hdr *hdr,
+				  u16 head, u32 total_len, u32 pkt_len)
+{
+	u32 reg_flags, offset, pages;
+	irq_flags_t flags;
+	physical_addr_t hphys;
+	physical_size_t hsize;
+	struct virtio_net_tx_zc *zc;
+	struct virtio_net_dev *ndev = q->ndev;
+	struct vmm_mbuf *mb;
+
+	if (!ndev->tx_zc_va || (iov_cnt != 1)) {
+		return NULL;
+	}
+
+	/* Guest mapping stays pinned till the frame is freed */
+	if (vmm_guest_physical_map(ndev->vdev->guest, iov[0].addr, pkt_len,
+				   &hphys, &hsize, &reg_flags)) {
+		return NULL;
+	}
+	if ((hsize < pkt_len) ||
+	    !(reg_flags & VMM_REGION_ISRAM) ||
+	    !(reg_flags & VMM_REGION_REAL)) {
+		goto fail_unmap;
+	}
+
+	offset = hphys & VMM_PAGE_MASK;
+	pages = VMM_SIZE_TO_PAGE(offset + pkt_len);
+	if (VIRTIO_NET_TX_ZC_SLOT_PAGES < pages) {
+		goto fail_unmap;
+	}
+
+	MGETHDR(mb, 0, 0);
+	if (!mb) {
+		goto fail_unmap;
+	}
+
+	vmm_spin_lock_irqsave(&ndev->tx_zc_lock, flags);
+	if (!ndev->tx_zc_free_count) {
+		vmm_spin_unlock_irqrestore(&ndev->tx_zc_lock, flags);
+		m_freem(mb);
+		goto fail_unmap;
+	}
+	zc = &ndev->tx_zc[ndev->tx_zc_free[--ndev->tx_zc_free_count]];
+	ndev->tx_zc_inflight++;
+	vmm_spin_unlock_irqrestore(&ndev->tx_zc_lock, flags);
+
+	vmm_spin_lock_irqsave(&q->tx_lock, flags);
+	zc->epoch = q->tx_epoch;
+	vmm_spin_unlock_irqrestore(&q->tx_lock, flags);
+
+	zc->q = q;
+	zc->guest = ndev->vdev->guest;
+	zc->gpa = iov[0].addr;
+	zc->pages = pages;
+	zc->head = head;
+	zc->len = total_len;
+	if (vmm_host_map_pages(zc->va, hphys & ~VMM_PAGE_MASK, pages,
+			       VMM_MEMORY_FLAGS_NORMAL)) {
+		vmm_spin_lock_irqsave(&ndev->tx_zc_lock, flags);
+		ndev->tx_zc_free[ndev->tx_zc_free_count++] = zc - ndev->tx_zc;
+		ndev->tx_zc_inflight--;
+		vmm_spin_unlock_irqrestore(&ndev->tx_zc_lock, flags);
+		m_freem(mb);
+		goto fail_unmap;
+	}
+
+	/* Guest owns the frame so don't let anybody write to it */
+	MEXTADD(mb, zc->va + offset, pkt_len, virtio_net_tx_zc_free, zc);
+	mb->m_flags &= ~M_EXT_RW;
+	mb->m_flags |= M_EXT_GUEST;
+	mb->m_len = mb->m_pktlen = pkt_len;
+	virtio_net_tx_offload(ndev, hdr, mb);
+
+	return mb;
+
+fail_unmap:
+	vmm_guest_physical_unmap(ndev->vdev->guest, iov[0].addr, pkt_len);
+	return NULL;
+}
 
 static void virtio_net_tx_lazy(struct vmm_netport *port, void *arg, int budget)
 {
 	u16 head = 0;
-	u32 iov_cnt = 0, pkt_len = 0, total_len = 0;
-	struct virtio_net_dev *ndev = arg;
+	u32 i, iov_cnt = 0, pkt_len = 0, total_len = 0, burst_cnt = 0;
+	struct virtio_net_queue *q = arg;
+	struct virtio_net_dev *ndev = q->ndev;
 	struct virtio_device *dev = ndev->vdev;
-	struct virtio_queue *vq = &ndev->vqs[VIRTIO_NET_TX_QUEUE];
-	struct virtio_iovec *iov = ndev->tx_iov;
-	struct vmm_mbuf *mb;
+	struct virtio_queue *vq = &q->tx_vq;
+	struct virtio_iovec *iov = q->tx_iov;
+	u32 hdr_len = virtio_net_hdr_len(ndev);
+	struct virtio_net_hdr hdr;
+	struct vmm_mbuf *mb, *burst[VMM_NETPORT_MAX_BURST];
 
 	while ((budget > 0) && virtio_queue_available(vq)) {
+		/* Frames are sent to netswitch in bursts */
+		if (burst_cnt == VMM_NETPORT_MAX_BURST) {
+			vmm_port2switch_xfer_burst(ndev->port,
+						   burst, burst_cnt);
+			burst_cnt = 0;
+		}
+
+
 		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
 
-		/* iov[0] is offload info */
-		pkt_len = total_len - iov[0].len;
+		/* Frame is preceded by offload info */
+		pkt_len = (hdr_len < total_len) ? (total_len - hdr_len) : 0;
+		memset(&hdr, 0, sizeof(hdr));
+		virtio_iovec_to_buf_read(dev, iov, iov_cnt,
+					 &hdr, sizeof(hdr));
+		i = virtio_net_tx_skip_hdr(iov, iov_cnt, hdr_len);
+
+		/* Empty or oversized frames are completed but not sent */
+		if (pkt_len && (pkt_len <= VIRTIO_NET_MAX_FRAME)) {
+			/* Used ring is updated when frame is freed */
+			mb = virtio_net_tx_zc_xfer(q, &iov[i], iov_cnt - i,
+						   &hdr, head, total_len,
+						   pkt_len);
+			if (mb) {
+				burst[burst_cnt++] = mb;
+				budget--;
+				continue;
+			}
 
-		if (pkt_len <= VIRTIO_NET_MTU) {
 			MGETHDR(mb, 0, 0);
-			MEXTMALLOC(mb, pkt_len, 0);
-			virtio_iovec_to_buf_read(dev, 
-						 &iov[1], iov_cnt - 1,
-						 M_BUFADDR(mb), pkt_len);
-			mb->m_len = mb->m_pktlen = pkt_len;
-			vmm_port2switch_xfer_mbuf(ndev->port, mb);
+			if (mb && MEXTMALLOC(mb, pkt_len, 0)) {
+				virtio_iovec_to_buf_read(dev,
+						&iov[i], iov_cnt - i,
+						M_BUFADDR(mb), pkt_len);
+				mb->m_len = mb->m_pktlen = pkt_len;
+				virtio_net_tx_offload(ndev, &hdr, mb);
+				burst[burst_cnt++] = mb;
+			} else if (mb) {
+				m_freem(mb);
+			}
 		}
 
-		virtio_queue_set_used_elem(vq, head, total_len);
+		virtio_net_tx_done(q, head, total_len);
 
 		budget--;
 	}
 
-	if (virtio_queue_should_signal(vq)) {
-		dev->tra->notify(dev, VIRTIO_NET_TX_QUEUE);
+	if (burst_cnt) {
+		vmm_port2switch_xfer_burst(ndev->port, burst, burst_cnt);
 	}
 
-	virtio_net_tx_poke(ndev);
+	virtio_net_tx_signal(q);
+
+	virtio_net_tx_poke(q);
 }
 
-static void virtio_net_tx_poke(struct virtio_net_dev *ndev)
+static void virtio_net_tx_poke(struct virtio_net_queue *q)
 {
-	struct virtio_queue *vq = &ndev->vqs[VIRTIO_NET_TX_QUEUE];
+	if (virtio_queue_available(&q->tx_vq)) {
+		vmm_port2switch_xfer_lazy_oncpu(q->ndev->port, q->cpu,
+						virtio_net_tx_lazy, q,
+						VIRTIO_NET_TX_LAZY_BUDGET);
+	}
+}
+
+static virtio_net_ctrl_ack virtio_net_ctrl_mq(struct virtio_net_dev *ndev,
+					      struct virtio_net_ctrl_hdr *hdr,
+					      struct virtio_iovec *iov,
+					      u32 iov_cnt)
+{
+	struct virtio_net_ctrl_mq mq;
+
+	if ((hdr->cmd != VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET) || !iov_cnt ||
+	    !(ndev->features & (1UL << VIRTIO_NET_F_MQ))) {
+		return VIRTIO_NET_ERR;
+	}
+
+	if (virtio_iovec_to_buf_read(ndev->vdev, iov, iov_cnt,
+				     &mq, sizeof(mq)) != sizeof(mq)) {
+		return VIRTIO_NET_ERR;
+	}
 
-	if (virtio_queue_available(vq)) {
-		vmm_port2switch_xfer_lazy(ndev->port, virtio_net_tx_lazy, 
-					  ndev, VIRTIO_NET_TX_LAZY_BUDGET);
+	if ((mq.virtqueue_pairs < VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN) ||
+	    (ndev->max_pairs < mq.virtqueue_pairs)) {
+		return VIRTIO_NET_ERR;
+	}
+
+	/* RX steering picks up new value on next frame */
+	ndev->curr_pairs = mq.virtqueue_pairs;
+
+	return VIRTIO_NET_OK;
+}
+
+static void virtio_net_ctrl_handle(struct virtio_net_dev *ndev)
+{
+	u16 head = 0;
+	u32 iov_cnt = 0, total_len = 0, len;
+	virtio_net_ctrl_ack ack;
+	struct virtio_net_ctrl_hdr hdr;
+	struct virtio_device *dev = ndev->vdev;
+	struct virtio_queue *vq = &ndev->ctrl_vq;
+	struct virtio_iovec *iov = ndev->ctrl_iov;
+
+	while (virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+
+		/* iov[0] is command header and last iov is ack */
+		ack = VIRTIO_NET_ERR;
+		if ((2 <= iov_cnt) &&
+		    (virtio_iovec_to_buf_read(dev, &iov[0], 1, &hdr,
+					      sizeof(hdr)) == sizeof(hdr))) {
+			switch (hdr.class) {
+			case VIRTIO_NET_CTRL_MQ:
+				ack = virtio_net_ctrl_mq(ndev, &hdr,
+							 &iov[1], iov_cnt - 2);
+				break;
+			default:
+				break;
+			};
+		}
+
+		len = 0;
+		if (iov_cnt) {
+			len = virtio_buf_to_iovec_write(dev,
+						&iov[iov_cnt - 1], 1,
+						&ack, sizeof(ack));
+		}
+
+		virtio_queue_set_used_elem(vq, head, len);
+	}
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, virtio_net_ctrl_vq_index(ndev));
 	}
 }
 
 static int virtio_net_notify_vq(struct virtio_device *dev, u32 vq)
 {
-	int rc = VMM_OK;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
-	switch (vq) {
-	case VIRTIO_NET_TX_QUEUE:
-		virtio_net_tx_poke(ndev);
-		break;
-	case VIRTIO_NET_RX_QUEUE:
-		break;
-	default:
-		rc = VMM_EINVALID;
-		break;
+	if (virtio_net_is_ctrl_vq(ndev, vq)) {
+		virtio_net_ctrl_handle(ndev);
+	} else if (vq < (ndev->max_pairs * 2)) {
+		if (vq & 0x1) {
+			virtio_net_tx_poke(&ndev->qs[vq >> 1]);
+		} else {
+			virtio_net_rx_poke(&ndev->qs[vq >> 1]);
+		}
+	} else {
+		return VMM_EINVALID;
 	}
 
-	return rc;
+	return VMM_OK;
 }
 
 static void virtio_net_set_link(struct vmm_netport *p)
@@ -228,47 +739,415 @@ static void virtio_net_set_link(struct vmm_netport *p)
 	/* FIXME: */
 }
 
+/* Frames may be steered to any active queue pair so we can receive
+ * as soon as one of them has its RX queue set up.
+ */
 static int virtio_net_can_receive(struct vmm_netport *p)
 {
+	u32 i, pairs;
 	struct virtio_net_dev *ndev = p->priv;
-	struct virtio_queue *vq = &ndev->vqs[VIRTIO_NET_RX_QUEUE];
 
-	return virtio_queue_setup_done(vq) ? 1 : 0;
+	pairs = ndev->curr_pairs;
+	for (i = 0; i < pairs; i++) {
+		if (virtio_queue_setup_done(&ndev->qs[i].rx_vq)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+struct virtio_net_rx_cursor {
+	struct virtio_iovec *iov;
+	u32 iov_cnt;
+	u32 idx;
+	u32 pos;
+};
+
+static void virtio_net_rx_cursor_init(struct virtio_net_rx_cursor *cur,
+				      struct virtio_iovec *iov, u32 iov_cnt)
+{
+	cur->iov = iov;
+	cur->iov_cnt = iov_cnt;
+	cur->idx = 0;
+	cur->pos = 0;
+}
+
+/* Write to guest buffer chain at cursor and advance the cursor.
+ * If buf is NULL then cursor is only advanced.
+ */
+static u32 virtio_net_rx_cursor_write(struct virtio_net_rx_cursor *cur,
+				      struct vmm_guest_memcopy *mc,
+				      void *buf, u32 len)
+{
+	u32 ret = 0, wlen;
+	struct virtio_iovec *iov;
+
+	while (len && (cur->idx < cur->iov_cnt)) {
+		iov = &cur->iov[cur->idx];
+		wlen = min(iov->len - cur->pos, len);
+		if (buf) {
+			if (vmm_guest_memcopy_write(mc, iov->addr + cur->pos,
+						    buf + ret, wlen) != wlen) {
+				/* Bad guest buffer so treat chain as full */
+				cur->idx = cur->iov_cnt;
+				break;
+			}
+		}
+		ret += wlen;
+		len -= wlen;
+		cur->pos += wlen;
+		if (cur->pos == iov->len) {
+			cur->idx++;
+			cur->pos = 0;
+		}
+	}
+
+	return ret;
+}
+
+/* Scatter one frame across guest RX buffers.
+ * Without VIRTIO_NET_F_MRG_RXBUF the frame must fit in one descriptor
+ * chain whereas with it the frame is spread over as many chains as
+ * required. The used elements of all chains are published together
+ * so that guest never sees a partial frame.
+ * NOTE: This function must be called with rx_lock held
+ */
+static int virtio_net_rx_frame(struct virtio_net_queue *q,
+			       struct vmm_mbuf *mb)
+{
+	u16 head, num_buffers = 0;
+	u32 iov_cnt, first_iov_cnt = 0, total_len, hdr_len, len, wlen;
+	u32 remain = mb->m_pktlen, moff = 0;
+	struct virtio_net_dev *ndev = q->ndev;
+	bool mrg = (ndev->features & (1UL << VIRTIO_NET_F_MRG_RXBUF)) ?
+								TRUE : FALSE;
+	struct virtio_device *dev = ndev->vdev;
+	struct virtio_queue *vq = &q->rx_vq;
+	struct virtio_iovec *iov;
+	struct virtio_net_hdr_mrg_rxbuf hdr;
+	struct virtio_net_rx_cursor cur;
+	struct vmm_guest_memcopy mc;
+	struct vmm_mbuf *m = mb;
+
+	hdr_len = virtio_net_hdr_len(ndev);
+
+	vmm_guest_memcopy_init(&mc, dev->guest, TRUE);
+
+	do {
+		if (!virtio_queue_available(vq)) {
+			virtio_queue_rewind(vq, num_buffers);
+			return VMM_EAGAIN;
+		}
+
+		/* Keep IO vectors of first chain for writing header */
+		iov = (num_buffers) ? q->rx_iov_next : q->rx_iov;
+		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+		virtio_net_rx_cursor_init(&cur, iov, iov_cnt);
+
+		len = 0;
+		if (!num_buffers) {
+			first_iov_cnt = iov_cnt;
+			len = virtio_net_rx_cursor_write(&cur, &mc,
+							 NULL, hdr_len);
+		}
+
+		while (m && remain && (cur.idx < cur.iov_cnt)) {
+			wlen = min((u32)m->m_len - moff, remain);
+			wlen = virtio_net_rx_cursor_write(&cur, &mc,
+					mtod(m, u8 *) + moff, wlen);
+			len += wlen;
+			moff += wlen;
+			remain -= wlen;
+			if (moff == m->m_len) {
+				m = m->m_next;
+				moff = 0;
+			}
+		}
+
+		virtio_queue_fill_used_elem(vq, num_buffers, head, len);
+		num_buffers++;
+
+		if (remain && (!mrg || (num_buffers == vq->vring.num) ||
+				(len < hdr_len))) {
+			/* Frame can never fit in guest buffers */
+			virtio_queue_rewind(vq, num_buffers);
+			return VMM_ENOSPC;
+		}
+	} while (remain);
+
+	memset(&hdr, 0, sizeof(hdr));
+	virtio_net_rx_offload(ndev, mb, &hdr.hdr);
+	hdr.num_buffers = num_buffers;
+	virtio_net_rx_cursor_init(&cur, q->rx_iov, first_iov_cnt);
+	virtio_net_rx_cursor_write(&cur, &mc, &hdr, hdr_len);
+
+	virtio_queue_flush_used(vq, num_buffers);
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_NET_RX_VQ(q->index));
+	}
+
+	return VMM_OK;
+}
+
+/* Deliver backlogged frames in order until guest RX ring is empty.
+ * NOTE: This function must be called with rx_lock held
+ */
+static void virtio_net_rx_drain(struct virtio_net_queue *q)
+{
+	struct vmm_mbuf *mb;
+
+	while (q->rx_backlog_count) {
+		mb = q->rx_backlog[q->rx_backlog_head];
+		if (virtio_net_rx_frame(q, mb) == VMM_EAGAIN) {
+			break;
+		}
+		m_freem(mb);
+		q->rx_backlog[q->rx_backlog_head] = NULL;
+		q->rx_backlog_head++;
+		if (q->rx_backlog_head == VIRTIO_NET_RX_BACKLOG) {
+			q->rx_backlog_head = 0;
+		}
+		q->rx_backlog_count--;
+	}
+}
+
+/* Free all backlogged frames
+ * NOTE: This function must be called with rx_lock held
+ */
+static void virtio_net_rx_purge(struct virtio_net_queue *q)
+{
+	while (q->rx_backlog_count) {
+		m_freem(q->rx_backlog[q->rx_backlog_head]);
+		q->rx_backlog[q->rx_backlog_head] = NULL;
+		q->rx_backlog_head++;
+		if (q->rx_backlog_head == VIRTIO_NET_RX_BACKLOG) {
+			q->rx_backlog_head = 0;
+		}
+		q->rx_backlog_count--;
+	}
+	q->rx_backlog_head = 0;
+}
+
+static void virtio_net_rx_lazy(struct vmm_netport *port, void *arg, int budget)
+{
+	irq_flags_t flags;
+	struct virtio_net_queue *q = arg;
+
+	vmm_spin_lock_irqsave(&q->rx_lock, flags);
+	q->rx_kick = FALSE;
+	virtio_net_rx_drain(q);
+	vmm_spin_unlock_irqrestore(&q->rx_lock, flags);
+}
+
+/* Schedule backlog drain on host CPU of the queue pair
+ * NOTE: This function must be called with rx_lock held
+ */
+static void virtio_net_rx_kick(struct virtio_net_queue *q)
+{
+	if (q->rx_kick || !q->rx_backlog_count) {
+		return;
+	}
+
+	q->rx_kick = TRUE;
+	if (vmm_port2switch_xfer_lazy_oncpu(q->ndev->port, q->cpu,
+					    virtio_net_rx_lazy, q,
+					    VIRTIO_NET_RX_LAZY_BUDGET)) {
+		q->rx_kick = FALSE;
+	}
+}
+
+static void virtio_net_rx_poke(struct virtio_net_queue *q)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&q->rx_lock, flags);
+	if (vmm_smp_processor_id() == q->cpu) {
+		virtio_net_rx_drain(q);
+	} else {
+		virtio_net_rx_kick(q);
+	}
+	vmm_spin_unlock_irqrestore(&q->rx_lock, flags);
+}
+
+#define VIRTIO_NET_RD32(p)	(((u32)(p)[0] << 24) | ((u32)(p)[1] << 16) | \
+				 ((u32)(p)[2] << 8) | (u32)(p)[3])
+
+/* Pick RX queue pair of a frame based on hash of its flow */
+static u32 virtio_net_rx_steer(struct virtio_net_dev *ndev,
+			       struct vmm_mbuf *mb)
+{
+	u32 hash, ihl, pairs = ndev->curr_pairs;
+	u8 *frame = mtod(mb, u8 *), *ip;
+
+	if ((pairs < 2) || (mb->m_len < ETHER_HLEN)) {
+		return 0;
+	}
+
+	if ((ether_type(frame) == 0x0800) &&
+	    ((ETHER_HLEN + IP4_HLEN) <= mb->m_len)) {
+		ip = ether_payload(frame);
+		ihl = (ip[0] & 0xF) << 2;
+		hash = VIRTIO_NET_RD32(ip_srcaddr(ip)) ^
+		       VIRTIO_NET_RD32(ip_dstaddr(ip));
+		/* Use ports of unfragmented TCP and UDP frames */
+		if (((ip_protocol(ip) == 0x06) || (ip_protocol(ip) == 0x11)) &&
+		    !(vmm_be16_to_cpu(((struct ip_header *)ip)->ipoffset) &
+								0x3FFF) &&
+		    ((ETHER_HLEN + ihl + 4) <= mb->m_len)) {
+			hash ^= VIRTIO_NET_RD32(ip + ihl);
+		}
+	} else {
+		hash = VIRTIO_NET_RD32(ether_dstmac(frame) + 2) ^
+		       VIRTIO_NET_RD32(ether_srcmac(frame) + 2);
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+
+	return umod32(hash, pairs);
+}
+
+/* Deliver a frame to queue pair or add it to backlog of queue pair.
+ * Returns the mbuf if it has to be freed by caller.
+ * NOTE: This function must be called with rx_lock held
+ */
+static struct vmm_mbuf *virtio_net_rx_enqueue(struct virtio_net_queue *q,
+					      struct vmm_mbuf *mb)
+{
+	u32 tail;
+	bool local;
+	struct vmm_mbuf *cmb;
+
+	/* Frames for queue pair of another host CPU are handed over
+	 * using the backlog.
+	 */
+	local = (vmm_smp_processor_id() == q->cpu) ? TRUE : FALSE;
+	if (local) {
+		virtio_net_rx_drain(q);
+		if (!q->rx_backlog_count &&
+		    (virtio_net_rx_frame(q, mb) != VMM_EAGAIN)) {
+			return mb;
+		}
+	}
+
+	if (q->rx_backlog_count == VIRTIO_NET_RX_BACKLOG) {
+		return mb;
+	}
+
+	/* Frames owned by another guest are never held in backlog,
+	 * whether local or remote, because the sender can't reuse its
+	 * TX slot till the frame is freed.
+	 */
+	if (mb->m_flags & M_EXT_GUEST) {
+		MGETHDR(cmb, 0, 0);
+		if (!cmb) {
+			return mb;
+		}
+		if (!MEXTMALLOC(cmb, mb->m_pktlen, 0)) {
+			m_freem(cmb);
+			return mb;
+		}
+		m_copydata(mb, 0, mb->m_pktlen, M_BUFADDR(cmb));
+		M_COPY_PKTHDR(cmb, mb);
+		cmb->m_len = mb->m_pktlen;
+		m_freem(mb);
+		mb = cmb;
+	}
+
+	tail = q->rx_backlog_head + q->rx_backlog_count;
+	if (VIRTIO_NET_RX_BACKLOG <= tail) {
+		tail -= VIRTIO_NET_RX_BACKLOG;
+	}
+	q->rx_backlog[tail] = mb;
+	q->rx_backlog_count++;
+
+	if (!local) {
+		virtio_net_rx_kick(q);
+	}
+
+	return NULL;
 }
 
 static int virtio_net_switch2port_xfer(struct vmm_netport *p,
 				       struct vmm_mbuf *mb)
 {
-	u16 head = 0;
-	u32 iov_cnt = 0, total_len = 0, pkt_len = 0;
+	irq_flags_t flags;
 	struct virtio_net_dev *ndev = p->priv;
-	struct virtio_queue *vq = &ndev->vqs[VIRTIO_NET_RX_QUEUE];
-	struct virtio_iovec *iov = ndev->rx_iov;
-	struct virtio_device *dev = ndev->vdev;
+	struct virtio_net_queue *q;
 
-	pkt_len = min(VIRTIO_NET_MTU, mb->m_pktlen);
+	if (VIRTIO_NET_MAX_FRAME < mb->m_pktlen) {
+		m_freem(mb);
+		return VMM_OK;
+	}
 
-	if (virtio_queue_available(vq)) {
-		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+	q = &ndev->qs[virtio_net_rx_steer(ndev, mb)];
+
+	vmm_spin_lock_irqsave(&q->rx_lock, flags);
+	mb = virtio_net_rx_enqueue(q, mb);
+	vmm_spin_unlock_irqrestore(&q->rx_lock, flags);
+
+	if (mb) {
+		m_freem(mb);
 	}
 
-	if (iov_cnt > 1) {
-		virtio_iovec_fill_zeros(dev, &iov[0], 1);
-		virtio_buf_to_iovec_write(dev, &iov[1], 1,
-						M_BUFADDR(mb), pkt_len);
-		virtio_queue_set_used_elem(vq, head, iov[0].len + pkt_len);
+	return VMM_OK;
+}
+
+/* Consecutive frames steered to same queue pair are delivered
+ * under single acquisition of its rx_lock.
+ */
+static int virtio_net_switch2port_xfer_burst(struct vmm_netport *p,
+					     struct vmm_mbuf **mbs, u32 count)
+{
+	u32 i, drop_cnt = 0;
+	irq_flags_t flags;
+	struct vmm_mbuf *mb, *drop[VMM_NETPORT_MAX_BURST];
+	struct virtio_net_dev *ndev = p->priv;
+	struct virtio_net_queue *q, *lq = NULL;
+
+	if (VMM_NETPORT_MAX_BURST < count) {
+		return VMM_EINVALID;
+	}
+
+	for (i = 0; i < count; i++) {
+		mb = mbs[i];
+
+		if (VIRTIO_NET_MAX_FRAME < mb->m_pktlen) {
+			drop[drop_cnt++] = mb;
+			continue;
+		}
+
+		q = &ndev->qs[virtio_net_rx_steer(ndev, mb)];
+		if (q != lq) {
+			if (lq) {
+				vmm_spin_unlock_irqrestore(&lq->rx_lock,
+							   flags);
+			}
+			vmm_spin_lock_irqsave(&q->rx_lock, flags);
+			lq = q;
+		}
 
-		if (virtio_queue_should_signal(vq)) {
-			dev->tra->notify(dev, VIRTIO_NET_RX_QUEUE);
+		mb = virtio_net_rx_enqueue(q, mb);
+		if (mb) {
+			drop[drop_cnt++] = mb;
 		}
 	}
 
-	m_freem(mb);
+	if (lq) {
+		vmm_spin_unlock_irqrestore(&lq->rx_lock, flags);
+	}
+
+	for (i = 0; i < drop_cnt; i++) {
+		m_freem(drop[i]);
+	}
 
 	return VMM_OK;
 }
 
-static int virtio_net_read_config(struct virtio_device *dev, 
+static int virtio_net_read_config(struct virtio_device *dev,
 				  u32 offset, void *dst, u32 dst_len)
 {
 	struct virtio_net_dev *ndev = dev->emu_data;
@@ -298,27 +1177,66 @@ static int virtio_net_write_config(struct virtio_device *dev,
 
 static int virtio_net_reset(struct virtio_device *dev)
 {
-	int rc;
+	int rc, ret = VMM_OK;
+	u32 i;
+	irq_flags_t flags;
+	struct virtio_net_queue *q;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
-	rc = virtio_queue_cleanup(&ndev->vqs[VIRTIO_NET_RX_QUEUE]);
-	if (rc) {
-		return rc;
+	for (i = 0; i < ndev->max_pairs; i++) {
+		q = &ndev->qs[i];
+
+		/* Backlogged frames are stale after reset */
+		vmm_spin_lock_irqsave(&q->rx_lock, flags);
+		virtio_net_rx_purge(q);
+		rc = virtio_queue_cleanup(&q->rx_vq);
+		vmm_spin_unlock_irqrestore(&q->rx_lock, flags);
+		if (rc && !ret) {
+			ret = rc;
+		}
+
+		/* In-flight zero-copy TX frames must not touch new rings */
+		vmm_spin_lock_irqsave(&q->tx_lock, flags);
+		q->tx_epoch++;
+		rc = virtio_queue_cleanup(&q->tx_vq);
+		vmm_spin_unlock_irqrestore(&q->tx_lock, flags);
+		if (rc && !ret) {
+			ret = rc;
+		}
 	}
 
-	rc = virtio_queue_cleanup(&ndev->vqs[VIRTIO_NET_TX_QUEUE]);
-	if (rc) {
-		return rc;
+	rc = virtio_queue_cleanup(&ndev->ctrl_vq);
+	if (rc && !ret) {
+		ret = rc;
 	}
 
-	return VMM_OK;
+	ndev->curr_pairs = 1;
+
+	return ret;
+}
+
+/* Spread queue pairs over online host CPUs */
+static u32 virtio_net_queue_cpu(u32 index)
+{
+	u32 cpu, nth = umod32(index, vmm_num_online_cpus());
+
+	for_each_online_cpu(cpu) {
+		if (!nth) {
+			return cpu;
+		}
+		nth--;
+	}
+
+	return vmm_smp_processor_id();
 }
 
-static int virtio_net_connect(struct virtio_device *dev, 
+static int virtio_net_connect(struct virtio_device *dev,
 			      struct virtio_emulator *emu)
 {
 	int i, rc;
+	u32 pairs;
 	const char *attr;
+	struct virtio_net_queue *q;
 	struct virtio_net_dev *ndev;
 	struct vmm_netswitch *nsw;
 
@@ -330,17 +1248,68 @@ static int virtio_net_connect(struct virtio_device *dev,
 
 	ndev->vdev = dev;
 	vmm_snprintf(ndev->name, VIRTIO_DEVICE_MAX_NAME_LEN, "%s", dev->name);
+
+	/* By default one queue pair for each guest VCPU */
+	if (vmm_devtree_read_u32(dev->edev->node,
+				 "max_queue_pairs", &pairs)) {
+		pairs = dev->guest->vcpu_count;
+	}
+	if (pairs < 1) {
+		pairs = 1;
+	} else if (VIRTIO_NET_MAX_QUEUE_PAIRS < pairs) {
+		pairs = VIRTIO_NET_MAX_QUEUE_PAIRS;
+	}
+	ndev->max_pairs = pairs;
+	ndev->curr_pairs = 1;
+
+	ndev->qs = vmm_zalloc(pairs * sizeof(struct virtio_net_queue));
+	if (!ndev->qs) {
+		vmm_printf("Failed to allocate virtio net queues....\n");
+		vmm_free(ndev);
+		return VMM_EFAIL;
+	}
+
+	for (i = 0; i < pairs; i++) {
+		q = &ndev->qs[i];
+		q->ndev = ndev;
+		q->index = i;
+		q->cpu = virtio_net_queue_cpu(i);
+		INIT_SPIN_LOCK(&q->rx_lock);
+		q->rx_kick = FALSE;
+		q->rx_backlog_head = 0;
+		q->rx_backlog_count = 0;
+		INIT_SPIN_LOCK(&q->tx_lock);
+		q->tx_epoch = 0;
+	}
+
+	INIT_SPIN_LOCK(&ndev->tx_zc_lock);
+	ndev->tx_dead = FALSE;
+	ndev->tx_zc_inflight = 0;
+	ndev->tx_zc_free_count = 0;
+	if (vmm_host_vapool_alloc(&ndev->tx_zc_va, VIRTIO_NET_TX_ZC_SLOTS *
+					VIRTIO_NET_TX_ZC_SLOT_SIZE)) {
+		/* Zero-copy TX not possible so always copy */
+		ndev->tx_zc_va = 0;
+	} else {
+		for (i = 0; i < VIRTIO_NET_TX_ZC_SLOTS; i++) {
+			ndev->tx_zc[i].va = ndev->tx_zc_va +
+					i * VIRTIO_NET_TX_ZC_SLOT_SIZE;
+			ndev->tx_zc_free[ndev->tx_zc_free_count++] = i;
+		}
+	}
 	ndev->port = vmm_netport_alloc(ndev->name, VIRTIO_NET_QUEUE_SIZE);
-	ndev->port->mtu = VIRTIO_NET_MTU;
+	ndev->port->mtu = VIRTIO_NET_MAX_FRAME;
 	ndev->port->link_changed = virtio_net_set_link;
 	ndev->port->can_receive = virtio_net_can_receive;
 	ndev->port->switch2port_xfer = virtio_net_switch2port_xfer;
+	ndev->port->switch2port_xfer_burst =
+				virtio_net_switch2port_xfer_burst;
 	ndev->port->priv = ndev;
 
 	rc = vmm_netport_register(ndev->port);
 	if (rc) {
 		vmm_netport_free(ndev->port);
-		vmm_free(ndev);
+		virtio_net_free(ndev);
 		return rc;
 	}
 
@@ -360,6 +1329,7 @@ static int virtio_net_connect(struct virtio_device *dev,
 	}
 
 	ndev->config.status = VIRTIO_NET_S_LINK_UP;
+	ndev->config.max_virtqueue_pairs = ndev->max_pairs;
 	dev->emu_data = ndev;
 
 	return VMM_OK;
@@ -367,11 +1337,37 @@ static int virtio_net_connect(struct virtio_device *dev,
 
 static void virtio_net_disconnect(struct virtio_device *dev)
 {
+	u32 i;
+	bool free_ndev;
+	irq_flags_t flags;
+	struct virtio_net_queue *q;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
 	vmm_netport_unregister(ndev->port);
 	vmm_netport_free(ndev->port);
-	vmm_free(ndev);
+
+	for (i = 0; i < ndev->max_pairs; i++) {
+		q = &ndev->qs[i];
+
+		vmm_spin_lock_irqsave(&q->rx_lock, flags);
+		virtio_net_rx_purge(q);
+		vmm_spin_unlock_irqrestore(&q->rx_lock, flags);
+
+		/* In-flight zero-copy TX frames must not touch rings or vdev */
+		vmm_spin_lock_irqsave(&q->tx_lock, flags);
+		q->tx_epoch++;
+		vmm_spin_unlock_irqrestore(&q->tx_lock, flags);
+	}
+
+	/* Last in-flight zero-copy TX frame will free the device */
+	vmm_spin_lock_irqsave(&ndev->tx_zc_lock, flags);
+	ndev->tx_dead = TRUE;
+	free_ndev = (ndev->tx_zc_inflight) ? FALSE : TRUE;
+	vmm_spin_unlock_irqrestore(&ndev->tx_zc_lock, flags);
+
+	if (free_ndev) {
+		virtio_net_free(ndev);
+	}
 }
 
 struct virtio_device_id virtio_net_emu_id[] = {
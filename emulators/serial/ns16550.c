@@ -685,6 +685,40 @@ static int ns16550_send(struct vmm_vserial *vser, u8 data)
 	return VMM_OK;
 }
 
+static u32 ns16550_send_buf(struct vmm_vserial *vser, u8 *src, u32 len)
+{
+	u32 count;
+	struct ns16550_state *s = vmm_vserial_priv(vser);
+
+	if (!len) {
+		return 0;
+	}
+
+	/* Without FIFO only one byte can be pending */
+	if (!(s->fcr & UART_FCR_FE)) {
+		if (s->lsr & UART_LSR_DR) {
+			return 0;
+		}
+		ns16550_send(vser, src[0]);
+		return 1;
+	}
+
+	/* Receive overruns do not overwrite FIFO contents. */
+	count = fifo_enqueue_bulk(s->recv_fifo, src, len, FALSE);
+	if (!count) {
+		return 0;
+	}
+	s->lsr |= UART_LSR_DR;
+
+	/* call the timeout receive callback in 4 char transmit time */
+	vmm_timer_event_stop(&s->fifo_timeout_timer);
+	vmm_timer_event_start(&s->fifo_timeout_timer, (s->char_transmit_time * 4));
+
+	ns16550_update_irq(s);
+
+	return count;
+}
+
 #if 0
 static void ns16550_event(void *opaque, int event)
 {
@@ -859,6 +893,7 @@ static int ns16550_emulator_probe(struct vmm_guest *guest,
 	s->vser = vmm_vserial_create(name, 
 				     &ns16550_can_send, 
 				     &ns16550_send, 
+				     &ns16550_send_buf,
 				     2048, s);
 	if (!(s->vser)) {
 		SERIAL_LOG(LVL_ERR, "Failed to create vserial instance.\n");
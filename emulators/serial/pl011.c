@@ -278,15 +278,19 @@ static bool pl011_vserial_can_send(struct vmm_vserial *vser)
 	return !fifo_isfull(s->rd_fifo);
 }
 
-static int pl011_vserial_send(struct vmm_vserial *vser, u8 data)
+static u32 pl011_vserial_send_buf(struct vmm_vserial *vser, u8 *src, u32 len)
 {
 	bool set_irq = FALSE;
-	u32 rd_count, level, enabled;
+	u32 count, rd_count, level, enabled;
 	struct pl011_state *s = vmm_vserial_priv(vser);
 
-	fifo_enqueue(s->rd_fifo, &data, TRUE);
+	count = fifo_enqueue_bulk(s->rd_fifo, src, len, FALSE);
+	if (!count) {
+		return 0;
+	}
 	rd_count = fifo_avail(s->rd_fifo);
 
+	/* Update flags and interrupt once for whole batch */
 	vmm_spin_lock(&s->lock);
 	s->flags &= ~PL011_FLAG_RXFE;
 	if (s->cr & 0x10 || rd_count == s->fifo_sz) {
@@ -304,6 +308,13 @@ static int pl011_vserial_send(struct vmm_vserial *vser, u8 data)
 		pl011_set_irq(s, level, enabled);
 	}
 
+	return count;
+}
+
+static int pl011_vserial_send(struct vmm_vserial *vser, u8 data)
+{
+	pl011_vserial_send_buf(vser, &data, 1);
+
 	return VMM_OK;
 }
 
@@ -434,6 +445,7 @@ static int pl011_emulator_probe(struct vmm_guest *guest,
 	s->vser = vmm_vserial_create(name, 
 				     &pl011_vserial_can_send, 
 				     &pl011_vserial_send, 
+				     &pl011_vserial_send_buf,
 				     s->fifo_sz, s);
 	if (!(s->vser)) {
 		goto pl011_emulator_probe_freerbuf_fail;
@@ -175,10 +175,58 @@ VMM_EXPORT_SYMBOL(virtio_config_write);
 
 int virtio_reset(struct virtio_device *dev)
 {
+	if (dev) {
+		dev->features = 0;
+	}
+
 	return __virtio_reset_emulator(dev);
 }
 VMM_EXPORT_SYMBOL(virtio_reset);
 
+u64 virtio_host_features(struct virtio_device *dev)
+{
+	u64 features = 0;
+
+	if (!dev || !dev->emu) {
+		return 0;
+	}
+
+	if (dev->emu->get_host_features) {
+		features = dev->emu->get_host_features(dev);
+	}
+
+	/* Packed ring is handled by virtio queue so
+	 * every emulator gets it with modern transport.
+	 */
+	if (dev->modern) {
+		features |= (1ULL << VIRTIO_F_VERSION_1) |
+			    (1ULL << VIRTIO_F_RING_PACKED);
+	}
+
+	return features;
+}
+VMM_EXPORT_SYMBOL(virtio_host_features);
+
+void virtio_guest_features(struct virtio_device *dev, u64 features)
+{
+	if (!dev || !dev->emu) {
+		return;
+	}
+
+	dev->features = features & virtio_host_features(dev);
+
+	if (dev->emu->set_guest_features) {
+		dev->emu->set_guest_features(dev, (u32)dev->features);
+	}
+}
+VMM_EXPORT_SYMBOL(virtio_guest_features);
+
+bool virtio_has_feature(struct virtio_device *dev, u32 bit)
+{
+	return (dev && (dev->features & (1ULL << bit))) ? TRUE : FALSE;
+}
+VMM_EXPORT_SYMBOL(virtio_has_feature);
+
 int virtio_register_device(struct virtio_device *dev)
 {
 	int rc = VMM_OK;
@@ -190,6 +238,7 @@ int virtio_register_device(struct virtio_device *dev)
 	INIT_LIST_HEAD(&dev->node);
 	dev->emu = NULL;
 	dev->emu_data = NULL;
+	dev->features = 0;
 
 	vmm_mutex_lock(&virtio_mutex);
 
@@ -0,0 +1,524 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_balloon.c
+ * @author Xvisor Developers
+ * @brief VirtIO based memory balloon Emulator.
+ *
+ * Pages given up by guest (inflate) are discarded from guest address
+ * space and pages reported free by guest (free page reporting) are
+ * unmapped. Host RAM of demand allocated guest RAM chunks is released
+ * as soon as guest does not use any page of the chunk.
+ */
+
+#include <vmm_error.h>
+#include <vmm_macros.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_spinlocks.h>
+#include <vmm_devemu.h>
+#include <vmm_guest_aspace.h>
+#include <libs/stringlib.h>
+
+#include <emu/virtio.h>
+#include <emu/virtio_balloon.h>
+
+#define MODULE_DESC			"VirtIO Balloon Emulator"
+#define MODULE_AUTHOR			"Xvisor Developers"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VIRTIO_IPRIORITY + 1)
+#define MODULE_INIT			virtio_balloon_init
+#define MODULE_EXIT			virtio_balloon_exit
+
+#define VIRTIO_BALLOON_QUEUE_SIZE	128
+#define VIRTIO_BALLOON_NUM_QUEUES	4
+#define VIRTIO_BALLOON_INFLATE_QUEUE	0
+#define VIRTIO_BALLOON_DEFLATE_QUEUE	1
+#define VIRTIO_BALLOON_STATS_QUEUE	2
+#define VIRTIO_BALLOON_REPORTING_QUEUE	3
+
+#define VIRTIO_BALLOON_PFN_BATCH	64
+
+#define VIRTIO_BALLOON_HOST_FEATURES	\
+			((1UL << VIRTIO_BALLOON_F_MUST_TELL_HOST) | \
+			 (1UL << VIRTIO_BALLOON_F_STATS_VQ) | \
+			 (1UL << VIRTIO_BALLOON_F_REPORTING))
+
+struct virtio_balloon_dev {
+	struct virtio_device *vdev;
+
+	struct virtio_queue vqs[VIRTIO_BALLOON_NUM_QUEUES];
+	struct virtio_iovec iov[VIRTIO_BALLOON_NUM_QUEUES]
+			       [VIRTIO_BALLOON_QUEUE_SIZE];
+	struct virtio_balloon_config config;
+	u32 features;
+
+	vmm_spinlock_t lock;
+	bool stats_pending;
+	u16 stats_head;
+	u32 stats_vq;
+
+	struct vmm_guest_balloon b;
+};
+
+/* Queue numbers of optional queues depend on negotiated features */
+static int virtio_balloon_vq_type(struct virtio_balloon_dev *bdev, u32 vq)
+{
+	if (vq <= VIRTIO_BALLOON_DEFLATE_QUEUE) {
+		return vq;
+	}
+
+	if (bdev->features & (1UL << VIRTIO_BALLOON_F_STATS_VQ)) {
+		if (vq == VIRTIO_BALLOON_STATS_QUEUE) {
+			return VIRTIO_BALLOON_STATS_QUEUE;
+		}
+		vq--;
+	}
+
+	if ((bdev->features & (1UL << VIRTIO_BALLOON_F_REPORTING)) &&
+	    (vq == VIRTIO_BALLOON_STATS_QUEUE)) {
+		return VIRTIO_BALLOON_REPORTING_QUEUE;
+	}
+
+	return -1;
+}
+
+static u32 virtio_balloon_get_host_features(struct virtio_device *dev)
+{
+	return VIRTIO_BALLOON_HOST_FEATURES;
+}
+
+static void virtio_balloon_set_guest_features(struct virtio_device *dev,
+					      u32 features)
+{
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	bdev->features = features & VIRTIO_BALLOON_HOST_FEATURES;
+}
+
+static int virtio_balloon_init_vq(struct virtio_device *dev,
+				  u32 vq, struct virtio_queue_layout *layout)
+{
+	int type;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	type = virtio_balloon_vq_type(bdev, vq);
+	if (type < 0) {
+		return VMM_EINVALID;
+	}
+
+	if (type == VIRTIO_BALLOON_STATS_QUEUE) {
+		bdev->stats_vq = vq;
+	}
+
+	return virtio_queue_setup(&bdev->vqs[type], dev->guest, layout);
+}
+
+static int virtio_balloon_get_pfn_vq(struct virtio_device *dev, u32 vq)
+{
+	int type;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	type = virtio_balloon_vq_type(bdev, vq);
+	if (type < 0) {
+		return VMM_EINVALID;
+	}
+
+	return virtio_queue_guest_pfn(&bdev->vqs[type]);
+}
+
+static int virtio_balloon_get_size_vq(struct virtio_device *dev, u32 vq)
+{
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	return (virtio_balloon_vq_type(bdev, vq) < 0) ?
+				0 : VIRTIO_BALLOON_QUEUE_SIZE;
+}
+
+static int virtio_balloon_set_size_vq(struct virtio_device *dev,
+				      u32 vq, int size)
+{
+	/* FIXME: dynamic */
+	return size;
+}
+
+/* Discard or undiscard guest pages in runs of contiguous PFNs */
+static void virtio_balloon_do_pfns(struct virtio_balloon_dev *bdev,
+				   u32 *pfns, u32 count, bool inflate)
+{
+	u32 i, start, run;
+	physical_addr_t gpa;
+	physical_size_t sz, released = 0;
+	struct vmm_guest *guest = bdev->vdev->guest;
+
+	start = pfns[0];
+	run = 1;
+	for (i = 1; i <= count; i++) {
+		if ((i < count) && (pfns[i] == (start + run))) {
+			run++;
+			continue;
+		}
+
+		gpa = (physical_addr_t)start << VIRTIO_BALLOON_PFN_SHIFT;
+		sz = (physical_size_t)run << VIRTIO_BALLOON_PFN_SHIFT;
+		if (inflate) {
+			released += vmm_guest_physical_discard(guest,
+							gpa, sz, TRUE);
+		} else {
+			vmm_guest_physical_undiscard(guest, gpa, sz);
+		}
+
+		if (i < count) {
+			start = pfns[i];
+			run = 1;
+		}
+	}
+
+	bdev->b.released += released;
+}
+
+static void virtio_balloon_do_inflate_deflate(struct virtio_device *dev,
+					      struct virtio_balloon_dev *bdev,
+					      u32 vq, int type)
+{
+	u16 head;
+	u32 i, len, iov_cnt = 0, total_len = 0;
+	u32 pfns[VIRTIO_BALLOON_PFN_BATCH];
+	struct virtio_queue *q = &bdev->vqs[type];
+	struct virtio_iovec *iov = bdev->iov[type];
+	struct virtio_iovec tiov;
+
+	while (virtio_queue_available(q)) {
+		head = virtio_queue_get_iovec(q, iov, &iov_cnt, &total_len);
+
+		for (i = 0; i < iov_cnt; i++) {
+			memcpy(&tiov, &iov[i], sizeof(tiov));
+			while (tiov.len >= sizeof(u32)) {
+				len = (tiov.len < sizeof(pfns)) ?
+						tiov.len : sizeof(pfns);
+				len = virtio_iovec_to_buf_read(dev, &tiov, 1,
+							       pfns, len);
+				if (len < sizeof(u32)) {
+					break;
+				}
+				virtio_balloon_do_pfns(bdev, pfns,
+					len / sizeof(u32),
+					(type == VIRTIO_BALLOON_INFLATE_QUEUE));
+				tiov.addr += len;
+				tiov.len -= len;
+			}
+		}
+
+		virtio_queue_set_used_elem(q, head, 0);
+	}
+
+	if (virtio_queue_should_signal(q)) {
+		dev->tra->notify(dev, vq);
+	}
+}
+
+static void virtio_balloon_do_stats(struct virtio_device *dev,
+				    struct virtio_balloon_dev *bdev)
+{
+	u16 head;
+	u32 i, len, iov_cnt = 0, total_len = 0;
+	irq_flags_t flags;
+	struct virtio_balloon_stat st[VIRTIO_BALLOON_S_NR];
+	struct virtio_queue *q = &bdev->vqs[VIRTIO_BALLOON_STATS_QUEUE];
+	struct virtio_iovec *iov = bdev->iov[VIRTIO_BALLOON_STATS_QUEUE];
+
+	if (!virtio_queue_available(q)) {
+		return;
+	}
+
+	head = virtio_queue_get_iovec(q, iov, &iov_cnt, &total_len);
+	len = virtio_iovec_to_buf_read(dev, iov, iov_cnt, st, sizeof(st));
+
+	/* Keep the buffer until we want fresh statistics */
+	vmm_spin_lock_irqsave_lite(&bdev->lock, flags);
+	for (i = 0; i < (len / sizeof(st[0])); i++) {
+		if (st[i].tag < VMM_GUEST_BALLOON_STAT_MAX) {
+			bdev->b.stats[st[i].tag] = st[i].val;
+		}
+	}
+	bdev->b.stats_valid = TRUE;
+	bdev->stats_head = head;
+	bdev->stats_pending = TRUE;
+	vmm_spin_unlock_irqrestore_lite(&bdev->lock, flags);
+}
+
+static void virtio_balloon_do_reporting(struct virtio_device *dev,
+					struct virtio_balloon_dev *bdev,
+					u32 vq)
+{
+	u16 head;
+	u32 i, iov_cnt = 0, total_len = 0;
+	physical_size_t released = 0;
+	struct virtio_queue *q = &bdev->vqs[VIRTIO_BALLOON_REPORTING_QUEUE];
+	struct virtio_iovec *iov = bdev->iov[VIRTIO_BALLOON_REPORTING_QUEUE];
+
+	/* Reported pages can be reused by guest without telling us */
+	while (virtio_queue_available(q)) {
+		head = virtio_queue_get_iovec(q, iov, &iov_cnt, &total_len);
+
+		for (i = 0; i < iov_cnt; i++) {
+			released += vmm_guest_physical_discard(dev->guest,
+						iov[i].addr, iov[i].len,
+						FALSE);
+		}
+
+		virtio_queue_set_used_elem(q, head, 0);
+	}
+
+	bdev->b.released += released;
+
+	if (virtio_queue_should_signal(q)) {
+		dev->tra->notify(dev, vq);
+	}
+}
+
+static int virtio_balloon_notify_vq(struct virtio_device *dev, u32 vq)
+{
+	int type;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	type = virtio_balloon_vq_type(bdev, vq);
+	switch (type) {
+	case VIRTIO_BALLOON_INFLATE_QUEUE:
+	case VIRTIO_BALLOON_DEFLATE_QUEUE:
+		virtio_balloon_do_inflate_deflate(dev, bdev, vq, type);
+		break;
+	case VIRTIO_BALLOON_STATS_QUEUE:
+		virtio_balloon_do_stats(dev, bdev);
+		break;
+	case VIRTIO_BALLOON_REPORTING_QUEUE:
+		virtio_balloon_do_reporting(dev, bdev, vq);
+		break;
+	default:
+		return VMM_EINVALID;
+	};
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_set_target(struct vmm_guest_balloon *b,
+				     physical_size_t target)
+{
+	irq_flags_t flags;
+	physical_size_t num_pages;
+	struct virtio_balloon_dev *bdev = b->priv;
+	struct virtio_device *dev = bdev->vdev;
+
+	num_pages = target >> VIRTIO_BALLOON_PFN_SHIFT;
+	if (num_pages > 0xFFFFFFFFULL) {
+		num_pages = 0xFFFFFFFFULL;
+	}
+
+	vmm_spin_lock_irqsave_lite(&bdev->lock, flags);
+	bdev->config.num_pages = (u32)num_pages;
+	b->target = num_pages << VIRTIO_BALLOON_PFN_SHIFT;
+	vmm_spin_unlock_irqrestore_lite(&bdev->lock, flags);
+
+	if (dev->tra && dev->tra->notify_config) {
+		return dev->tra->notify_config(dev);
+	}
+
+	return VMM_OK;
+}
+
+static void virtio_balloon_update_stats(struct vmm_guest_balloon *b)
+{
+	u16 head;
+	bool pending;
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = b->priv;
+	struct virtio_device *dev = bdev->vdev;
+	struct virtio_queue *q = &bdev->vqs[VIRTIO_BALLOON_STATS_QUEUE];
+
+	vmm_spin_lock_irqsave_lite(&bdev->lock, flags);
+	pending = bdev->stats_pending;
+	head = bdev->stats_head;
+	bdev->stats_pending = FALSE;
+	vmm_spin_unlock_irqrestore_lite(&bdev->lock, flags);
+
+	if (!pending || !virtio_queue_setup_done(q)) {
+		return;
+	}
+
+	/* Giving back the stats buffer asks guest for fresh statistics */
+	virtio_queue_set_used_elem(q, head, 0);
+	dev->tra->notify(dev, bdev->stats_vq);
+}
+
+static int virtio_balloon_read_config(struct virtio_device *dev,
+				      u32 offset, void *dst, u32 dst_len)
+{
+	u32 i;
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+	u8 *src = (u8 *)&bdev->config;
+
+	vmm_spin_lock_irqsave_lite(&bdev->lock, flags);
+	for (i = 0; (i < dst_len) && ((offset + i) < sizeof(bdev->config));
+	     i++) {
+		*((u8 *)dst + i) = src[offset + i];
+	}
+	vmm_spin_unlock_irqrestore_lite(&bdev->lock, flags);
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_write_config(struct virtio_device *dev,
+				       u32 offset, void *src, u32 src_len)
+{
+	u32 i;
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+	u8 *dst = (u8 *)&bdev->config;
+
+	/* Only actual field of balloon config space is writeable */
+	vmm_spin_lock_irqsave_lite(&bdev->lock, flags);
+	for (i = 0; i < src_len; i++) {
+		if (((offset + i) <
+			offsetof(struct virtio_balloon_config, actual)) ||
+		    ((offset + i) >=
+			offsetof(struct virtio_balloon_config,
+				 free_page_hint_cmd_id))) {
+			continue;
+		}
+		dst[offset + i] = *((u8 *)src + i);
+	}
+	bdev->b.actual = (physical_size_t)bdev->config.actual <<
+						VIRTIO_BALLOON_PFN_SHIFT;
+	vmm_spin_unlock_irqrestore_lite(&bdev->lock, flags);
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_reset(struct virtio_device *dev)
+{
+	int rc;
+	u32 i;
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	/* Guest starts with an empty balloon after reset */
+	vmm_guest_physical_undiscard(dev->guest, 0, ~(physical_size_t)0);
+
+	vmm_spin_lock_irqsave_lite(&bdev->lock, flags);
+	bdev->config.actual = 0;
+	bdev->b.actual = 0;
+	bdev->b.stats_valid = FALSE;
+	bdev->stats_pending = FALSE;
+	vmm_spin_unlock_irqrestore_lite(&bdev->lock, flags);
+
+	bdev->features = 0;
+
+	for (i = 0; i < VIRTIO_BALLOON_NUM_QUEUES; i++) {
+		rc = virtio_queue_cleanup(&bdev->vqs[i]);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_connect(struct virtio_device *dev,
+				  struct virtio_emulator *emu)
+{
+	int rc;
+	struct virtio_balloon_dev *bdev;
+
+	bdev = vmm_zalloc(sizeof(struct virtio_balloon_dev));
+	if (!bdev) {
+		vmm_printf("Failed to allocate virtio balloon device....\n");
+		return VMM_ENOMEM;
+	}
+	bdev->vdev = dev;
+	INIT_SPIN_LOCK(&bdev->lock);
+
+	bdev->b.guest = dev->guest;
+	bdev->b.set_target = virtio_balloon_set_target;
+	bdev->b.update_stats = virtio_balloon_update_stats;
+	bdev->b.priv = bdev;
+
+	rc = vmm_guest_balloon_register(&bdev->b);
+	if (rc) {
+		vmm_printf("%s: guest %s already has a balloon\n",
+			   dev->name, dev->guest->name);
+		vmm_free(bdev);
+		return rc;
+	}
+
+	dev->emu_data = bdev;
+
+	return VMM_OK;
+}
+
+static void virtio_balloon_disconnect(struct virtio_device *dev)
+{
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	vmm_guest_balloon_unregister(&bdev->b);
+	vmm_free(bdev);
+}
+
+struct virtio_device_id virtio_balloon_emu_id[] = {
+	{.type = VIRTIO_ID_BALLON},
+	{ },
+};
+
+struct virtio_emulator virtio_balloon = {
+	.name = "virtio_balloon",
+	.id_table = virtio_balloon_emu_id,
+
+	/* VirtIO operations */
+	.get_host_features      = virtio_balloon_get_host_features,
+	.set_guest_features     = virtio_balloon_set_guest_features,
+	.init_vq                = virtio_balloon_init_vq,
+	.get_pfn_vq             = virtio_balloon_get_pfn_vq,
+	.get_size_vq            = virtio_balloon_get_size_vq,
+	.set_size_vq            = virtio_balloon_set_size_vq,
+	.notify_vq              = virtio_balloon_notify_vq,
+
+	/* Emulator operations */
+	.read_config = virtio_balloon_read_config,
+	.write_config = virtio_balloon_write_config,
+	.reset = virtio_balloon_reset,
+	.connect = virtio_balloon_connect,
+	.disconnect = virtio_balloon_disconnect,
+};
+
+static int __init virtio_balloon_init(void)
+{
+	return virtio_register_emulator(&virtio_balloon);
+}
+
+static void __exit virtio_balloon_exit(void)
+{
+	virtio_unregister_emulator(&virtio_balloon);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -26,6 +26,7 @@
 #include <vmm_stdio.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <libs/stringlib.h>
 #include <emu/virtio.h>
 #include <emu/virtio_queue.h>
 #include <emu/virtio_mmio.h>
@@ -48,11 +49,82 @@ static int virtio_mmio_notify(struct virtio_device *dev, u32 vq)
 	return VMM_OK;
 }
 
+static int virtio_mmio_notify_config(struct virtio_device *dev)
+{
+	struct virtio_mmio_dev *m = dev->tra_data;
+
+	m->config_generation++;
+	m->config.interrupt_state |= VIRTIO_MMIO_INT_CONFIG;
+
+	vmm_devemu_emulate_irq(m->guest, m->irq, 1);
+
+	return VMM_OK;
+}
+
+static bool virtio_mmio_modern(struct virtio_mmio_dev *m)
+{
+	return (m->config.version == VIRTIO_MMIO_VERSION_MODERN) ?
+							TRUE : FALSE;
+}
+
+static struct virtio_mmio_queue *virtio_mmio_sel_queue(
+					struct virtio_mmio_dev *m)
+{
+	if (m->config.queue_sel < VIRTIO_MMIO_QUEUE_MAX) {
+		return &m->queues[m->config.queue_sel];
+	}
+
+	return NULL;
+}
+
+/* Setup queue from latched registers when guest sets it ready */
+static int virtio_mmio_queue_ready(struct virtio_mmio_dev *m,
+				   struct virtio_mmio_queue *q)
+{
+	int rc;
+	u32 max;
+	struct virtio_queue_layout layout;
+
+	max = m->dev.emu->get_size_vq(&m->dev, m->config.queue_sel);
+	if (!q->num || (max < q->num)) {
+		return VMM_EINVALID;
+	}
+
+	memset(&layout, 0, sizeof(layout));
+	layout.desc_count = q->num;
+	layout.packed = virtio_has_feature(&m->dev, VIRTIO_F_RING_PACKED);
+	layout.desc_addr = q->desc;
+	layout.driver_addr = q->avail;
+	layout.device_addr = q->used;
+
+	rc = m->dev.emu->init_vq(&m->dev, m->config.queue_sel, &layout);
+	if (rc) {
+		return rc;
+	}
+
+	q->ready = 1;
+
+	return VMM_OK;
+}
+
+/* Writing zero to status register resets modern device */
+static int virtio_mmio_device_reset(struct virtio_mmio_dev *m)
+{
+	m->guest_features = 0;
+	m->config.interrupt_state = 0x0;
+	memset(m->queues, 0, sizeof(m->queues));
+	vmm_devemu_emulate_irq(m->guest, m->irq, 0);
+
+	return virtio_reset(&m->dev);
+}
+
 int virtio_mmio_config_read(struct virtio_mmio_dev *m,
 			    u32 offset, void *dst,
 			    u32 dst_len)
 {
 	int rc = VMM_OK;
+	u64 features;
+	struct virtio_mmio_queue *q;
 
 	switch (offset) {
 	case VIRTIO_MMIO_MAGIC_VALUE:
@@ -64,9 +136,20 @@ int virtio_mmio_config_read(struct virtio_mmio_dev *m,
 		*(u32 *)dst = (*(u32 *)(((void *)&m->config) + offset));
 		break;
 	case VIRTIO_MMIO_HOST_FEATURES:
-		*(u32 *)dst = m->dev.emu->get_host_features(&m->dev);
+		features = virtio_host_features(&m->dev);
+		if (m->config.host_features_sel == 0) {
+			*(u32 *)dst = (u32)features;
+		} else if (m->config.host_features_sel == 1) {
+			*(u32 *)dst = (u32)(features >> 32);
+		} else {
+			*(u32 *)dst = 0;
+		}
 		break;
 	case VIRTIO_MMIO_QUEUE_PFN:
+		if (virtio_mmio_modern(m)) {
+			*(u32 *)dst = 0;
+			break;
+		}
 		*(u32 *)dst = m->dev.emu->get_pfn_vq(&m->dev,
 					     m->config.queue_sel);
 		break;
@@ -74,6 +157,14 @@ int virtio_mmio_config_read(struct virtio_mmio_dev *m,
 		*(u32 *)dst = m->dev.emu->get_size_vq(&m->dev,
 					      m->config.queue_sel);
 		break;
+	case VIRTIO_MMIO_QUEUE_READY:
+		q = virtio_mmio_sel_queue(m);
+		*(u32 *)dst = (virtio_mmio_modern(m) && q) ? q->ready : 0;
+		break;
+	case VIRTIO_MMIO_CONFIG_GENERATION:
+		*(u32 *)dst = (virtio_mmio_modern(m)) ?
+				m->config_generation : 0;
+		break;
 	default:
 		break;
 	}
@@ -99,24 +190,44 @@ static int virtio_mmio_config_write(struct virtio_mmio_dev *m,
 {
 	int rc = VMM_OK;
 	u32 val = *(u32 *)(src);
+	struct virtio_mmio_queue *q = virtio_mmio_sel_queue(m);
+	struct virtio_queue_layout layout;
 
 	switch (offset) {
 	case VIRTIO_MMIO_HOST_FEATURES_SEL:
 	case VIRTIO_MMIO_GUEST_FEATURES_SEL:
 	case VIRTIO_MMIO_QUEUE_SEL:
-	case VIRTIO_MMIO_STATUS:
 		*(u32 *)(((void *)&m->config) + offset) = val;
 		break;
+	case VIRTIO_MMIO_STATUS:
+		m->config.status = val;
+		if (!val && virtio_mmio_modern(m)) {
+			rc = virtio_mmio_device_reset(m);
+		}
+		break;
 	case VIRTIO_MMIO_GUEST_FEATURES:
 		if (m->config.guest_features_sel == 0)  {
-			m->dev.emu->set_guest_features(&m->dev, val);
+			m->guest_features &= ~0xFFFFFFFFULL;
+			m->guest_features |= val;
+		} else if (m->config.guest_features_sel == 1) {
+			m->guest_features &= 0xFFFFFFFFULL;
+			m->guest_features |= (u64)val << 32;
+		} else {
+			break;
 		}
+		virtio_guest_features(&m->dev, m->guest_features);
 		break;
 	case VIRTIO_MMIO_GUEST_PAGE_SIZE:
 		m->config.guest_page_size = val;
 		break;
 	case VIRTIO_MMIO_QUEUE_NUM:
 		m->config.queue_num = val;
+		if (virtio_mmio_modern(m)) {
+			if (q) {
+				q->num = val;
+			}
+			break;
+		}
 		m->dev.emu->set_size_vq(&m->dev, 
 					m->config.queue_sel,
 					m->config.queue_num);
@@ -125,11 +236,55 @@ static int virtio_mmio_config_write(struct virtio_mmio_dev *m,
 		m->config.queue_align = val;
 		break;
 	case VIRTIO_MMIO_QUEUE_PFN:
-		m->dev.emu->init_vq(&m->dev, 
-				    m->config.queue_sel,
-				    m->config.guest_page_size,
-				    m->config.queue_align,
-				    val);
+		if (virtio_mmio_modern(m)) {
+			break;
+		}
+		virtio_queue_layout_legacy(&layout,
+				m->dev.emu->get_size_vq(&m->dev,
+							m->config.queue_sel),
+				val, m->config.guest_page_size,
+				m->config.queue_align);
+		m->dev.emu->init_vq(&m->dev, m->config.queue_sel, &layout);
+		break;
+	case VIRTIO_MMIO_QUEUE_READY:
+		if (!virtio_mmio_modern(m) || !q) {
+			break;
+		}
+		if (val) {
+			rc = virtio_mmio_queue_ready(m, q);
+		} else {
+			q->ready = 0;
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_DESC_LOW:
+		if (q) {
+			q->desc = (q->desc & ~0xFFFFFFFFULL) | val;
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_DESC_HIGH:
+		if (q) {
+			q->desc = (q->desc & 0xFFFFFFFFULL) | ((u64)val << 32);
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_AVAIL_LOW:
+		if (q) {
+			q->avail = (q->avail & ~0xFFFFFFFFULL) | val;
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_AVAIL_HIGH:
+		if (q) {
+			q->avail = (q->avail & 0xFFFFFFFFULL) | ((u64)val << 32);
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_USED_LOW:
+		if (q) {
+			q->used = (q->used & ~0xFFFFFFFFULL) | val;
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_USED_HIGH:
+		if (q) {
+			q->used = (q->used & 0xFFFFFFFFULL) | ((u64)val << 32);
+		}
 		break;
 	case VIRTIO_MMIO_QUEUE_NOTIFY:
 		m->dev.emu->notify_vq(&m->dev, val);
@@ -221,7 +376,9 @@ static int virtio_mmio_reset(struct vmm_emudev *edev)
 {
 	struct virtio_mmio_dev *m = edev->priv;
 
+	m->guest_features = 0;
 	m->config.interrupt_state = 0x0;
+	memset(m->queues, 0, sizeof(m->queues));
 	vmm_devemu_emulate_irq(m->guest, m->irq, 0);
 
 	return virtio_reset(&m->dev);
@@ -230,6 +387,7 @@ static int virtio_mmio_reset(struct vmm_emudev *edev)
 static struct virtio_transport mmio_tra = {
 	.name = "virtio_mmio",
 	.notify = virtio_mmio_notify,
+	.notify_config = virtio_mmio_notify_config,
 };
 
 static int virtio_mmio_probe(struct vmm_guest *guest,
@@ -237,6 +395,7 @@ static int virtio_mmio_probe(struct vmm_guest *guest,
 			     const struct vmm_devtree_nodeid *eid)
 {
 	int rc = VMM_OK;
+	u32 version;
 	struct virtio_mmio_dev *m;
 
 	m = vmm_zalloc(sizeof(struct virtio_mmio_dev));
@@ -256,7 +415,7 @@ static int virtio_mmio_probe(struct vmm_guest *guest,
 
 	m->config = (struct virtio_mmio_config) {
 		     .magic          = {'v', 'i', 'r', 't'},
-		     .version        = 1,
+		     .version        = VIRTIO_MMIO_VERSION_LEGACY,
 		     .vendor_id      = 0x52535658, /* XVSR */
 		     .queue_num_max  = 256,
 	};
@@ -269,6 +428,13 @@ static int virtio_mmio_probe(struct vmm_guest *guest,
 
 	m->dev.id.type = m->config.device_id;
 
+	/* Legacy layout unless modern one is asked for */
+	if (!vmm_devtree_read_u32(edev->node, "virtio_version", &version) &&
+	    (version == VIRTIO_MMIO_VERSION_MODERN)) {
+		m->config.version = VIRTIO_MMIO_VERSION_MODERN;
+	}
+	m->dev.modern = virtio_mmio_modern(m);
+
 	rc = vmm_devtree_irq_get(edev->node, &m->irq, 0);
 	if (rc) {
 		goto virtio_mmio_probe_freestate_fail;
@@ -26,6 +26,7 @@
 #include <vmm_heap.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <libs/stringlib.h>
 #include <emu/virtio.h>
 #include <emu/virtio_queue.h>
 #include <emu/virtio_pci.h>
@@ -53,6 +54,311 @@ static int virtio_pci_notify(struct virtio_device *dev, u32 vq)
 	return VMM_OK;
 }
 
+static int virtio_pci_notify_config(struct virtio_device *dev)
+{
+	struct virtio_pci_dev *m = dev->tra_data;
+
+	m->config_generation++;
+	m->config.interrupt_state |= VIRTIO_PCI_INT_CONFIG;
+
+	vmm_devemu_emulate_irq(m->guest, m->irq, 1);
+
+	return VMM_OK;
+}
+
+static u32 virtio_pci_isr_read(struct virtio_pci_dev *m)
+{
+	u32 isr = m->config.interrupt_state;
+
+	/* reading from the ISR also clears it. */
+	m->config.interrupt_state = 0;
+	vmm_devemu_emulate_irq(m->guest, m->irq, 0);
+
+	return isr;
+}
+
+static int virtio_pci_device_reset(struct virtio_pci_dev *m)
+{
+	m->guest_features = 0;
+	m->config.interrupt_state = 0x0;
+	memset(m->queues, 0, sizeof(m->queues));
+	vmm_devemu_emulate_irq(m->guest, m->irq, 0);
+
+	return virtio_reset(&m->dev);
+}
+
+static struct virtio_pci_queue *virtio_pci_sel_queue(struct virtio_pci_dev *m)
+{
+	if (m->config.queue_sel < VIRTIO_PCI_QUEUE_MAX) {
+		return &m->queues[m->config.queue_sel];
+	}
+
+	return NULL;
+}
+
+/* Queues are numbered contiguously from zero */
+static u32 virtio_pci_num_queues(struct virtio_pci_dev *m)
+{
+	u32 vq;
+
+	for (vq = 0; vq < VIRTIO_PCI_QUEUE_MAX; vq++) {
+		if (m->dev.emu->get_size_vq(&m->dev, vq) <= 0) {
+			break;
+		}
+	}
+
+	return vq;
+}
+
+/* Setup queue from latched registers when guest enables it */
+static int virtio_pci_queue_enable(struct virtio_pci_dev *m,
+				   struct virtio_pci_queue *q)
+{
+	int rc, max;
+	struct virtio_queue_layout layout;
+
+	max = m->dev.emu->get_size_vq(&m->dev, m->config.queue_sel);
+	if ((max <= 0) || (max < q->size)) {
+		return VMM_EINVALID;
+	}
+
+	memset(&layout, 0, sizeof(layout));
+	layout.desc_count = (q->size) ? q->size : max;
+	layout.packed = virtio_has_feature(&m->dev, VIRTIO_F_RING_PACKED);
+	layout.desc_addr = q->desc;
+	layout.driver_addr = q->avail;
+	layout.device_addr = q->used;
+
+	rc = m->dev.emu->init_vq(&m->dev, m->config.queue_sel, &layout);
+	if (rc) {
+		return rc;
+	}
+
+	q->enable = 1;
+
+	return VMM_OK;
+}
+
+static int virtio_pci_common_read(struct virtio_pci_dev *m,
+				  u32 offset, u32 *dst)
+{
+	u64 features;
+	struct virtio_pci_queue *q = virtio_pci_sel_queue(m);
+
+	switch (offset) {
+	case VIRTIO_PCI_COMMON_DFSELECT:
+		*dst = m->host_features_sel;
+		break;
+	case VIRTIO_PCI_COMMON_DF:
+		features = virtio_host_features(&m->dev);
+		if (m->host_features_sel == 0) {
+			*dst = (u32)features;
+		} else if (m->host_features_sel == 1) {
+			*dst = (u32)(features >> 32);
+		} else {
+			*dst = 0;
+		}
+		break;
+	case VIRTIO_PCI_COMMON_GFSELECT:
+		*dst = m->guest_features_sel;
+		break;
+	case VIRTIO_PCI_COMMON_GF:
+		if (m->guest_features_sel == 0) {
+			*dst = (u32)m->guest_features;
+		} else if (m->guest_features_sel == 1) {
+			*dst = (u32)(m->guest_features >> 32);
+		} else {
+			*dst = 0;
+		}
+		break;
+	case VIRTIO_PCI_COMMON_MSIX:
+	case VIRTIO_PCI_COMMON_Q_MSIX:
+		/* No MSI-X so guest has to use INTx */
+		*dst = VIRTIO_MSI_NO_VECTOR;
+		break;
+	case VIRTIO_PCI_COMMON_NUMQ:
+		*dst = virtio_pci_num_queues(m);
+		break;
+	case VIRTIO_PCI_COMMON_STATUS:
+		*dst = m->config.status;
+		break;
+	case VIRTIO_PCI_COMMON_CFGGENERATION:
+		*dst = m->config_generation;
+		break;
+	case VIRTIO_PCI_COMMON_Q_SELECT:
+		*dst = m->config.queue_sel;
+		break;
+	case VIRTIO_PCI_COMMON_Q_SIZE:
+		*dst = 0;
+		if (q) {
+			*dst = (q->size) ? q->size :
+				m->dev.emu->get_size_vq(&m->dev,
+							m->config.queue_sel);
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_ENABLE:
+		*dst = (q) ? q->enable : 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_NOFF:
+		*dst = m->config.queue_sel;
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCLO:
+		*dst = (q) ? (u32)q->desc : 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCHI:
+		*dst = (q) ? (u32)(q->desc >> 32) : 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILLO:
+		*dst = (q) ? (u32)q->avail : 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILHI:
+		*dst = (q) ? (u32)(q->avail >> 32) : 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDLO:
+		*dst = (q) ? (u32)q->used : 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDHI:
+		*dst = (q) ? (u32)(q->used >> 32) : 0;
+		break;
+	default:
+		*dst = 0;
+		break;
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_pci_common_write(struct virtio_pci_dev *m,
+				   u32 offset, u32 val)
+{
+	int rc = VMM_OK;
+	struct virtio_pci_queue *q = virtio_pci_sel_queue(m);
+
+	switch (offset) {
+	case VIRTIO_PCI_COMMON_DFSELECT:
+		m->host_features_sel = val;
+		break;
+	case VIRTIO_PCI_COMMON_GFSELECT:
+		m->guest_features_sel = val;
+		break;
+	case VIRTIO_PCI_COMMON_GF:
+		if (m->guest_features_sel == 0) {
+			m->guest_features &= ~0xFFFFFFFFULL;
+			m->guest_features |= val;
+		} else if (m->guest_features_sel == 1) {
+			m->guest_features &= 0xFFFFFFFFULL;
+			m->guest_features |= (u64)val << 32;
+		} else {
+			break;
+		}
+		virtio_guest_features(&m->dev, m->guest_features);
+		break;
+	case VIRTIO_PCI_COMMON_STATUS:
+		m->config.status = val;
+		if (!val) {
+			rc = virtio_pci_device_reset(m);
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_SELECT:
+		m->config.queue_sel = val;
+		break;
+	case VIRTIO_PCI_COMMON_Q_SIZE:
+		if (q) {
+			q->size = val;
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_ENABLE:
+		if (q && val) {
+			rc = virtio_pci_queue_enable(m, q);
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCLO:
+		if (q) {
+			q->desc = (q->desc & ~0xFFFFFFFFULL) | val;
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCHI:
+		if (q) {
+			q->desc = (q->desc & 0xFFFFFFFFULL) | ((u64)val << 32);
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILLO:
+		if (q) {
+			q->avail = (q->avail & ~0xFFFFFFFFULL) | val;
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILHI:
+		if (q) {
+			q->avail = (q->avail & 0xFFFFFFFFULL) | ((u64)val << 32);
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDLO:
+		if (q) {
+			q->used = (q->used & ~0xFFFFFFFFULL) | val;
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDHI:
+		if (q) {
+			q->used = (q->used & 0xFFFFFFFFULL) | ((u64)val << 32);
+		}
+		break;
+	default:
+		/* MSI-X vectors and read-only fields */
+		break;
+	}
+
+	return rc;
+}
+
+static int virtio_pci_modern_read(struct virtio_pci_dev *m,
+				  u32 offset, u32 *dst)
+{
+	if (VIRTIO_PCI_MODERN_NOTIFY_OFFSET <= offset) {
+		*dst = 0;
+		return VMM_OK;
+	}
+
+	if (VIRTIO_PCI_MODERN_DEVICE_OFFSET <= offset) {
+		offset -= VIRTIO_PCI_MODERN_DEVICE_OFFSET;
+		return virtio_config_read(&m->dev, offset, dst, 4);
+	}
+
+	if (VIRTIO_PCI_MODERN_ISR_OFFSET <= offset) {
+		*dst = (offset == VIRTIO_PCI_MODERN_ISR_OFFSET) ?
+					virtio_pci_isr_read(m) : 0;
+		return VMM_OK;
+	}
+
+	return virtio_pci_common_read(m, offset, dst);
+}
+
+static int virtio_pci_modern_write(struct virtio_pci_dev *m,
+				   u32 offset, u32 src)
+{
+	u32 vq;
+
+	if (VIRTIO_PCI_MODERN_NOTIFY_OFFSET <= offset) {
+		vq = (offset - VIRTIO_PCI_MODERN_NOTIFY_OFFSET) /
+					VIRTIO_PCI_MODERN_NOTIFY_MULT;
+		if (vq < VIRTIO_PCI_QUEUE_MAX) {
+			m->dev.emu->notify_vq(&m->dev, vq);
+		}
+		return VMM_OK;
+	}
+
+	if (VIRTIO_PCI_MODERN_DEVICE_OFFSET <= offset) {
+		offset -= VIRTIO_PCI_MODERN_DEVICE_OFFSET;
+		return virtio_config_write(&m->dev, offset, &src, 4);
+	}
+
+	if (VIRTIO_PCI_MODERN_ISR_OFFSET <= offset) {
+		/* ISR is read-only */
+		return VMM_OK;
+	}
+
+	return virtio_pci_common_write(m, offset, src);
+}
+
 int virtio_pci_config_read(struct virtio_pci_dev *m,
 			   u32 offset, void *dst,
 			   u32 dst_len)
@@ -61,7 +367,7 @@ int virtio_pci_config_read(struct virtio_pci_dev *m,
 
 	switch (offset) {
 	case VIRTIO_PCI_HOST_FEATURES:
-		*(u32 *)dst = m->dev.emu->get_host_features(&m->dev);
+		*(u32 *)dst = (u32)virtio_host_features(&m->dev);
 		break;
 	case VIRTIO_PCI_QUEUE_PFN:
 		*(u32 *)dst = m->dev.emu->get_pfn_vq(&m->dev,
@@ -75,10 +381,7 @@ int virtio_pci_config_read(struct virtio_pci_dev *m,
 		*(u32 *)dst = (*(u32 *)(((void *)&m->config) + offset));
 		break;
 	case VIRTIO_PCI_ISR:
-		/* reading from the ISR also clears it. */
-		*(u32 *)dst = m->config.interrupt_state;
-		m->config.interrupt_state = 0;
-		vmm_devemu_emulate_irq(m->guest, m->irq, 0);
+		*(u32 *)dst = virtio_pci_isr_read(m);
 		break;
 	default:
 		rc = VMM_EFAIL;
@@ -91,6 +394,10 @@ int virtio_pci_config_read(struct virtio_pci_dev *m,
 static int virtio_pci_read(struct virtio_pci_dev *m,
 			   u32 offset, u32 *dst)
 {
+	if (m->dev.modern) {
+		return virtio_pci_modern_read(m, offset, dst);
+	}
+
 	/* Device specific config write */
 	if (offset >= VIRTIO_PCI_CONFIG) {
 		offset -= VIRTIO_PCI_CONFIG;
@@ -106,17 +413,19 @@ static int virtio_pci_config_write(struct virtio_pci_dev *m,
 {
 	int rc = VMM_OK;
 	u32 val = *(u32 *)(src);
+	struct virtio_queue_layout layout;
 
 	switch (offset) {
 	case VIRTIO_PCI_GUEST_FEATURES:
-		m->dev.emu->set_guest_features(&m->dev, val);
+		virtio_guest_features(&m->dev, val);
 		break;
 	case VIRTIO_PCI_QUEUE_PFN:
-		m->dev.emu->init_vq(&m->dev,
-				    m->config.queue_sel,
-				    VIRTIO_PCI_PAGE_SIZE,
-				    VIRTIO_PCI_PAGE_SIZE,
-				    val);
+		virtio_queue_layout_legacy(&layout,
+				m->dev.emu->get_size_vq(&m->dev,
+							m->config.queue_sel),
+				val, VIRTIO_PCI_PAGE_SIZE,
+				VIRTIO_PCI_PAGE_SIZE);
+		m->dev.emu->init_vq(&m->dev, m->config.queue_sel, &layout);
 		break;
 	case VIRTIO_PCI_QUEUE_SEL:
 		if (val < VIRTIO_PCI_QUEUE_MAX)
@@ -146,6 +455,10 @@ static int virtio_pci_write(struct virtio_pci_dev *m,
 {
 	src = src & ~src_mask;
 
+	if (m->dev.modern) {
+		return virtio_pci_modern_write(m, offset, src);
+	}
+
 	/* Device specific config write */
 	if (offset >= VIRTIO_PCI_CONFIG) {
 		offset -= VIRTIO_PCI_CONFIG;
@@ -158,8 +471,101 @@ static int virtio_pci_write(struct virtio_pci_dev *m,
 static struct virtio_transport pci_tra = {
 	.name = "virtio_pci",
 	.notify = virtio_pci_notify,
+	.notify_config = virtio_pci_notify_config,
 };
 
+/* Vendor capabilities describing BAR layout of modern device */
+struct virtio_pci_modern_caps {
+	struct virtio_pci_cap common;
+	struct virtio_pci_notify_cap notify;
+	struct virtio_pci_cap isr;
+	struct virtio_pci_cap device;
+} __attribute__((packed));
+
+static u32 virtio_pci_caps_read(struct pci_class *class, u16 reg_offset)
+{
+	u32 ret = 0, len;
+	struct virtio_pci_modern_caps *caps = ((struct pci_device *)class)->priv;
+
+	if (!caps || (reg_offset < VIRTIO_PCI_CAP_OFFSET) ||
+	    ((VIRTIO_PCI_CAP_OFFSET + sizeof(*caps)) <= reg_offset)) {
+		return 0;
+	}
+
+	reg_offset -= VIRTIO_PCI_CAP_OFFSET;
+	len = sizeof(*caps) - reg_offset;
+	memcpy(&ret, (u8 *)caps + reg_offset, (len < 4) ? len : 4);
+
+	return ret;
+}
+
+static int virtio_pci_caps_write(struct pci_class *class,
+				 u16 reg_offset, u32 data)
+{
+	/* Capabilities are read-only */
+	return VMM_OK;
+}
+
+static void virtio_pci_cap_init(struct virtio_pci_cap *cap, u8 cap_next,
+				u8 cap_len, u8 cfg_type, u8 bar,
+				u32 offset, u32 length)
+{
+	cap->cap_vndr = VIRTIO_PCI_CAP_ID_VNDR;
+	cap->cap_next = cap_next;
+	cap->cap_len = cap_len;
+	cap->cfg_type = cfg_type;
+	cap->bar = bar;
+	cap->offset = offset;
+	cap->length = length;
+}
+
+static void virtio_pci_caps_init(struct virtio_pci_modern_caps *caps, u8 bar)
+{
+	virtio_pci_cap_init(&caps->common, VIRTIO_PCI_CAP_OFFSET +
+			offsetof(struct virtio_pci_modern_caps, notify),
+			sizeof(caps->common), VIRTIO_PCI_CAP_COMMON_CFG, bar,
+			VIRTIO_PCI_MODERN_COMMON_OFFSET,
+			VIRTIO_PCI_COMMON_SIZE);
+	virtio_pci_cap_init(&caps->notify.cap, VIRTIO_PCI_CAP_OFFSET +
+			offsetof(struct virtio_pci_modern_caps, isr),
+			sizeof(caps->notify), VIRTIO_PCI_CAP_NOTIFY_CFG, bar,
+			VIRTIO_PCI_MODERN_NOTIFY_OFFSET,
+			VIRTIO_PCI_MODERN_NOTIFY_SIZE);
+	caps->notify.notify_off_multiplier = VIRTIO_PCI_MODERN_NOTIFY_MULT;
+	virtio_pci_cap_init(&caps->isr, VIRTIO_PCI_CAP_OFFSET +
+			offsetof(struct virtio_pci_modern_caps, device),
+			sizeof(caps->isr), VIRTIO_PCI_CAP_ISR_CFG, bar,
+			VIRTIO_PCI_MODERN_ISR_OFFSET,
+			VIRTIO_PCI_MODERN_ISR_SIZE);
+	virtio_pci_cap_init(&caps->device, 0,
+			sizeof(caps->device), VIRTIO_PCI_CAP_DEVICE_CFG, bar,
+			VIRTIO_PCI_MODERN_DEVICE_OFFSET,
+			VIRTIO_PCI_MODERN_DEVICE_SIZE);
+}
+
+/* Read attribute of first BAR node of PCI device */
+static int virtio_pci_bar_read_u32(struct pci_device *pdev,
+				   const char *attr, u32 *val)
+{
+	int rc = VMM_ENOTAVAIL;
+	struct vmm_devtree_node *bars, *bar;
+
+	bars = vmm_devtree_getchild(pdev->node, "bars");
+	if (!bars) {
+		return rc;
+	}
+
+	vmm_devtree_for_each_child(bar, bars) {
+		rc = vmm_devtree_read_u32(bar, attr, val);
+		vmm_devtree_dref_node(bar);
+		break;
+	}
+
+	vmm_devtree_dref_node(bars);
+
+	return rc;
+}
+
 static int virtio_pci_emulator_reset(struct pci_device *pdev)
 {
 	return VMM_OK;
@@ -169,7 +575,9 @@ static int virtio_pci_emulator_probe(struct pci_device *pdev,
 				     struct vmm_guest *guest,
 				     const struct vmm_devtree_nodeid *eid)
 {
+	u32 version, type, barnum;
 	struct pci_class *class = (struct pci_class *)pdev;
+	struct virtio_pci_modern_caps *caps;
 
 	/* Virtio device */
 	class->conf_header.vendor_id = 0x1af4;
@@ -178,11 +586,42 @@ static int virtio_pci_emulator_probe(struct pci_device *pdev,
 
 	pdev->priv = NULL;
 
+	if (virtio_pci_bar_read_u32(pdev, "virtio_version", &version) ||
+	    (version != VIRTIO_PCI_VERSION_MODERN)) {
+		return VMM_OK;
+	}
+
+	if (virtio_pci_bar_read_u32(pdev, "virtio_type", &type) ||
+	    virtio_pci_bar_read_u32(pdev, "barnum", &barnum)) {
+		return VMM_EINVALID;
+	}
+
+	caps = vmm_zalloc(sizeof(*caps));
+	if (!caps) {
+		return VMM_ENOMEM;
+	}
+	virtio_pci_caps_init(caps, barnum);
+
+	/* Modern only device */
+	class->conf_header.device_id = VIRTIO_PCI_MODERN_DEVICE_ID + type;
+	class->conf_header.revision = 1;
+	class->conf_header.status |= PCI_STATUS_CAP_LIST;
+	class->conf_header.cap_pointer = VIRTIO_PCI_CAP_OFFSET;
+	class->config_read = virtio_pci_caps_read;
+	class->config_write = virtio_pci_caps_write;
+
+	pdev->priv = caps;
+
 	return VMM_OK;
 }
 
 static int virtio_pci_emulator_remove(struct pci_device *pdev)
 {
+	if (pdev->priv) {
+		vmm_free(pdev->priv);
+		pdev->priv = NULL;
+	}
+
 	return VMM_OK;
 }
 
@@ -246,12 +685,7 @@ static int virtio_pci_bar_write32(struct vmm_emudev *edev,
 
 static int virtio_pci_bar_reset(struct vmm_emudev *edev)
 {
-	struct virtio_pci_dev *m = edev->priv;
-
-	m->config.interrupt_state = 0x0;
-	vmm_devemu_emulate_irq(m->guest, m->irq, 0);
-
-	return virtio_reset(&m->dev);
+	return virtio_pci_device_reset(edev->priv);
 }
 
 static int virtio_pci_bar_remove(struct vmm_emudev *edev)
@@ -272,6 +706,7 @@ static int virtio_pci_bar_probe(struct vmm_guest *guest,
 				const struct vmm_devtree_nodeid *eid)
 {
 	int rc = VMM_OK;
+	u32 version;
 	struct virtio_pci_dev *vdev;
 
 	vdev = vmm_zalloc(sizeof(struct virtio_pci_dev));
@@ -304,6 +739,12 @@ static int virtio_pci_bar_probe(struct vmm_guest *guest,
 		goto virtio_pci_probe_freestate_fail;
 	}
 
+	/* Modern interface is described by capabilities of PCI device */
+	if (!vmm_devtree_read_u32(edev->node, "virtio_version", &version) &&
+	    (version == VIRTIO_PCI_VERSION_MODERN)) {
+		vdev->dev.modern = TRUE;
+	}
+
 	if ((rc = virtio_register_device(&vdev->dev))) {
 		goto virtio_pci_probe_freestate_fail;
 	}
@@ -34,6 +34,12 @@
 
 #include <emu/virtio.h>
 
+bool virtio_queue_packed(struct virtio_queue *vq)
+{
+	return (vq) ? vq->packed : FALSE;
+}
+VMM_EXPORT_SYMBOL(virtio_queue_packed);
+
 void *virtio_queue_base(struct virtio_queue *vq)
 {
 	return (vq) ? vq->addr : NULL;
@@ -88,20 +94,86 @@ physical_size_t virtio_queue_total_size(struct virtio_queue *vq)
 }
 VMM_EXPORT_SYMBOL(virtio_queue_total_size);
 
+/* Take next buffer from packed ring and remember its descriptor slots
+ * so that used descriptor can be written and popping can be undone.
+ */
+static u16 virtio_queue_packed_pop(struct virtio_queue *vq)
+{
+	u16 id, slot = vq->last_avail_idx, num = 0;
+	bool wrap = vq->avail_wrap;
+	struct vring_packed_desc *desc;
+	struct virtio_queue_pbuf *pbuf;
+
+	do {
+		desc = &vq->pvring.desc[slot];
+		num++;
+		if (++slot == vq->pvring.num) {
+			slot = 0;
+			wrap = !wrap;
+		}
+	} while ((desc->flags & VRING_DESC_F_NEXT) &&
+		 (num < vq->pvring.num));
+
+	/* Buffer ID is in last descriptor of chain */
+	id = umod32(desc->id, vq->pvring.num);
+
+	pbuf = &vq->pbufs[id];
+	pbuf->slot = vq->last_avail_idx;
+	pbuf->num = num;
+	pbuf->wrap = vq->avail_wrap;
+
+	vq->pop_ids[vq->pop_count] = id;
+	if (++vq->pop_count == vq->pvring.num) {
+		vq->pop_count = 0;
+	}
+
+	vq->last_avail_idx = slot;
+	vq->avail_wrap = wrap;
+
+	return id;
+}
+
 u16 virtio_queue_pop(struct virtio_queue *vq)
 {
 	if (!vq || !vq->addr) {
 		return 0;
 	}
 
+	if (vq->packed) {
+		return virtio_queue_packed_pop(vq);
+	}
+
 	return vq->vring.avail->ring[
 			umod32(vq->last_avail_idx++, vq->vring.num)];
 }
 VMM_EXPORT_SYMBOL(virtio_queue_pop);
 
-struct vring_desc *virtio_queue_get_desc(struct virtio_queue *vq, u16 indx)
+void virtio_queue_rewind(struct virtio_queue *vq, u16 count)
 {
+	struct virtio_queue_pbuf *pbuf;
+
 	if (!vq || !vq->addr) {
+		return;
+	}
+
+	if (!vq->packed) {
+		vq->last_avail_idx -= count;
+		return;
+	}
+
+	while (count--) {
+		vq->pop_count = (vq->pop_count) ?
+				(vq->pop_count - 1) : (vq->pvring.num - 1);
+		pbuf = &vq->pbufs[vq->pop_ids[vq->pop_count]];
+		vq->last_avail_idx = pbuf->slot;
+		vq->avail_wrap = pbuf->wrap;
+	}
+}
+VMM_EXPORT_SYMBOL(virtio_queue_rewind);
+
+struct vring_desc *virtio_queue_get_desc(struct virtio_queue *vq, u16 indx)
+{
+	if (!vq || !vq->addr || vq->packed) {
 		return NULL;
 	}
 
@@ -109,9 +181,33 @@ struct vring_desc *virtio_queue_get_desc(struct virtio_queue *vq, u16 indx)
 }
 VMM_EXPORT_SYMBOL(virtio_queue_get_desc);
 
+static bool virtio_queue_packed_available(struct virtio_queue *vq)
+{
+	u16 flags = vq->pvring.desc[vq->last_avail_idx].flags;
+	bool avail = (flags & (1 << VRING_PACKED_DESC_F_AVAIL)) ? TRUE : FALSE;
+	bool used = (flags & (1 << VRING_PACKED_DESC_F_USED)) ? TRUE : FALSE;
+
+	if ((avail == used) || (avail != vq->avail_wrap)) {
+		return FALSE;
+	}
+
+	/* Descriptor contents must be read only after its flags */
+	arch_rmb();
+
+	return TRUE;
+}
+
 bool virtio_queue_available(struct virtio_queue *vq)
 {
-	if (!vq || !vq->addr || !vq->vring.avail) {
+	if (!vq || !vq->addr) {
+		return FALSE;
+	}
+
+	if (vq->packed) {
+		return virtio_queue_packed_available(vq);
+	}
+
+	if (!vq->vring.avail) {
 		return FALSE;
 	}
 
@@ -121,6 +217,35 @@ bool virtio_queue_available(struct virtio_queue *vq)
 }
 VMM_EXPORT_SYMBOL(virtio_queue_available);
 
+static bool virtio_queue_packed_should_signal(struct virtio_queue *vq)
+{
+	u16 old_idx, new_idx, event_idx, off_wrap, flags;
+
+	/* Used descriptors must be visible before reading driver event */
+	arch_mb();
+
+	off_wrap        = vq->pvring.driver->off_wrap;
+	flags           = vq->pvring.driver->flags;
+
+	old_idx         = vq->last_used_signalled;
+	new_idx         = vq->used_idx;
+	vq->last_used_signalled = new_idx;
+
+	if (flags == VRING_PACKED_EVENT_FLAG_ENABLE) {
+		return TRUE;
+	} else if (flags == VRING_PACKED_EVENT_FLAG_DISABLE) {
+		return FALSE;
+	}
+
+	event_idx = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+	if (((off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR) & 0x1) !=
+	    ((vq->used_wrap) ? 1 : 0)) {
+		event_idx -= vq->pvring.num;
+	}
+
+	return vring_need_event(event_idx, new_idx, old_idx) ? TRUE : FALSE;
+}
+
 bool virtio_queue_should_signal(struct virtio_queue *vq)
 {
 	u16 old_idx, new_idx, event_idx;
@@ -129,6 +254,10 @@ bool virtio_queue_should_signal(struct virtio_queue *vq)
 		return FALSE;
 	}
 
+	if (vq->packed) {
+		return virtio_queue_packed_should_signal(vq);
+	}
+
 	old_idx         = vq->last_used_signalled;
 	new_idx         = vq->vring.used->idx;
 	event_idx       = vring_used_event(&vq->vring);
@@ -142,15 +271,58 @@ bool virtio_queue_should_signal(struct virtio_queue *vq)
 }
 VMM_EXPORT_SYMBOL(virtio_queue_should_signal);
 
+/* Write used descriptor of given buffer at current used slot of
+ * packed ring and return flags which will make it visible to guest.
+ */
+static u16 virtio_queue_packed_put(struct virtio_queue *vq,
+				   u16 id, u16 *slot)
+{
+	struct virtio_queue_pbuf *pbuf = &vq->pbufs[id];
+	struct vring_packed_desc *desc = &vq->pvring.desc[vq->used_idx];
+	u16 flags = (vq->used_wrap) ? ((1 << VRING_PACKED_DESC_F_AVAIL) |
+				       (1 << VRING_PACKED_DESC_F_USED)) : 0;
+
+	desc->id = id;
+	desc->len = pbuf->used.len;
+	*slot = vq->used_idx;
+
+	vq->used_idx += pbuf->num;
+	if (vq->pvring.num <= vq->used_idx) {
+		vq->used_idx -= vq->pvring.num;
+		vq->used_wrap = !vq->used_wrap;
+	}
+
+	return flags;
+}
+
 struct vring_used_elem *virtio_queue_set_used_elem(struct virtio_queue *vq,
 						   u32 head, u32 len)
 {
+	u16 slot, flags;
 	struct vring_used_elem *used_elem;
 
 	if (!vq || !vq->addr) {
 		return NULL;
 	}
 
+	if (vq->packed) {
+		head = umod32(head, vq->pvring.num);
+		used_elem       = &vq->pbufs[head].used;
+		used_elem->id   = head;
+		used_elem->len  = len;
+
+		flags = virtio_queue_packed_put(vq, head, &slot);
+
+		/* Buffer ID and length must be visible before flags */
+		arch_wmb();
+		vq->pvring.desc[slot].flags = flags;
+
+		/* Guest must see updated flags before we signal it */
+		arch_wmb();
+
+		return used_elem;
+	}
+
 	used_elem       = &vq->vring.used->ring[
 				umod32(vq->vring.used->idx, vq->vring.num)];
 	used_elem->id   = head;
@@ -175,12 +347,210 @@ struct vring_used_elem *virtio_queue_set_used_elem(struct virtio_queue *vq,
 }
 VMM_EXPORT_SYMBOL(virtio_queue_set_used_elem);
 
+struct vring_used_elem *virtio_queue_fill_used_elem(struct virtio_queue *vq,
+						    u32 offset,
+						    u32 head, u32 len)
+{
+	struct vring_used_elem *used_elem;
+
+	if (!vq || !vq->addr) {
+		return NULL;
+	}
+
+	if (vq->packed) {
+		/* Descriptor slots of popped buffers may still be read
+		 * again after rewind so keep used element on our side
+		 * until it is flushed.
+		 */
+		if (vq->pvring.num <= offset) {
+			return NULL;
+		}
+		head = umod32(head, vq->pvring.num);
+		vq->fill_ids[offset] = head;
+		used_elem = &vq->pbufs[head].used;
+	} else {
+		used_elem = &vq->vring.used->ring[
+			umod32(vq->vring.used->idx + offset, vq->vring.num)];
+	}
+	used_elem->id   = head;
+	used_elem->len  = len;
+
+	return used_elem;
+}
+VMM_EXPORT_SYMBOL(virtio_queue_fill_used_elem);
+
+static void virtio_queue_packed_flush_used(struct virtio_queue *vq, u32 count)
+{
+	u32 i;
+	u16 slot, flags, first_slot = 0, first_flags = 0;
+
+	if (vq->pvring.num < count) {
+		count = vq->pvring.num;
+	}
+
+	for (i = 0; i < count; i++) {
+		flags = virtio_queue_packed_put(vq, vq->fill_ids[i], &slot);
+		if (!i) {
+			first_slot = slot;
+			first_flags = flags;
+			continue;
+		}
+		arch_wmb();
+		vq->pvring.desc[slot].flags = flags;
+	}
+
+	/* Flags of first used descriptor are written last so that
+	 * guest sees all used descriptors at once.
+	 */
+	arch_wmb();
+	vq->pvring.desc[first_slot].flags = first_flags;
+
+	/* Guest must see updated flags before we signal it */
+	arch_wmb();
+}
+
+void virtio_queue_flush_used(struct virtio_queue *vq, u32 count)
+{
+	if (!vq || !vq->addr || !count) {
+		return;
+	}
+
+	if (vq->packed) {
+		virtio_queue_packed_flush_used(vq, count);
+		return;
+	}
+
+	/* Filled used elements must be visible before advancing idx */
+	arch_wmb();
+	vq->vring.used->idx += count;
+
+	/* Guest must see updated idx before we signal it */
+	arch_wmb();
+}
+VMM_EXPORT_SYMBOL(virtio_queue_flush_used);
+
 bool virtio_queue_setup_done(struct virtio_queue *vq)
 {
 	return (vq) ? ((vq->addr) ? TRUE : FALSE) : FALSE;
 }
 VMM_EXPORT_SYMBOL(virtio_queue_setup_done);
 
+static int virtio_queue_unmap(struct virtio_queue *vq)
+{
+	int rc, ret = VMM_OK;
+
+	while (vq->map_count) {
+		vq->map_count--;
+		rc = vmm_host_memunmap(
+			(virtual_addr_t)vq->map_va[vq->map_count]);
+		if (rc && !ret) {
+			ret = rc;
+		}
+		vmm_guest_physical_unmap(vq->map_guest,
+					 vq->map_gpa[vq->map_count],
+					 vq->map_size[vq->map_count]);
+		vq->map_va[vq->map_count] = NULL;
+	}
+	vq->map_guest = NULL;
+
+	return ret;
+}
+
+/* Map guest areas of queue using as few host mappings as possible
+ * because areas of a ring usually share pages.
+ */
+static int virtio_queue_map(struct virtio_queue *vq,
+			    struct vmm_guest *guest,
+			    physical_addr_t *gpa, physical_size_t *size,
+			    void **va, physical_addr_t *desc_hpa)
+{
+	bool merged;
+	u32 i, w, count, reg_flags;
+	virtual_addr_t wva;
+	physical_addr_t hpa;
+	physical_addr_t start[VIRTIO_QUEUE_MAX_MAPS];
+	physical_addr_t end[VIRTIO_QUEUE_MAX_MAPS];
+	physical_addr_t whpa[VIRTIO_QUEUE_MAX_MAPS];
+	physical_size_t avail_size;
+
+	for (i = 0; i < VIRTIO_QUEUE_MAX_MAPS; i++) {
+		start[i] = gpa[i] - (gpa[i] & VMM_PAGE_MASK);
+		end[i] = start[i] +
+			 VMM_ROUNDUP2_PAGE_SIZE(gpa[i] + size[i] - start[i]);
+	}
+	count = VIRTIO_QUEUE_MAX_MAPS;
+
+	/* Merge overlapping windows */
+	do {
+		merged = FALSE;
+		for (i = 0; !merged && (i < count); i++) {
+			for (w = i + 1; w < count; w++) {
+				if ((end[i] <= start[w]) ||
+				    (end[w] <= start[i])) {
+					continue;
+				}
+				start[i] = (start[w] < start[i]) ?
+						start[w] : start[i];
+				end[i] = (end[i] < end[w]) ? end[w] : end[i];
+				count--;
+				start[w] = start[count];
+				end[w] = end[count];
+				merged = TRUE;
+				break;
+			}
+		}
+	} while (merged);
+
+	/* Guest mappings stay pinned till queue is unmapped so that
+	 * guest can't release host RAM of rings while we use them.
+	 */
+	vq->map_guest = guest;
+	for (w = 0; w < count; w++) {
+		if (vmm_guest_physical_map(guest, start[w], end[w] - start[w],
+					   &hpa, &avail_size, &reg_flags)) {
+			vmm_printf("Failed vmm_guest_physical_map\n");
+			virtio_queue_unmap(vq);
+			return VMM_EFAIL;
+		}
+
+		if (!(reg_flags & VMM_REGION_ISRAM) ||
+		    (avail_size < (end[w] - start[w]))) {
+			vmm_guest_physical_unmap(guest, start[w],
+						 end[w] - start[w]);
+			virtio_queue_unmap(vq);
+			return VMM_EINVALID;
+		}
+
+		wva = vmm_host_memmap(hpa, end[w] - start[w],
+				      VMM_MEMORY_FLAGS_NORMAL);
+		if (!wva) {
+			vmm_guest_physical_unmap(guest, start[w],
+						 end[w] - start[w]);
+			virtio_queue_unmap(vq);
+			return VMM_ENOMEM;
+		}
+
+		whpa[w] = hpa;
+		vq->map_gpa[vq->map_count] = start[w];
+		vq->map_size[vq->map_count] = end[w] - start[w];
+		vq->map_va[vq->map_count++] = (void *)wva;
+	}
+
+	for (i = 0; i < VIRTIO_QUEUE_MAX_MAPS; i++) {
+		for (w = 0; w < count; w++) {
+			if ((start[w] <= gpa[i]) && (gpa[i] < end[w])) {
+				break;
+			}
+		}
+		va[i] = vq->map_va[w] + (gpa[i] - start[w]);
+		if (!i) {
+			*desc_hpa = whpa[w] + (gpa[i] - start[w]);
+		}
+	}
+
+	return VMM_OK;
+}
+
 int virtio_queue_cleanup(struct virtio_queue *vq)
 {
 	int rc = VMM_OK;
@@ -189,12 +559,26 @@ int virtio_queue_cleanup(struct virtio_queue *vq)
 		goto done;
 	}
 
-	rc = vmm_host_memunmap((virtual_addr_t)vq->addr);
+	rc = virtio_queue_unmap(vq);
+
+	if (vq->pbufs) {
+		vmm_free(vq->pbufs);
+	}
 
 done:
 	vq->last_avail_idx = 0;
 	vq->last_used_signalled = 0;
 
+	vq->packed = FALSE;
+	vq->avail_wrap = FALSE;
+	vq->used_wrap = FALSE;
+	vq->used_idx = 0;
+	vq->pop_count = 0;
+	memset(&vq->pvring, 0, sizeof(vq->pvring));
+	vq->pbufs = NULL;
+	vq->pop_ids = NULL;
+	vq->fill_ids = NULL;
+
 	vq->addr = NULL;
 	vq->guest = NULL;
 
@@ -211,18 +595,47 @@ done:
 }
 VMM_EXPORT_SYMBOL(virtio_queue_cleanup);
 
+void virtio_queue_layout_legacy(struct virtio_queue_layout *layout,
+				u32 desc_count,
+				physical_addr_t guest_pfn,
+				physical_size_t guest_page_size,
+				u32 align)
+{
+	physical_size_t used_off;
+
+	if (!layout) {
+		return;
+	}
+
+	used_off = sizeof(struct vring_desc) * desc_count +
+		   sizeof(u16) * (3 + desc_count);
+	if (align) {
+		used_off = (used_off + align - 1) & ~((physical_size_t)align - 1);
+	}
+
+	layout->desc_count = desc_count;
+	layout->packed = FALSE;
+	layout->guest_pfn = guest_pfn;
+	layout->guest_page_size = guest_page_size;
+	layout->align = align;
+	layout->desc_addr = guest_pfn * guest_page_size;
+	layout->driver_addr = layout->desc_addr +
+			      sizeof(struct vring_desc) * desc_count;
+	layout->device_addr = layout->desc_addr + used_off;
+}
+VMM_EXPORT_SYMBOL(virtio_queue_layout_legacy);
+
 int virtio_queue_setup(struct virtio_queue *vq,
 			struct vmm_guest *guest,
-			physical_addr_t guest_pfn,
-			physical_size_t guest_page_size,
-			u32 desc_count, u32 align)
+			struct virtio_queue_layout *layout)
 {
 	int rc = VMM_OK;
-	u32 reg_flags;
-	physical_addr_t gphys_addr, hphys_addr;
-	physical_size_t gphys_size, avail_size;
+	u32 num;
+	void *va[VIRTIO_QUEUE_MAX_MAPS];
+	physical_addr_t gpa[VIRTIO_QUEUE_MAX_MAPS], hphys_addr;
+	physical_size_t gsz[VIRTIO_QUEUE_MAX_MAPS];
 
-	if (!vq || !guest) {
+	if (!vq || !guest || !layout) {
 		return VMM_EFAIL;
 	}
 
@@ -230,41 +643,73 @@ int virtio_queue_setup(struct virtio_queue *vq,
 		return rc;
 	}
 
-	gphys_addr = guest_pfn * guest_page_size;
-	gphys_size = vring_size(desc_count, align);
-
-	if ((rc = vmm_guest_physical_map(guest, gphys_addr, gphys_size,
-					 &hphys_addr, &avail_size,
-					 &reg_flags))) {
-		vmm_printf("Failed vmm_guest_physical_map\n");
-		return VMM_EFAIL;
-	}
-
-	if (!(reg_flags & VMM_REGION_ISRAM)) {
+	/* Free running indexes of split ring need power of two size */
+	num = layout->desc_count;
+	if (!num || (VIRTIO_QUEUE_MAX_DESC < num) ||
+	    (!layout->packed && (num & (num - 1)))) {
 		return VMM_EINVALID;
 	}
 
-	if (avail_size < gphys_size) {
-		return VMM_EINVALID;
+	gpa[0] = layout->desc_addr;
+	gpa[1] = layout->driver_addr;
+	gpa[2] = layout->device_addr;
+	if (layout->packed) {
+		gsz[0] = sizeof(struct vring_packed_desc) * num;
+		gsz[1] = sizeof(struct vring_packed_desc_event);
+		gsz[2] = sizeof(struct vring_packed_desc_event);
+	} else {
+		gsz[0] = sizeof(struct vring_desc) * num;
+		gsz[1] = sizeof(u16) * (3 + num);
+		gsz[2] = sizeof(u16) * 3 + sizeof(struct vring_used_elem) * num;
 	}
 
-	vq->addr = (void *)vmm_host_memmap(hphys_addr, gphys_size, 
-					   VMM_MEMORY_FLAGS_NORMAL);
-	if (!vq->addr) {
-		return VMM_ENOMEM;
+	if ((rc = virtio_queue_map(vq, guest, gpa, gsz, va, &hphys_addr))) {
+		return rc;
 	}
 
-	vring_init(&vq->vring, desc_count, vq->addr, align);
+	if (layout->packed) {
+		vq->pbufs = vmm_zalloc(num * (sizeof(*vq->pbufs) +
+					      2 * sizeof(u16)));
+		if (!vq->pbufs) {
+			virtio_queue_unmap(vq);
+			return VMM_ENOMEM;
+		}
+		vq->pop_ids = (u16 *)&vq->pbufs[num];
+		vq->fill_ids = &vq->pop_ids[num];
+
+		vq->pvring.num = num;
+		vq->pvring.desc = va[0];
+		vq->pvring.driver = va[1];
+		vq->pvring.device = va[2];
+
+		/* Wrap counters start with one */
+		vq->avail_wrap = TRUE;
+		vq->used_wrap = TRUE;
+
+		/* Guest can always notify us */
+		vq->pvring.device->off_wrap = 0;
+		vq->pvring.device->flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+
+		/* Emulators use vring.num as queue size */
+		vq->vring.num = num;
+	} else {
+		vq->vring.num = num;
+		vq->vring.desc = va[0];
+		vq->vring.avail = va[1];
+		vq->vring.used = va[2];
+	}
 
+	vq->packed = layout->packed;
+	vq->addr = va[0];
 	vq->guest = guest;
-	vq->desc_count = desc_count;
-	vq->align = align;
-	vq->guest_pfn = guest_pfn;
-	vq->guest_page_size = guest_page_size;
+	vq->desc_count = num;
+	vq->align = layout->align;
+	vq->guest_pfn = layout->guest_pfn;
+	vq->guest_page_size = layout->guest_page_size;
 
-	vq->guest_addr = gphys_addr;
+	vq->guest_addr = layout->desc_addr;
 	vq->host_addr = hphys_addr;
-	vq->total_size = gphys_size;
+	vq->total_size = gsz[0] + gsz[1] + gsz[2];
 
 	return VMM_OK;
 }
@@ -285,7 +730,105 @@ static unsigned next_desc(struct vring_desc *desc, u32 i, u32 max)
 
 	next = desc[i].next;
 
-	return next;
+	return (next < max) ? next : max;
+}
+
+/* Expand indirect descriptor table into IO vectors. The table is in
+ * guest memory so descriptors are read one at a time. At most max
+ * IO vectors are filled so callers can size them by queue size.
+ */
+static u32 virtio_queue_indirect_iovec(struct virtio_queue *vq,
+				       u64 addr, u32 len, u32 max,
+				       struct virtio_iovec *iov,
+				       u32 *ret_total_len)
+{
+	u32 i, idx = 0, num = len / sizeof(struct vring_desc);
+	struct vring_desc desc;
+	struct vring_packed_desc pdesc;
+
+	num = min(num, max);
+	for (i = 0; i < num; i++) {
+		if (vq->packed) {
+			/* Packed table is used in order */
+			if (vmm_guest_memory_read(vq->guest,
+					addr + i * sizeof(pdesc),
+					&pdesc, sizeof(pdesc),
+					TRUE) != sizeof(pdesc)) {
+				break;
+			}
+			desc.addr = pdesc.addr;
+			desc.len = pdesc.len;
+			desc.flags = pdesc.flags;
+		} else {
+			if (vmm_guest_memory_read(vq->guest,
+					addr + idx * sizeof(desc),
+					&desc, sizeof(desc),
+					TRUE) != sizeof(desc)) {
+				break;
+			}
+		}
+
+		iov[i].addr = desc.addr;
+		iov[i].len = desc.len;
+		iov[i].flags = (desc.flags & VRING_DESC_F_WRITE) ? 1 : 0;
+
+		*ret_total_len += desc.len;
+
+		if (!vq->packed) {
+			if (!(desc.flags & VRING_DESC_F_NEXT) ||
+			    (num <= desc.next)) {
+				i++;
+				break;
+			}
+			idx = desc.next;
+		}
+	}
+
+	return i;
+}
+
+static u16 virtio_queue_packed_get_head_iovec(struct virtio_queue *vq,
+					u16 head, struct virtio_iovec *iov,
+					u32 *ret_iov_cnt, u32 *ret_total_len)
+{
+	u32 i;
+	u16 slot;
+	struct vring_packed_desc *desc;
+	struct virtio_queue_pbuf *pbuf;
+
+	head = umod32(head, vq->pvring.num);
+	pbuf = &vq->pbufs[head];
+	slot = pbuf->slot;
+
+	for (i = 0; i < pbuf->num; i++) {
+		desc = &vq->pvring.desc[slot];
+
+		if (desc->flags & VRING_DESC_F_INDIRECT) {
+			i += virtio_queue_indirect_iovec(vq, desc->addr,
+						desc->len, vq->pvring.num - i,
+						&iov[i], ret_total_len);
+			break;
+		}
+
+		iov[i].addr = desc->addr;
+		iov[i].len = desc->len;
+
+		*ret_total_len += desc->len;
+
+		if (desc->flags & VRING_DESC_F_WRITE) {
+			iov[i].flags = 1;  /* Write */
+		} else {
+			iov[i].flags = 0; /* Read */
+		}
+
+		if (++slot == vq->pvring.num) {
+			slot = 0;
+		}
+	}
+
+	*ret_iov_cnt = i;
+
+	return head;
 }
 
 u16 virtio_queue_get_head_iovec(struct virtio_queue *vq,
@@ -306,15 +849,20 @@ u16 virtio_queue_get_head_iovec(struct virtio_queue *vq,
 
 	*ret_iov_cnt = 0;
 	*ret_total_len = 0;
+
+	if (vq->packed) {
+		return virtio_queue_packed_get_head_iovec(vq, head, iov,
+						ret_iov_cnt, ret_total_len);
+	}
+
 	max = vq->vring.num;
 	desc = vq->vring.desc;
 
 	if (desc[idx].flags & VRING_DESC_F_INDIRECT) {
-#if 0
-		max = desc[idx].len / sizeof(struct vring_desc);
-		desc = guest_flat_to_host(kvm, desc[idx].addr);
-		idx = 0;
-#endif
+		*ret_iov_cnt = virtio_queue_indirect_iovec(vq,
+					desc[idx].addr, desc[idx].len,
+					max, iov, ret_total_len);
+		return head;
 	}
 
 	i = 0;
@@ -332,7 +880,7 @@ u16 virtio_queue_get_head_iovec(struct virtio_queue *vq,
 
 		i++;
 
-	} while ((idx = next_desc(desc, idx, max)) != max);
+	} while ((i < max) && ((idx = next_desc(desc, idx, max)) != max));
 
 	*ret_iov_cnt = i;
 
@@ -346,33 +894,58 @@ u16 virtio_queue_get_iovec(struct virtio_queue *vq,
 {
 	u16 head = virtio_queue_pop(vq);
 
-	return virtio_queue_get_head_iovec(vq, head, iov, 
+	return virtio_queue_get_head_iovec(vq, head, iov,
 					   ret_iov_cnt, ret_total_len);
 }
 VMM_EXPORT_SYMBOL(virtio_queue_get_iovec);
 
-u32 virtio_iovec_to_buf_read(struct virtio_device *dev,
-                             struct virtio_iovec *iov,
-                             u32 iov_cnt, void *buf,
-                             u32 buf_len)
+/* Number of virtio iovecs handed to guest scatter-gather copy at once */
+#define VIRTIO_IOVEC_BATCH		16
+
+static u32 virtio_iovec_rw(struct virtio_device *dev,
+			   struct virtio_iovec *iov, u32 iov_cnt,
+			   void *buf, u32 buf_len, bool is_write)
 {
-	u32 i = 0, pos = 0, len = 0;
+	u32 i, n, len, done, pos = 0;
+	struct vmm_guest_iovec giov[VIRTIO_IOVEC_BATCH];
+
+	while (iov_cnt && (pos < buf_len)) {
+		n = (iov_cnt < VIRTIO_IOVEC_BATCH) ?
+					iov_cnt : VIRTIO_IOVEC_BATCH;
+		len = 0;
+		for (i = 0; i < n; i++) {
+			giov[i].addr = iov[i].addr;
+			giov[i].len = iov[i].len;
+			len += iov[i].len;
+		}
 
-	for (i = 0; i < iov_cnt && pos < buf_len; i++) {
-		len = ((buf_len - pos) < iov[i].len) ?
-						(buf_len - pos) : iov[i].len;
+		if (is_write) {
+			done = vmm_guest_memory_writev(dev->guest, giov, n,
+						buf + pos, buf_len - pos, TRUE);
+		} else {
+			done = vmm_guest_memory_readv(dev->guest, giov, n,
+						buf + pos, buf_len - pos, TRUE);
+		}
 
-		len = vmm_guest_memory_read(dev->guest, iov[i].addr,
-					    buf + pos, len, TRUE);
-		if (!len) {
+		pos += done;
+		if (done < len) {
 			break;
 		}
 
-		pos += len;
+		iov += n;
+		iov_cnt -= n;
 	}
 
 	return pos;
 }
+
+u32 virtio_iovec_to_buf_read(struct virtio_device *dev,
+                             struct virtio_iovec *iov,
+                             u32 iov_cnt, void *buf,
+                             u32 buf_len)
+{
+	return virtio_iovec_rw(dev, iov, iov_cnt, buf, buf_len, FALSE);
+}
 VMM_EXPORT_SYMBOL(virtio_iovec_to_buf_read);
 
 u32 virtio_buf_to_iovec_write(struct virtio_device *dev,
@@ -380,22 +953,7 @@ u32 virtio_buf_to_iovec_write(struct virtio_device *dev,
                               u32 iov_cnt, void *buf,
                               u32 buf_len)
 {
-	u32 i = 0, pos = 0, len = 0;
-
-	for (i = 0; i < iov_cnt && pos < buf_len; i++) {
-		len = ((buf_len - pos) < iov[i].len) ?
-					(buf_len - pos) : iov[i].len;
-
-		len = vmm_guest_memory_write(dev->guest, iov[i].addr,
-					     buf + pos, len, TRUE);
-		if (!len) {
-			break;
-		}
-
-		pos += len;
-	}
-
-	return pos;
+	return virtio_iovec_rw(dev, iov, iov_cnt, buf, buf_len, TRUE);
 }
 VMM_EXPORT_SYMBOL(virtio_buf_to_iovec_write);
 
@@ -25,6 +25,8 @@
 
 #include <vmm_error.h>
 #include <vmm_stdio.h>
+#include <arch_atomic.h>
+#include <arch_barrier.h>
 #include <libs/stringlib.h>
 #include <libs/buddy.h>
 
@@ -55,6 +57,20 @@ struct buddy_area {
 #define AREA_START(a)			((a)->map)
 #define AREA_END(a)			((a)->map + AREA_SIZE(a))
 
+#define AREA_INDEX(ba, a)		\
+	(((void *)(a) - (ba)->hk_area) / sizeof(struct buddy_area))
+#define INDEX_AREA(ba, i)		\
+	((struct buddy_area *)((ba)->hk_area + (i) * sizeof(struct buddy_area)))
+#define MAP_INDEX(ba, addr)		\
+	BLOCK_COUNT((addr) - (ba)->mem_start, (ba)->min_bin)
+
+/* Every MAP_STRIDE-th entry of alloc map inside an alloced area also
+ * holds the area so that find never walks more than MAP_STRIDE entries.
+ */
+#define MAP_STRIDE			64UL
+#define MAP_STRIDE_NEXT(idx)		\
+	(((idx) + MAP_STRIDE) & ~(MAP_STRIDE - 1))
+
 unsigned long buddy_estimate_bin(struct buddy_allocator *ba,
 				 unsigned long size)
 {
@@ -148,6 +164,87 @@ unsigned long buddy_hk_area_total(struct buddy_allocator *ba)
 	return ba->hk_total_count;
 }
 
+/* NOTE: This function does not require any lock */
+static struct buddy_area *buddy_map_find(struct buddy_allocator *ba,
+					 unsigned long addr)
+{
+	long v;
+	struct buddy_area *a;
+	unsigned long i, idx;
+
+	idx = MAP_INDEX(ba, addr);
+	if (ba->alloc_map_count <= idx) {
+		return NULL;
+	}
+
+	/* Fast path: addr is start (or stride block) of an alloced area */
+	v = arch_atomic_read(&ba->alloc_map[idx]);
+	if (v) {
+		a = INDEX_AREA(ba, v - 1);
+		return ((AREA_START(a) <= addr) && (addr < AREA_END(a))) ?
+			a : NULL;
+	}
+
+	/* Slow path: walk back to nearest start or stride block of
+	 * alloced area which is at most MAP_STRIDE - 1 entries away
+	 */
+	for (i = 1; (i < MAP_STRIDE) && (i <= idx); i++) {
+		v = arch_atomic_read(&ba->alloc_map[idx - i]);
+		if (!v) {
+			continue;
+		}
+		a = INDEX_AREA(ba, v - 1);
+		return ((AREA_START(a) <= addr) && (addr < AREA_END(a))) ?
+			a : NULL;
+	}
+
+	return NULL;
+}
+
+static void buddy_map_add(struct buddy_allocator *ba,
+			  struct buddy_area *a)
+{
+	long v = AREA_INDEX(ba, a) + 1;
+	unsigned long i, start, end;
+
+	start = MAP_INDEX(ba, AREA_START(a));
+	end = MAP_INDEX(ba, AREA_END(a));
+
+	/* Make sure buddy area is visible before publishing it */
+	arch_smp_wmb();
+
+	/* Stride blocks bound the slow path of find */
+	for (i = MAP_STRIDE_NEXT(start); i < end; i += MAP_STRIDE) {
+		arch_atomic_write(&ba->alloc_map[i], v);
+	}
+
+	arch_atomic_write(&ba->alloc_map[start], v);
+}
+
+/* Atomically clear alloc map entry of given buddy area.
+ * Returns FALSE if entry was already cleared (or reused) by someone else.
+ */
+static bool buddy_map_claim(struct buddy_allocator *ba,
+			    struct buddy_area *a)
+{
+	long v = AREA_INDEX(ba, a) + 1;
+	unsigned long i, start, end;
+
+	start = MAP_INDEX(ba, AREA_START(a));
+	end = MAP_INDEX(ba, AREA_END(a));
+
+	if (arch_atomic_cmpxchg(&ba->alloc_map[start], v, 0) != v) {
+		return FALSE;
+	}
+
+	/* Blocks are not back in bins so nobody else owns stride blocks */
+	for (i = MAP_STRIDE_NEXT(start); i < end; i += MAP_STRIDE) {
+		arch_atomic_write(&ba->alloc_map[i], 0);
+	}
+
+	return TRUE;
+}
+
 /* NOTE: This function must be called with ba->alloc_lock held */
 static struct buddy_area *__buddy_alloc_find(struct buddy_allocator *ba,
 					     unsigned long addr,
@@ -156,6 +253,7 @@ static struct buddy_area *__buddy_alloc_find(struct buddy_allocator *ba,
 					     unsigned long *alloc_blk_count)
 {
 	struct rb_node *n;
+	struct buddy_area *a;
 
 	if (!ba) {
 		return NULL;
@@ -163,6 +261,22 @@ static struct buddy_area *__buddy_alloc_find(struct buddy_allocator *ba,
 
 	DPRINTF("%s: ba=%p addr=0x%x\n", __func__, ba, addr);
 
+	if (ba->alloc_map) {
+		a = buddy_map_find(ba, addr);
+		if (a) {
+			if (alloc_map) {
+				*alloc_map = a->map;
+			}
+			if (alloc_bin) {
+				*alloc_bin = a->bin_num;
+			}
+			if (alloc_blk_count) {
+				*alloc_blk_count = a->blk_count;
+			}
+		}
+		return a;
+	}
+
 	n = ba->alloc.rb_node;
   	while (n) {
   		struct buddy_area *a = rb_entry(n, struct buddy_area, hk_rb);
@@ -208,6 +322,12 @@ static struct buddy_area *buddy_alloc_find(struct buddy_allocator *ba,
 
 	DPRINTF("%s: ba=%p addr=0x%x\n", __func__, ba, addr);
 
+	/* Alloc map does not require any lock for find */
+	if (ba->alloc_map) {
+		return __buddy_alloc_find(ba, addr,
+				alloc_map, alloc_bin, alloc_blk_count);
+	}
+
 	vmm_spin_lock_irqsave_lite(&ba->alloc_lock, f);
 	ret = __buddy_alloc_find(ba, addr,
 				 alloc_map, alloc_bin, alloc_blk_count);
@@ -231,6 +351,11 @@ static void __buddy_alloc_add(struct buddy_allocator *ba,
 	DPRINTF("%s: ba=%p map=0x%x bin_num=%d blk_count=%d\n",
 		__func__, ba, a->map, a->bin_num, a->blk_count);
 
+	if (ba->alloc_map) {
+		buddy_map_add(ba, a);
+		return;
+	}
+
 	depth = 0;
 	new = &(ba->alloc.rb_node);
 	while (*new) {
@@ -262,23 +387,37 @@ static void buddy_alloc_add(struct buddy_allocator *ba,
 	DPRINTF("%s: ba=%p map=0x%x bin_num=%d blk_count=%d\n",
 		__func__, ba, a->map, a->bin_num, a->blk_count);
 
+	/* Alloc map does not require any lock for add */
+	if (ba->alloc_map) {
+		__buddy_alloc_add(ba, a);
+		return;
+	}
+
 	vmm_spin_lock_irqsave_lite(&ba->alloc_lock, f);
 	__buddy_alloc_add(ba, a);
 	vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
 }
 
-/* NOTE: This function must be called with ba->alloc_lock held */
-static void __buddy_alloc_del(struct buddy_allocator *ba,
+/* Returns FALSE if buddy area was already deleted
+ * NOTE: This function must be called with ba->alloc_lock held
+ */
+static bool __buddy_alloc_del(struct buddy_allocator *ba,
 			      struct buddy_area *a)
 {
 	if (!ba || !a) {
-		return;
+		return FALSE;
 	}
 
 	DPRINTF("%s: ba=%p map=0x%x bin_num=%d blk_count=%d\n",
 		__func__, ba, a->map, a->bin_num, a->blk_count);
 
+	if (ba->alloc_map) {
+		return buddy_map_claim(ba, a);
+	}
+
 	rb_erase(&a->hk_rb, &ba->alloc);
+
+	return TRUE;
 }
 
 /* NOTE: Don't call this function directly */
@@ -935,6 +1074,18 @@ int buddy_mem_free(struct buddy_allocator *ba, unsigned long addr)
 
 	DPRINTF("%s: ba=%p addr=0x%x\n", __func__, ba, addr);
 
+	/* Alloc map does not require alloc lock and only one of
+	 * the racing (or repeated) frees can claim the alloced area
+	 */
+	if (ba->alloc_map) {
+		a = __buddy_alloc_find(ba, addr, NULL, NULL, NULL);
+		if (!a || !__buddy_alloc_del(ba, a)) {
+			return VMM_ENOTAVAIL;
+		}
+		buddy_bins_put(ba, a);
+		return VMM_OK;
+	}
+
 	/* Acquire alloc lock */
 	vmm_spin_lock_irqsave_lite(&ba->alloc_lock, f);
 
@@ -962,7 +1113,7 @@ int buddy_mem_partial_free(struct buddy_allocator *ba,
 {
 	irq_flags_t f;
 	struct buddy_area *a, *b;
-	unsigned long old_bin_num, old_blk_count;
+	unsigned long a_map, a_bin, a_blk_count, a_end;
 
 	/* Sanity checks */
 	if (!ba || (addr < ba->mem_start) ||
@@ -977,40 +1128,41 @@ int buddy_mem_partial_free(struct buddy_allocator *ba,
 	vmm_spin_lock_irqsave_lite(&ba->alloc_lock, f);
 
 	/* Find buddy area from alloc tree */
-	a = __buddy_alloc_find(ba, addr, NULL, NULL, NULL);
+	a = __buddy_alloc_find(ba, addr, &a_map, &a_bin, &a_blk_count);
 	if (!a) {
 		vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
 		return VMM_ENOTAVAIL;
 	}
 
-	/* Downgrade to smallest bin */
-	old_bin_num = a->bin_num;
-	old_blk_count = a->blk_count;
-	a->blk_count = a->blk_count * (0x1UL << (a->bin_num - ba->min_bin));
-	a->bin_num = ba->min_bin;
-
-	/* More sanity checks */
-	if (BLOCK_COUNT(addr - AREA_START(a), a->bin_num) &&
-	    (addr & BLOCK_MASK(a->bin_num))) {
-		a->blk_count = old_blk_count;
-		a->bin_num = old_bin_num;
+	/* More sanity checks
+	 * NOTE: Buddy area is still published in alloc tree (or alloc
+	 * map which is read without alloc lock) so we only look at it.
+	 */
+	a_end = a_map + a_blk_count * BLOCK_SIZE(a_bin);
+	if (BLOCK_COUNT(addr - a_map, ba->min_bin) &&
+	    (addr & BLOCK_MASK(ba->min_bin))) {
 		vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
 		return VMM_EINVALID;
 	}
-	if (BLOCK_COUNT(AREA_END(a) - (addr + size), a->bin_num) &&
-	    ((addr + size) & BLOCK_MASK(a->bin_num))) {
-		a->blk_count = old_blk_count;
-		a->bin_num = old_bin_num;
+	if (BLOCK_COUNT(a_end - (addr + size), ba->min_bin) &&
+	    ((addr + size) & BLOCK_MASK(ba->min_bin))) {
 		vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
 		return VMM_EINVALID;
 	}
 
 	/* Delete buddy area from alloc tree */
-	__buddy_alloc_del(ba, a);
+	if (!__buddy_alloc_del(ba, a)) {
+		vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
+		return VMM_ENOTAVAIL;
+	}
 
 	/* Release alloc lock */
 	vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
 
+	/* Downgrade to smallest bin now that nobody else can see it */
+	a->blk_count = a->blk_count * (0x1UL << (a->bin_num - ba->min_bin));
+	a->bin_num = ba->min_bin;
+
 	/* Collect residue from start of freed buddy area */
 	if (BLOCK_COUNT(addr - AREA_START(a), a->bin_num) &&
 	    !(addr & BLOCK_MASK(a->bin_num))) {
@@ -1043,8 +1195,15 @@ skip:
 	return VMM_OK;
 }
 
+unsigned long buddy_alloc_map_size(unsigned long mem_size,
+				   unsigned long min_bin)
+{
+	return BLOCK_COUNT(mem_size, min_bin) * sizeof(atomic_t);
+}
+
 int buddy_allocator_init(struct buddy_allocator *ba,
 			 void *hk_area, unsigned long hk_area_size,
+			 void *map_area, unsigned long map_area_size,
 			 unsigned long mem_start, unsigned long mem_size,
 			 unsigned long min_bin, unsigned long max_bin)
 {
@@ -1064,6 +1223,10 @@ int buddy_allocator_init(struct buddy_allocator *ba,
 	    (hk_area_size < sizeof(struct buddy_area))) {
 		return VMM_EINVALID;
 	}
+	if (map_area &&
+	    (map_area_size < buddy_alloc_map_size(mem_size, min_bin))) {
+		return VMM_EINVALID;
+	}
 
 	/* Initialize house-keeping */
 	ba->hk_area = hk_area;
@@ -1092,6 +1255,15 @@ int buddy_allocator_init(struct buddy_allocator *ba,
 	INIT_SPIN_LOCK(&ba->alloc_lock);
 	ba->alloc = RB_ROOT;
 
+	/* Setup empty alloc map */
+	ba->alloc_map = map_area;
+	ba->alloc_map_count = 0;
+	if (ba->alloc_map) {
+		ba->alloc_map_count = BLOCK_COUNT(mem_size, min_bin);
+		memset(ba->alloc_map, 0,
+		       ba->alloc_map_count * sizeof(*ba->alloc_map));
+	}
+
 	/* Setup empty bins and alloc trees */
 	for (i = 0; i < BUDDY_MAX_SUPPORTED_BIN; i++) {
 		INIT_SPIN_LOCK(&ba->bins_lock[i]);
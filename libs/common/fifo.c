@@ -203,6 +203,96 @@ bool fifo_dequeue(struct fifo *f, void *dst)
 	return ret;
 }
 
+u32 fifo_enqueue_bulk(struct fifo *f, void *src, u32 count, bool overwrite)
+{
+	u32 free, chunk, ret;
+	irq_flags_t flags;
+
+	if (!f || !src) {
+		return 0;
+	}
+
+	vmm_spin_lock_irqsave_lite(&f->lock, flags);
+
+	/* Only last element_count elements can be kept */
+	if (overwrite && (f->element_count < count)) {
+		src += (count - f->element_count) * f->element_size;
+		count = f->element_count;
+	}
+
+	free = f->element_count - f->avail_count;
+	if (overwrite && (free < count)) {
+		f->read_pos += count - free;
+		if (f->element_count <= f->read_pos) {
+			f->read_pos -= f->element_count;
+		}
+		f->avail_count -= count - free;
+		free = count;
+	}
+
+	if (free < count) {
+		count = free;
+	}
+	ret = count;
+
+	while (count) {
+		chunk = f->element_count - f->write_pos;
+		if (count < chunk) {
+			chunk = count;
+		}
+		memcpy(f->elements + (f->write_pos * f->element_size),
+			src, chunk * f->element_size);
+		src += chunk * f->element_size;
+		f->write_pos += chunk;
+		if (f->element_count <= f->write_pos) {
+			f->write_pos = 0;
+		}
+		f->avail_count += chunk;
+		count -= chunk;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&f->lock, flags);
+
+	return ret;
+}
+
+u32 fifo_dequeue_bulk(struct fifo *f, void *dst, u32 count)
+{
+	u32 chunk, ret;
+	irq_flags_t flags;
+
+	if (!f || !dst) {
+		return 0;
+	}
+
+	vmm_spin_lock_irqsave_lite(&f->lock, flags);
+
+	if (f->avail_count < count) {
+		count = f->avail_count;
+	}
+	ret = count;
+
+	while (count) {
+		chunk = f->element_count - f->read_pos;
+		if (count < chunk) {
+			chunk = count;
+		}
+		memcpy(dst, f->elements + (f->read_pos * f->element_size),
+			chunk * f->element_size);
+		dst += chunk * f->element_size;
+		f->read_pos += chunk;
+		if (f->element_count <= f->read_pos) {
+			f->read_pos = 0;
+		}
+		f->avail_count -= chunk;
+		count -= chunk;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&f->lock, flags);
+
+	return ret;
+}
+
 bool fifo_clear(struct fifo *f)
 {
 	irq_flags_t flags;
@@ -33,7 +33,18 @@
 
 #define BUDDY_MAX_SUPPORTED_BIN			32
 
-/** Representation of buddy allocator instance */
+/** Representation of buddy allocator instance
+ *
+ *  Alloced buddy areas are tracked in one of two ways:
+ *  1. An rbtree of alloced areas protected by alloc_lock (default)
+ *  2. An alloc map having one atomic entry per min_bin block which holds
+ *     (house-keeping area index + 1) for the first block of each alloced
+ *     area and for every 64th block inside it, so that a lookup from
+ *     the middle of an area walks back a bounded number of entries.
+ *     This makes free and size queries constant time without any lock
+ *     on the read side at the cost of extra memory for alloc map.
+ *     Free claims the entry using cmpxchg so a double free is rejected.
+ */
 struct buddy_allocator {
 	void *hk_area;
 	unsigned long hk_area_size;
@@ -47,6 +58,8 @@ struct buddy_allocator {
 	unsigned long max_bin;
 	vmm_spinlock_t alloc_lock;
 	struct rb_root alloc;
+	atomic_t *alloc_map;
+	unsigned long alloc_map_count;
 	vmm_spinlock_t bins_lock[BUDDY_MAX_SUPPORTED_BIN];
 	struct dlist bins[BUDDY_MAX_SUPPORTED_BIN];
 };
@@ -102,9 +115,18 @@ int buddy_mem_free(struct buddy_allocator *ba, unsigned long addr);
 int buddy_mem_partial_free(struct buddy_allocator *ba,
 			   unsigned long addr, unsigned long size);
 
-/** Initialize buddy allocator */
+/** Size of alloc map required for given memory size and min_bin */
+unsigned long buddy_alloc_map_size(unsigned long mem_size,
+				   unsigned long min_bin);
+
+/** Initialize buddy allocator
+ *  NOTE: If map_area is NULL then alloced areas are tracked using rbtree
+ *  otherwise map_area is used as alloc map and it must be atleast
+ *  buddy_alloc_map_size() bytes.
+ */
 int buddy_allocator_init(struct buddy_allocator *ba,
 			 void *hk_area, unsigned long hk_area_size,
+			 void *map_area, unsigned long map_area_size,
 			 unsigned long mem_start, unsigned long mem_size,
 			 unsigned long min_bin, unsigned long max_bin);
 
@@ -61,6 +61,16 @@ bool fifo_enqueue(struct fifo *f, void *src, bool overwrite);
  */
 bool fifo_dequeue(struct fifo *f, void *dst);
 
+/** Enqueue multiple elements to FIFO
+ *  @returns number of elements enqueued
+ */
+u32 fifo_enqueue_bulk(struct fifo *f, void *src, u32 count, bool overwrite);
+
+/** Dequeue multiple elements from FIFO
+ *  @returns number of elements dequeued
+ */
+u32 fifo_dequeue_bulk(struct fifo *f, void *dst, u32 count);
+
 /** Clear (or empty) the FIFO
  *  @returns TRUE on success and FALSE on failure
  */
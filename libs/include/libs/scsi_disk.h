@@ -27,7 +27,7 @@
 #include <vmm_types.h>
 #include <libs/scsi.h>
 #include <block/vmm_blockdev.h>
-#include <block/vmm_blockrq_nop.h>
+#include <block/vmm_blockrq_mq.h>
 
 #define SCSI_DISK_IPRIORITY		(SCSI_IPRIORITY + \
 					 VMM_BLOCKDEV_CLASS_IPRIORITY + 1)
@@ -41,7 +41,7 @@ struct scsi_disk {
 	struct scsi_info info;
 
 	struct vmm_blockdev *bdev;
-	struct vmm_blockrq_nop *rqnop;
+	struct vmm_blockrq_mq *rqmq;
 };
 
 struct scsi_disk *scsi_create_disk(const char *name,
@@ -30,6 +30,15 @@ struct stack_trace {
 	int skip;	/* input argument: how many entries to skip */
 };
 
+struct arch_regs;
+
+/** Save stack-backtrace of current context */
+void arch_save_stacktrace(struct stack_trace *trace);
+
+/** Save stack-backtrace of context represented by saved registers */
+void arch_save_stacktrace_regs(struct arch_regs *regs,
+			       struct stack_trace *trace);
+
 void dump_stacktrace(void);
 
 #endif /* __STACKTRACE__ */
@@ -32,6 +32,8 @@
 #define VFS_MAX_PATH		(256)
 #define	VFS_MAX_NAME		(64)
 #define VFS_MAX_FD		(32)
+#define VFS_BCACHE_BLOCK_SHIFT	(12)
+#define VFS_BCACHE_BLOCK_SIZE	(1 << VFS_BCACHE_BLOCK_SHIFT)
 
 /** file type bits */
 #define	S_IFDIR			(1<<0)
@@ -386,4 +388,29 @@ struct filesystem *vfs_filesystem_get(int index);
  */
 u32 vfs_filesystem_count(void);
 
+/** Attach block device to buffer cache 
+ *  Note: Attach is reference counted and done by vfs_mount()
+ */
+int vfs_bcache_attach(struct vmm_blockdev *bdev);
+
+/** Write back cached data and detach block device from buffer cache 
+ *  Note: Detach is reference counted and done by vfs_unmount()
+ */
+void vfs_bcache_detach(struct vmm_blockdev *bdev);
+
+/** Read from block device through buffer cache 
+ *  Note: Filesystems should use this instead of vmm_blockdev_read()
+ */
+u64 vfs_bcache_read(struct vmm_blockdev *bdev, u8 *buf, u64 off, u64 len);
+
+/** Write to block device through buffer cache 
+ *  Note: Filesystems should use this instead of vmm_blockdev_write()
+ */
+u64 vfs_bcache_write(struct vmm_blockdev *bdev, u8 *buf, u64 off, u64 len);
+
+/** Write back cached data and flush block device cache 
+ *  Note: Filesystems should use this instead of vmm_blockdev_flush_cache()
+ */
+int vfs_bcache_sync(struct vmm_blockdev *bdev);
+
 #endif /* __VFS_H_ */
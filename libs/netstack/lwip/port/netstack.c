@@ -751,6 +751,20 @@ static int lwip_switch2port_xfer(struct vmm_netport *port,
 	return VMM_OK;
 }
 
+static int lwip_switch2port_xfer_burst(struct vmm_netport *port,
+				       struct vmm_mbuf **mbufs, u32 count)
+{
+	u32 i;
+
+	for (i = 0; i < count; i++) {
+		if (lwip_switch2port_xfer(port, mbufs[i])) {
+			m_freem(mbufs[i]);
+		}
+	}
+
+	return VMM_OK;
+}
+
 void lwip_netstack_mbuf_free(struct vmm_mbuf *m, void *p, u32 len, void *arg)
 {
 	struct pbuf *pb = (struct pbuf *)arg;
@@ -882,6 +896,7 @@ static int __init lwip_netstack_init(void)
 	lns.port->link_changed = lwip_set_link;
 	lns.port->can_receive = lwip_can_receive;
 	lns.port->switch2port_xfer = lwip_switch2port_xfer;
+	lns.port->switch2port_xfer_burst = lwip_switch2port_xfer_burst;
 	lns.port->priv = &lns;
 
 	/* Register a netport */
@@ -44,7 +44,7 @@
 #define DPRINTF(msg...)
 #endif
 
-static int scsi_disk_rq_read(struct vmm_blockrq_nop *rqnop,
+static int scsi_disk_rq_read(struct vmm_blockrq_mq *rqmq,
 			     struct vmm_request *r, void *priv)
 {
 	void *data;
@@ -98,7 +98,7 @@ static int scsi_disk_rq_read(struct vmm_blockrq_nop *rqnop,
 	return VMM_OK;
 }
 
-static int scsi_disk_rq_write(struct vmm_blockrq_nop *rqnop,
+static int scsi_disk_rq_write(struct vmm_blockrq_mq *rqmq,
 			      struct vmm_request *r, void *priv)
 {
 	void *data;
@@ -152,7 +152,7 @@ static int scsi_disk_rq_write(struct vmm_blockrq_nop *rqnop,
 	return VMM_OK;
 }
 
-static void scsi_disk_rq_flush(struct vmm_blockrq_nop *rqnop, void *priv)
+static void scsi_disk_rq_flush(struct vmm_blockrq_mq *rqmq, void *priv)
 {
 	/* Nothing to do here. */
 }
@@ -212,21 +212,25 @@ struct scsi_disk *scsi_create_disk(const char *name,
 	disk->bdev->num_blocks = disk->info.capacity;
 	disk->bdev->block_size = disk->info.blksz;
 
-	/* Setup request queue for block device instance */
-	disk->rqnop = vmm_blockrq_nop_create(name, max_pending,
-					     scsi_disk_rq_read,
-					     scsi_disk_rq_write,
-					     scsi_disk_rq_flush, disk);
-	if (!disk->rqnop) {
+	/* Setup request queue for block device instance
+	 * Note: SCSI transports are not re-entrant so we use single
+	 * worker and merge adjacent requests up to one transfer.
+	 */
+	disk->rqmq = vmm_blockrq_mq_create(name, max_pending, 1,
+					   blks_per_xfer * disk->info.blksz,
+					   scsi_disk_rq_read,
+					   scsi_disk_rq_write,
+					   scsi_disk_rq_flush, disk);
+	if (!disk->rqmq) {
 		vmm_blockdev_free(disk->bdev);
 		vmm_free(disk);
 		return VMM_ERR_PTR(VMM_ENOMEM);
 	}
-	disk->bdev->rq = vmm_blockrq_nop_to_rq(disk->rqnop);
+	disk->bdev->rq = vmm_blockrq_mq_to_rq(disk->rqmq);
 
 	/* Register block device instance */
 	if ((err = vmm_blockdev_register(disk->bdev))) {
-		vmm_blockrq_nop_destroy(disk->rqnop);
+		vmm_blockrq_mq_destroy(disk->rqmq);
 		vmm_blockdev_free(disk->bdev);
 		vmm_free(disk);
 		return VMM_ERR_PTR(err);
@@ -243,7 +247,7 @@ int scsi_destroy_disk(struct scsi_disk *disk)
 	}
 
 	vmm_blockdev_unregister(disk->bdev);
-	vmm_blockrq_nop_destroy(disk->rqnop);
+	vmm_blockrq_mq_destroy(disk->rqmq);
 	vmm_blockdev_free(disk->bdev);
 	vmm_free(disk);
 
@@ -163,7 +163,7 @@ static int cpiofs_mount(struct mount *m, const char *dev, u32 flags)
 		return VMM_EFAIL;
 	}
 
-	read_count = vmm_blockdev_read(m->m_dev, 
+	read_count = vfs_bcache_read(m->m_dev, 
 			(u8 *)(&header), 0, sizeof(struct cpio_newc_header));
 	if (read_count != sizeof(struct cpio_newc_header)) {
 		return VMM_EIO;
@@ -228,7 +228,7 @@ static size_t cpiofs_read(struct vnode *v, loff_t off, void *buf, size_t len)
 	}
 
 	toff = (u64)((u32)(v->v_data));
-	sz = vmm_blockdev_read(v->v_mount->m_dev, (u8 *)buf, (toff + off), sz);
+	sz = vfs_bcache_read(v->v_mount->m_dev, (u8 *)buf, (toff + off), sz);
 
 	return sz;
 }
@@ -262,7 +262,7 @@ static int cpiofs_readdir(struct vnode *dv, loff_t off, struct dirent *d)
 	int i = 0;
 
 	while (1) {
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)&header, 
+		rd = vfs_bcache_read(dv->v_mount->m_dev, (u8 *)&header, 
 				toff, sizeof(struct cpio_newc_header));
 		if (!rd) {
 			return VMM_EIO;
@@ -283,7 +283,7 @@ static int cpiofs_readdir(struct vnode *dv, loff_t off, struct dirent *d)
 		memcpy(buf, &header.c_mode, 8);
 		mode = strtoul((const char *)buf, NULL, 16);
 
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)path, 
+		rd = vfs_bcache_read(dv->v_mount->m_dev, (u8 *)path, 
 		toff + sizeof(struct cpio_newc_header), name_size);
 		if (!rd) {
 			return VMM_EIO;
@@ -348,7 +348,7 @@ static int cpiofs_lookup(struct vnode *dv, const char *name, struct vnode *v)
 	u8 buf[9];
 
 	while (1) {
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)&header, 
+		rd = vfs_bcache_read(dv->v_mount->m_dev, (u8 *)&header, 
 					off, sizeof(struct cpio_newc_header));
 		if (!rd) {
 			return VMM_EIO;
@@ -372,7 +372,7 @@ static int cpiofs_lookup(struct vnode *dv, const char *name, struct vnode *v)
 		memcpy(buf, &header.c_mtime, 8);
 		mtime = strtoul((const char *)buf, NULL, 16);
 
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)path, 
+		rd = vfs_bcache_read(dv->v_mount->m_dev, (u8 *)path, 
 			off + sizeof(struct cpio_newc_header), name_size);
 		if (!rd) {
 			return VMM_EIO;
@@ -26,6 +26,7 @@
 #include <vmm_wallclock.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <libs/vfs.h>
 
 #include "ext4_control.h"
 
@@ -46,7 +47,7 @@ int ext4fs_devread(struct ext4fs_control *ctrl,
 	off = ((u64)blkno << (ctrl->log2_block_size + EXT2_SECTOR_BITS));
 	off += blkoff;
 	len = buf_len;
-	len = vmm_blockdev_read(ctrl->bdev, (u8 *)buf, off, len);
+	len = vfs_bcache_read(ctrl->bdev, (u8 *)buf, off, len);
 
 	return (len == buf_len) ? VMM_OK : VMM_EIO;
 }
@@ -59,7 +60,7 @@ int ext4fs_devwrite(struct ext4fs_control *ctrl,
 	off = ((u64)blkno << (ctrl->log2_block_size + EXT2_SECTOR_BITS));
 	off += blkoff;
 	len = buf_len;
-	len = vmm_blockdev_write(ctrl->bdev, (u8 *)buf, off, len);
+	len = vfs_bcache_write(ctrl->bdev, (u8 *)buf, off, len);
 
 	return (len == buf_len) ? VMM_OK : VMM_EIO;
 }
@@ -345,7 +346,7 @@ int ext4fs_control_sync(struct ext4fs_control *ctrl)
 
 	if (ctrl->sblock_dirty) {
 		/* Write superblock to block device */
-		wr = vmm_blockdev_write(ctrl->bdev, (u8 *)&ctrl->sblock, 
+		wr = vfs_bcache_write(ctrl->bdev, (u8 *)&ctrl->sblock, 
 					1024, sizeof(struct ext2_sblock));
 		if (wr != sizeof(struct ext2_sblock)) {
 			vmm_mutex_unlock(&ctrl->sblock_lock);
@@ -411,7 +412,7 @@ int ext4fs_control_sync(struct ext4fs_control *ctrl)
 	}
 
 	/* Flush cached data in device request queue */
-	rc = vmm_blockdev_flush_cache(ctrl->bdev);
+	rc = vfs_bcache_sync(ctrl->bdev);
 	if (rc) {
 		return rc;
 	}
@@ -433,8 +434,8 @@ int ext4fs_control_init(struct ext4fs_control *ctrl,
 	INIT_MUTEX(&ctrl->sblock_lock);
 
 	/* Read the superblock.  */
-	sb_read = vmm_blockdev_read(bdev, (u8 *)&ctrl->sblock, 
-				    1024, sizeof(struct ext2_sblock));
+	sb_read = vfs_bcache_read(bdev, (u8 *)&ctrl->sblock, 
+				  1024, sizeof(struct ext2_sblock));
 	if (sb_read != sizeof(struct ext2_sblock)) {
 		rc = VMM_EIO;
 		goto fail;
@@ -100,6 +100,29 @@ int ext4fs_node_read_blk(struct ext4fs_node *node,
 	return VMM_OK;
 }
 
+int ext4fs_node_read_blks(struct ext4fs_node *node,
+			  u32 blkno, u32 blkcnt, char *buf)
+{
+	int rc;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	/* Write back cached block if it is part of the read */
+	if (node->cached_block && node->cached_dirty &&
+	    (blkno <= node->cached_blkno) &&
+	    (node->cached_blkno < (blkno + blkcnt))) {
+		rc = ext4fs_devwrite(ctrl, node->cached_blkno,
+				    0, ctrl->block_size,
+				    (char *)node->cached_block);
+		if (rc) {
+			return rc;
+		}
+		node->cached_dirty = FALSE;
+	}
+
+	return ext4fs_devread(ctrl, blkno, 0,
+			      blkcnt * ctrl->block_size, buf);
+}
+
 int ext4fs_node_write_blk(struct ext4fs_node *node,
 			  u32 blkno, u32 blkoff, u32 blklen, char *buf)
 {
@@ -387,7 +410,7 @@ u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 {
 	int rc;
 	u64 filesize = ext4fs_node_get_size(node);
-	u32 i, rlen, blkno, blkoff, blklen;
+	u32 i, rlen, blkno, nblkno, blkcnt, blkoff, blklen;
 	u32 last_blkpos, last_blklen;
 	u32 first_blkpos, first_blkoff, first_blklen;
 	struct ext4fs_control *ctrl = node->ctrl;
@@ -433,15 +456,37 @@ u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 			blklen = ctrl->block_size;
 		}
 
-		/* Read cached block */
-		rc = ext4fs_node_read_blk(node, blkno, blkoff, blklen, buf);
+		/* Find run of full blocks contiguous on disk */
+		blkcnt = 1;
+		if (blkno && !blkoff && (blklen == ctrl->block_size)) {
+			while (((blkcnt + 1) * ctrl->block_size) <= rlen) {
+				rc = ext4fs_node_read_blkno(node, i + blkcnt,
+							    &nblkno);
+				if (rc || (nblkno != (blkno + blkcnt))) {
+					break;
+				}
+				blkcnt++;
+			}
+		}
+
+		if (1 < blkcnt) {
+			/* Read whole run with one large read so that
+			 * block cache can pass it to block device.
+			 */
+			blklen = blkcnt * ctrl->block_size;
+			rc = ext4fs_node_read_blks(node, blkno, blkcnt, buf);
+		} else {
+			/* Read cached block */
+			rc = ext4fs_node_read_blk(node, blkno,
+						  blkoff, blklen, buf);
+		}
 		if (rc) {
 			goto done;
 		}
 
 		buf += blklen;
 		rlen -= blklen;
-		i++;
+		i += blkcnt;
 	}
 
 done:
@@ -80,6 +80,9 @@ void ext4fs_node_set_size(struct ext4fs_node *node, u64 size);
 int ext4fs_node_read_blk(struct ext4fs_node *node,
 			 u32 blkno, u32 blkoff, u32 blklen, char *buf);
 
+int ext4fs_node_read_blks(struct ext4fs_node *node,
+			  u32 blkno, u32 blkcnt, char *buf);
+
 int ext4fs_node_write_blk(struct ext4fs_node *node,
 			  u32 blkno, u32 blkoff, u32 blklen, char *buf);
 
@@ -45,7 +45,7 @@ static int __fatfs_control_flush_fat_cache(struct fatfs_control *ctrl,
 				  (i * ctrl->sectors_per_fat)) * 
 			   ctrl->bytes_per_sector;
 		sect_num = ctrl->fat_cache_num[index];
-		len = vmm_blockdev_write(ctrl->bdev, 
+		len = vfs_bcache_write(ctrl->bdev, 
 			&ctrl->fat_cache_buf[index * ctrl->bytes_per_sector], 
 			fat_base + sect_num * ctrl->bytes_per_sector, 
 			ctrl->bytes_per_sector);
@@ -96,7 +96,7 @@ static int __fatfs_control_load_fat_cache(struct fatfs_control *ctrl,
 	}
 
 	fat_base = (u64)ctrl->first_fat_sector * ctrl->bytes_per_sector;
-	len = vmm_blockdev_read(ctrl->bdev, 
+	len = vfs_bcache_read(ctrl->bdev, 
 			&ctrl->fat_cache_buf[index * ctrl->bytes_per_sector], 
 			fat_base + sect_num * ctrl->bytes_per_sector, 
 			ctrl->bytes_per_sector);
@@ -698,7 +698,7 @@ int fatfs_control_sync(struct fatfs_control *ctrl)
 	vmm_mutex_unlock(&ctrl->fat_cache_lock);
 
 	/* Flush cached data in device request queue */
-	rc = vmm_blockdev_flush_cache(ctrl->bdev);
+	rc = vfs_bcache_sync(ctrl->bdev);
 	if (rc) {
 		return rc;
 	}
@@ -713,7 +713,7 @@ int fatfs_control_init(struct fatfs_control *ctrl, struct vmm_blockdev *bdev)
 	struct fat_bootsec *bsec = &ctrl->bsec;
 
 	/* Read boot sector from block device */
-	rlen = vmm_blockdev_read(bdev, (u8 *)bsec,
+	rlen = vfs_bcache_read(bdev, (u8 *)bsec,
 				FAT_BOOTSECTOR_OFFSET, 
 				sizeof(struct fat_bootsec));
 	if (rlen != sizeof(struct fat_bootsec)) {
@@ -821,7 +821,7 @@ int fatfs_control_init(struct fatfs_control *ctrl, struct vmm_blockdev *bdev)
 	}
 
 	/* Load fat cache */
-	rlen = vmm_blockdev_read(ctrl->bdev, ctrl->fat_cache_buf, 
+	rlen = vfs_bcache_read(ctrl->bdev, ctrl->fat_cache_buf, 
 			ctrl->first_fat_sector * ctrl->bytes_per_sector, 
 			FAT_TABLE_CACHE_SIZE * ctrl->bytes_per_sector);
 	if (rlen != (FAT_TABLE_CACHE_SIZE * ctrl->bytes_per_sector)) {
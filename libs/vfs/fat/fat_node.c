@@ -120,7 +120,7 @@ static int fatfs_node_sync_cached_cluster(struct fatfs_node *node)
 		woff = (u64)ctrl->first_data_sector * ctrl->bytes_per_sector;
 		woff += (u64)(node->cached_clust - 2) * ctrl->bytes_per_cluster;
 
-		wlen = vmm_blockdev_write(ctrl->bdev, 
+		wlen = vfs_bcache_write(ctrl->bdev, 
 					node->cached_data, 
 					woff, ctrl->bytes_per_cluster);
 		if (wlen != ctrl->bytes_per_cluster) {
@@ -191,7 +191,7 @@ u32 fatfs_node_read(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 		}
 		roff = (u64)ctrl->first_root_sector * ctrl->bytes_per_sector;
 		roff += pos;
-		return vmm_blockdev_read(ctrl->bdev, (u8 *)buf, roff, rlen);
+		return vfs_bcache_read(ctrl->bdev, (u8 *)buf, roff, rlen);
 	}
 
 	/* Allocate cached cluster memory if not already allocated */
@@ -239,7 +239,7 @@ u32 fatfs_node_read(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 			roff = (u64)ctrl->first_data_sector * 
 						ctrl->bytes_per_sector;
 			roff += (u64)(cl_num - 2) * ctrl->bytes_per_cluster;
-			rlen = vmm_blockdev_read(ctrl->bdev, 
+			rlen = vfs_bcache_read(ctrl->bdev, 
 						node->cached_data, 
 						roff, ctrl->bytes_per_cluster);
 			if (rlen != ctrl->bytes_per_cluster) {
@@ -277,7 +277,7 @@ u32 fatfs_node_write(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 		}
 		woff = (u64)ctrl->first_root_sector * ctrl->bytes_per_sector;
 		woff += pos;
-		return vmm_blockdev_write(ctrl->bdev, (u8 *)buf, woff, wlen);
+		return vfs_bcache_write(ctrl->bdev, (u8 *)buf, woff, wlen);
 	}
 
 	wstartcl = udiv32(pos, ctrl->bytes_per_cluster);
@@ -340,7 +340,7 @@ u32 fatfs_node_write(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 		/* Write zeros to new cluster */
 		woff = (u64)ctrl->first_data_sector * ctrl->bytes_per_sector;
 		woff += (u64)(cl_num - 2) * ctrl->bytes_per_cluster;
-		wlen = vmm_blockdev_write(ctrl->bdev, 
+		wlen = vfs_bcache_write(ctrl->bdev, 
 					node->cached_data, 
 					woff, ctrl->bytes_per_cluster);
 		if (wlen != ctrl->bytes_per_cluster) {
@@ -365,7 +365,7 @@ u32 fatfs_node_write(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 		woff = (u64)ctrl->first_data_sector * ctrl->bytes_per_sector;
 		woff += (u64)(cl_num - 2) * ctrl->bytes_per_cluster;
 		woff += cl_off;
-		wlen = vmm_blockdev_write(ctrl->bdev, buf, woff, cl_len);
+		wlen = vfs_bcache_write(ctrl->bdev, buf, woff, cl_len);
 		if (wlen != cl_len) {
 			break;
 		}
@@ -205,9 +205,9 @@ static int iso9660fs_mount(struct mount *m, const char *dev, u32 flags)
 
 	mdata->mdev = m->m_dev;
 
-	read_count = vmm_blockdev_read(m->m_dev, (u8 *)(&mdata->vol_desc),
-				       VOL_DESC_START_OFFS,
-				       sizeof(struct primary_vol_desc));
+	read_count = vfs_bcache_read(m->m_dev, (u8 *)(&mdata->vol_desc),
+				     VOL_DESC_START_OFFS,
+				     sizeof(struct primary_vol_desc));
 	if (read_count != sizeof(struct primary_vol_desc)) {
 		retval = VMM_EIO;
 		goto _fail;
@@ -234,9 +234,9 @@ static int iso9660fs_mount(struct mount *m, const char *dev, u32 flags)
 		goto _fail;
 	}
 
-	rd = vmm_blockdev_read(m->m_dev, (u8 *)mdata->root_dir,
-			       mdata->root_dir_offset,
-			       mdata->root_dir_len);
+	rd = vfs_bcache_read(m->m_dev, (u8 *)mdata->root_dir,
+			     mdata->root_dir_offset,
+			     mdata->root_dir_len);
 	if (!rd || rd != mdata->root_dir_len) {
 		retval = VMM_EIO;
 		goto _fail;
@@ -310,7 +310,7 @@ static size_t iso9660fs_read(struct vnode *v, loff_t off, void *buf, size_t len)
 	}
 
 	toff = (u64)(v->v_data);
-	sz = vmm_blockdev_read(v->v_mount->m_dev, (u8 *)buf, (toff + off), sz);
+	sz = vfs_bcache_read(v->v_mount->m_dev, (u8 *)buf, (toff + off), sz);
 
 	return sz;
 }
@@ -412,9 +412,9 @@ static struct dir_entry *path_to_dentry(struct vmm_blockdev *mdev,
 	dentry = lookup_dentry(dirname, pdentry);
 	if (dentry) {
 		d_root = vmm_zalloc(dentry->dlen.lsb);
-		rd = vmm_blockdev_read(mdev, (u8 *)d_root,
-				       (dentry->start_lba.lsb * 2048),
-				       dentry->dlen.lsb);
+		rd = vfs_bcache_read(mdev, (u8 *)d_root,
+				     (dentry->start_lba.lsb * 2048),
+				     dentry->dlen.lsb);
 		if (rd != dentry->dlen.lsb) {
 			vmm_free(d_root);
 			return NULL;
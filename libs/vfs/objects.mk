@@ -21,5 +21,14 @@
 # @brief list of fs objects to be build
 # */
 
-libs-objs-$(CONFIG_VFS)+= vfs/vfs.o
+libs-objs-$(CONFIG_VFS)+= vfs/vfs_mod.o
+
+vfs_mod-y += vfs.o
+vfs_mod-y += vfs_bcache.o
+
+%/vfs_mod.o: $(foreach obj,$(vfs_mod-y),%/$(obj))
+	$(call merge_objs,$@,$^)
+
+%/vfs_mod.dep: $(foreach dep,$(vfs_mod-y:.o=.dep),%/$(dep))
+	$(call merge_deps,$@,$^)
 
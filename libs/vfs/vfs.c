@@ -578,6 +578,9 @@ static void vfs_force_unmount(struct mount *m)
 	m->m_fs->unmount(m);
 	vmm_mutex_unlock(&m->m_lock);
 
+	/* Detach block device from buffer cache */
+	vfs_bcache_detach(m->m_dev);
+
 	/* Release covering filesystem vnode */
 	if (m->m_covered) {
 		vfs_vnode_release(m->m_covered);
@@ -710,11 +713,23 @@ int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags)
 	v->v_mode = S_IFDIR | S_IRWXU | S_IRWXG | S_IRWXO;
 	m->m_root = v;
 
+	/* attach block device to buffer cache. */
+	err = vfs_bcache_attach(bdev);
+	if (err != 0) {
+		vfs_vnode_release(m->m_root);
+		if (m->m_covered) {
+			vfs_vnode_release(m->m_covered);
+		}
+		vmm_free(m);
+		return err;
+	}
+
 	/* call a file system specific routine. */
 	vmm_mutex_lock(&m->m_lock);
 	err = m->m_fs->mount(m, dev, flags);
 	vmm_mutex_unlock(&m->m_lock);
 	if (err != 0) {
+		vfs_bcache_detach(bdev);
 		vfs_vnode_release(m->m_root);
 		if (m->m_covered) {
 			vfs_vnode_release(m->m_covered);
@@ -737,6 +752,7 @@ int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags)
 			vmm_mutex_lock(&m->m_lock);
 			m->m_fs->unmount(m);
 			vmm_mutex_unlock(&m->m_lock);
+			vfs_bcache_detach(bdev);
 			vfs_vnode_release(m->m_root);
 			if (m->m_covered) {
 				vfs_vnode_release(m->m_covered);
@@ -797,6 +813,9 @@ int vfs_unmount(const char *path)
 	m->m_fs->unmount(m);
 	vmm_mutex_unlock(&m->m_lock);
 
+	/* detach block device from buffer cache */
+	vfs_bcache_detach(m->m_dev);
+
 	/* releae mount point root */
 	vfs_vnode_release(m->m_root);
 
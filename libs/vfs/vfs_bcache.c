@@ -0,0 +1,691 @@
+/**
+ * Copyright (c) 2026 Xvisor Developers.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vfs_bcache.c
+ * @author Xvisor Developers
+ * @brief Buffer cache shared by filesystems of light-weight VFS
+ *
+ * Block devices are cached in units of VFS_BCACHE_BLOCK_SIZE bytes. Each
+ * attached block device has a radix tree of cached blocks indexed by
+ * block number and all cached blocks are kept on one global LRU list.
+ * Writes are cached (write-back) and written to block device in runs of
+ * contiguous dirty blocks. Read misses fetch a readahead window which is
+ * doubled for sequential access. Large block aligned transfers bypass the
+ * cache so that loading big images does not evict filesystem metadata.
+ *
+ * Each device has its own lock which is held across block device I/O
+ * of that device. The global lock only protects device list, LRU list
+ * and buffer count so it is never held across block device I/O.
+ * Lock ordering is device lock followed by global lock. Recycling a
+ * buffer of another device only try-locks that device.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_mutex.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_host_aspace.h>
+#include <libs/stringlib.h>
+#include <libs/radix-tree.h>
+#include <libs/vfs.h>
+
+#define BCACHE_BLOCK_SHIFT		VFS_BCACHE_BLOCK_SHIFT
+#define BCACHE_BLOCK_SIZE		VFS_BCACHE_BLOCK_SIZE
+#define BCACHE_BLOCK_MASK		(BCACHE_BLOCK_SIZE - 1)
+#define BCACHE_RA_MIN			4
+#define BCACHE_RA_MAX			32
+#define BCACHE_DIRECT_BLOCKS		BCACHE_RA_MAX
+#define BCACHE_MIN_BUFS			(4 * BCACHE_RA_MAX)
+#define BCACHE_GANG_SIZE		16
+
+struct bcache_dev;
+
+struct bcache_buf {
+	struct dlist lru;
+	struct bcache_dev *dev;
+	unsigned long blk;
+	bool dirty;
+	u8 *data;
+};
+
+struct bcache_dev {
+	struct dlist head;
+	struct vmm_mutex lock;
+	struct vmm_blockdev *bdev;
+	u32 refcnt;
+	unsigned long blk_count;
+	struct radix_tree_root tree;
+	u32 nr_dirty;
+	unsigned long ra_next;
+	u32 ra_blocks;
+	u8 *io_buf;
+};
+
+struct bcache_ctrl {
+	struct vmm_mutex lock;
+	struct dlist dev_list;
+	struct dlist lru_list;
+	u32 nr_bufs;
+	u32 max_bufs;
+};
+
+static struct bcache_ctrl bcc = {
+	.lock = __MUTEX_INITIALIZER(bcc.lock),
+	.dev_list = LIST_HEAD_INIT(bcc.dev_list),
+	.lru_list = LIST_HEAD_INIT(bcc.lru_list),
+	.nr_bufs = 0,
+	.max_bufs = 0,
+};
+
+static u32 bcache_max_bufs(void)
+{
+	if (!bcc.max_bufs) {
+		bcc.max_bufs = (CONFIG_VFS_BCACHE_SIZE * 1024) /
+							BCACHE_BLOCK_SIZE;
+		if (bcc.max_bufs < BCACHE_MIN_BUFS) {
+			bcc.max_bufs = BCACHE_MIN_BUFS;
+		}
+	}
+
+	return bcc.max_bufs;
+}
+
+/* NOTE: This function must be called with bcc.lock held */
+static struct bcache_dev *bcache_dev_find(struct vmm_blockdev *bdev)
+{
+	struct bcache_dev *dev;
+
+	list_for_each_entry(dev, &bcc.dev_list, head) {
+		if (dev->bdev == bdev) {
+			return dev;
+		}
+	}
+
+	return NULL;
+}
+
+/* Write back run of contiguous dirty blocks starting at given block
+ * NOTE: This function must be called with dev->lock held
+ */
+static int bcache_write_run(struct bcache_dev *dev, unsigned long blk,
+			    unsigned long end)
+{
+	u32 i, count;
+	u64 wlen;
+	struct bcache_buf *b, *run[BCACHE_RA_MAX];
+
+	for (count = 0; (count < BCACHE_RA_MAX) && (blk + count < end);
+	     count++) {
+		b = radix_tree_lookup(&dev->tree, blk + count);
+		if (!b || !b->dirty) {
+			break;
+		}
+		run[count] = b;
+		memcpy(dev->io_buf + (count << BCACHE_BLOCK_SHIFT),
+			b->data, BCACHE_BLOCK_SIZE);
+	}
+	if (!count) {
+		return VMM_OK;
+	}
+
+	wlen = vmm_blockdev_write(dev->bdev, dev->io_buf,
+				  (u64)blk << BCACHE_BLOCK_SHIFT,
+				  (u64)count << BCACHE_BLOCK_SHIFT);
+	if (wlen != ((u64)count << BCACHE_BLOCK_SHIFT)) {
+		return VMM_EIO;
+	}
+
+	for (i = 0; i < count; i++) {
+		run[i]->dirty = FALSE;
+		dev->nr_dirty--;
+	}
+
+	return count;
+}
+
+/* Write back dirty blocks in range [blk, end)
+ * NOTE: This function must be called with dev->lock held
+ */
+static int bcache_writeback(struct bcache_dev *dev,
+			    unsigned long blk, unsigned long end)
+{
+	int rc;
+	u32 i, found;
+	struct bcache_buf *bufs[BCACHE_GANG_SIZE];
+
+	while (dev->nr_dirty && (blk < end)) {
+		found = radix_tree_gang_lookup(&dev->tree, (void **)bufs,
+					       blk, BCACHE_GANG_SIZE);
+		if (!found) {
+			break;
+		}
+
+		for (i = 0; i < found; i++) {
+			if (end <= bufs[i]->blk) {
+				return VMM_OK;
+			}
+			if (bufs[i]->blk < blk || !bufs[i]->dirty) {
+				continue;
+			}
+			rc = bcache_write_run(dev, bufs[i]->blk, end);
+			if (rc < 0) {
+				return rc;
+			}
+			blk = bufs[i]->blk + rc;
+		}
+
+		if (blk <= bufs[found - 1]->blk) {
+			blk = bufs[found - 1]->blk + 1;
+		}
+	}
+
+	return VMM_OK;
+}
+
+/* Take least recently used buffer away from its device. Buffers of
+ * other devices are only taken when their device lock is free.
+ * NOTE: This function must be called with dev->lock held
+ */
+static struct bcache_buf *bcache_buf_steal(struct bcache_dev *dev)
+{
+	bool found = FALSE;
+	struct bcache_buf *b;
+	struct bcache_dev *odev = NULL;
+
+	vmm_mutex_lock(&bcc.lock);
+	list_for_each_entry_reverse(b, &bcc.lru_list, lru) {
+		odev = b->dev;
+		if ((odev == dev) || vmm_mutex_trylock(&odev->lock)) {
+			list_del(&b->lru);
+			found = TRUE;
+			break;
+		}
+	}
+	vmm_mutex_unlock(&bcc.lock);
+	if (!found) {
+		return NULL;
+	}
+
+	if (b->dirty &&
+	    (bcache_write_run(odev, b->blk, odev->blk_count) < 0)) {
+		vmm_mutex_lock(&bcc.lock);
+		list_add_tail(&b->lru, &bcc.lru_list);
+		vmm_mutex_unlock(&bcc.lock);
+		b = NULL;
+	} else {
+		radix_tree_delete(&odev->tree, b->blk);
+		b->dev = NULL;
+	}
+
+	if (odev != dev) {
+		vmm_mutex_unlock(&odev->lock);
+	}
+
+	return b;
+}
+
+/* NOTE: This function must be called with dev->lock held */
+static struct bcache_buf *bcache_buf_alloc(struct bcache_dev *dev,
+					   unsigned long blk)
+{
+	bool grow;
+	struct bcache_buf *b;
+
+	vmm_mutex_lock(&bcc.lock);
+	grow = (bcc.nr_bufs < bcache_max_bufs()) ? TRUE : FALSE;
+	if (grow) {
+		bcc.nr_bufs++;
+	}
+	vmm_mutex_unlock(&bcc.lock);
+
+	if (grow) {
+		b = vmm_zalloc(sizeof(*b));
+		if (b) {
+			b->data = (u8 *)vmm_host_alloc_pages(
+				VMM_SIZE_TO_PAGE(BCACHE_BLOCK_SIZE),
+				VMM_MEMORY_FLAGS_NORMAL);
+			if (!b->data) {
+				vmm_free(b);
+				b = NULL;
+			}
+		}
+	} else {
+		/* Recycle least recently used block */
+		b = bcache_buf_steal(dev);
+	}
+	if (!b) {
+		goto fail;
+	}
+
+	b->dev = dev;
+	b->blk = blk;
+	b->dirty = FALSE;
+	if (radix_tree_insert(&dev->tree, blk, b)) {
+		vmm_host_free_pages((virtual_addr_t)b->data,
+				    VMM_SIZE_TO_PAGE(BCACHE_BLOCK_SIZE));
+		vmm_free(b);
+		grow = TRUE;
+		goto fail;
+	}
+
+	vmm_mutex_lock(&bcc.lock);
+	list_add(&b->lru, &bcc.lru_list);
+	vmm_mutex_unlock(&bcc.lock);
+
+	return b;
+
+fail:
+	if (grow) {
+		vmm_mutex_lock(&bcc.lock);
+		bcc.nr_bufs--;
+		vmm_mutex_unlock(&bcc.lock);
+	}
+	return NULL;
+}
+
+/* NOTE: This function must be called with dev->lock held */
+static void bcache_buf_free(struct bcache_buf *b)
+{
+	vmm_mutex_lock(&bcc.lock);
+	list_del(&b->lru);
+	bcc.nr_bufs--;
+	vmm_mutex_unlock(&bcc.lock);
+
+	radix_tree_delete(&b->dev->tree, b->blk);
+	b->dev = NULL;
+
+	vmm_host_free_pages((virtual_addr_t)b->data,
+			    VMM_SIZE_TO_PAGE(BCACHE_BLOCK_SIZE));
+	vmm_free(b);
+}
+
+/* Get cached block and read it (with readahead) when fill is TRUE
+ * NOTE: This function must be called with dev->lock held
+ */
+static struct bcache_buf *bcache_getblk(struct bcache_dev *dev,
+					unsigned long blk, bool fill)
+{
+	u64 rlen;
+	u32 i, count;
+	struct bcache_buf *b, *ra[BCACHE_RA_MAX];
+
+	b = radix_tree_lookup(&dev->tree, blk);
+	if (b) {
+		vmm_mutex_lock(&bcc.lock);
+		list_del(&b->lru);
+		list_add(&b->lru, &bcc.lru_list);
+		vmm_mutex_unlock(&bcc.lock);
+		return b;
+	}
+
+	if (!fill) {
+		return bcache_buf_alloc(dev, blk);
+	}
+
+	/* Grow readahead window for sequential misses */
+	if (blk == dev->ra_next) {
+		dev->ra_blocks = (dev->ra_blocks < BCACHE_RA_MAX / 2) ?
+				 dev->ra_blocks * 2 : BCACHE_RA_MAX;
+	} else {
+		dev->ra_blocks = BCACHE_RA_MIN;
+	}
+
+	for (count = 1; (count < dev->ra_blocks) &&
+			(blk + count < dev->blk_count); count++) {
+		if (radix_tree_lookup(&dev->tree, blk + count)) {
+			break;
+		}
+	}
+
+	/* Allocate blocks before reading because recycling a dirty
+	 * block writes it back using io_buf of its device.
+	 * Insert in reverse so that requested block is most recent.
+	 */
+	for (i = count; i > 0; i--) {
+		ra[i - 1] = bcache_buf_alloc(dev, blk + i - 1);
+		if (!ra[i - 1]) {
+			goto fail;
+		}
+	}
+
+	rlen = vmm_blockdev_read(dev->bdev, dev->io_buf,
+				 (u64)blk << BCACHE_BLOCK_SHIFT,
+				 (u64)count << BCACHE_BLOCK_SHIFT);
+	if (rlen != ((u64)count << BCACHE_BLOCK_SHIFT)) {
+		i = 0;
+		goto fail;
+	}
+	dev->ra_next = blk + count;
+
+	for (i = 0; i < count; i++) {
+		memcpy(ra[i]->data, dev->io_buf + (i << BCACHE_BLOCK_SHIFT),
+			BCACHE_BLOCK_SIZE);
+	}
+
+	return ra[0];
+
+fail:
+	for (; i < count; i++) {
+		bcache_buf_free(ra[i]);
+	}
+	return NULL;
+}
+
+u64 vfs_bcache_read(struct vmm_blockdev *bdev, u8 *buf, u64 off, u64 len)
+{
+	u64 done, chunk, rlen;
+	u32 boff;
+	unsigned long blk, nblks;
+	struct bcache_buf *b;
+	struct bcache_dev *dev;
+
+	vmm_mutex_lock(&bcc.lock);
+	dev = bcache_dev_find(bdev);
+	vmm_mutex_unlock(&bcc.lock);
+	if (!dev || !dev->blk_count) {
+		return vmm_blockdev_read(bdev, buf, off, len);
+	}
+
+	vmm_mutex_lock(&dev->lock);
+
+	done = 0;
+	while (done < len) {
+		blk = (off + done) >> BCACHE_BLOCK_SHIFT;
+		boff = (off + done) & BCACHE_BLOCK_MASK;
+
+		/* Partial block at end of device is not cached */
+		if (dev->blk_count <= blk) {
+			done += vmm_blockdev_read(bdev, buf + done,
+						  off + done, len - done);
+			break;
+		}
+
+		/* Large aligned read goes directly to block device */
+		nblks = (len - done) >> BCACHE_BLOCK_SHIFT;
+		if (!boff && (BCACHE_DIRECT_BLOCKS <= nblks)) {
+			if (dev->blk_count < blk + nblks) {
+				nblks = dev->blk_count - blk;
+			}
+			if (bcache_writeback(dev, blk, blk + nblks)) {
+				break;
+			}
+			chunk = (u64)nblks << BCACHE_BLOCK_SHIFT;
+			rlen = vmm_blockdev_read(bdev, buf + done,
+						 off + done, chunk);
+			done += rlen;
+			if (rlen != chunk) {
+				break;
+			}
+			continue;
+		}
+
+		b = bcache_getblk(dev, blk, TRUE);
+		if (!b) {
+			break;
+		}
+
+		chunk = BCACHE_BLOCK_SIZE - boff;
+		if ((len - done) < chunk) {
+			chunk = len - done;
+		}
+		memcpy(buf + done, b->data + boff, chunk);
+		done += chunk;
+	}
+
+	vmm_mutex_unlock(&dev->lock);
+
+	return done;
+}
+VMM_EXPORT_SYMBOL(vfs_bcache_read);
+
+/* Update cached blocks in range [blk, blk + nblks) with written data
+ * NOTE: This function must be called with dev->lock held
+ */
+static void bcache_update_range(struct bcache_dev *dev, unsigned long blk,
+				unsigned long nblks, u8 *buf)
+{
+	u32 i, found;
+	unsigned long first = blk;
+	struct bcache_buf *b, *bufs[BCACHE_GANG_SIZE];
+
+	while (first < (blk + nblks)) {
+		found = radix_tree_gang_lookup(&dev->tree, (void **)bufs,
+					       first, BCACHE_GANG_SIZE);
+		if (!found) {
+			break;
+		}
+		for (i = 0; i < found; i++) {
+			b = bufs[i];
+			if ((blk + nblks) <= b->blk) {
+				break;
+			}
+			memcpy(b->data,
+			       buf + ((u64)(b->blk - blk) << BCACHE_BLOCK_SHIFT),
+			       BCACHE_BLOCK_SIZE);
+			if (b->dirty) {
+				b->dirty = FALSE;
+				dev->nr_dirty--;
+			}
+		}
+		first = bufs[found - 1]->blk + 1;
+	}
+}
+
+u64 vfs_bcache_write(struct vmm_blockdev *bdev, u8 *buf, u64 off, u64 len)
+{
+	u64 done, chunk, wlen;
+	u32 boff;
+	unsigned long blk, nblks;
+	struct bcache_buf *b;
+	struct bcache_dev *dev;
+
+	vmm_mutex_lock(&bcc.lock);
+	dev = bcache_dev_find(bdev);
+	vmm_mutex_unlock(&bcc.lock);
+	if (!dev || !dev->blk_count) {
+		return vmm_blockdev_write(bdev, buf, off, len);
+	}
+
+	vmm_mutex_lock(&dev->lock);
+
+	done = 0;
+	while (done < len) {
+		blk = (off + done) >> BCACHE_BLOCK_SHIFT;
+		boff = (off + done) & BCACHE_BLOCK_MASK;
+
+		/* Partial block at end of device is not cached */
+		if (dev->blk_count <= blk) {
+			done += vmm_blockdev_write(bdev, buf + done,
+						   off + done, len - done);
+			break;
+		}
+
+		/* Large aligned write goes directly to block device
+		 * and updates already cached blocks in the range.
+		 */
+		nblks = (len - done) >> BCACHE_BLOCK_SHIFT;
+		if (!boff && (BCACHE_DIRECT_BLOCKS <= nblks)) {
+			if (dev->blk_count < blk + nblks) {
+				nblks = dev->blk_count - blk;
+			}
+			chunk = (u64)nblks << BCACHE_BLOCK_SHIFT;
+			wlen = vmm_blockdev_write(bdev, buf + done,
+						  off + done, chunk);
+			if (wlen != chunk) {
+				done += wlen;
+				break;
+			}
+			bcache_update_range(dev, blk, nblks, buf + done);
+			done += chunk;
+			continue;
+		}
+
+		chunk = BCACHE_BLOCK_SIZE - boff;
+		if ((len - done) < chunk) {
+			chunk = len - done;
+		}
+
+		b = bcache_getblk(dev, blk, (chunk != BCACHE_BLOCK_SIZE));
+		if (!b) {
+			break;
+		}
+
+		memcpy(b->data + boff, buf + done, chunk);
+		if (!b->dirty) {
+			b->dirty = TRUE;
+			dev->nr_dirty++;
+		}
+		done += chunk;
+	}
+
+	/* Do not let dirty blocks take over the cache */
+	if ((bcache_max_bufs() / 2) < dev->nr_dirty) {
+		bcache_writeback(dev, 0, dev->blk_count);
+	}
+
+	vmm_mutex_unlock(&dev->lock);
+
+	return done;
+}
+VMM_EXPORT_SYMBOL(vfs_bcache_write);
+
+int vfs_bcache_sync(struct vmm_blockdev *bdev)
+{
+	int rc = VMM_OK;
+	struct bcache_dev *dev;
+
+	vmm_mutex_lock(&bcc.lock);
+	dev = bcache_dev_find(bdev);
+	vmm_mutex_unlock(&bcc.lock);
+	if (dev) {
+		vmm_mutex_lock(&dev->lock);
+		rc = bcache_writeback(dev, 0, dev->blk_count);
+		vmm_mutex_unlock(&dev->lock);
+	}
+
+	if (rc) {
+		return rc;
+	}
+
+	return vmm_blockdev_flush_cache(bdev);
+}
+VMM_EXPORT_SYMBOL(vfs_bcache_sync);
+
+int vfs_bcache_attach(struct vmm_blockdev *bdev)
+{
+	int rc = VMM_OK;
+	struct bcache_dev *dev;
+
+	if (!bdev) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&bcc.lock);
+
+	dev = bcache_dev_find(bdev);
+	if (dev) {
+		dev->refcnt++;
+		goto done;
+	}
+
+	dev = vmm_zalloc(sizeof(*dev));
+	if (!dev) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	INIT_LIST_HEAD(&dev->head);
+	INIT_MUTEX(&dev->lock);
+	dev->bdev = bdev;
+	dev->refcnt = 1;
+	INIT_RADIX_TREE(&dev->tree, 0);
+	dev->nr_dirty = 0;
+	dev->ra_next = 0;
+	dev->ra_blocks = BCACHE_RA_MIN;
+
+	/* Devices with blocks bigger than cache block are not cached */
+	if (bdev->block_size && (bdev->block_size <= BCACHE_BLOCK_SIZE) &&
+	    !(BCACHE_BLOCK_SIZE % bdev->block_size)) {
+		dev->blk_count = vmm_blockdev_total_size(bdev) >>
+							BCACHE_BLOCK_SHIFT;
+	} else {
+		dev->blk_count = 0;
+	}
+
+	if (dev->blk_count) {
+		dev->io_buf = (u8 *)vmm_host_alloc_pages(
+			VMM_SIZE_TO_PAGE(BCACHE_RA_MAX * BCACHE_BLOCK_SIZE),
+			VMM_MEMORY_FLAGS_NORMAL);
+		if (!dev->io_buf) {
+			vmm_free(dev);
+			rc = VMM_ENOMEM;
+			goto done;
+		}
+	}
+
+	list_add_tail(&dev->head, &bcc.dev_list);
+
+done:
+	vmm_mutex_unlock(&bcc.lock);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vfs_bcache_attach);
+
+void vfs_bcache_detach(struct vmm_blockdev *bdev)
+{
+	u32 i, found;
+	struct bcache_dev *dev;
+	struct bcache_buf *bufs[BCACHE_GANG_SIZE];
+
+	vmm_mutex_lock(&bcc.lock);
+
+	dev = bcache_dev_find(bdev);
+	if (!dev || --dev->refcnt) {
+		vmm_mutex_unlock(&bcc.lock);
+		return;
+	}
+
+	list_del(&dev->head);
+
+	vmm_mutex_unlock(&bcc.lock);
+
+	vmm_mutex_lock(&dev->lock);
+
+	if (bcache_writeback(dev, 0, dev->blk_count)) {
+		vmm_printf("%s: failed to write back %d blocks of %s\n",
+			   __func__, dev->nr_dirty, bdev->name);
+	}
+
+	while ((found = radix_tree_gang_lookup(&dev->tree, (void **)bufs,
+					       0, BCACHE_GANG_SIZE))) {
+		for (i = 0; i < found; i++) {
+			bcache_buf_free(bufs[i]);
+		}
+	}
+
+	vmm_mutex_unlock(&dev->lock);
+
+	if (dev->io_buf) {
+		vmm_host_free_pages((virtual_addr_t)dev->io_buf,
+			VMM_SIZE_TO_PAGE(BCACHE_RA_MAX * BCACHE_BLOCK_SIZE));
+	}
+	vmm_free(dev);
+}
+VMM_EXPORT_SYMBOL(vfs_bcache_detach);
@@ -49,7 +49,7 @@ static struct vstelnet_control vstc;
 static void vstelnet_flush_tx_buffer(struct vstelnet *vst)
 {
 	int rc;
-	u32 tx_count;
+	u32 tx_count, chunk;
 	irq_flags_t flags;
 	u8 tx_buf[VSTELNET_MAX_FLUSH_SIZE];
 
@@ -61,13 +61,21 @@ static void vstelnet_flush_tx_buffer(struct vstelnet *vst)
 		tx_count = 0;
 		while (vst->tx_buf_count &&
 		       (tx_count < VSTELNET_MAX_FLUSH_SIZE)) {
-			tx_buf[tx_count] = vst->tx_buf[vst->tx_buf_head];
-			vst->tx_buf_head++;
+			chunk = VSTELNET_TXBUF_SIZE - vst->tx_buf_head;
+			if (vst->tx_buf_count < chunk) {
+				chunk = vst->tx_buf_count;
+			}
+			if ((VSTELNET_MAX_FLUSH_SIZE - tx_count) < chunk) {
+				chunk = VSTELNET_MAX_FLUSH_SIZE - tx_count;
+			}
+			memcpy(&tx_buf[tx_count],
+			       &vst->tx_buf[vst->tx_buf_head], chunk);
+			vst->tx_buf_head += chunk;
 			if (vst->tx_buf_head >= VSTELNET_TXBUF_SIZE) {
 				vst->tx_buf_head = 0;
 			}
-			vst->tx_buf_count--;
-			tx_count++;
+			vst->tx_buf_count -= chunk;
+			tx_count += chunk;
 		}
 
 		/* Unlock connection state */
@@ -86,30 +94,49 @@ static void vstelnet_flush_tx_buffer(struct vstelnet *vst)
 	}
 }
 
-static void vstelnet_vserial_recv(struct vmm_vserial *vser, void *priv, u8 ch)
+static void vstelnet_vserial_recv(struct vmm_vserial *vser, void *priv,
+				  u8 *data, u32 len)
 {
+	u32 chunk;
 	irq_flags_t flags;
 	struct vstelnet *vst = priv;
 
+	/* Only last VSTELNET_TXBUF_SIZE bytes can be kept */
+	if (VSTELNET_TXBUF_SIZE < len) {
+		data += len - VSTELNET_TXBUF_SIZE;
+		len = VSTELNET_TXBUF_SIZE;
+	}
+
 	vmm_spin_lock_irqsave(&vst->tx_buf_lock, flags);
 
-	if (VSTELNET_TXBUF_SIZE == vst->tx_buf_count) {
-		vst->tx_buf_head++;
+	/* Drop oldest bytes when Tx buffer overflows */
+	if (VSTELNET_TXBUF_SIZE < (vst->tx_buf_count + len)) {
+		chunk = vst->tx_buf_count + len - VSTELNET_TXBUF_SIZE;
+		vst->tx_buf_head += chunk;
 		if (vst->tx_buf_head >= VSTELNET_TXBUF_SIZE) {
-			vst->tx_buf_head = 0;
+			vst->tx_buf_head -= VSTELNET_TXBUF_SIZE;
 		}
-		vst->tx_buf_count--;
+		vst->tx_buf_count -= chunk;
 	}
 
-	vst->tx_buf[vst->tx_buf_tail] = ch;
+	while (len) {
+		chunk = VSTELNET_TXBUF_SIZE - vst->tx_buf_tail;
+		if (len < chunk) {
+			chunk = len;
+		}
+
+		memcpy(&vst->tx_buf[vst->tx_buf_tail], data, chunk);
+
+		vst->tx_buf_tail += chunk;
+		if (vst->tx_buf_tail >= VSTELNET_TXBUF_SIZE) {
+			vst->tx_buf_tail = 0;
+		}
 
-	vst->tx_buf_tail++;
-	if (vst->tx_buf_tail >= VSTELNET_TXBUF_SIZE) {
-		vst->tx_buf_tail = 0;
+		vst->tx_buf_count += chunk;
+		data += chunk;
+		len -= chunk;
 	}
 
-	vst->tx_buf_count++;
-	
 	vmm_spin_unlock_irqrestore(&vst->tx_buf_lock, flags);
 }
 
@@ -209,7 +236,8 @@ struct vstelnet *vstelnet_create(u32 port, const char *vser_name)
 	INIT_SPIN_LOCK(&vst->tx_buf_lock);
 
 	vst->vser = vser;
-	if (vmm_vserial_register_receiver(vser, &vstelnet_vserial_recv, vst)) {
+	if (vmm_vserial_register_receiver_buf(vser, &vstelnet_vserial_recv,
+					      vst)) {
 		goto fail3;
 	}
 
@@ -230,7 +258,7 @@ struct vstelnet *vstelnet_create(u32 port, const char *vser_name)
 	return vst;
 
 fail4:
-	vmm_vserial_unregister_receiver(vser, &vstelnet_vserial_recv, vst);
+	vmm_vserial_unregister_receiver_buf(vser, &vstelnet_vserial_recv, vst);
 fail3:
 	netstack_socket_close(vst->sk);
 fail2:
@@ -257,8 +285,8 @@ int vstelnet_destroy(struct vstelnet *vst)
 
 	vmm_threads_destroy(vst->thread);
 
-	vmm_vserial_unregister_receiver(vst->vser, 
-					&vstelnet_vserial_recv, vst);
+	vmm_vserial_unregister_receiver_buf(vst->vser,
+					    &vstelnet_vserial_recv, vst);
 
 	if (vst->active_sk) {
 		netstack_socket_close(vst->active_sk);